@@ -21,6 +21,13 @@
  */
 
 #include "configuration.h"
+#include "udpev/rate_limiter.h"
+#include "udpev/recorder.h"
+#include "udpev/flow_table.h"
+#include "udpev/capture.h"
+#include "udpev/generator.h"
+
+bool __verbose = false;
 
 /* new_configuration */
 configuration_t *new_configuration()
@@ -32,6 +39,19 @@ configuration_t *new_configuration()
 	memset(cfg, 0, LEN__T_CONFIGURATION);
 	cfg->__tx_test = false;
 	cfg->__verbose = false;
+	cfg->relay_delay_min = DEFAULT__RELAY_DELAY_MIN;
+	cfg->relay_delay_max = DEFAULT__RELAY_DELAY_MAX;
+	cfg->nec_hop_limit = DEFAULT__NEC_HOP_LIMIT;
+	cfg->nec_traffic_class = DEFAULT__NEC_TRAFFIC_CLASS;
+	cfg->tx_queue_len = DEFAULT__TX_QUEUE_LEN;
+	cfg->tx_lifetime = DEFAULT__TX_LIFETIME;
+	cfg->rate_limit = DEFAULT__RATE_LIMIT;
+	cfg->rate_policy = RATE_POLICY_DROP;
+	cfg->replay_speed = DEFAULT__REPLAY_SPEED;
+	cfg->tx_rate = DEFAULT__TX_RATE;
+	cfg->tx_sizes = GENERATOR_FIXED;
+	cfg->tx_min_size = cfg->tx_max_size = DEFAULT__TX_SIZE;
+	cfg->tx_flows = 1;
 
 	return(cfg);
 
@@ -69,11 +89,46 @@ int read_configuration(int argc, char** argv, configuration_t* cfg)
 		{"ifname",	required_argument,	NULL,	'i'	},
 		{"txtest",  no_argument,		NULL,   's' },
 		{"nec",		no_argument,		NULL,	'n' },
+		{"relay",	no_argument,		NULL,	'R' },
+		{"relaydelay", required_argument, NULL,	'D' },
+		{"necwrap",	no_argument,		NULL,	'W' },
+		{"necrepeat",	no_argument,		NULL,	'P' },
+		{"nechops",	required_argument,	NULL,	'H' },
+		{"nectc",	required_argument,	NULL,	'C' },
+		{"txqlen",	required_argument,	NULL,	'Q' },
+		{"lifetime",	required_argument,	NULL,	'L' },
+		{"txclass",	required_argument,	NULL,	'K' },
+		{"ratelimit",	required_argument,	NULL,	'B' },
+		{"ratepolicy",	required_argument,	NULL,	'O' },
+		{"position",	required_argument,	NULL,	'G' },
+		{"loctable",	no_argument,		NULL,	'T' },
+		{"ctrlport",	required_argument,	NULL,	'c' },
+		{"acl",		required_argument,	NULL,	'A' },
+		{"stats",	required_argument,	NULL,	'S' },
+		{"txtstamp",	no_argument,		NULL,	'X' },
+		{"watchdog",	required_argument,	NULL,	'J' },
+		{"trace",	required_argument,	NULL,	'N' },
+		{"traceflow",	required_argument,	NULL,	'F' },
+		{"recorder",	required_argument,	NULL,	'y' },
+		{"recorderfile",	required_argument,	NULL,	'Y' },
+		{"flowsfile",	required_argument,	NULL,	'o' },
+		{"capture",	required_argument,	NULL,	'a' },
+		{"capturesize",	required_argument,	NULL,	'b' },
+		{"capturetime",	required_argument,	NULL,	'f' },
+		{"replay",	required_argument,	NULL,	'p' },
+		{"replayspeed",	required_argument,	NULL,	'x' },
+		{"replayapp",	no_argument,		NULL,	'j' },
+		{"txapp",	no_argument,		NULL,	'j' },
+		{"txrate",	required_argument,	NULL,	'g' },
+		{"txsize",	required_argument,	NULL,	'k' },
+		{"txflows",	required_argument,	NULL,	'l' },
+		{"txduration",	required_argument,	NULL,	'm' },
+		{"analyze",	required_argument,	NULL,	'z' },
 		{0,0,0,0}
 	};
 	
 	while
-		( ( read = getopt_long(argc, argv, "nhsevt:r:i:u:w:d:", args, &idx) )
+		( ( read = getopt_long(argc, argv, "nRWPTXhsevt:r:i:u:w:d:D:H:C:Q:L:K:B:O:G:c:A:S:J:N:F:y:Y:o:a:b:f:p:x:jg:k:l:m:z:", args, &idx) )
 				> -1 )
 	{
 
@@ -136,6 +191,257 @@ int read_configuration(int argc, char** argv, configuration_t* cfg)
 				cfg->nec_mode = true;
 				break;
 
+			case 'R':
+
+				cfg->nec_relay = true;
+				break;
+
+			case 'D':
+
+				if ( sscanf(optarg, "%d:%d", &cfg->relay_delay_min
+								, &cfg->relay_delay_max) != 2 )
+					{ handle_app_error("read_configuration: " \
+										"wrong relay delay, use MIN:MAX.\n"); }
+				break;
+
+			case 'W':
+
+				cfg->nec_wrap = true;
+				break;
+
+			case 'P':
+
+				cfg->nec_repeat = true;
+				break;
+
+			case 'H':
+
+				cfg->nec_hop_limit = atoi(optarg);
+				break;
+
+			case 'C':
+
+				cfg->nec_traffic_class = atoi(optarg);
+				break;
+
+			case 'Q':
+
+				cfg->tx_queue_len = atoi(optarg);
+				break;
+
+			case 'L':
+
+				// either a default lifetime (MS) or one for a port (PORT=MS)
+				if ( strchr(optarg, '=') == NULL )
+				{
+					cfg->tx_lifetime = atoi(optarg);
+					break;
+				}
+
+				if ( cfg->no_lifetime_rules >= MAX__LIFETIME_RULES )
+					{ handle_app_error("read_configuration: " \
+										"too many lifetimes, max = %d.\n"
+										, MAX__LIFETIME_RULES); }
+
+				if ( sscanf(optarg, "%d=%d"
+							, &cfg->lifetime_ports[cfg->no_lifetime_rules]
+							, &cfg->lifetimes[cfg->no_lifetime_rules]) != 2 )
+					{ handle_app_error("read_configuration: " \
+										"wrong lifetime, use [PORT=]MS.\n"); }
+
+				cfg->no_lifetime_rules++;
+				break;
+
+			case 'K':
+
+				if ( cfg->no_class_rules >= MAX__CLASS_RULES )
+					{ handle_app_error("read_configuration: " \
+										"too many classes, max = %d.\n"
+										, MAX__CLASS_RULES); }
+
+				if ( sscanf(optarg, "%d=%d"
+							, &cfg->class_ports[cfg->no_class_rules]
+							, &cfg->tx_classes[cfg->no_class_rules]) != 2 )
+					{ handle_app_error("read_configuration: " \
+										"wrong class, use PORT=CLASS.\n"); }
+
+				cfg->no_class_rules++;
+				break;
+
+			case 'B':
+
+				// either a default limit (RATE[:BURST]) or one for a port
+				if ( strchr(optarg, '=') == NULL )
+				{
+					if ( sscanf(optarg, "%d:%d", &cfg->rate_limit
+									, &cfg->rate_burst) < 1 )
+						{ handle_app_error("read_configuration: " \
+											"wrong rate limit, use " \
+											"[PORT=]RATE[:BURST].\n"); }
+					break;
+				}
+
+				if ( cfg->no_rate_rules >= MAX__RATE_RULES )
+					{ handle_app_error("read_configuration: " \
+										"too many rate limits, max = %d.\n"
+										, MAX__RATE_RULES); }
+
+				if ( sscanf(optarg, "%d=%d:%d"
+							, &cfg->rate_ports[cfg->no_rate_rules]
+							, &cfg->rate_limits[cfg->no_rate_rules]
+							, &cfg->rate_bursts[cfg->no_rate_rules]) < 2 )
+					{ handle_app_error("read_configuration: " \
+										"wrong rate limit, use " \
+										"[PORT=]RATE[:BURST].\n"); }
+
+				cfg->no_rate_rules++;
+				break;
+
+			case 'O':
+
+				if ( ( cfg->rate_policy = rate_policy_parse(optarg) ) < 0 )
+					{ handle_app_error("read_configuration: " \
+										"wrong rate policy, use drop, " \
+										"queue or downgrade.\n"); }
+				break;
+
+			case 'G':
+
+				if ( sscanf(optarg, "%lf,%lf", &cfg->latitude
+								, &cfg->longitude) != 2 )
+					{ handle_app_error("read_configuration: " \
+										"wrong position, use LAT,LON.\n"); }
+				cfg->geo_filter = true;
+				break;
+
+			case 'T':
+
+				cfg->loc_table = true;
+				break;
+
+			case 'c':
+
+				cfg->ctrl_port = atoi(optarg);
+				break;
+
+			case 'A':
+
+				if ( strlen(optarg) <= 0 )
+					{ handle_app_error("read_configuration: " \
+										"wrong ACL file.\n"); }
+				cfg->acl_file = optarg;
+				break;
+
+			case 'S':
+
+				cfg->stats_name = optarg;
+				break;
+
+			case 'X':
+
+				cfg->tx_tstamp = true;
+				break;
+
+			case 'J':
+
+				cfg->watchdog_ms = atoi(optarg);
+				break;
+
+			case 'N':
+
+				cfg->trace_every = atoi(optarg);
+				break;
+
+			case 'F':
+
+				cfg->trace_first = atoi(optarg);
+				break;
+
+			case 'y':
+
+				cfg->recorder_kb = atoi(optarg);
+				break;
+
+			case 'Y':
+
+				if ( strlen(optarg) <= 0 )
+					{ handle_app_error("read_configuration: " \
+										"wrong recorder file.\n"); }
+				cfg->recorder_path = optarg;
+				break;
+
+			case 'o':
+
+				if ( strlen(optarg) <= 0 )
+					{ handle_app_error("read_configuration: " \
+										"wrong flows file.\n"); }
+				cfg->flows_path = optarg;
+				break;
+
+			case 'a':
+
+				if ( strlen(optarg) <= 0 )
+					{ handle_app_error("read_configuration: " \
+										"wrong capture prefix.\n"); }
+				cfg->capture_prefix = optarg;
+				break;
+
+			case 'b':
+
+				cfg->capture_mb = atoi(optarg);
+				break;
+
+			case 'f':
+
+				cfg->capture_secs = atoi(optarg);
+				break;
+
+			case 'p':
+
+				if ( strlen(optarg) <= 0 )
+					{ handle_app_error("read_configuration: " \
+										"wrong replay file.\n"); }
+				cfg->replay_file = optarg;
+				break;
+
+			case 'x':
+
+				cfg->replay_speed = atof(optarg);
+				break;
+
+			case 'j':
+
+				cfg->replay_app = true;
+				break;
+
+			case 'g':
+
+				cfg->tx_rate = atoi(optarg);
+				break;
+
+			case 'k':
+
+				if ( generator_parse_sizes(optarg, &cfg->tx_sizes
+						, &cfg->tx_min_size, &cfg->tx_max_size) < 0 )
+					{ handle_app_error("read_configuration: " \
+										"wrong TX size (N, MIN-MAX, imix).\n"); }
+				break;
+
+			case 'l':
+
+				cfg->tx_flows = atoi(optarg);
+				break;
+
+			case 'm':
+
+				cfg->tx_duration = atoi(optarg);
+				break;
+
+			case 'z':
+
+				cfg->analyze_port = atoi(optarg);
+				break;
+
 			case 'e':
 				
 				__verbose = true;
@@ -186,6 +492,116 @@ int check_configuration(configuration_t *cfg)
 	if ( ( cfg->app_tx_port <= 0 ) || ( cfg->app_rx_port <= 0 ) )
 		{ handle_app_error("Both APP. TX and RX port must be set.\n"); }
 
+	if ( ( cfg->nec_relay == true ) && ( cfg->nec_mode == false ) )
+		{ handle_app_error("Relay mode requires NEC mode.\n"); }
+
+	if ( ( cfg->nec_wrap == true ) && ( cfg->nec_mode == false ) )
+		{ handle_app_error("Wrapping NEC headers requires NEC mode.\n"); }
+
+	if ( ( cfg->nec_repeat == true ) &&
+			( ( cfg->nec_mode == false ) || ( cfg->nec_wrap == true ) ) )
+		{ handle_app_error("Repeating NEC messages requires NEC mode " \
+							"without wrapping.\n"); }
+
+	if ( ( cfg->nec_hop_limit < 1 ) || ( cfg->nec_hop_limit > 0xFF ) )
+		{ handle_app_error("NEC hop_limit must be within [1, 255].\n"); }
+
+	if ( ( cfg->nec_traffic_class < 0 ) || ( cfg->nec_traffic_class > 0xFF ) )
+		{ handle_app_error("NEC traffic_class must be within [0, 255].\n"); }
+
+	if ( cfg->tx_queue_len < 1 )
+		{ handle_app_error("TX queue length must be > 0.\n"); }
+
+	if ( cfg->tx_lifetime < 0 )
+		{ handle_app_error("TX lifetime must be >= 0.\n"); }
+
+	for ( int i = 0; i < cfg->no_lifetime_rules; i++ )
+	{
+		if ( ( cfg->lifetime_ports[i] <= 0 ) || ( cfg->lifetimes[i] < 0 ) )
+			{ handle_app_error("Lifetime rules must satisfy PORT > 0 and " \
+								"MS >= 0.\n"); }
+	}
+
+	for ( int i = 0; i < cfg->no_class_rules; i++ )
+	{
+		if ( ( cfg->class_ports[i] <= 0 ) || ( cfg->tx_classes[i] < 0 )
+				|| ( cfg->tx_classes[i] > MAX__TX_CLASS ) )
+			{ handle_app_error("Class rules must satisfy PORT > 0 and " \
+								"0 <= CLASS <= %d.\n", MAX__TX_CLASS); }
+	}
+
+	if ( ( cfg->geo_filter == true ) && ( cfg->nec_mode == false ) )
+		{ handle_app_error("Filtering geocasts requires NEC mode.\n"); }
+
+	if ( ( cfg->loc_table == true ) && ( cfg->nec_mode == false ) )
+		{ handle_app_error("Location table requires NEC mode.\n"); }
+
+	if ( ( cfg->ctrl_port < 0 ) || ( cfg->ctrl_port > 0xFFFF ) )
+		{ handle_app_error("Control port must be within [0, 65535].\n"); }
+
+	if ( ( cfg->stats_name != NULL ) &&
+			( ( cfg->stats_name[0] != '/' ) ||
+				( strchr(cfg->stats_name + 1, '/') != NULL ) ||
+				( strlen(cfg->stats_name) < 2 ) ) )
+		{ handle_app_error("Statistics segment name must be /name.\n"); }
+
+	if ( cfg->watchdog_ms < 0 )
+		{ handle_app_error("Watchdog threshold must be >= 0 (ms).\n"); }
+
+	if ( ( cfg->trace_every < 0 ) || ( cfg->trace_first < 0 ) )
+		{ handle_app_error("Trace sampling must be >= 0.\n"); }
+
+	if ( cfg->recorder_kb < 0 )
+		{ handle_app_error("Recorder size must be >= 0 (KB).\n"); }
+
+	if ( ( cfg->recorder_path != NULL ) &&
+			( strlen(cfg->recorder_path) >= RECORDER_PATH_LEN ) )
+		{ handle_app_error("Recorder file path is too long.\n"); }
+
+	if ( ( cfg->flows_path != NULL ) &&
+			( strlen(cfg->flows_path) >= FLOW_TABLE_PATH_LEN ) )
+		{ handle_app_error("Flows file path is too long.\n"); }
+
+	if ( ( cfg->capture_prefix != NULL ) &&
+			( strlen(cfg->capture_prefix) >= CAPTURE_PATH_LEN ) )
+		{ handle_app_error("Capture prefix is too long.\n"); }
+
+	if ( ( cfg->capture_mb < 0 ) || ( cfg->capture_secs < 0 ) )
+		{ handle_app_error("Capture rotation must be >= 0 (MB, secs).\n"); }
+
+	if ( cfg->replay_speed < 0.0 )
+		{ handle_app_error("Replay speed must be >= 0 (0: max).\n"); }
+
+	if ( ( cfg->tx_rate < 0 ) || ( cfg->tx_duration < 0 ) )
+		{ handle_app_error("TX rate and duration must be >= 0.\n"); }
+
+	if ( ( cfg->tx_flows < 1 ) || ( cfg->tx_flows > GENERATOR_MAX_FLOWS ) )
+		{ handle_app_error("TX flows must be within [1, %d].\n"
+							, GENERATOR_MAX_FLOWS); }
+
+	if ( ( cfg->analyze_port < 0 ) || ( cfg->analyze_port > 65535 ) )
+		{ handle_app_error("Analyzer port must be within [0, 65535].\n"); }
+
+	if ( 	( cfg->latitude < -90.0 ) || ( cfg->latitude > 90.0 ) ||
+			( cfg->longitude < -180.0 ) || ( cfg->longitude > 180.0 ) )
+		{ handle_app_error("Position must be within [-90, 90], " \
+							"[-180, 180].\n"); }
+
+	if ( ( cfg->rate_limit < 0 ) || ( cfg->rate_burst < 0 ) )
+		{ handle_app_error("Rate limit and burst must be >= 0.\n"); }
+
+	for ( int i = 0; i < cfg->no_rate_rules; i++ )
+	{
+		if ( ( cfg->rate_ports[i] <= 0 ) || ( cfg->rate_limits[i] < 0 )
+				|| ( cfg->rate_bursts[i] < 0 ) )
+			{ handle_app_error("Rate limits must satisfy PORT > 0, " \
+								"RATE >= 0 and BURST >= 0.\n"); }
+	}
+
+	if ( 	( cfg->relay_delay_min < 0 ) ||
+			( cfg->relay_delay_max < cfg->relay_delay_min ) )
+		{ handle_app_error("Relay delay must satisfy 0 <= MIN <= MAX.\n"); }
+
 	return(EX_OK);
 
 }
@@ -206,6 +622,56 @@ void print_configuration(const configuration_t *cfg)
 	log_app_msg("\t.rx_port = %d\n", cfg->rx_port);
 	log_app_msg("\t.if_name = %s\n", cfg->if_name);
 	log_app_msg("\t.nec_mode = %s\n", cfg->nec_mode ? "true" : "false");
+	log_app_msg("\t.nec_relay = %s\n", cfg->nec_relay ? "true" : "false");
+	log_app_msg("\t.relay_delay = [%d, %d] ms\n"
+					, cfg->relay_delay_min, cfg->relay_delay_max);
+	log_app_msg("\t.nec_wrap = %s\n", cfg->nec_wrap ? "true" : "false");
+	log_app_msg("\t.nec_repeat = %s\n", cfg->nec_repeat ? "true" : "false");
+	log_app_msg("\t.tx_queue_len = %d\n", cfg->tx_queue_len);
+	log_app_msg("\t.tx_lifetime = %d\n", cfg->tx_lifetime);
+	for ( int i = 0; i < cfg->no_lifetime_rules; i++ )
+		{ log_app_msg("\t* lifetime[port=%d] = %d\n"
+						, cfg->lifetime_ports[i], cfg->lifetimes[i]); }
+	for ( int i = 0; i < cfg->no_class_rules; i++ )
+		{ log_app_msg("\t* class[port=%d] = %d\n"
+						, cfg->class_ports[i], cfg->tx_classes[i]); }
+	log_app_msg("\t.geo_filter = %s (lat = %.7f, lon = %.7f)\n"
+					, cfg->geo_filter ? "true" : "false"
+					, cfg->latitude, cfg->longitude);
+	log_app_msg("\t.loc_table = %s\n", cfg->loc_table ? "true" : "false");
+	log_app_msg("\t.ctrl_port = %d\n", cfg->ctrl_port);
+	log_app_msg("\t.acl_file = %s\n"
+					, ( cfg->acl_file != NULL ) ? cfg->acl_file : "none");
+	log_app_msg("\t.stats_name = %s\n"
+					, ( cfg->stats_name != NULL ) ? cfg->stats_name : "none");
+	log_app_msg("\t.tx_tstamp = %s\n", cfg->tx_tstamp ? "true" : "false");
+	log_app_msg("\t.watchdog_ms = %d\n", cfg->watchdog_ms);
+	log_app_msg("\t.trace = 1/%d, first %d per flow\n"
+					, cfg->trace_every, cfg->trace_first);
+	log_app_msg("\t.recorder_kb = %d (file = %s)\n", cfg->recorder_kb
+					, ( cfg->recorder_path != NULL ) ?
+						cfg->recorder_path : "default");
+	log_app_msg("\t.flows_path = %s\n", ( cfg->flows_path != NULL ) ?
+												cfg->flows_path : "default");
+	log_app_msg("\t.capture = %s (rotation = %d MB, %d secs)\n"
+					, ( cfg->capture_prefix != NULL ) ?
+						cfg->capture_prefix : "none"
+					, cfg->capture_mb, cfg->capture_secs);
+	log_app_msg("\t.replay = %s (speed = %.2f, side = %s)\n"
+					, ( cfg->replay_file != NULL ) ? cfg->replay_file : "none"
+					, cfg->replay_speed, cfg->replay_app ? "app" : "net");
+	log_app_msg("\t.tx_rate = %d (sizes = [%d, %d], flows = %d, " \
+					"duration = %d)\n", cfg->tx_rate, cfg->tx_min_size
+					, cfg->tx_max_size, cfg->tx_flows, cfg->tx_duration);
+	log_app_msg("\t.analyze_port = %d\n", cfg->analyze_port);
+	log_app_msg("\t.rate_limit = %d (burst = %d, policy = %d)\n"
+					, cfg->rate_limit, cfg->rate_burst, cfg->rate_policy);
+	for ( int i = 0; i < cfg->no_rate_rules; i++ )
+		{ log_app_msg("\t* rate_limit[port=%d] = %d (burst = %d)\n"
+						, cfg->rate_ports[i], cfg->rate_limits[i]
+						, cfg->rate_bursts[i]); }
+	log_app_msg("\t.nec_hop_limit = %d\n", cfg->nec_hop_limit);
+	log_app_msg("\t.nec_traffic_class = %d\n", cfg->nec_traffic_class);
 	log_app_msg("\t.__tx_test = %s\n", cfg->__tx_test ? "true" : "false");
 	log_app_msg("\t.__verbose = %s\n", cfg->__verbose ? "true" : "false");
 	log_app_msg("}\n");
@@ -39,12 +39,27 @@
 /********************************************************************* EXTERN */
 
 /*!< Variable that sets the __verbose mode on or off. */
-bool __verbose;
+extern bool __verbose;
 
 /***************************************************************** DATA TYPES */
 
 #define LEN__LL_IF_NAME_BUFFER ( IF_NAMESIZE + 1 )	/*!< if_name buffer size */
 
+#define DEFAULT__RELAY_DELAY_MIN 1		/*!< Min. relay delay (ms). */
+#define DEFAULT__RELAY_DELAY_MAX 20		/*!< Max. relay delay (ms). */
+#define DEFAULT__NEC_HOP_LIMIT 1		/*!< hop_limit of wrapped messages. */
+#define DEFAULT__NEC_TRAFFIC_CLASS 0	/*!< traffic_class of wrapped msgs (BE). */
+#define DEFAULT__TX_QUEUE_LEN 512		/*!< Max. messages queued for TX. */
+#define DEFAULT__TX_LIFETIME 0			/*!< Lifetime of TX msgs (ms, 0: none).*/
+#define MAX__LIFETIME_RULES 32			/*!< Max. per port lifetimes. */
+#define MAX__CLASS_RULES 32				/*!< Max. per port traffic classes. */
+#define MAX__TX_CLASS 3					/*!< Lowest priority traffic class. */
+#define DEFAULT__RATE_LIMIT 0			/*!< Msgs/s per app (0: no limit). */
+#define MAX__RATE_RULES 32				/*!< Max. per port rate limits. */
+#define DEFAULT__REPLAY_SPEED 1.0		/*!< Replay timing (0: max). */
+#define DEFAULT__TX_RATE 1				/*!< TX test msgs/s (0: max). */
+#define DEFAULT__TX_SIZE 64				/*!< TX test message size. */
+
 /*!
  * \struct configuration_t
  * \brief Runtime configuration of the application.
@@ -63,6 +78,58 @@ typedef struct configuration
 	char if_name[LEN__LL_IF_NAME_BUFFER];	/**< Name of the interface. */
 
 	bool nec_mode;							/**< Indicates NEC mode. */
+	bool nec_relay;							/**< Indicates NEC relay mode. */
+	int relay_delay_min;					/**< Min. relay delay (ms). */
+	int relay_delay_max;					/**< Max. relay delay (ms). */
+	bool nec_wrap;							/**< Wrap/strip NEC headers. */
+	int nec_hop_limit;						/**< hop_limit for wrapping. */
+	int nec_traffic_class;					/**< traffic_class for wrapping. */
+	bool nec_repeat;						/**< Repeat NEC TX messages. */
+
+	int tx_queue_len;						/**< Max. messages queued for TX. */
+	int tx_lifetime;						/**< Default TX lifetime (ms). */
+	int lifetime_ports[MAX__LIFETIME_RULES];	/**< Ports with a lifetime. */
+	int lifetimes[MAX__LIFETIME_RULES];		/**< Lifetime for those (ms). */
+	int no_lifetime_rules;					/**< Number of per port lifetimes. */
+	int class_ports[MAX__CLASS_RULES];		/**< Ports with a traffic class. */
+	int tx_classes[MAX__CLASS_RULES];		/**< Traffic class for those. */
+	int no_class_rules;						/**< Number of per port classes. */
+
+	int rate_limit;							/**< Default msgs/s per app. */
+	int rate_burst;							/**< Default burst per app. */
+	int rate_ports[MAX__RATE_RULES];		/**< Ports with a rate limit. */
+	int rate_limits[MAX__RATE_RULES];		/**< Msgs/s for those. */
+	int rate_bursts[MAX__RATE_RULES];		/**< Burst for those. */
+	int no_rate_rules;						/**< Number of per port limits. */
+	int rate_policy;						/**< Policy over the limit. */
+
+	bool geo_filter;						/**< Filter geocasts by position. */
+	double latitude;						/**< Local latitude (degrees). */
+	double longitude;						/**< Local longitude (degrees). */
+	bool loc_table;							/**< Keep a location table. */
+	int ctrl_port;							/**< Control port (0: none). */
+	char *acl_file;							/**< Source allow/deny rules. */
+	char *stats_name;						/**< Shared stats (NULL: none). */
+	bool tx_tstamp;							/**< Kernel TX timestamps. */
+	int watchdog_ms;						/**< Stall threshold (0: none). */
+	int trace_every;						/**< Trace 1 out of N (0: off). */
+	int trace_first;						/**< Trace first K per flow. */
+	int recorder_kb;						/**< Flight recorder (0: off). */
+	char *recorder_path;					/**< Its dump file (NULL: def). */
+	char *flows_path;						/**< Flows dump file (NULL: def). */
+	char *capture_prefix;					/**< pcapng files (NULL: off). */
+	int capture_mb;							/**< Rotation size (0: none). */
+	int capture_secs;						/**< Rotation age (0: none). */
+	char *replay_file;						/**< Capture replayed (NULL: no). */
+	double replay_speed;					/**< Replay timing (0: max). */
+	bool replay_app;						/**< Replay/test the app side. */
+	int tx_rate;							/**< TX test msgs/s (0: max). */
+	int tx_sizes;							/**< TX test size distribution. */
+	int tx_min_size;						/**< TX test min. size. */
+	int tx_max_size;						/**< TX test max. size. */
+	int tx_flows;							/**< TX test flows (sockets). */
+	int tx_duration;						/**< TX/RX test secs (0: forever). */
+	int analyze_port;						/**< RX test port (0: off). */
 
 	bool __tx_test;							/**< Indicates a TX test. */
 	bool __verbose;							/**< Indicates verbose mode. */
@@ -28,6 +28,9 @@
 #include "configuration.h"
 #include "udpev/udp_events.h"
 #include "udpev/cb_udp_events.h"
+#include "udpev/control.h"
+#include "udpev/replay.h"
+#include "udpev/generator.h"
 
 /************************************************** Application definitions */
 
@@ -58,6 +61,34 @@ int main(int argc, char **argv)
 	log_app_msg(">>> Configuration read! Printing data...\n");
 	print_configuration(cfg);
 
+	// (a capture is replayed without opening any event manager)
+	if ( cfg->replay_file != NULL )
+	{
+
+		int fd = -1;
+		sockaddr_in_t *dest = NULL;
+
+		if ( cfg->replay_app == true )
+		{
+			fd = open_transmitter_udp_socket(cfg->app_tx_port);
+			dest = init_sockaddr_in(cfg->app_address, cfg->app_tx_port);
+		}
+		else
+		{
+			fd = open_broadcast_udp_socket(cfg->if_name, cfg->tx_port);
+			dest = init_broadcast_sockaddr_in(cfg->tx_port);
+		}
+
+		log_app_msg(">>> Replaying capture %s...\n", cfg->replay_file);
+		replay_t *replay = init_replay(cfg->replay_file, fd, dest
+										, cfg->replay_speed);
+		int result = replay_run(replay);
+		print_replay(replay);
+
+		exit( ( result == EX_OK ) ? EXIT_SUCCESS : EXIT_FAILURE );
+
+	}
+
 	// 2) Create UDP socket event managers:
 	udp_events_t *net_events = NULL;
 	udp_events_t *app_events = NULL;
@@ -65,15 +96,54 @@ int main(int argc, char **argv)
 	if ( cfg->__tx_test == true )
 	{
 
-		net_events = init_tx_udp_events(cfg->if_name, cfg->tx_port
-										, cb_broadcast_sendto, true);
-		printf("> UDP TX socket open, port = %d, fd = %d.\n"
-					, cfg->tx_port, net_events->socket_fd);
+		struct ev_loop *loop = ev_default_loop(0);
+		generator_t *generator = NULL;
+
+		log_app_msg(">>> Generating test traffic...\n");
+		if ( cfg->replay_app == true )
+			{ generator = init_generator(loop, NULL
+					, init_sockaddr_in(cfg->app_address, cfg->app_tx_port)
+					, cfg->tx_flows, cfg->tx_rate, cfg->tx_sizes
+					, cfg->tx_min_size, cfg->tx_max_size, cfg->tx_duration); }
+		else
+			{ generator = init_generator(loop, cfg->if_name
+					, init_broadcast_sockaddr_in(cfg->tx_port)
+					, cfg->tx_flows, cfg->tx_rate, cfg->tx_sizes
+					, cfg->tx_min_size, cfg->tx_max_size, cfg->tx_duration); }
+
+		ev_loop(loop, 0);
+		print_generator(generator);
+		exit(EXIT_SUCCESS);
+
+	}
+	else if ( cfg->analyze_port > 0 )
+	{
+
+		log_app_msg(">>> Analyzing test traffic...\n");
+		net_events = init_rx_udp_events(cfg->analyze_port, cfg->if_name
+										, cb_analyze_recvfrom);
+		analyzer_t *analyzer = init_analyzer(net_events->loop
+												, cfg->tx_duration);
+		get_public_arg(net_events)->analyzer = analyzer;
+
+		ev_loop(net_events->loop, 0);
+		print_analyzer(analyzer);
+		exit(EXIT_SUCCESS);
 
 	}
 	else
 	{
 
+		// per message records are only written when verbose or tracing
+		async_log_t *async = NULL;
+		if ( ( cfg->__verbose == true ) || ( cfg->trace_every > 0 )
+				|| ( cfg->trace_first > 0 ) )
+		{
+			log_app_msg(">>> Logging per message records asynchronously...\n");
+			async = init_async_log(STDOUT_FILENO);
+			print_async_log(async);
+		}
+
 		log_app_msg(">>> Opening UDP NET RX socket...\n");
 		net_events = init_net_udp_events
 						(cfg->rx_port, cfg->if_name
@@ -83,6 +153,61 @@ int main(int argc, char **argv)
 		log_app_msg(">>> UDP NET RX socket open!\n");
 		print_udp_events(net_events, cfg->rx_port, cfg->app_rx_port);
 
+		if ( cfg->nec_relay == true )
+		{
+			log_app_msg(">>> Enabling NEC multi-hop relay...\n");
+			get_public_arg(net_events)->relay
+				= init_nec_relay(net_events->loop, cfg->if_name, cfg->tx_port
+									, cfg->relay_delay_min
+									, cfg->relay_delay_max);
+		}
+
+		if ( cfg->geo_filter == true )
+		{
+			log_app_msg(">>> Filtering geocasts by local position...\n");
+			get_public_arg(net_events)->geo_filter
+				= init_geo_filter(cfg->latitude, cfg->longitude);
+			print_geo_filter(get_public_arg(net_events)->geo_filter);
+		}
+
+		stats_t *stats = NULL;
+		if ( cfg->stats_name != NULL )
+		{
+			log_app_msg(">>> Publishing statistics in shared memory...\n");
+			stats = init_stats(cfg->stats_name);
+			get_public_arg(net_events)->stats = stats_block(stats, STATS_NET);
+			print_stats(stats);
+		}
+
+		flow_table_t *flows = init_flow_table(net_events->loop
+												, cfg->flows_path);
+		get_public_arg(net_events)->flows = flows;
+		get_public_arg(net_events)->latency
+			= init_latency(net_events->loop, "net");
+		get_public_arg(net_events)->talkers
+			= init_top_talkers(net_events->loop, "net");
+
+		if ( cfg->acl_file != NULL )
+		{
+			log_app_msg(">>> Loading source allow/deny rules...\n");
+			get_public_arg(net_events)->acl
+				= init_acl(net_events->loop, cfg->acl_file);
+			print_acl(get_public_arg(net_events)->acl);
+		}
+
+		if ( cfg->loc_table == true )
+		{
+			log_app_msg(">>> Keeping a location table of neighbours...\n");
+			loc_table_t *loc = init_loc_table(net_events->loop
+												, LOC_TABLE_LIFETIME);
+			if ( cfg->geo_filter == true )
+				{ loc_table_set_position(loc, cfg->latitude, cfg->longitude); }
+			if ( get_public_arg(net_events)->relay != NULL )
+				{ get_public_arg(net_events)->relay->loc_table = loc; }
+			get_public_arg(net_events)->loc_table = loc;
+			print_loc_table(loc);
+		}
+
 		log_app_msg(">>> Opening UDP APP RX socket...\n");
 		app_events = init_app_udp_events
 						(cfg->app_tx_port, cfg->if_name, cfg->tx_port
@@ -90,6 +215,176 @@ int main(int argc, char **argv)
 		log_app_msg(">>> UDP APP RX socket open!\n");
 		print_udp_events(app_events, cfg->app_tx_port, cfg->tx_port);
 
+		get_public_arg(app_events)->nec_mode = cfg->nec_mode;
+		get_public_arg(app_events)->flows = flows;
+		get_public_arg(app_events)->talkers
+			= init_top_talkers(app_events->loop, "app");
+
+		tx_scheduler_t *tx_sched = init_tx_scheduler_udp_events
+									(app_events, cfg->if_name
+									, cfg->tx_queue_len, cfg->tx_lifetime);
+		for ( int i = 0; i < cfg->no_lifetime_rules; i++ )
+			{ tx_scheduler_set_lifetime(tx_sched, cfg->lifetime_ports[i]
+										, cfg->lifetimes[i]); }
+		for ( int i = 0; i < cfg->no_class_rules; i++ )
+			{ tx_scheduler_set_class(tx_sched, cfg->class_ports[i]
+										, cfg->tx_classes[i]); }
+		tx_sched->latency = init_latency(app_events->loop, "app");
+		print_tx_scheduler(tx_sched);
+
+		tx_tstamp_t *tstamp = NULL;
+		if ( cfg->tx_tstamp == true )
+		{
+			log_app_msg(">>> Enabling kernel TX timestamps...\n");
+			tstamp = init_tx_tstamp(app_events->loop);
+			if ( tx_scheduler_set_tstamp(tx_sched, tstamp) < 0 )
+				{ handle_app_error("Kernel TX timestamps not supported.\n"); }
+			print_tx_tstamp(tstamp);
+		}
+
+		if ( stats != NULL )
+		{
+			get_public_arg(app_events)->stats = stats_block(stats, STATS_APP);
+			tx_scheduler_set_stats(tx_sched, stats_block(stats, STATS_APP));
+			latency_set_stats(get_public_arg(net_events)->latency
+								, stats_block(stats, STATS_NET));
+			latency_set_stats(tx_sched->latency
+								, stats_block(stats, STATS_APP));
+		}
+
+		if ( ( cfg->rate_limit > 0 ) || ( cfg->no_rate_rules > 0 ) )
+		{
+			log_app_msg(">>> Enabling per source rate limits...\n");
+			rate_limiter_t *rl = init_rate_limiter
+									(app_events->loop, tx_sched
+									, cfg->rate_limit, cfg->rate_burst
+									, cfg->rate_policy);
+			for ( int i = 0; i < cfg->no_rate_rules; i++ )
+				{ rate_limiter_set_limit(rl, cfg->rate_ports[i]
+											, cfg->rate_limits[i]
+											, cfg->rate_bursts[i]); }
+			get_public_arg(app_events)->rate_limiter = rl;
+			print_rate_limiter(rl);
+		}
+
+		if ( cfg->nec_wrap == true )
+		{
+			log_app_msg(">>> Wrapping/stripping NEC headers...\n");
+			init_nec_wrap_udp_events(app_events
+										, cfg->nec_hop_limit
+										, cfg->nec_traffic_class);
+			init_nec_strip_udp_events(net_events);
+		}
+
+		if ( cfg->nec_repeat == true )
+		{
+			log_app_msg(">>> Enabling NEC message repetitions...\n");
+			get_public_arg(app_events)->nec_repeat
+				= init_nec_repeat(app_events->loop, tx_sched);
+		}
+
+		recorder_t *recorder = NULL;
+		if ( cfg->recorder_kb > 0 )
+		{
+			log_app_msg(">>> Recording the last messages received...\n");
+			recorder = init_recorder(net_events->loop, cfg->recorder_kb
+										, cfg->recorder_path);
+			get_public_arg(net_events)->recorder = recorder;
+			get_public_arg(app_events)->recorder = recorder;
+			print_recorder(recorder);
+		}
+
+		capture_t *capture = NULL;
+		if ( cfg->capture_prefix != NULL )
+		{
+			log_app_msg(">>> Capturing messages to pcapng files...\n");
+			capture = init_capture(cfg->capture_prefix, cfg->if_name
+									, cfg->capture_mb, cfg->capture_secs);
+			get_public_arg(net_events)->capture = capture;
+			get_public_arg(app_events)->capture = capture;
+			print_capture(capture);
+		}
+
+		trace_t *trace = NULL;
+		if ( ( cfg->trace_every > 0 ) || ( cfg->trace_first > 0 ) )
+		{
+			log_app_msg(">>> Tracing sampled messages...\n");
+			trace = init_trace(cfg->trace_every, cfg->trace_first);
+			get_public_arg(net_events)->trace = trace;
+			get_public_arg(app_events)->trace = trace;
+			print_trace(trace);
+		}
+
+		watchdog_t *watchdog = NULL;
+		if ( cfg->watchdog_ms > 0 )
+		{
+			log_app_msg(">>> Watching the event loop for stalls...\n");
+			watchdog = init_watchdog(net_events->loop, cfg->watchdog_ms);
+			if ( stats != NULL )
+				{ watchdog_set_stats(watchdog, stats_block(stats, STATS_NET)); }
+			print_watchdog(watchdog);
+		}
+
+#ifdef UDPIP_CYCLES
+		log_app_msg(">>> Accounting cycles per pipeline stage...\n");
+		cycles_t *cycles = init_cycles(net_events->loop);
+		print_cycles(cycles);
+#endif
+
+		if ( cfg->ctrl_port > 0 )
+		{
+			log_app_msg(">>> Opening control socket...\n");
+			control_t *ctl = init_control(net_events->loop, cfg->ctrl_port);
+			if ( get_public_arg(net_events)->loc_table != NULL )
+				{ control_register(ctl, "loc", "location table of neighbours"
+									, loc_table_control
+									, get_public_arg(net_events)->loc_table); }
+			control_register(ctl, "flows", "per-flow counters"
+								, flow_table_control, flows);
+			control_register(ctl, "latnet", "forwarding latency, net to app"
+								, latency_control
+								, get_public_arg(net_events)->latency);
+			control_register(ctl, "latapp", "forwarding latency, app to net"
+								, latency_control, tx_sched->latency);
+			if ( tstamp != NULL )
+			{
+				control_register(ctl, "txsched", "TX latency, sendmsg to qdisc"
+									, latency_control, tstamp->to_sched);
+				control_register(ctl, "txdriver", "TX latency, qdisc to driver"
+									, latency_control, tstamp->to_driver);
+			}
+			control_register(ctl, "topnet", "top sources heard from the network"
+								, top_talkers_control
+								, get_public_arg(net_events)->talkers);
+			control_register(ctl, "topapp", "top applications broadcasting"
+								, top_talkers_control
+								, get_public_arg(app_events)->talkers);
+			if ( get_public_arg(net_events)->acl != NULL )
+				{ control_register(ctl, "acl", "source allow/deny rules"
+									, acl_control
+									, get_public_arg(net_events)->acl); }
+			if ( async != NULL )
+				{ control_register(ctl, "log", "asynchronous log records"
+									, async_log_control, async); }
+			if ( recorder != NULL )
+				{ control_register(ctl, "recorder", "flight recorder of messages"
+									, recorder_control, recorder); }
+			if ( capture != NULL )
+				{ control_register(ctl, "capture", "pcapng capture files"
+									, capture_control, capture); }
+			if ( trace != NULL )
+				{ control_register(ctl, "trace", "sampled message tracing"
+									, trace_control, trace); }
+			if ( watchdog != NULL )
+				{ control_register(ctl, "watchdog", "event loop lag and stalls"
+									, watchdog_control, watchdog); }
+#ifdef UDPIP_CYCLES
+			control_register(ctl, "cycles", "CPU cycles per pipeline stage"
+								, cycles_control, cycles);
+#endif
+			print_control(ctl);
+		}
+
 	}
 
 	// 3) loop that waits for net_events to occur...
@@ -0,0 +1,217 @@
+/**
+ * @file necbench.c
+ * @author Ricardo Tubío (rtpardavila[at]gmail.com)
+ * @version 0.1
+ *
+ * @section LICENSE
+ *
+ * This file is part of udpip-broadcaster.
+ * udpip-broadcaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * udpip-broadcaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with udpip-broadcaster.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Microbenchmark of the NEC GN-BTP codec: times __NEC__parse_tx(),
+ * __NEC__parse_rx() and __NEC__parse_batch() over a ring of synthetic TSB
+ * messages and prints the cost of each one in ns/packet. It is built but not
+ * installed; the figures depend on the CFLAGS of the tree (-O0 by default),
+ * so rebuild it with, e.g., make necbench CFLAGS="-std=gnu99 -O2" to measure
+ * an optimized codec.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+
+#include "execution_codes.h"
+#include "logger.h"
+#include "udpev/__NEC__gnbtpapi_udp_msg.h"
+
+/************************************************** Application definitions */
+
+static const char* __x_app_name = "necbench";
+static const char* __x_app_version = "0.1";
+
+#define __RING 256				/**< Messages in the ring (one batch). */
+#define __PAYLOAD 64			/**< Payload of the messages (bytes). */
+#define __MSG_LEN ( LEN____NEC__GNBTPAPI_MAX_HEADER + __PAYLOAD )
+#define __DEFAULT_PACKETS 10000000L	/**< Packets parsed by each test. */
+
+/******************************************************* INTERNAL FUNCTIONS */
+
+/* print_help */
+static void print_help()
+{
+	fprintf(stdout, "HELP, %s\n", __x_app_name);
+	fprintf(stdout, "usage: %s [-n packets]\n", __x_app_name);
+	fprintf(stdout, "\t-n, --packets\tpackets parsed by each test " \
+					"(default %ld)\n", __DEFAULT_PACKETS);
+}
+
+/* print_version */
+static void print_version()
+{
+	fprintf(stdout, "Version = %s\n", __x_app_version);
+}
+
+/* __now_ns */
+static uint64_t __now_ns()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return( (uint64_t)t.tv_sec * 1000000000ULL + (uint64_t)t.tv_nsec );
+}
+
+/* __fill */
+static void __fill(uint8_t *b, const int header_len, const int seq)
+{
+
+	memset(b, 0, __MSG_LEN);
+
+	b[__NEC__OFF_HEADER_TYPE] = __NEC__HT_TSB;
+	b[__NEC__OFF_HEADER_SUBTYPE] = __NEC__HST_TSB_SINGLE_HOP;
+	b[__NEC__OFF_HOP_LIMIT] = 1;
+	__NEC__wr16(b + __NEC__OFF_PAYLOAD_LENGTH, __PAYLOAD);
+
+	for ( int i = 0; i < __PAYLOAD; i++ )
+		{ b[header_len + i] = (uint8_t)( seq + i ); }
+
+}
+
+/* __report */
+static void __report(	const char *name, const uint64_t ns,
+						const long packets, const long valid	)
+{
+	log_app_msg("%-12s %10ld packets %8.2f ns/packet (valid = %ld)\n"
+				, name, packets, (double)ns / packets, valid);
+}
+
+/* __bench_single */
+static void __bench_single(	const char *name,
+							int (*parse)(const void *, const int,
+											__NEC__msg_t *),
+							const void * const *buffers, const int *lens,
+							const long packets	)
+{
+
+	__NEC__msg_t m;
+	long valid = 0;
+
+	uint64_t t0 = __now_ns();
+	for ( long i = 0; i < packets; i++ )
+	{
+		if ( parse(buffers[i % __RING], lens[i % __RING], &m) == EX_OK )
+			{ valid += ( m.payload_len > 0 ); }
+	}
+	uint64_t t1 = __now_ns();
+
+	__report(name, t1 - t0, packets, valid);
+
+}
+
+/* __bench_batch */
+static void __bench_batch(	const char *name, const bool rx,
+							const void * const *buffers, const int *lens,
+							const long packets	)
+{
+
+	__NEC__msg_t msgs[__RING];
+	unsigned long counts[__NEC__MSG_TYPES];
+	long batches = ( packets + __RING - 1 ) / __RING, valid = 0;
+
+	memset(counts, 0, sizeof(counts));
+
+	uint64_t t0 = __now_ns();
+	for ( long i = 0; i < batches; i++ )
+		{ valid += __NEC__parse_batch(buffers, lens, __RING, rx
+										, msgs, counts); }
+	uint64_t t1 = __now_ns();
+
+	__report(name, t1 - t0, batches * __RING, valid);
+
+}
+
+/* main */
+int main(int argc, char **argv)
+{
+
+	long packets = __DEFAULT_PACKETS;
+	int idx = 0, read = 0;
+
+	static struct option args[] =
+	{
+		{"help",	no_argument,		NULL,	'h'	},
+		{"version",	no_argument,		NULL,	'v'	},
+		{"packets",	required_argument,	NULL,	'n'	},
+		{0,0,0,0}
+	};
+
+	while ( ( read = getopt_long(argc, argv, "hvn:", args, &idx) ) > -1 )
+	{
+
+		switch(read)
+		{
+			case 'n':
+
+				if ( ( packets = atol(optarg) ) <= 0 )
+					{ handle_app_error("Packets must be > 0.\n"); }
+				break;
+
+			case 'v':
+
+				print_version();
+				exit(EXIT_SUCCESS);
+				break;
+
+			case 'h':
+			default:
+
+				print_help();
+				exit(EXIT_SUCCESS);
+				break;
+		}
+
+	}
+
+	// 1) a ring of TSB messages of each direction, as read from the sockets
+	static uint8_t tx[__RING][__MSG_LEN], rx[__RING][__MSG_LEN];
+	const void *tx_buffers[__RING], *rx_buffers[__RING];
+	int tx_lens[__RING], rx_lens[__RING];
+
+	for ( int i = 0; i < __RING; i++ )
+	{
+
+		__fill(tx[i], LEN____NEC__GNBTPAPI_TSB_TX_HEADER, i);
+		tx_buffers[i] = tx[i];
+		tx_lens[i] = LEN____NEC__GNBTPAPI_TSB_TX_HEADER + __PAYLOAD;
+
+		__fill(rx[i], LEN____NEC__GNBTPAPI_TSB_RX_HEADER, i);
+		rx_buffers[i] = rx[i];
+		rx_lens[i] = LEN____NEC__GNBTPAPI_TSB_RX_HEADER + __PAYLOAD;
+
+	}
+
+	// 2) one message per call, then whole rings per call
+	__bench_single("parse_tx", __NEC__parse_tx
+					, tx_buffers, tx_lens, packets);
+	__bench_single("parse_rx", __NEC__parse_rx
+					, rx_buffers, rx_lens, packets);
+	__bench_batch("batch_tx", false, tx_buffers, tx_lens, packets);
+	__bench_batch("batch_rx", true, rx_buffers, rx_lens, packets);
+
+	exit(EXIT_SUCCESS);
+
+}
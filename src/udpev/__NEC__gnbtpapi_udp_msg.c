@@ -22,33 +22,261 @@
 
 #include "__NEC__gnbtpapi_udp_msg.h"
 
+#define __HT_MAX 8		/**< Size of the tables indexed by header_type. */
+
+/*!< Kind of TX message for each header_type. */
+static const __NEC__msg_type_t __tx_types[__HT_MAX] =
+{
+	[__NEC__HT_GEOUNICAST]		= __NEC__MSG_GEOUNICAST_TX,
+	[__NEC__HT_GEOANYCAST]		= __NEC__MSG_GEOCAST_TX,
+	[__NEC__HT_GEOBROADCAST]	= __NEC__MSG_GEOCAST_TX,
+	[__NEC__HT_TSB]				= __NEC__MSG_TSB_TX
+};
+
+/*!< Kind of RX message for each header_type. */
+static const __NEC__msg_type_t __rx_types[__HT_MAX] =
+{
+	[__NEC__HT_GEOUNICAST]		= __NEC__MSG_GEOUNICAST_RX,
+	[__NEC__HT_GEOANYCAST]		= __NEC__MSG_GEOCAST_RX,
+	[__NEC__HT_GEOBROADCAST]	= __NEC__MSG_GEOCAST_RX,
+	[__NEC__HT_TSB]				= __NEC__MSG_TSB_RX
+};
+
+/*!< Length of the headers for each kind of message. */
+static const int __header_lens[__NEC__MSG_TYPES] =
+{
+	[__NEC__MSG_INVALID]		= 0,
+	[__NEC__MSG_TSB_TX]			= LEN____NEC__GNBTPAPI_TSB_TX_HEADER,
+	[__NEC__MSG_GEOUNICAST_TX]	= LEN____NEC__GNBTPAPI_GEOUNICAST_TX_HEADER,
+	[__NEC__MSG_GEOCAST_TX]		= LEN____NEC__GNBTPAPI_GEOCAST_TX_HEADER,
+	[__NEC__MSG_TSB_RX]			= LEN____NEC__GNBTPAPI_TSB_RX_HEADER,
+	[__NEC__MSG_GEOUNICAST_RX]	= LEN____NEC__GNBTPAPI_GEOUNICAST_RX_HEADER,
+	[__NEC__MSG_GEOCAST_RX]		= LEN____NEC__GNBTPAPI_GEOCAST_RX_HEADER
+};
+
+/*!< Offset of the destination port for each kind of message. */
+static const int __dport_offsets[__NEC__MSG_TYPES] =
+{
+	[__NEC__MSG_TSB_TX]			= __NEC__TSB_TX_DESTINATION_PORT,
+	[__NEC__MSG_GEOUNICAST_TX]	= __NEC__GUC_TX_DESTINATION_PORT,
+	[__NEC__MSG_GEOCAST_TX]		= __NEC__GBC_TX_DESTINATION_PORT,
+	[__NEC__MSG_TSB_RX]			= __NEC__UC_RX_DESTINATION_PORT,
+	[__NEC__MSG_GEOUNICAST_RX]	= __NEC__UC_RX_DESTINATION_PORT,
+	[__NEC__MSG_GEOCAST_RX]		= __NEC__GBC_RX_DESTINATION_PORT
+};
+
+/*!< Names for the kinds of messages. */
+static const char *__type_names[__NEC__MSG_TYPES] =
+{
+	"invalid", "tsb-tx", "geounicast-tx", "geocast-tx",
+	"tsb-rx", "geounicast-rx", "geocast-rx"
+};
+
+/* __parse */
+static inline int __parse(	const uint8_t *b, const int len,
+							const __NEC__msg_type_t *types,
+							__NEC__msg_t *m	)
+{
+
+	m->buffer = b;
+	m->len = len;
+	m->type = __NEC__MSG_INVALID;
+	m->header_len = 0;
+	m->payload = NULL;
+	m->payload_len = 0;
+
+	if ( ( b == NULL ) || ( len < LEN____NEC__GNBTPAPI_BASIC_HEADER ) )
+		{ return(EX_WRONG_PARAM); }
+
+	uint8_t ht = b[__NEC__OFF_HEADER_TYPE];
+	if ( ht >= __HT_MAX ) { return(EX_WRONG_PARAM); }
+
+	__NEC__msg_type_t type = types[ht];
+	int header_len = __header_lens[type];
+	int payload_len = __NEC__rd16(b + __NEC__OFF_PAYLOAD_LENGTH);
+
+	if ( 	( type == __NEC__MSG_INVALID ) ||
+			( len < header_len + payload_len ) )
+		{ return(EX_WRONG_PARAM); }
+
+	m->type = type;
+	m->header_len = header_len;
+	m->payload = b + header_len;
+	m->payload_len = payload_len;
+
+	return(EX_OK);
+
+}
+
+/* __NEC__parse_tx */
+int __NEC__parse_tx(const void *buffer, const int len, __NEC__msg_t *m)
+	{ return(__parse((const uint8_t *)buffer, len, __tx_types, m)); }
+
+/* __NEC__parse_rx */
+int __NEC__parse_rx(const void *buffer, const int len, __NEC__msg_t *m)
+	{ return(__parse((const uint8_t *)buffer, len, __rx_types, m)); }
+
+/* __NEC__parse_batch */
+int __NEC__parse_batch(	const void * const *buffers, const int *lens,
+						const int n, const bool rx,
+						__NEC__msg_t *msgs, unsigned long *counts	)
+{
+
+	const __NEC__msg_type_t *types = ( rx == true ) ? __rx_types : __tx_types;
+	int valid = 0;
+
+	for ( int i = 0; i < n; i++ )
+	{
+
+		if ( __parse((const uint8_t *)buffers[i], lens[i], types, &msgs[i])
+				== EX_OK )
+			{ valid++; }
+
+		if ( counts != NULL ) { counts[msgs[i].type]++; }
+
+	}
+
+	return(valid);
+
+}
+
+/* __NEC__repetition_interval */
+uint32_t __NEC__repetition_interval(const __NEC__msg_t *m)
+{
+
+	if ( m->type == __NEC__MSG_INVALID ) { return(0); }
+	if ( m->type == __NEC__MSG_GEOCAST_RX )
+		{ return(__NEC__rd32(m->buffer + __NEC__GBC_RX_REPETITION_INTERVAL)); }
+	if ( __NEC__is_rx(m) == true ) { return(0); }
+
+	return(__NEC__rd32(m->buffer + __NEC__OFF_REPETITION_INTERVAL));
+
+}
+
+/* __NEC__max_lifetime */
+uint32_t __NEC__max_lifetime(const __NEC__msg_t *m)
+{
+
+	if ( m->type == __NEC__MSG_INVALID ) { return(0); }
+	if ( m->type == __NEC__MSG_GEOCAST_RX )
+		{ return(__NEC__rd32(m->buffer + __NEC__GBC_RX_MAX_LIFETIME)); }
+	if ( __NEC__is_rx(m) == true ) { return(0); }
+
+	return(__NEC__rd32(m->buffer + __NEC__OFF_MAX_LIFETIME));
+
+}
+
+/* __NEC__destination_port */
+uint16_t __NEC__destination_port(const __NEC__msg_t *m)
+{
+	if ( m->type == __NEC__MSG_INVALID ) { return(0); }
+	return(__NEC__rd16(m->buffer + __dport_offsets[m->type]));
+}
+
+/* __NEC__geo_area */
+int __NEC__geo_area(const __NEC__msg_t *m, __NEC__geo_area_t *area)
+{
+
+	const uint8_t *b = m->buffer;
+
+	if ( m->type == __NEC__MSG_GEOCAST_RX )
+	{
+		area->latitude = (int32_t)__NEC__rd32(b + __NEC__GBC_RX_LATITUDE);
+		area->longitude = (int32_t)__NEC__rd32(b + __NEC__GBC_RX_LONGITUDE);
+		area->distance_a = __NEC__rd16(b + __NEC__GBC_RX_DISTANCE_A);
+		area->distance_b = __NEC__rd16(b + __NEC__GBC_RX_DISTANCE_B);
+		area->orientation = __NEC__rd16(b + __NEC__GBC_RX_ORIENTATION);
+	}
+	else if ( m->type == __NEC__MSG_GEOCAST_TX )
+	{
+		area->latitude = (int32_t)__NEC__rd32(b + __NEC__GBC_TX_LATITUDE);
+		area->longitude = (int32_t)__NEC__rd32(b + __NEC__GBC_TX_LONGITUDE);
+		area->distance_a = __NEC__rd16(b + __NEC__GBC_TX_DISTANCE_A);
+		area->distance_b = __NEC__rd16(b + __NEC__GBC_TX_DISTANCE_B);
+		area->orientation = __NEC__rd16(b + __NEC__GBC_TX_ORIENTATION);
+	}
+	else
+		{ return(EX_WRONG_PARAM); }
+
+	area->shape = b[__NEC__OFF_HEADER_SUBTYPE];
+	return(EX_OK);
+
+}
+
+/* __NEC__msg_type_name */
+const char *__NEC__msg_type_name(const __NEC__msg_type_t type)
+{
+	if ( ( type < 0 ) || ( type >= __NEC__MSG_TYPES ) ) { return("unknown"); }
+	return(__type_names[type]);
+}
+
 /* print__NEC__basic_header */
-void print__NEC__basic_header(const void* buffer)
+void print__NEC__basic_header(const void *buffer)
 {
 
-	__NEC__gnbtpapi_basic_header_t* h
-		= (__NEC__gnbtpapi_basic_header_t *)buffer;
+	const uint8_t *b = (const uint8_t *)buffer;
 
-	printf("\t* header_type = %.2X\n", h->header_type);
-	printf("\t* header_subtype = %.2X\n", h->header_subtype);
-	printf("\t* hop_limit = %d\n", h->hop_limit);
-	printf("\t* flags = %.2X\n", h->flags);
-	printf("\t* payload_length = %d\n", h->payload_length);
-	printf("\t* traffic_class = %.2X\n", h->traffic_class);
-	printf("\t* btp_type = %.2X\n", h->btp_type);
+	printf("\t* header_type = %.2X\n", b[__NEC__OFF_HEADER_TYPE]);
+	printf("\t* header_subtype = %.2X\n", b[__NEC__OFF_HEADER_SUBTYPE]);
+	printf("\t* hop_limit = %d\n", b[__NEC__OFF_HOP_LIMIT]);
+	printf("\t* flags = %.2X\n", b[__NEC__OFF_FLAGS]);
+	printf("\t* payload_length = %d\n"
+			, __NEC__rd16(b + __NEC__OFF_PAYLOAD_LENGTH));
+	printf("\t* traffic_class = %.2X\n", b[__NEC__OFF_TRAFFIC_CLASS]);
+	printf("\t* btp_type = %.2X\n", b[__NEC__OFF_BTP_TYPE]);
 
 }
 
 /* print__NEC__extended_header */
-void print__NEC__extended_header(const void* buffer)
+void print__NEC__extended_header(const void *buffer)
 {
 
-	__NEC__print_basic_header(buffer);
+	const uint8_t *b = (const uint8_t *)buffer;
+
+	print__NEC__basic_header(buffer);
+
+	printf("\t* repetition_interval = %u\n"
+			, __NEC__rd32(b + __NEC__OFF_REPETITION_INTERVAL));
+	printf("\t* max_lifetime = %u\n"
+			, __NEC__rd32(b + __NEC__OFF_MAX_LIFETIME));
+
+}
+
+/* print__NEC__msg */
+void print__NEC__msg(const __NEC__msg_t *m)
+{
+
+	printf("\t* type = %s\n", __NEC__msg_type_name(m->type));
+	if ( m->type == __NEC__MSG_INVALID ) { return; }
+
+	if ( __NEC__is_rx(m) == false )
+		{ print__NEC__extended_header(m->buffer); }
+	else
+	{
+
+		const uint8_t *rxi = __NEC__rx_info(m);
+
+		print__NEC__basic_header(m->buffer);
+		printf("\t* gn_address = %.16llX\n"
+				, (unsigned long long)__NEC__rxi_gn_address(rxi));
+		printf("\t* timestamp = %u\n", __NEC__rxi_timestamp(rxi));
+		printf("\t* latitude = %d\n", __NEC__rxi_latitude(rxi));
+		printf("\t* longitude = %d\n", __NEC__rxi_longitude(rxi));
+		printf("\t* speed = %u\n", __NEC__rxi_speed(rxi));
+		printf("\t* heading = %u\n", __NEC__rxi_heading(rxi));
+
+	}
 
-	__NEC__gnbtpapi_extended_header_t* h
-		= (__NEC__gnbtpapi_extended_header_t *)buffer;
+	__NEC__geo_area_t area;
+	if ( __NEC__geo_area(m, &area) == EX_OK )
+	{
+		printf("\t* area = { shape = %u, lat = %d, lon = %d, " \
+				"a = %u, b = %u, angle = %u }\n"
+				, area.shape, area.latitude, area.longitude
+				, area.distance_a, area.distance_b, area.orientation);
+	}
 
-	printf("\t* repetition_interval = %d\n", h->repetition_interval);
-	printf("\t* max_lifetime = %d\n", h->max_lifetime);
+	printf("\t* destination_port = %u\n", __NEC__destination_port(m));
+	printf("\t* payload = %d bytes\n", m->payload_len);
 
 }
@@ -18,6 +18,13 @@
  *
  * You should have received a copy of the GNU General Public License
  * along with udpip-broadcaster.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Codec for the headers of the NEC GN-BTP API. Headers are never copied into
+ * C structures: the wire layout of every header is fixed below (offsets in
+ * bytes, all multi-byte fields in network byte order) and the accessors read
+ * and write the fields in place, directly from the reception buffer.
  */
 
 #ifndef UDP_NEC_GNBTPAPI_H_
@@ -25,145 +32,332 @@
 
 #include <stdio.h>
 #include <stdint.h>
-
-typedef struct __NEC__gnbtpapi_basic_header
-{
-
-	uint8_t header_type;
-	uint8_t header_subtype;
-	uint8_t hop_limit;
-	uint8_t flags;
-	uint16_t payload_length;
-	uint8_t traffic_class;
-	uint8_t btp_type;
-
-} __NEC__gnbtpapi_basic_header_t;
-
-typedef struct __NEC__gnbtpapi_extended_header
+#include <stdbool.h>
+
+#include "../execution_codes.h"
+
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// WIRE LAYOUTS
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+/* basic header, common to all messages */
+#define __NEC__OFF_HEADER_TYPE			0
+#define __NEC__OFF_HEADER_SUBTYPE		1
+#define __NEC__OFF_HOP_LIMIT			2
+#define __NEC__OFF_FLAGS				3
+#define __NEC__OFF_PAYLOAD_LENGTH		4
+#define __NEC__OFF_TRAFFIC_CLASS		6
+#define __NEC__OFF_BTP_TYPE				7
+#define LEN____NEC__GNBTPAPI_BASIC_HEADER		8
+
+/* extended header = basic header + repetition fields (TX only) */
+#define __NEC__OFF_REPETITION_INTERVAL	8
+#define __NEC__OFF_MAX_LIFETIME			12
+#define LEN____NEC__GNBTPAPI_EXTENDED_HEADER	16
+
+/* rx_info header, offsets relative to the start of this header */
+#define __NEC__RXI_DESTINATION_GN_ADDRESS	0
+#define __NEC__RXI_TIMESTAMP				8
+#define __NEC__RXI_LATITUDE					12
+#define __NEC__RXI_LONGITUDE				16
+#define __NEC__RXI_SPEED					20
+#define __NEC__RXI_HEADING					22
+#define __NEC__RXI_ALTITUDE					24
+#define __NEC__RXI_ACCURACIES				26
+#define LEN____NEC__GNBTPAPI_RX_INFO_HEADER		28
+
+/* TSB (topologically scoped broadcast) TX header */
+#define __NEC__TSB_TX_DESTINATION_PORT	16
+#define __NEC__TSB_TX_SOURCE_PORT		18
+#define LEN____NEC__GNBTPAPI_TSB_TX_HEADER		20
+
+/* geo-unicast TX header */
+#define __NEC__GUC_TX_DESTINATION_GN_ADDRESS	16
+#define __NEC__GUC_TX_DESTINATION_PORT	20
+#define __NEC__GUC_TX_SOURCE_PORT		22
+#define LEN____NEC__GNBTPAPI_GEOUNICAST_TX_HEADER	24
+
+/* geocast TX header */
+#define __NEC__GBC_TX_LATITUDE			16
+#define __NEC__GBC_TX_LONGITUDE			20
+#define __NEC__GBC_TX_DISTANCE_A		24
+#define __NEC__GBC_TX_DISTANCE_B		26
+#define __NEC__GBC_TX_ORIENTATION		28
+#define __NEC__GBC_TX_DESTINATION_PORT	32
+#define __NEC__GBC_TX_SOURCE_PORT		34
+#define LEN____NEC__GNBTPAPI_GEOCAST_TX_HEADER	36
+
+/* RX headers = basic header + rx_info header + type specific fields */
+#define __NEC__OFF_RX_INFO				8
+
+/* TSB and geo-unicast RX headers */
+#define __NEC__UC_RX_DESTINATION_PORT	36
+#define __NEC__UC_RX_DESTINATION_PORT_INFO	38
+#define LEN____NEC__GNBTPAPI_TSB_RX_HEADER			40
+#define LEN____NEC__GNBTPAPI_GEOUNICAST_RX_HEADER	40
+
+/* geocast RX header */
+#define __NEC__GBC_RX_REPETITION_INTERVAL	36
+#define __NEC__GBC_RX_MAX_LIFETIME		40
+#define __NEC__GBC_RX_LATITUDE			44
+#define __NEC__GBC_RX_LONGITUDE			48
+#define __NEC__GBC_RX_DISTANCE_A		52
+#define __NEC__GBC_RX_DISTANCE_B		54
+#define __NEC__GBC_RX_ORIENTATION		56
+#define __NEC__GBC_RX_DESTINATION_PORT	60
+#define __NEC__GBC_RX_SOURCE_PORT		62
+#define LEN____NEC__GNBTPAPI_GEOCAST_RX_HEADER	64
+
+#define LEN____NEC__GNBTPAPI_MAX_HEADER	LEN____NEC__GNBTPAPI_GEOCAST_RX_HEADER
+
+/* values for the header_type field (GeoNetworking header types) */
+#define __NEC__HT_GEOUNICAST			2
+#define __NEC__HT_GEOANYCAST			3
+#define __NEC__HT_GEOBROADCAST			4
+#define __NEC__HT_TSB					5
+
+/* values for the header_subtype field */
+#define __NEC__HST_TSB_SINGLE_HOP		0	/**< TSB, single hop. */
+#define __NEC__HST_TSB_MULTI_HOP		1	/**< TSB, multi hop. */
+#define __NEC__HST_AREA_CIRCLE			0	/**< Geo-area, circle. */
+#define __NEC__HST_AREA_RECTANGLE		1	/**< Geo-area, rectangle. */
+#define __NEC__HST_AREA_ELLIPSE			2	/**< Geo-area, ellipse. */
+
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// MESSAGE VIEWS
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+/**
+ * @enum __NEC__msg_type
+ * @brief Kinds of messages recognized by the parser.
+ */
+typedef enum __NEC__msg_type
 {
 
-	__NEC__gnbtpapi_basic_header_t header;
-
-	uint32_t repetition_interval;
-	uint32_t max_lifetime;
-
-} __NEC__gnbtpapi_extended_header_t;
-
-typedef struct __NEC__gnbtpapi_rx_info_header
+	__NEC__MSG_INVALID = 0,			/**< Not a valid NEC message. */
+	__NEC__MSG_TSB_TX,				/**< TSB, application to router. */
+	__NEC__MSG_GEOUNICAST_TX,		/**< Geo-unicast, application to router. */
+	__NEC__MSG_GEOCAST_TX,			/**< Geocast, application to router. */
+	__NEC__MSG_TSB_RX,				/**< TSB, router to application. */
+	__NEC__MSG_GEOUNICAST_RX,		/**< Geo-unicast, router to application. */
+	__NEC__MSG_GEOCAST_RX,			/**< Geocast, router to application. */
+	__NEC__MSG_TYPES				/**< Number of kinds of messages. */
+
+} __NEC__msg_type_t;
+
+/**
+ * @struct __NEC__msg
+ * @brief View over a message that lies in a reception buffer; it holds no
+ * 			copy of the message, only the results of its validation.
+ */
+typedef struct __NEC__msg
 {
 
-	uint64_t destination_gn_address;
-	uint32_t timestamp;
-	uint32_t latitude;
-	uint32_t longitude;
-	uint16_t speed;
-	uint16_t heading;
-	uint16_t altitude;
-	uint16_t accuracies;
-
-} __NEC__gnbtpapi_rx_info_header_t;
-
-#define LEN____NEC__GNBTPAPI_BASIC_HEADER \
-	sizeof(__NEC__gnbtpapi_basic_header_t)
+	const uint8_t *buffer;			/**< Start of the message. */
+	int len;						/**< Length of the whole message. */
 
-#define LEN____NEC__GNBTPAPI_EXTENDED_HEADER \
-	sizeof(__NEC__gnbtpapi_extended_header_t)
+	__NEC__msg_type_t type;			/**< Kind of message. */
+	int header_len;					/**< Length of all the headers. */
 
-#define LEN____NEC__GNBTPAPI_RX_INFO_HEADER \
-	sizeof(__NEC__gnbtpapi_rx_info_header_t)
-
-typedef struct __NEC__gnbtpapi_tsb_tx_header
-{
+	const uint8_t *payload;			/**< Start of the payload. */
+	int payload_len;				/**< Length of the payload. */
 
-	__NEC__gnbtpapi_extended_header_t header;
+} __NEC__msg_t;
 
-	uint16_t destination_port;
-	uint16_t source_port;
+#define LEN____NEC__MSG sizeof(__NEC__msg_t)
 
-	void* payload;
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// FIELD ACCESSORS
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
-} __NEC__gnbtpapi_tsb_tx_header_t;
+static inline uint16_t __NEC__rd16(const uint8_t *p)
+	{ return( (uint16_t)( ( p[0] << 8 ) | p[1] ) ); }
 
-typedef struct __NEC__gnbtpapi_geounicast_tx_header
+static inline uint32_t __NEC__rd32(const uint8_t *p)
 {
+	return(	( (uint32_t)p[0] << 24 ) | ( (uint32_t)p[1] << 16 ) |
+			( (uint32_t)p[2] << 8 ) | (uint32_t)p[3] );
+}
 
-	__NEC__gnbtpapi_extended_header_t header;
+static inline uint64_t __NEC__rd64(const uint8_t *p)
+	{ return( ( (uint64_t)__NEC__rd32(p) << 32 ) | __NEC__rd32(p + 4) ); }
 
-	uint32_t destination_gn_address;
-	uint16_t destination_port;
-	uint16_t source_port;
+static inline void __NEC__wr16(uint8_t *p, const uint16_t v)
+	{ p[0] = (uint8_t)( v >> 8 ); p[1] = (uint8_t)v; }
 
-	void* payload;
-
-} __NEC__gnbtpapi_geounicast_tx_header_t;
-
-typedef struct __NEC__gnbtpapi_geocast_tx_header
+static inline void __NEC__wr32(uint8_t *p, const uint32_t v)
 {
+	p[0] = (uint8_t)( v >> 24 ); p[1] = (uint8_t)( v >> 16 );
+	p[2] = (uint8_t)( v >> 8 ); p[3] = (uint8_t)v;
+}
+
+static inline void __NEC__wr64(uint8_t *p, const uint64_t v)
+	{ __NEC__wr32(p, (uint32_t)( v >> 32 )); __NEC__wr32(p + 4, (uint32_t)v); }
+
+/* basic header fields, valid for every kind of message */
+static inline uint8_t __NEC__header_type(const __NEC__msg_t *m)
+	{ return(m->buffer[__NEC__OFF_HEADER_TYPE]); }
+static inline uint8_t __NEC__header_subtype(const __NEC__msg_t *m)
+	{ return(m->buffer[__NEC__OFF_HEADER_SUBTYPE]); }
+static inline uint8_t __NEC__hop_limit(const __NEC__msg_t *m)
+	{ return(m->buffer[__NEC__OFF_HOP_LIMIT]); }
+static inline uint8_t __NEC__flags(const __NEC__msg_t *m)
+	{ return(m->buffer[__NEC__OFF_FLAGS]); }
+static inline uint16_t __NEC__payload_length(const __NEC__msg_t *m)
+	{ return(__NEC__rd16(m->buffer + __NEC__OFF_PAYLOAD_LENGTH)); }
+static inline uint8_t __NEC__traffic_class(const __NEC__msg_t *m)
+	{ return(m->buffer[__NEC__OFF_TRAFFIC_CLASS]); }
+static inline uint8_t __NEC__btp_type(const __NEC__msg_t *m)
+	{ return(m->buffer[__NEC__OFF_BTP_TYPE]); }
+
+/**
+ * @brief Checks whether the message is an RX message (router to application).
+ */
+static inline bool __NEC__is_rx(const __NEC__msg_t *m)
+	{ return(m->type >= __NEC__MSG_TSB_RX); }
 
-	__NEC__gnbtpapi_extended_header_t header;
-
-	uint32_t latitude;
-	uint32_t longitude;
-
-	uint16_t distance_a;
-	uint16_t distance_b;
-	uint16_t orientation;
-	uint16_t reserved;
-
-	uint16_t destination_port;
-	uint16_t source_port;
-
-	void* payload;
+/**
+ * @brief Gets a pointer to the rx_info header of an RX message.
+ * @return Pointer to the header, NULL if this is not an RX message.
+ */
+static inline const uint8_t *__NEC__rx_info(const __NEC__msg_t *m)
+	{ return( __NEC__is_rx(m) ? m->buffer + __NEC__OFF_RX_INFO : NULL ); }
+
+/* rx_info header fields, the pointer must come from __NEC__rx_info() */
+static inline uint64_t __NEC__rxi_gn_address(const uint8_t *rxi)
+	{ return(__NEC__rd64(rxi + __NEC__RXI_DESTINATION_GN_ADDRESS)); }
+static inline uint32_t __NEC__rxi_timestamp(const uint8_t *rxi)
+	{ return(__NEC__rd32(rxi + __NEC__RXI_TIMESTAMP)); }
+static inline int32_t __NEC__rxi_latitude(const uint8_t *rxi)
+	{ return((int32_t)__NEC__rd32(rxi + __NEC__RXI_LATITUDE)); }
+static inline int32_t __NEC__rxi_longitude(const uint8_t *rxi)
+	{ return((int32_t)__NEC__rd32(rxi + __NEC__RXI_LONGITUDE)); }
+static inline uint16_t __NEC__rxi_speed(const uint8_t *rxi)
+	{ return(__NEC__rd16(rxi + __NEC__RXI_SPEED)); }
+static inline uint16_t __NEC__rxi_heading(const uint8_t *rxi)
+	{ return(__NEC__rd16(rxi + __NEC__RXI_HEADING)); }
+static inline uint16_t __NEC__rxi_altitude(const uint8_t *rxi)
+	{ return(__NEC__rd16(rxi + __NEC__RXI_ALTITUDE)); }
+static inline uint16_t __NEC__rxi_accuracies(const uint8_t *rxi)
+	{ return(__NEC__rd16(rxi + __NEC__RXI_ACCURACIES)); }
+
+/**
+ * @brief Gets the repetition interval of the message (TX messages and
+ * 			geocast RX messages); 0 for the rest.
+ */
+uint32_t __NEC__repetition_interval(const __NEC__msg_t *m);
 
-} __NEC__gnbtpapi_geocast_tx_header_t;
+/**
+ * @brief Gets the maximum lifetime of the message (TX messages and geocast
+ * 			RX messages); 0 for the rest.
+ */
+uint32_t __NEC__max_lifetime(const __NEC__msg_t *m);
 
-#define LEN____NEC__GNBTPAPI_TSB_TX_HEADER \
-	sizeof(__NEC__gnbtpapi_tsb_tx_header_t)
-#define LEN____NEC__GNBTPAPI_GEOUNICAST_TX_HEADER \
-	sizeof(__NEC__gnbtpapi_geounicast_tx_header_t)
-#define LEN____NEC__GNBTPAPI_GEOCAST_TX_HEADER\
-	sizeof(__NEC__gnbtpapi_geocast_tx_header_t)
+/**
+ * @brief Gets the destination BTP port of the message.
+ */
+uint16_t __NEC__destination_port(const __NEC__msg_t *m);
 
-typedef struct __NEC__gnbtpapi_geounicast_rx_header
+/**
+ * @struct __NEC__geo_area
+ * @brief Destination area of a geocast message, as read from the wire.
+ */
+typedef struct __NEC__geo_area
 {
 
-	__NEC__gnbtpapi_basic_header_t header;
-	__NEC__gnbtpapi_rx_info_header_t rx_info_header;
-
-	uint16_t destination_port;
-	uint16_t destination_port_info;
-
-	void* payload;
-
-} __NEC__gnbtpapi_geounicast_rx_header_t;
+	uint8_t shape;					/**< __NEC__HST_AREA_* */
+	int32_t latitude;				/**< Center, 1/10 micro-degree. */
+	int32_t longitude;				/**< Center, 1/10 micro-degree. */
+	uint16_t distance_a;			/**< Semi-axis a (meters). */
+	uint16_t distance_b;			/**< Semi-axis b (meters). */
+	uint16_t orientation;			/**< Azimuth of axis a (degrees). */
 
-typedef struct __NEC__gnbtpapi_geocast_rx_header
-{
+} __NEC__geo_area_t;
 
-	__NEC__gnbtpapi_basic_header_t header;
-	__NEC__gnbtpapi_rx_info_header_t rx_info_header;
+#define LEN____NEC__GEO_AREA sizeof(__NEC__geo_area_t)
 
-	uint32_t repetition_interval;
-	uint32_t maxlife_time;
+/**
+ * @brief Reads the destination area of a geocast message.
+ * @param m View of the message.
+ * @param area Structure where the area is to be stored.
+ * @return EX_OK if the message is a geocast message; otherwise < 0.
+ */
+int __NEC__geo_area(const __NEC__msg_t *m, __NEC__geo_area_t *area);
 
-	uint16_t distance_a;
-	uint16_t distance_b;
-	uint16_t orientation;
-	uint16_t reserved;
+/**
+ * @brief Overwrites the hop_limit of a message in place.
+ * @param buffer Buffer where the message is stored.
+ * @param hop_limit New value for the hop_limit field.
+ */
+static inline void __NEC__set_hop_limit(void *buffer, const uint8_t hop_limit)
+	{ ((uint8_t *)buffer)[__NEC__OFF_HOP_LIMIT] = hop_limit; }
+
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// PARSING
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+/**
+ * @brief Validates a message that an application sends to the router and
+ * 			initializes a view over it. The message is not copied.
+ * @param buffer Buffer where the message is stored.
+ * @param len Number of bytes in the buffer.
+ * @param m View to be initialized.
+ * @return EX_OK if the message is valid; otherwise < 0 and m->type is set
+ * 			to __NEC__MSG_INVALID.
+ */
+int __NEC__parse_tx(const void *buffer, const int len, __NEC__msg_t *m);
+
+/**
+ * @brief Validates a message that the router sends to the applications and
+ * 			initializes a view over it. The message is not copied.
+ * @param buffer Buffer where the message is stored.
+ * @param len Number of bytes in the buffer.
+ * @param m View to be initialized.
+ * @return EX_OK if the message is valid; otherwise < 0 and m->type is set
+ * 			to __NEC__MSG_INVALID.
+ */
+int __NEC__parse_rx(const void *buffer, const int len, __NEC__msg_t *m);
+
+/**
+ * @brief Classifies a whole array of received messages in a single pass.
+ * @param buffers Array with the buffers of the messages.
+ * @param lens Array with the lengths of the messages.
+ * @param n Number of messages in the arrays.
+ * @param rx Flag that indicates RX ('true') or TX ('false') messages.
+ * @param msgs Array with (at least) n views to be initialized.
+ * @param counts Array with __NEC__MSG_TYPES counters, incremented with the
+ * 					kinds of messages found (it can be NULL).
+ * @return Number of valid messages.
+ */
+int __NEC__parse_batch(	const void * const *buffers, const int *lens,
+						const int n, const bool rx,
+						__NEC__msg_t *msgs, unsigned long *counts	);
 
-	uint16_t destination_port;
-	uint16_t source_port;
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// PRINTING
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
-	void* payload;
+/**
+ * @brief Gets a human readable name for the given kind of message.
+ */
+const char *__NEC__msg_type_name(const __NEC__msg_type_t type);
 
-} __NEC__gnbtpapi_geocast_rx_header_t;
+/**
+ * @brief Prints the basic header that starts at the given buffer.
+ * @param buffer Buffer with (at least) a complete basic header.
+ */
+void print__NEC__basic_header(const void *buffer);
 
-#define LEN____NEC__GNBTPAPI_GEOUNICAST_RX_HEADER \
-	sizeof(__NEC__gnbtpapi_geounicast_rx_header_t)
-#define LEN____NEC__GNBTPAPI_GEOCAST_RX_HEADER \
-	sizeof(__NEC__gnbtpapi_geocast_rx_header_t)
+/**
+ * @brief Prints the extended header that starts at the given buffer.
+ * @param buffer Buffer with (at least) a complete extended header.
+ */
+void print__NEC__extended_header(const void *buffer);
 
-void print__NEC__basic_header();
-void print__NEC__extended_header();
+/**
+ * @brief Prints all the headers of the given message.
+ * @param m View of a valid message.
+ */
+void print__NEC__msg(const __NEC__msg_t *m);
 
 #endif /* UDP_NEC_GNBTPAPI_H_ */
@@ -0,0 +1,431 @@
+/**
+ * @file acl.c
+ * @author Ricardo Tubío (rtpardavila[at]gmail.com)
+ * @version 0.1
+ *
+ * @section LICENSE
+ *
+ * This file is part of udpip-broadcaster.
+ * udpip-broadcaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * udpip-broadcaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with udpip-broadcaster.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "acl.h"
+#include "control.h"
+
+#define __LEVELS 3						/**< Levels of the trie. */
+
+/**< Bits of the address resolved down to each level. */
+static const int __bits[__LEVELS] = { 16, 24, 32 };
+/**< Bits resolved within each level. */
+static const int __strides[__LEVELS] = { 16, 8, 8 };
+/**< Names of the actions. */
+static const char *__actions[] = { "none", "allow", "deny" };
+
+/* __entry */
+static inline uint32_t *__entry(	acl_trie_t *t, const int level,
+									const uint32_t chunk, const int i	)
+	{ return( ( level == 0 ) ? &t->root[i] : &t->chunks[chunk][i] ); }
+
+/* __new_chunk; chunk whose entries are all set to the given value */
+static int __new_chunk(acl_trie_t *t, const uint32_t value)
+{
+
+	if ( t->no_chunks == t->max_chunks )
+	{
+
+		int max = ( t->max_chunks == 0 ) ? 64 : 2 * t->max_chunks;
+		if ( max > ACL_MAX_CHUNKS ) { return(EX_ERR); }
+
+		void *chunks = realloc(t->chunks, max * sizeof(*t->chunks));
+		if ( chunks == NULL ) { return(EX_ERR); }
+
+		t->chunks = chunks;
+		t->max_chunks = max;
+
+	}
+
+	for ( int i = 0; i < ACL_CHUNK_LEN; i++ )
+		{ t->chunks[t->no_chunks][i] = value; }
+
+	return(t->no_chunks++);
+
+}
+
+/* __paint; sets an entry and every entry below it */
+static void __paint(	acl_trie_t *t, const int level, const uint32_t chunk,
+						const int i, const uint32_t action	)
+{
+
+	uint32_t e = *__entry(t, level, chunk, i);
+
+	if ( ( e & ACL_CHILD ) == 0 )
+		{ *__entry(t, level, chunk, i) = action; return; }
+
+	for ( int j = 0; j < ACL_CHUNK_LEN; j++ )
+		{ __paint(t, level + 1, e & ~ACL_CHILD, j, action); }
+
+}
+
+/* __insert; controlled prefix expansion of a single rule */
+static int __insert(	acl_trie_t *t, const int level, const uint32_t chunk,
+						const acl_rule_t *r	)
+{
+
+	int i = ( r->prefix >> ( 32 - __bits[level] ) )
+				& ( ( 1 << __strides[level] ) - 1 );
+
+	// 1) prefixes that end within this level cover a range of entries
+	if ( r->len <= __bits[level] )
+	{
+		int n = 1 << ( __bits[level] - r->len );
+		i &= ~( n - 1 );
+		for ( int k = 0; k < n; k++ )
+			{ __paint(t, level, chunk, i + k, r->action); }
+		return(EX_OK);
+	}
+
+	// 2) longer prefixes go down, a chunk is created if required
+	uint32_t e = *__entry(t, level, chunk, i);
+
+	if ( ( e & ACL_CHILD ) == 0 )
+	{
+		int c = __new_chunk(t, e);
+		if ( c < 0 ) { return(EX_ERR); }
+		e = (uint32_t)c | ACL_CHILD;
+		*__entry(t, level, chunk, i) = e;
+	}
+
+	return(__insert(t, level + 1, e & ~ACL_CHILD, r));
+
+}
+
+/* __compare_rules; shorter prefixes first, file order for ties */
+static int __compare_rules(const void *a, const void *b)
+{
+
+	const acl_rule_t *ra = (const acl_rule_t *)a;
+	const acl_rule_t *rb = (const acl_rule_t *)b;
+
+	if ( ra->len != rb->len ) { return(ra->len - rb->len); }
+	return(ra->line - rb->line);
+
+}
+
+/* __parse_rule; 1 if a rule was read, EX_OK if there was nothing to read */
+static int __parse_rule(char *line, acl_rule_t *r, uint32_t *fallback)
+{
+
+	char action[16], prefix[32];
+	struct in_addr addr;
+	int len = 32;
+
+	char *comment = strchr(line, '#');
+	if ( comment != NULL ) { *comment = '\0'; }
+
+	int n = sscanf(line, "%15s %31s", action, prefix);
+	if ( n <= 0 ) { return(EX_OK); }
+	if ( n != 2 ) { return(EX_WRONG_PARAM); }
+
+	if ( strcmp(action, "default") == 0 )
+	{
+		if ( strcmp(prefix, "allow") == 0 ) { *fallback = ACL_ALLOW; }
+		else if ( strcmp(prefix, "deny") == 0 ) { *fallback = ACL_DENY; }
+		else { return(EX_WRONG_PARAM); }
+		return(EX_OK);
+	}
+
+	if ( strcmp(action, "allow") == 0 ) { r->action = ACL_ALLOW; }
+	else if ( strcmp(action, "deny") == 0 ) { r->action = ACL_DENY; }
+	else { return(EX_WRONG_PARAM); }
+
+	char *slash = strchr(prefix, '/');
+	if ( slash != NULL )
+	{
+		*slash = '\0';
+		if ( ( sscanf(slash + 1, "%d", &len) != 1 ) || ( len < 0 )
+				|| ( len > 32 ) )
+			{ return(EX_WRONG_PARAM); }
+	}
+
+	if ( inet_pton(AF_INET, prefix, &addr) != 1 )
+		{ return(EX_WRONG_PARAM); }
+
+	// host bits are cleared, 10.1.2.3/8 is taken as 10.0.0.0/8
+	r->len = len;
+	r->prefix = ntohl(addr.s_addr)
+				& ( ( len == 0 ) ? 0 : ( 0xFFFFFFFFU << ( 32 - len ) ) );
+
+	return(1);
+
+}
+
+/* new_acl_trie */
+acl_trie_t *new_acl_trie()
+{
+	acl_trie_t *s = NULL;
+	if ( ( s = (acl_trie_t *)malloc(LEN__ACL_TRIE) ) == NULL )
+		{ handle_sys_error("new_acl_trie: <malloc> returns NULL."); }
+	if ( memset(s, 0, LEN__ACL_TRIE) == NULL )
+		{ handle_sys_error("new_acl_trie: <memset> returns NULL."); }
+	return(s);
+}
+
+/* init_acl_trie */
+acl_trie_t *init_acl_trie(	acl_rule_t *rules, const int n,
+							const uint32_t fallback	)
+{
+
+	acl_trie_t *s = new_acl_trie();
+
+	s->fallback = fallback;
+	s->no_rules = n;
+
+	// shorter prefixes are expanded first, so that longer ones overwrite
+	//		the entries they cover
+	qsort(rules, n, LEN__ACL_RULE, __compare_rules);
+
+	for ( int i = 0; i < n; i++ )
+	{
+		if ( __insert(s, 0, 0, &rules[i]) < 0 )
+		{
+			log_app_msg("init_acl_trie: no room for more chunks.\n");
+			free_acl_trie(s);
+			return(NULL);
+		}
+	}
+
+	return(s);
+
+}
+
+/* acl_trie_load */
+acl_trie_t *acl_trie_load(const char *path)
+{
+
+	FILE *f = NULL;
+	char line[ACL_LINE_LEN];
+	acl_rule_t *rules = NULL;
+	acl_trie_t *t = NULL;
+	uint32_t fallback = ACL_ALLOW;
+	int n = 0, max = 0, no_line = 0, read = 0;
+
+	if ( ( f = fopen(path, "r") ) == NULL )
+	{
+		log_app_msg("acl_trie_load: cannot open <%s>.\n", path);
+		return(NULL);
+	}
+
+	while ( fgets(line, ACL_LINE_LEN, f) != NULL )
+	{
+
+		no_line++;
+
+		if ( n == max )
+		{
+			max = ( max == 0 ) ? 256 : 2 * max;
+			void *more = realloc(rules, max * LEN__ACL_RULE);
+			if ( more == NULL ) { read = EX_ERR; break; }
+			rules = more;
+		}
+
+		if ( ( read = __parse_rule(line, &rules[n], &fallback) ) < 0 )
+		{
+			log_app_msg("acl_trie_load: <%s:%d> wrong rule.\n"
+							, path, no_line);
+			break;
+		}
+
+		if ( read > 0 ) { rules[n++].line = no_line; }
+
+	}
+
+	fclose(f);
+
+	if ( read >= 0 )
+		{ t = init_acl_trie(rules, n, fallback); }
+
+	free(rules);
+	return(t);
+
+}
+
+/* free_acl_trie */
+void free_acl_trie(acl_trie_t *t)
+{
+	free(t->chunks);
+	free(t);
+}
+
+/* __loader; the trie is built out of the event loop */
+static void *__loader(void *arg)
+{
+
+	acl_t *a = (acl_t *)arg;
+
+	a->pending = acl_trie_load(a->path);
+	ev_async_send(a->loop, &a->loaded);
+
+	return(NULL);
+
+}
+
+/* new_acl */
+acl_t *new_acl()
+{
+	acl_t *s = NULL;
+	if ( ( s = (acl_t *)malloc(LEN__ACL) ) == NULL )
+		{ handle_sys_error("new_acl: <malloc> returns NULL."); }
+	if ( memset(s, 0, LEN__ACL) == NULL )
+		{ handle_sys_error("new_acl: <memset> returns NULL."); }
+	return(s);
+}
+
+/* init_acl */
+acl_t *init_acl(struct ev_loop *loop, const char *path)
+{
+
+	acl_t *s = new_acl();
+
+	s->loop = loop;
+	s->path = path;
+
+	if ( ( s->trie = acl_trie_load(path) ) == NULL )
+		{ handle_app_error("init_acl: cannot load <%s>.\n", path); }
+
+	ev_async_init(&s->loaded, cb_acl_loaded);
+	ev_async_start(loop, &s->loaded);
+
+	ev_signal_init(&s->reload, cb_acl_reload, SIGHUP);
+	s->reload.data = s;
+	ev_signal_start(loop, &s->reload);
+
+	return(s);
+
+}
+
+/* acl_reload */
+int acl_reload(acl_t *a)
+{
+
+	pthread_t loader;
+	pthread_attr_t attr;
+
+	if ( a->loading == true ) { return(EX_ERR); }
+
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+	if ( pthread_create(&loader, &attr, __loader, a) != 0 )
+	{
+		log_app_msg("acl_reload: <pthread_create> returns error.\n");
+		pthread_attr_destroy(&attr);
+		return(EX_ERR);
+	}
+
+	pthread_attr_destroy(&attr);
+	a->loading = true;
+
+	return(EX_OK);
+
+}
+
+/* acl_control */
+int acl_control(	void *arg, int argc, char **argv,
+					char *out, const int out_len	)
+{
+
+	acl_t *a = (acl_t *)arg;
+	struct in_addr addr;
+
+	if ( argc < 2 )
+	{
+		return(control_append(out, out_len
+					, "rules=%d chunks=%d default=%s allowed=%lu denied=%lu" \
+					" reloads=%lu failures=%lu\n"
+					, a->trie->no_rules, a->trie->no_chunks
+					, __actions[a->trie->fallback], a->allowed, a->denied
+					, a->reloads, a->failures));
+	}
+
+	if ( ( strcmp(argv[1], "lookup") == 0 ) && ( argc == 3 ) &&
+			( inet_pton(AF_INET, argv[2], &addr) == 1 ) )
+	{
+		return(control_append(out, out_len, "%s\n"
+					, __actions[acl_trie_lookup(a->trie
+												, ntohl(addr.s_addr))]));
+	}
+
+	if ( ( strcmp(argv[1], "reload") == 0 ) && ( argc == 2 ) )
+	{
+		return(control_append(out, out_len, "%s\n"
+					, ( acl_reload(a) == EX_OK ) ?
+						"reloading" : "reload in progress"));
+	}
+
+	return(control_append(out, out_len
+								, "usage: acl [lookup ADDRESS | reload]\n"));
+
+}
+
+/* print_acl */
+void print_acl(const acl_t *a)
+{
+
+	log_app_msg(">>> ACL (%s) = \n{\n", a->path);
+	log_app_msg("\t.rules = %d\n", a->trie->no_rules);
+	log_app_msg("\t.chunks = %d\n", a->trie->no_chunks);
+	log_app_msg("\t.default = %s\n", __actions[a->trie->fallback]);
+	log_app_msg("\t.allowed = %lu\n", a->allowed);
+	log_app_msg("\t.denied = %lu\n", a->denied);
+	log_app_msg("\t.reloads = %lu\n", a->reloads);
+	log_app_msg("\t.failures = %lu\n", a->failures);
+	log_app_msg("}\n");
+
+}
+
+/* cb_acl_reload */
+void cb_acl_reload(struct ev_loop *loop, ev_signal *watcher, int revents)
+{
+
+	acl_t *a = (acl_t *)watcher->data;
+
+	if ( acl_reload(a) < 0 )
+		{ log_app_msg(">>> ACL reload already in progress.\n"); }
+
+}
+
+/* cb_acl_loaded */
+void cb_acl_loaded(struct ev_loop *loop, ev_async *watcher, int revents)
+{
+
+	acl_t *a = (acl_t *)watcher;
+	a->loading = false;
+
+	// a wrong file leaves the list in use untouched
+	if ( a->pending == NULL )
+	{
+		a->failures++;
+		log_app_msg(">>> ACL reload failed, keeping previous rules.\n");
+		return;
+	}
+
+	acl_trie_t *old = a->trie;
+	a->trie = a->pending;
+	a->pending = NULL;
+	a->reloads++;
+	free_acl_trie(old);
+
+	log_app_msg(">>> ACL reloaded, %d rules.\n", a->trie->no_rules);
+
+}
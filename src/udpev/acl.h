@@ -0,0 +1,253 @@
+/**
+ * @file acl.h
+ * @author Ricardo Tubío (rtpardavila[at]gmail.com)
+ * @version 0.1
+ *
+ * @section LICENSE
+ *
+ * This file is part of udpip-broadcaster.
+ * udpip-broadcaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * udpip-broadcaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with udpip-broadcaster.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Source access control list: allow/deny rules over IPv4 prefixes, resolved
+ * by longest prefix match. Rules are expanded into a DIR-16-8-8 multibit
+ * trie (a 64K entry root plus 256 entry chunks allocated on demand), so
+ * that every lookup takes at most three memory accesses. The list is read
+ * from a file that looks like this:
+ *
+ *     # comments and blank lines are ignored
+ *     default allow
+ *     deny 10.0.0.0/8
+ *     allow 10.1.2.0/24
+ *
+ * On SIGHUP, the file is read again and a new trie is built by a helper
+ * thread. The new trie is then swapped in from the event loop, so the RX
+ * path is never paused or locked.
+ */
+
+#ifndef ACL_H_
+#define ACL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <signal.h>
+#include <arpa/inet.h>
+#include <ev.h>
+
+#include "../execution_codes.h"
+#include "../logger.h"
+
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// DATA STRUCTURES
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+#define ACL_ROOT_LEN 65536			/**< Entries of the root (16 bits). */
+#define ACL_CHUNK_LEN 256			/**< Entries of a chunk (8 bits). */
+#define ACL_MAX_CHUNKS 65536		/**< Max. chunks of a trie (64 MB). */
+#define ACL_LINE_LEN 128			/**< Max. length of a rule. */
+
+#define ACL_NONE 0					/**< No rule matches. */
+#define ACL_ALLOW 1					/**< Source allowed. */
+#define ACL_DENY 2					/**< Source denied. */
+#define ACL_CHILD 0x80000000		/**< Entry points to a chunk. */
+
+/**
+ * @struct acl_rule
+ * @brief Rule as read from the file.
+ */
+typedef struct acl_rule
+{
+
+	uint32_t prefix;				/**< Prefix (host byte order). */
+	int len;						/**< Length of the prefix (bits). */
+	uint32_t action;				/**< ACL_ALLOW or ACL_DENY. */
+	int line;						/**< Line of the file (for ties). */
+
+} acl_rule_t;
+
+#define LEN__ACL_RULE sizeof(acl_rule_t)
+
+/**
+ * @struct acl_trie
+ * @brief Immutable lookup table built from a list of rules.
+ */
+typedef struct acl_trie
+{
+
+	uint32_t fallback;				/**< Action when no rule matches. */
+	int no_rules;					/**< Rules expanded into the trie. */
+
+	uint32_t root[ACL_ROOT_LEN];	/**< First 16 bits of the address. */
+	uint32_t (*chunks)[ACL_CHUNK_LEN];	/**< Next 8 bits, on demand. */
+	int no_chunks;					/**< Chunks in use. */
+	int max_chunks;					/**< Chunks allocated. */
+
+} acl_trie_t;
+
+#define LEN__ACL_TRIE sizeof(acl_trie_t)
+
+/**
+ * @struct acl
+ * @brief Access control list in use plus its reloading machinery.
+ */
+typedef struct acl
+{
+
+	ev_async loaded;				/**< Reload finished (MUST be 1st). */
+	ev_signal reload;				/**< SIGHUP watcher. */
+	struct ev_loop *loop;			/**< Loop where watchers are run. */
+
+	const char *path;				/**< File with the rules. */
+	acl_trie_t *trie;				/**< Trie in use. */
+	acl_trie_t *pending;			/**< Trie built by the loader. */
+	bool loading;					/**< A loader thread is running. */
+
+	unsigned long allowed;			/**< Messages allowed. */
+	unsigned long denied;			/**< Messages denied. */
+	unsigned long reloads;			/**< Tries swapped in. */
+	unsigned long failures;			/**< Reloads that failed. */
+
+} acl_t;
+
+#define LEN__ACL sizeof(acl_t)
+
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// TRIE MANAGEMENT
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+/**
+ * @brief Allocates memory for an acl_trie structure.
+ * @return A pointer to the newly allocated block of memory.
+ */
+acl_trie_t *new_acl_trie();
+
+/**
+ * @brief Builds a trie from a list of rules.
+ * @param rules Rules (sorted in place by prefix length).
+ * @param n Number of rules.
+ * @param fallback Action when no rule matches.
+ * @return A pointer to the trie, NULL if it could not be built.
+ */
+acl_trie_t *init_acl_trie(	acl_rule_t *rules, const int n,
+							const uint32_t fallback	);
+
+/**
+ * @brief Reads a file of rules and builds its trie.
+ * @param path Path of the file.
+ * @return A pointer to the trie, NULL if the file is wrong.
+ */
+acl_trie_t *acl_trie_load(const char *path);
+
+/**
+ * @brief Frees the given trie.
+ * @param t The trie.
+ */
+void free_acl_trie(acl_trie_t *t);
+
+/**
+ * @brief Longest prefix match of an address.
+ * @param t The trie.
+ * @param addr Address (host byte order).
+ * @return ACL_ALLOW or ACL_DENY.
+ */
+static inline uint32_t acl_trie_lookup(const acl_trie_t *t, const uint32_t addr)
+{
+
+	uint32_t e = t->root[addr >> 16];
+
+	if ( e & ACL_CHILD )
+	{
+		e = t->chunks[e & ~ACL_CHILD][( addr >> 8 ) & 0xFF];
+		if ( e & ACL_CHILD )
+			{ e = t->chunks[e & ~ACL_CHILD][addr & 0xFF]; }
+	}
+
+	return( ( e == ACL_NONE ) ? t->fallback : e );
+
+}
+
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// ACL MANAGEMENT
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+/**
+ * @brief Allocates memory for an acl structure.
+ * @return A pointer to the newly allocated block of memory.
+ */
+acl_t *new_acl();
+
+/**
+ * @brief Loads the rules of a file and reloads them on SIGHUP.
+ * @param loop Event loop where the watchers are to be run.
+ * @param path File with the rules.
+ * @return A pointer to the initialized structure.
+ */
+acl_t *init_acl(struct ev_loop *loop, const char *path);
+
+/**
+ * @brief Starts reloading the rules, unless a reload is in progress.
+ * @param a The access control list.
+ * @return EX_OK if started, EX_ERR otherwise.
+ */
+int acl_reload(acl_t *a);
+
+/**
+ * @brief Checks whether messages from the given source are allowed.
+ * @param a The access control list.
+ * @param addr Source address (network byte order).
+ * @return 'true' if allowed.
+ */
+static inline bool acl_allow(acl_t *a, const in_addr_t addr)
+{
+
+	if ( acl_trie_lookup(a->trie, ntohl(addr)) == ACL_DENY )
+		{ a->denied++; return(false); }
+
+	a->allowed++;
+	return(true);
+
+}
+
+/**
+ * @brief Handler of the "acl" control command.
+ * 			acl: counters of the list.
+ * 			acl lookup ADDRESS: action for a source.
+ * 			acl reload: reads the file again.
+ * @return Number of bytes written to the response.
+ */
+int acl_control(	void *arg, int argc, char **argv,
+					char *out, const int out_len	);
+
+/**
+ * @brief Prints the counters of the given access control list.
+ * @param a The access control list.
+ */
+void print_acl(const acl_t *a);
+
+/**
+ * @brief Callback that starts a reload on SIGHUP.
+ */
+void cb_acl_reload(struct ev_loop *loop, ev_signal *watcher, int revents);
+
+/**
+ * @brief Callback that swaps in the trie built by the loader thread.
+ */
+void cb_acl_loaded(struct ev_loop *loop, ev_async *watcher, int revents);
+
+#endif /* ACL_H_ */
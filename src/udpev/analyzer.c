@@ -0,0 +1,270 @@
+/**
+ * @file analyzer.c
+ * @author Ricardo Tubío (rtpardavila[at]gmail.com)
+ * @version 0.1
+ *
+ * @section LICENSE
+ *
+ * This file is part of udpip-broadcaster.
+ * udpip-broadcaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * udpip-broadcaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with udpip-broadcaster.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <endian.h>
+
+#include "analyzer.h"
+#include "hash.h"
+
+/* __lost; messages of a flow never received */
+static inline uint64_t __lost(const analyzer_flow_t *f)
+{
+	uint64_t expected = f->max_seq - f->first_seq + 1;
+	uint64_t unique = f->received - f->duplicates;
+	return( ( expected > unique ) ? expected - unique : 0 );
+}
+
+/* __lookup; slot of a flow, NULL if the table is full */
+static analyzer_flow_t *__lookup(	analyzer_t *a, const uint32_t addr,
+									const uint16_t port, const uint32_t flow	)
+{
+
+	uint32_t h = (uint32_t)( hash_source(addr, port) ^ hash_u32(flow) );
+
+	for ( int i = 0; i < ANALYZER_FLOWS; i++ )
+	{
+
+		analyzer_flow_t *f = &a->flows[( h + i ) & ( ANALYZER_FLOWS - 1 )];
+
+		if ( f->used == false )
+		{
+			f->used = true;
+			f->src_addr = addr;
+			f->src_port = port;
+			f->flow = flow;
+			a->no_flows++;
+			return(f);
+		}
+
+		if ( ( f->src_addr == addr ) && ( f->src_port == port ) &&
+				( f->flow == flow ) )
+			{ return(f); }
+
+	}
+
+	return(NULL);
+
+}
+
+/* __sequence; loss, reordering and duplicates of a flow */
+static void __sequence(analyzer_flow_t *f, const uint64_t seq)
+{
+
+	// 1) first message, or the highest so far
+	if ( f->received == 0 )
+	{
+		f->first_seq = f->max_seq = seq;
+		f->window = 1;
+		return;
+	}
+
+	if ( seq > f->max_seq )
+	{
+		uint64_t shift = seq - f->max_seq;
+		f->window = ( shift < ANALYZER_WINDOW ) ? f->window << shift : 0;
+		f->window |= 1;
+		f->max_seq = seq;
+		return;
+	}
+
+	// 2) older ones, duplicates are only told apart within the window
+	uint64_t d = f->max_seq - seq;
+
+	if ( d < ANALYZER_WINDOW )
+	{
+		if ( f->window & ( 1ULL << d ) ) { f->duplicates++; return; }
+		f->window |= 1ULL << d;
+	}
+
+	if ( seq < f->first_seq ) { f->first_seq = seq; }
+	f->reordered++;
+
+}
+
+/* new_analyzer */
+analyzer_t *new_analyzer()
+{
+	analyzer_t *s = NULL;
+	if ( ( s = (analyzer_t *)malloc(LEN__ANALYZER) ) == NULL )
+		{ handle_sys_error("new_analyzer: <malloc> returns NULL."); }
+	if ( memset(s, 0, LEN__ANALYZER) == NULL )
+		{ handle_sys_error("new_analyzer: <memset> returns NULL."); }
+	return(s);
+}
+
+/* init_analyzer */
+analyzer_t *init_analyzer(struct ev_loop *loop, const int duration)
+{
+
+	analyzer_t *s = new_analyzer();
+
+	s->loop = loop;
+	s->duration = duration;
+	s->start = ev_time();
+	s->period = init_latency(loop, "period");
+	s->total = init_latency(loop, "total");
+
+	ev_timer_init(&s->report, cb_analyzer_report
+					, ANALYZER_PERIOD, ANALYZER_PERIOD);
+	ev_timer_start(loop, &s->report);
+
+	return(s);
+
+}
+
+/* analyzer_add */
+void analyzer_add(	analyzer_t *a, const sockaddr_in_t *src,
+					const void *data, const int len, const uint64_t rx_ns	)
+{
+
+	generator_header_t h;
+
+	if ( len < (int)LEN__GENERATOR_HEADER ) { a->foreign++; return; }
+	memcpy(&h, data, LEN__GENERATOR_HEADER);
+	if ( ntohl(h.magic) != GENERATOR_MAGIC ) { a->foreign++; return; }
+
+	uint64_t seq = be64toh(h.seq), tx_ns = be64toh(h.tx_ns);
+	uint64_t at = ( rx_ns > 0 ) ? rx_ns : latency_now_ns();
+
+	a->received++;
+	a->bytes += len;
+
+	// 1) latency of every message, flows tracked or not
+	latency_add(a->period, tx_ns, at);
+	latency_add(a->total, tx_ns, at);
+
+	analyzer_flow_t *f = __lookup(a, src->sin_addr.s_addr, src->sin_port
+									, ntohl(h.flow));
+	if ( f == NULL ) { a->untracked++; return; }
+
+	// 2) sequence and jitter (RFC 3550, 6.4.1)
+	__sequence(f, seq);
+
+	int64_t transit = (int64_t)( at - tx_ns );
+	if ( f->received > 0 )
+	{
+		int64_t d = transit - f->transit;
+		if ( d < 0 ) { d = -d; }
+		f->jitter += ( d - f->jitter ) / 16;
+	}
+	f->transit = transit;
+
+	f->received++;
+	f->bytes += len;
+
+}
+
+/* print_analyzer */
+void print_analyzer(const analyzer_t *a)
+{
+
+	uint64_t lost = 0, reordered = 0, duplicates = 0;
+
+	for ( int i = 0; i < ANALYZER_FLOWS; i++ )
+	{
+		if ( a->flows[i].used == false ) { continue; }
+		lost += __lost(&a->flows[i]);
+		reordered += a->flows[i].reordered;
+		duplicates += a->flows[i].duplicates;
+	}
+
+	log_app_msg(">>> Analyzer = \n{\n");
+	log_app_msg("\t.elapsed = %.1f secs\n", ev_time() - a->start);
+	log_app_msg("\t.flows = %d (untracked msgs = %llu)\n", a->no_flows
+					, (unsigned long long)a->untracked);
+	log_app_msg("\t.received = %llu (%llu bytes, foreign = %llu)\n"
+					, (unsigned long long)a->received
+					, (unsigned long long)a->bytes
+					, (unsigned long long)a->foreign);
+	log_app_msg("\t.lost = %llu, reordered = %llu, duplicates = %llu\n"
+					, (unsigned long long)lost
+					, (unsigned long long)reordered
+					, (unsigned long long)duplicates);
+	log_app_msg("\t.latency = p50 %llu, p90 %llu, p99 %llu, p99.9 %llu, " \
+					"max %llu ns (clock steps = %lu)\n"
+					, (unsigned long long)latency_percentile(a->total, 0.50)
+					, (unsigned long long)latency_percentile(a->total, 0.90)
+					, (unsigned long long)latency_percentile(a->total, 0.99)
+					, (unsigned long long)latency_percentile(a->total, 0.999)
+					, (unsigned long long)a->total->max, a->total->skipped);
+	log_app_msg("}\n");
+
+}
+
+/* cb_analyzer_report */
+void cb_analyzer_report(struct ev_loop *loop, ev_timer *watcher, int revents)
+{
+
+	analyzer_t *a = (analyzer_t *)watcher;
+	char addr[INET_ADDRSTRLEN];
+	uint64_t msgs = a->received - a->period_received;
+	uint64_t bytes = a->bytes - a->period_bytes;
+	int shown = 0;
+
+	// 1) rate and latency of the last period
+	log_app_msg(">>> analyzer: %.0f msgs/s %.2f Mbit/s latency(us) " \
+					"p50=%.1f p90=%.1f p99=%.1f max=%.1f\n"
+					, msgs / ANALYZER_PERIOD
+					, bytes * 8.0 / ANALYZER_PERIOD / 1e6
+					, latency_percentile(a->period, 0.50) / 1e3
+					, latency_percentile(a->period, 0.90) / 1e3
+					, latency_percentile(a->period, 0.99) / 1e3
+					, a->period->max / 1e3);
+
+	// 2) flows, since the start of the test
+	for ( int i = 0; ( i < ANALYZER_FLOWS ) &&
+						( shown < ANALYZER_REPORT_FLOWS ); i++ )
+	{
+
+		const analyzer_flow_t *f = &a->flows[i];
+		if ( f->used == false ) { continue; }
+
+		struct in_addr in;
+		in.s_addr = f->src_addr;
+		inet_ntop(AF_INET, &in, addr, sizeof(addr));
+
+		log_app_msg("\t%s:%d/%u rx=%llu lost=%llu reord=%llu dup=%llu " \
+						"jitter=%.1fus\n"
+						, addr, ntohs(f->src_port), f->flow
+						, (unsigned long long)f->received
+						, (unsigned long long)__lost(f)
+						, (unsigned long long)f->reordered
+						, (unsigned long long)f->duplicates
+						, f->jitter / 1e3);
+		shown++;
+
+	}
+
+	if ( a->no_flows > shown )
+		{ log_app_msg("\t(%d more flows)\n", a->no_flows - shown); }
+
+	a->period_received = a->received;
+	a->period_bytes = a->bytes;
+	latency_reset(a->period);
+
+	if ( ( a->duration > 0 ) && ( ev_time() - a->start >= a->duration ) )
+	{
+		ev_timer_stop(loop, watcher);
+		ev_break(loop, EVBREAK_ALL);
+	}
+
+}
@@ -0,0 +1,155 @@
+/**
+ * @file analyzer.h
+ * @author Ricardo Tubío (rtpardavila[at]gmail.com)
+ * @version 0.1
+ *
+ * @section LICENSE
+ *
+ * This file is part of udpip-broadcaster.
+ * udpip-broadcaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * udpip-broadcaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with udpip-broadcaster.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Receiver side of the load tests: messages of the traffic generator are
+ * accounted per flow (source and generator flow) in a preallocated table,
+ * so that losses, reordering, duplicates, one-way latency and RFC 3550
+ * jitter are measured without allocating while receiving. Summaries with
+ * latency percentiles are printed periodically.
+ */
+
+#ifndef ANALYZER_H_
+#define ANALYZER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ev.h>
+
+#include "../execution_codes.h"
+#include "../logger.h"
+
+#include "udp_socket.h"
+#include "latency.h"
+#include "generator.h"
+
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// DATA STRUCTURES
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+#define ANALYZER_FLOWS 1024				/**< Flows tracked (power of 2). */
+#define ANALYZER_WINDOW 64				/**< Seqs checked for duplicates. */
+#define ANALYZER_PERIOD 1.0				/**< Period of the summaries (s). */
+#define ANALYZER_REPORT_FLOWS 16		/**< Flows per summary. */
+
+/**
+ * @struct analyzer_flow
+ * @brief State of a flow of the generator.
+ */
+typedef struct analyzer_flow
+{
+
+	bool used;						/**< Slot in use. */
+	uint32_t src_addr;				/**< Source address (network order). */
+	uint16_t src_port;				/**< Source port (network order). */
+	uint32_t flow;					/**< Flow within the generator. */
+
+	uint64_t first_seq;				/**< Lowest sequence number seen. */
+	uint64_t max_seq;				/**< Highest sequence number seen. */
+	uint64_t window;				/**< Bit i: max_seq - i received. */
+
+	uint64_t received;				/**< Messages received. */
+	uint64_t bytes;					/**< Bytes received. */
+	uint64_t reordered;				/**< Messages after a later one. */
+	uint64_t duplicates;			/**< Messages received twice. */
+
+	int64_t transit;				/**< Last transit time (ns). */
+	int64_t jitter;					/**< Interarrival jitter (ns). */
+
+} analyzer_flow_t;
+
+#define LEN__ANALYZER_FLOW sizeof(analyzer_flow_t)
+
+/**
+ * @struct analyzer
+ * @brief Per flow accounting of the messages of the generator.
+ */
+typedef struct analyzer
+{
+
+	ev_timer report;				/**< Summary timer (MUST be 1st). */
+	struct ev_loop *loop;			/**< Loop of the analyzer. */
+	int duration;					/**< Seconds (0: forever). */
+	double start;					/**< First summary period start. */
+
+	analyzer_flow_t flows[ANALYZER_FLOWS];	/**< Open addressing table. */
+	int no_flows;					/**< Slots in use. */
+
+	uint64_t received;				/**< Messages of the generator. */
+	uint64_t bytes;					/**< Their bytes. */
+	uint64_t foreign;				/**< Other messages. */
+	uint64_t untracked;				/**< Messages of flows not in table. */
+	uint64_t period_received;		/**< Messages at the last summary. */
+	uint64_t period_bytes;			/**< Bytes at the last summary. */
+
+	latency_t *period;				/**< One-way latency, last period. */
+	latency_t *total;				/**< One-way latency, whole test. */
+
+} analyzer_t;
+
+#define LEN__ANALYZER sizeof(analyzer_t)
+
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// ANALYZER MANAGEMENT
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+/**
+ * @brief Allocates memory for an analyzer structure.
+ * @return A pointer to the newly allocated block of memory.
+ */
+analyzer_t *new_analyzer();
+
+/**
+ * @brief Starts the periodic summaries.
+ * @param loop Event loop of the analyzer.
+ * @param duration Seconds until the loop is broken (0: forever).
+ * @return A pointer to the initialized structure.
+ */
+analyzer_t *init_analyzer(struct ev_loop *loop, const int duration);
+
+/**
+ * @brief Accounts a message received; latencies are only meaningful if the
+ * 			generator runs on the same host or with a synchronized clock.
+ * @param a The analyzer.
+ * @param src Source of the message.
+ * @param data Message.
+ * @param len Bytes of the message.
+ * @param rx_ns Kernel RX timestamp (ns, 0 if unknown).
+ */
+void analyzer_add(	analyzer_t *a, const sockaddr_in_t *src,
+					const void *data, const int len, const uint64_t rx_ns	);
+
+/**
+ * @brief Prints the totals of the whole test.
+ * @param a The analyzer.
+ */
+void print_analyzer(const analyzer_t *a);
+
+/**
+ * @brief Callback that prints the summary of the last period.
+ */
+void cb_analyzer_report(struct ev_loop *loop, ev_timer *watcher, int revents);
+
+#endif /* ANALYZER_H_ */
@@ -0,0 +1,388 @@
+/**
+ * @file async_log.c
+ * @author Ricardo Tubío (rtpardavila[at]gmail.com)
+ * @version 0.1
+ *
+ * @section LICENSE
+ *
+ * This file is part of udpip-broadcaster.
+ * udpip-broadcaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * udpip-broadcaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with udpip-broadcaster.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "async_log.h"
+#include "control.h"
+#include "udp_socket.h"
+
+static async_log_t *__log = NULL;				/**< Running logger. */
+static __thread async_log_ring_t *__ring = NULL;	/**< Ring of the thread. */
+
+#define __ALIGN(n) \
+	( ( (n) + ASYNC_LOG_ALIGN - 1 ) & ~( ASYNC_LOG_ALIGN - 1 ) )
+#define __FORMATTED(len) ( 3 * (len) + 160 )	/**< Max. text of a record. */
+
+static const char *__formats[ASYNC_LOG_FORMATS] =
+{
+	"",
+	">>>@cb_forward_recvfrom: Message blocked!\n",
+	">>>@cb_forward_recvfrom: Wrong NEC message!\n",
+	">>>@cb_broadcast_recvfrom: No NEC template!\n",
+	">>> fwd(net:%d>app:%d), msg[%.2d] = {",
+	">>> BROADCAST(app:%d>net:%d), msg[%.2d] = {",
+	">>> trace(%s) %s:%d at=%llu len=%d, msg = {",
+	"{\"dir\":\"%s\",\"src\":\"%s\",\"port\":%d,\"at\":%llu," \
+		"\"len\":%d,\"data\":\""
+};
+
+static const char *__directions[] = { "net", "app" };
+
+/* __format_trace; header of a sampled message */
+static int __format_trace(	const async_log_record_t *r,
+							char *out, const int out_len	)
+{
+
+	char addr[INET_ADDRSTRLEN];
+	struct in_addr in;
+	in.s_addr = (in_addr_t)r->args[1];
+	inet_ntop(AF_INET, &in, addr, sizeof(addr));
+
+	return(snprintf(out, out_len, __formats[r->format]
+					, __directions[r->args[0] & 1], addr, r->args[2]
+					, (unsigned long long)r->at, r->data_len));
+
+}
+
+/* __format; text of a record, as print_hex_data would have written it */
+static int __format(	const async_log_record_t *r, const uint8_t *data,
+						char *out, const int out_len	)
+{
+
+	bool json = ( r->format == ASYNC_LOG_TRACE_JSON );
+	int n = 0;
+
+	if ( ( r->format == ASYNC_LOG_TRACE_HEX ) || ( json == true ) )
+		{ n = __format_trace(r, out, out_len); }
+	else
+		{ n = snprintf(out, out_len, __formats[r->format]
+						, r->args[0], r->args[1], r->args[2]); }
+
+	if ( n >= out_len ) { return(out_len - 1); }
+	if ( ( r->format < ASYNC_LOG_FWD ) || ( out_len - n < 3 * r->len + 32 ) )
+		{ return(n); }
+
+	// data (callers size the buffer with __FORMATTED)
+	n += hex_encode(out + n, data, r->len, ( json == true ) ? '\0' : ':');
+	if ( ( json == false ) && ( r->len > 0 ) && ( r->len < r->data_len ) )
+		{ out[n++] = ':'; }
+
+	if ( json == true )
+		{ n += snprintf(out + n, out_len - n, "\",\"truncated\":%s}\n"
+						, ( r->len < r->data_len ) ? "true" : "false"); }
+	else
+		{ n += snprintf(out + n, out_len - n, "%s}\n"
+						, ( r->len < r->data_len ) ? "..." : ""); }
+
+	return( ( n < out_len ) ? n : out_len - 1 );
+
+}
+
+/* __register; ring of the calling thread */
+static async_log_ring_t *__register(async_log_t *l)
+{
+
+	async_log_ring_t *r = NULL;
+
+	pthread_mutex_lock(&l->lock);
+
+	if ( l->no_rings < ASYNC_LOG_RINGS )
+	{
+
+		if ( ( r = (async_log_ring_t *)malloc(LEN__ASYNC_LOG_RING) ) == NULL )
+			{ handle_sys_error("__register: <malloc> returns NULL."); }
+		memset(r, 0, LEN__ASYNC_LOG_RING);
+		if ( ( r->buffer = (uint8_t *)malloc(ASYNC_LOG_RING) ) == NULL )
+			{ handle_sys_error("__register: <malloc> returns NULL."); }
+
+		l->rings[l->no_rings] = r;
+		__atomic_store_n(&l->no_rings, l->no_rings + 1, __ATOMIC_RELEASE);
+
+	}
+
+	pthread_mutex_unlock(&l->lock);
+	return(r);
+
+}
+
+/* __writev; the whole batch, unless the output fails */
+static void __writev(const int fd, struct iovec *iov, int iovcnt)
+{
+
+	while ( iovcnt > 0 )
+	{
+
+		ssize_t w = writev(fd, iov, iovcnt);
+		if ( w < 0 )
+		{
+			if ( errno == EINTR ) { continue; }
+			return;
+		}
+
+		while ( ( iovcnt > 0 ) && ( (size_t)w >= iov->iov_len ) )
+			{ w -= iov->iov_len; iov++; iovcnt--; }
+		if ( iovcnt > 0 )
+		{
+			iov->iov_base = (char *)iov->iov_base + w;
+			iov->iov_len -= w;
+		}
+
+	}
+
+}
+
+/* __drain; formats and writes what the rings hold, returns bytes written */
+static int __drain(async_log_t *l)
+{
+
+	struct iovec iov[ASYNC_LOG_RINGS];
+	int iovcnt = 0, used = 0, records = 0;
+	int no_rings = __atomic_load_n(&l->no_rings, __ATOMIC_ACQUIRE);
+
+	// rings are published with no_rings, so registering a new one does not
+	//		wait for a write to the output
+	pthread_mutex_lock(&l->drain);
+
+	for ( int i = 0; i < no_rings; i++ )
+	{
+
+		async_log_ring_t *r = l->rings[i];
+		int start = used;
+		uint64_t tail = r->tail;
+		uint64_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+
+		// 1) records are formatted while they fit in the batch
+		while ( tail < head )
+		{
+
+			const async_log_record_t *rec = (const async_log_record_t *)
+									( r->buffer + tail % ASYNC_LOG_RING );
+
+			if ( rec->format != ASYNC_LOG_PAD )
+			{
+				if ( ASYNC_LOG_BATCH - used < __FORMATTED(rec->len) )
+					{ break; }
+				used += __format(rec, (const uint8_t *)( rec + 1 )
+									, l->batch + used, ASYNC_LOG_BATCH - used);
+				records++;
+			}
+
+			tail += rec->size;
+
+		}
+
+		__atomic_store_n(&r->tail, tail, __ATOMIC_RELEASE);
+
+		// 2) drops are reported where they happened
+		uint64_t dropped = __atomic_load_n(&r->dropped, __ATOMIC_RELAXED);
+		if ( ( dropped != r->reported ) && ( ASYNC_LOG_BATCH - used > 128 ) )
+		{
+			used += snprintf(l->batch + used, ASYNC_LOG_BATCH - used
+						, ">>> async_log: %llu records dropped\n"
+						, (unsigned long long)( dropped - r->reported ));
+			r->reported = dropped;
+		}
+
+		if ( used > start )
+		{
+			iov[iovcnt].iov_base = l->batch + start;
+			iov[iovcnt].iov_len = used - start;
+			iovcnt++;
+		}
+
+	}
+
+	// 3) one write for all the rings, after what stdio still buffers
+	if ( iovcnt > 0 )
+	{
+		if ( l->fd == STDOUT_FILENO ) { fflush(stdout); }
+		__writev(l->fd, iov, iovcnt);
+		__atomic_add_fetch(&l->written, records, __ATOMIC_RELAXED);
+	}
+
+	pthread_mutex_unlock(&l->drain);
+	return(used);
+
+}
+
+/* __writer; background thread */
+static void *__writer(void *arg)
+{
+
+	async_log_t *l = (async_log_t *)arg;
+	struct timespec idle;
+	idle.tv_sec = 0;
+	idle.tv_nsec = ASYNC_LOG_PERIOD_NS;
+
+	for ( ;; )
+		{ if ( __drain(l) == 0 ) { nanosleep(&idle, NULL); } }
+
+	return(NULL);
+
+}
+
+/* __flush; pending records are not lost at exit */
+static void __flush()
+{
+	while ( __drain(__log) > 0 ) {}
+}
+
+/* new_async_log */
+async_log_t *new_async_log()
+{
+	async_log_t *s = NULL;
+	if ( ( s = (async_log_t *)malloc(LEN__ASYNC_LOG) ) == NULL )
+		{ handle_sys_error("new_async_log: <malloc> returns NULL."); }
+	if ( memset(s, 0, LEN__ASYNC_LOG) == NULL )
+		{ handle_sys_error("new_async_log: <memset> returns NULL."); }
+	return(s);
+}
+
+/* init_async_log */
+async_log_t *init_async_log(const int fd)
+{
+
+	async_log_t *s = new_async_log();
+	pthread_attr_t attr;
+
+	s->fd = fd;
+	pthread_mutex_init(&s->lock, NULL);
+	pthread_mutex_init(&s->drain, NULL);
+
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	if ( pthread_create(&s->writer, &attr, __writer, s) != 0 )
+		{ handle_sys_error("init_async_log: <pthread_create> returns error."); }
+	pthread_attr_destroy(&attr);
+
+	__log = s;
+	atexit(__flush);
+
+	return(s);
+
+}
+
+/* __gather; copies up to len bytes of the buffers */
+static void __gather(	uint8_t *out, const struct iovec *iov, const int iovlen,
+						int len	)
+{
+	for ( int i = 0; ( i < iovlen ) && ( len > 0 ); i++ )
+	{
+		int n = ( (int)iov[i].iov_len < len ) ? (int)iov[i].iov_len : len;
+		memcpy(out, iov[i].iov_base, n);
+		out += n;
+		len -= n;
+	}
+}
+
+/* async_log_iov_at */
+void async_log_iov_at(	const int format, const uint64_t at,
+						const int a0, const int a1, const int a2,
+						const struct iovec *iov, const int iovlen,
+						const int len	)
+{
+
+	async_log_record_t rec;
+	int copy = ( iov == NULL ) ? 0 : len;
+	if ( copy < 0 ) { copy = 0; }
+	if ( copy > ASYNC_LOG_PAYLOAD ) { copy = ASYNC_LOG_PAYLOAD; }
+
+	memset(&rec, 0, LEN__ASYNC_LOG_RECORD);
+	rec.format = format;
+	rec.len = copy;
+	rec.size = __ALIGN(LEN__ASYNC_LOG_RECORD + copy);
+	rec.args[0] = a0;
+	rec.args[1] = a1;
+	rec.args[2] = a2;
+	rec.data_len = ( iov == NULL ) ? 0 : len;
+	rec.at = at;
+
+	// 1) without a writer (or a ring for this thread), it is written now
+	async_log_ring_t *r = __ring;
+	if ( ( r == NULL ) && ( __log != NULL ) ) { r = __ring = __register(__log); }
+
+	if ( r == NULL )
+	{
+		uint8_t data[ASYNC_LOG_PAYLOAD];
+		char out[__FORMATTED(ASYNC_LOG_PAYLOAD)];
+		__gather(data, iov, iovlen, copy);
+		int n = __format(&rec, data, out, sizeof(out));
+		log_app_msg("%.*s", n, out);
+		return;
+	}
+
+	// 2) records are never split, the end of the ring is skipped instead
+	uint64_t head = r->head;
+	uint64_t tail = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+	uint64_t off = head % ASYNC_LOG_RING;
+	uint64_t pad = ( off + rec.size > ASYNC_LOG_RING ) ?
+						ASYNC_LOG_RING - off : 0;
+
+	if ( head + pad + rec.size - tail > ASYNC_LOG_RING )
+		{ __atomic_add_fetch(&r->dropped, 1, __ATOMIC_RELAXED); return; }
+
+	if ( pad > 0 )
+	{
+		async_log_record_t *p = (async_log_record_t *)( r->buffer + off );
+		p->format = ASYNC_LOG_PAD;
+		p->size = pad;
+		head += pad;
+		off = 0;
+	}
+
+	memcpy(r->buffer + off, &rec, LEN__ASYNC_LOG_RECORD);
+	__gather(r->buffer + off + LEN__ASYNC_LOG_RECORD, iov, iovlen, copy);
+
+	__atomic_store_n(&r->head, head + rec.size, __ATOMIC_RELEASE);
+
+}
+
+/* async_log_control */
+int async_log_control(	void *arg, int argc, char **argv,
+						char *out, const int out_len	)
+{
+
+	async_log_t *l = (async_log_t *)arg;
+	uint64_t dropped = 0;
+	int no_rings = __atomic_load_n(&l->no_rings, __ATOMIC_ACQUIRE);
+
+	for ( int i = 0; i < no_rings; i++ )
+		{ dropped += __atomic_load_n(&l->rings[i]->dropped
+										, __ATOMIC_RELAXED); }
+
+	return(control_append(out, out_len, "rings=%d written=%llu dropped=%llu\n"
+			, no_rings
+			, (unsigned long long)__atomic_load_n(&l->written
+												, __ATOMIC_RELAXED)
+			, (unsigned long long)dropped));
+
+}
+
+/* print_async_log */
+void print_async_log(const async_log_t *l)
+{
+	log_app_msg(">>> Asynchronous log = \n{\n");
+	log_app_msg("\t.fd = %d\n", l->fd);
+	log_app_msg("\t.ring = %d bytes\n", ASYNC_LOG_RING);
+	log_app_msg("\t.max_rings = %d\n", ASYNC_LOG_RINGS);
+	log_app_msg("\t.max_payload = %d bytes\n", ASYNC_LOG_PAYLOAD);
+	log_app_msg("}\n");
+}
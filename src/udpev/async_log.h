@@ -0,0 +1,205 @@
+/**
+ * @file async_log.h
+ * @author Ricardo Tubío (rtpardavila[at]gmail.com)
+ * @version 0.1
+ *
+ * @section LICENSE
+ *
+ * This file is part of udpip-broadcaster.
+ * udpip-broadcaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * udpip-broadcaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with udpip-broadcaster.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Asynchronous logger for the messages written once per forwarded packet:
+ * the loop only copies a compact binary record (format id, integer arguments
+ * and the payload to be dumped) into a lock-free ring of its own thread, and
+ * a background writer thread formats the records and writes them in batches
+ * with writev. When a ring is full the record is dropped and counted, the
+ * loop never blocks on the output.
+ */
+
+#ifndef ASYNC_LOG_H_
+#define ASYNC_LOG_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/uio.h>
+
+#include "../execution_codes.h"
+#include "../logger.h"
+
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// DATA STRUCTURES
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+#define ASYNC_LOG_RING ( 1 << 22 )		/**< Bytes of every ring. */
+#define ASYNC_LOG_RINGS 8				/**< Max. threads logging. */
+#define ASYNC_LOG_PAYLOAD 5000			/**< Max. bytes dumped per record. */
+#define ASYNC_LOG_BATCH ( 1 << 16 )		/**< Bytes formatted per ring write. */
+#define ASYNC_LOG_PERIOD_NS 2000000		/**< Writer sleep when idle (ns). */
+#define ASYNC_LOG_ALIGN 32				/**< Records start at multiples. */
+
+/**
+ * @enum async_log_format
+ * @brief Messages that can be logged asynchronously.
+ */
+typedef enum async_log_format
+{
+	ASYNC_LOG_PAD = 0,				/**< End of the ring, skipped. */
+	ASYNC_LOG_BLOCKED,				/**< Self-originated message. */
+	ASYNC_LOG_WRONG_NEC,			/**< Wrong NEC message. */
+	ASYNC_LOG_NO_TEMPLATE,			/**< No NEC template for a source. */
+	ASYNC_LOG_FWD,					/**< (port, fwd_port, bytes) + data. */
+	ASYNC_LOG_BROADCAST,			/**< (port, fwd_port, bytes) + data. */
+	ASYNC_LOG_TRACE_HEX,			/**< (direction, addr, port) + data. */
+	ASYNC_LOG_TRACE_JSON,			/**< (direction, addr, port) + data. */
+	ASYNC_LOG_FORMATS				/**< Number of formats. */
+} async_log_format_t;
+
+/**
+ * @struct async_log_record
+ * @brief Header of a record in a ring, followed by its payload.
+ */
+typedef struct async_log_record
+{
+	uint16_t format;				/**< Format of the message. */
+	uint16_t len;					/**< Bytes of payload that follow. */
+	uint32_t size;					/**< Bytes of the record (aligned). */
+	int32_t args[3];				/**< Arguments of the format. */
+	int32_t data_len;				/**< Bytes of data (len if fitted). */
+	uint64_t at;					/**< Timestamp (ns, 0 if none). */
+} async_log_record_t;
+
+#define LEN__ASYNC_LOG_RECORD sizeof(async_log_record_t)
+
+/**
+ * @struct async_log_ring
+ * @brief Single producer, single consumer ring of records.
+ */
+typedef struct async_log_ring
+{
+	uint64_t head;					/**< Bytes written (producer). */
+	uint64_t tail;					/**< Bytes consumed (writer thread). */
+	uint64_t dropped;				/**< Records that did not fit. */
+	uint64_t reported;				/**< Drops already reported. */
+	uint8_t *buffer;				/**< ASYNC_LOG_RING bytes. */
+} async_log_ring_t;
+
+#define LEN__ASYNC_LOG_RING sizeof(async_log_ring_t)
+
+/**
+ * @struct async_log
+ * @brief Rings of all the threads and their writer.
+ */
+typedef struct async_log
+{
+
+	pthread_t writer;				/**< Writer thread. */
+	pthread_mutex_t lock;			/**< Serializes the registration. */
+	pthread_mutex_t drain;			/**< Serializes the writes. */
+	int fd;							/**< Output. */
+
+	int no_rings;					/**< Rings in use. */
+	async_log_ring_t *rings[ASYNC_LOG_RINGS];	/**< One per thread. */
+
+	uint64_t written;				/**< Records written. */
+	char batch[ASYNC_LOG_BATCH];	/**< Formatted records. */
+
+} async_log_t;
+
+#define LEN__ASYNC_LOG sizeof(async_log_t)
+
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// LOGGER MANAGEMENT
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+/**
+ * @brief Allocates memory for an asynchronous logger.
+ * @return A pointer to the newly allocated block of memory.
+ */
+async_log_t *new_async_log();
+
+/**
+ * @brief Starts the writer thread; from then on, records are written to the
+ * 			given file descriptor asynchronously (before, synchronously).
+ * @param fd Output, the standard output is flushed before every batch.
+ * @return A pointer to the initialized structure.
+ */
+async_log_t *init_async_log(const int fd);
+
+/**
+ * @brief Logs a message without blocking; the data is gathered from the
+ * 			buffers (truncated to ASYNC_LOG_PAYLOAD bytes) and dumped in
+ * 			hexadecimal after it.
+ * @param format Format of the message.
+ * @param at Timestamp of the message (ns, 0 if none).
+ * @param a0 First argument.
+ * @param a1 Second argument.
+ * @param a2 Third argument.
+ * @param iov Buffers with the data to be dumped (NULL if none).
+ * @param iovlen Number of buffers.
+ * @param len Bytes of data.
+ */
+void async_log_iov_at(	const int format, const uint64_t at,
+						const int a0, const int a1, const int a2,
+						const struct iovec *iov, const int iovlen,
+						const int len	);
+
+/**
+ * @brief Logs a message with its data in a single buffer
+ * 			(see async_log_iov_at).
+ * @param data Data to be dumped (NULL if none).
+ */
+static inline void async_log_at(	const int format, const uint64_t at,
+									const int a0, const int a1, const int a2,
+									const void *data, const int len	)
+{
+	struct iovec iov;
+	iov.iov_base = (void *)data;
+	iov.iov_len = ( len > 0 ) ? len : 0;
+	async_log_iov_at(format, at, a0, a1, a2
+						, ( data != NULL ) ? &iov : NULL, 1, len);
+}
+
+/**
+ * @brief Logs a message without timestamp (see async_log_at).
+ */
+static inline void async_log(	const int format,
+								const int a0, const int a1, const int a2,
+								const void *data, const int len	)
+{
+	async_log_at(format, 0, a0, a1, a2, data, len);
+}
+
+/**
+ * @brief Handler of the "log" control command: records written and dropped.
+ * @return Number of bytes written to the response.
+ */
+int async_log_control(	void *arg, int argc, char **argv,
+						char *out, const int out_len	);
+
+/**
+ * @brief Prints the configuration of the logger.
+ * @param l The logger.
+ */
+void print_async_log(const async_log_t *l);
+
+#endif /* ASYNC_LOG_H_ */
@@ -0,0 +1,439 @@
+/**
+ * @file capture.c
+ * @author Ricardo Tubío (rtpardavila[at]gmail.com)
+ * @version 0.1
+ *
+ * @section LICENSE
+ *
+ * This file is part of udpip-broadcaster.
+ * udpip-broadcaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * udpip-broadcaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with udpip-broadcaster.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "capture.h"
+#include "control.h"
+
+static capture_t *__capture = NULL;				/**< Running capture. */
+
+#define __SHB 0x0A0D0D0A				/**< Section header block. */
+#define __IDB 0x00000001				/**< Interface description block. */
+#define __EPB 0x00000006				/**< Enhanced packet block. */
+#define __BOM 0x1A2B3C4D				/**< Byte order magic. */
+#define __LINKTYPE_IPV4 228				/**< Raw IPv4 packets. */
+#define __SNAPLEN 65535					/**< Max. bytes per packet. */
+#define __PAD4(n) ( ( (n) + 3 ) & ~3 )	/**< Options are 32-bit aligned. */
+
+#define __OPT_END 0						/**< opt_endofopt */
+#define __OPT_COMMENT 1					/**< opt_comment */
+#define __SHB_USERAPPL 4				/**< shb_userappl */
+#define __IF_NAME 2						/**< if_name */
+#define __IF_TSRESOL 9					/**< if_tsresol */
+#define __EPB_FLAGS 2					/**< epb_flags */
+#define __EPB_INBOUND 0x01				/**< Direction bits of epb_flags. */
+
+#define __COMMENT_LEN 32				/**< Max. comment of a packet. */
+
+static const char *__verdicts[RECORDER_VERDICTS] =
+{
+	"pending", "forwarded", "blocked", "denied",
+	"filtered", "malformed", "dropped", "error"
+};
+
+static const char *__comments[] = { "net>app", "app>net" };
+
+/**
+ * @struct __epb_header
+ * @brief Fixed part of an enhanced packet block plus the IPv4 and UDP
+ * 			headers rebuilt for the message.
+ */
+typedef struct __epb_header
+{
+	uint32_t type;					/**< __EPB */
+	uint32_t length;				/**< Total length of the block. */
+	uint32_t interface;				/**< CAPTURE_NET or CAPTURE_APP. */
+	uint32_t ts_high;				/**< Timestamp (ns), upper 32 bits. */
+	uint32_t ts_low;				/**< Timestamp (ns), lower 32 bits. */
+	uint32_t captured;				/**< Bytes of packet data. */
+	uint32_t original;				/**< Bytes of the packet. */
+	uint8_t ip[20];					/**< IPv4 header. */
+	uint8_t udp[8];					/**< UDP header. */
+} __epb_header_t;
+
+#define LEN__EPB_HEADER sizeof(__epb_header_t)
+
+/**
+ * @struct __epb_trailer
+ * @brief Padding and options of an enhanced packet block.
+ */
+typedef struct __epb_trailer
+{
+	uint8_t bytes[3 + 8 + 4 + __COMMENT_LEN + 4 + 4];	/**< Trailer. */
+	int len;						/**< Bytes used. */
+} __epb_trailer_t;
+
+/* __option; appends an option, returns the bytes written */
+static int __option(	uint8_t *out, const uint16_t code,
+						const void *value, const uint16_t len	)
+{
+	memcpy(out, &code, 2);
+	memcpy(out + 2, &len, 2);
+	memcpy(out + 4, value, len);
+	memset(out + 4 + len, 0, __PAD4(len) - len);
+	return(4 + __PAD4(len));
+}
+
+/* __block; frames a block with its type and (repeated) length */
+static int __block(	uint8_t *out, const uint32_t type,
+					const uint8_t *body, const int len	)
+{
+	uint32_t total = 12 + len;
+	memcpy(out, &type, 4);
+	memcpy(out + 4, &total, 4);
+	memcpy(out + 8, body, len);
+	memcpy(out + 8 + len, &total, 4);
+	return(total);
+}
+
+/* __interface; interface description block */
+static int __interface(uint8_t *out, const char *name)
+{
+
+	uint8_t body[64 + IF_NAMESIZE];
+	uint16_t linktype = __LINKTYPE_IPV4, reserved = 0;
+	uint32_t snaplen = __SNAPLEN;
+	uint8_t tsresol = 9;
+	int n = 0;
+
+	memcpy(body, &linktype, 2);
+	memcpy(body + 2, &reserved, 2);
+	memcpy(body + 4, &snaplen, 4);
+	n = 8;
+	n += __option(body + n, __IF_NAME, name, strlen(name));
+	n += __option(body + n, __IF_TSRESOL, &tsresol, 1);
+	n += __option(body + n, __OPT_END, NULL, 0);
+
+	return(__block(out, __IDB, body, n));
+
+}
+
+/* __header; section header block and both interfaces */
+static int __header(const capture_t *c, uint8_t *out)
+{
+
+	uint8_t body[64];
+	uint32_t bom = __BOM;
+	uint16_t major = 1, minor = 0;
+	int64_t section = -1;
+	const char *appl = "udpipbroadcaster";
+	int n = 0, len = 0;
+
+	memcpy(body, &bom, 4);
+	memcpy(body + 4, &major, 2);
+	memcpy(body + 6, &minor, 2);
+	memcpy(body + 8, &section, 8);
+	n = 16;
+	n += __option(body + n, __SHB_USERAPPL, appl, strlen(appl));
+	n += __option(body + n, __OPT_END, NULL, 0);
+
+	len = __block(out, __SHB, body, n);
+	len += __interface(out + len, c->if_name);
+	len += __interface(out + len, "app");
+
+	return(len);
+
+}
+
+/* __checksum; of the IPv4 header */
+static uint16_t __checksum(const uint8_t *ip)
+{
+	uint32_t sum = 0;
+	for ( int i = 0; i < 20; i += 2 )
+		{ sum += ( ip[i] << 8 ) | ip[i + 1]; }
+	while ( sum >> 16 ) { sum = ( sum & 0xFFFF ) + ( sum >> 16 ); }
+	return(htons(~sum & 0xFFFF));
+}
+
+/* __packet; block of a message around its data, still in the ring */
+static void __packet(	const capture_record_t *r,
+						__epb_header_t *h, __epb_trailer_t *t	)
+{
+
+	uint16_t ip_len = htons(28 + r->len), udp_len = htons(8 + r->len);
+	uint16_t check = 0;
+	uint32_t flags = ( r->direction == CAPTURE_NET ) ? __EPB_INBOUND : 0;
+	char comment[__COMMENT_LEN];
+
+	// 1) IPv4 and UDP headers (UDP checksum not computed)
+	memset(h->ip, 0, sizeof(h->ip) + sizeof(h->udp));
+	h->ip[0] = 0x45;
+	memcpy(h->ip + 2, &ip_len, 2);
+	h->ip[8] = 64;
+	h->ip[9] = IPPROTO_UDP;
+	memcpy(h->ip + 12, &r->src_addr, 4);
+	memcpy(h->ip + 16, &r->dst_addr, 4);
+	check = __checksum(h->ip);
+	memcpy(h->ip + 10, &check, 2);
+	memcpy(h->udp, &r->src_port, 2);
+	memcpy(h->udp + 2, &r->dst_port, 2);
+	memcpy(h->udp + 4, &udp_len, 2);
+
+	// 2) padding of the data and options
+	int comment_len = snprintf(comment, sizeof(comment), "%s %s"
+								, __comments[r->direction & 1]
+								, __verdicts[r->verdict % RECORDER_VERDICTS]);
+	int pad = __PAD4(28 + r->len) - ( 28 + r->len );
+
+	memset(t->bytes, 0, pad);
+	t->len = pad;
+	t->len += __option(t->bytes + t->len, __EPB_FLAGS, &flags, 4);
+	t->len += __option(t->bytes + t->len, __OPT_COMMENT, comment, comment_len);
+	t->len += __option(t->bytes + t->len, __OPT_END, NULL, 0);
+
+	// 3) fixed part, the total length is repeated at the end
+	h->type = __EPB;
+	h->length = LEN__EPB_HEADER + r->len + t->len + 4;
+	h->interface = r->direction;
+	h->ts_high = r->at >> 32;
+	h->ts_low = r->at & 0xFFFFFFFF;
+	h->captured = h->original = 28 + r->len;
+	memcpy(t->bytes + t->len, &h->length, 4);
+	t->len += 4;
+
+}
+
+/* __writev; the whole batch, unless the output fails */
+static int __writev(const int fd, struct iovec *iov, int iovcnt)
+{
+
+	while ( iovcnt > 0 )
+	{
+
+		ssize_t w = writev(fd, iov, iovcnt);
+		if ( w < 0 )
+		{
+			if ( errno == EINTR ) { continue; }
+			return(EX_ERR);
+		}
+
+		while ( ( iovcnt > 0 ) && ( (size_t)w >= iov->iov_len ) )
+			{ w -= iov->iov_len; iov++; iovcnt--; }
+		if ( iovcnt > 0 )
+		{
+			iov->iov_base = (char *)iov->iov_base + w;
+			iov->iov_len -= w;
+		}
+
+	}
+
+	return(EX_OK);
+
+}
+
+/* __rotate; closes the current file and opens the next one */
+static int __rotate(capture_t *c)
+{
+
+	char path[CAPTURE_PATH_LEN + 32];
+	uint8_t header[256 + 2 * IF_NAMESIZE];
+	struct iovec iov;
+
+	if ( c->fd >= 0 ) { close(c->fd); c->fd = -1; }
+
+	snprintf(path, sizeof(path), "%s.%u.pcapng", c->prefix, c->no_files);
+	if ( ( c->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644) ) < 0 )
+	{
+		log_sys_error("capture: <open> cannot create %s.\n", path);
+		return(EX_ERR);
+	}
+
+	iov.iov_base = header;
+	iov.iov_len = __header(c, header);
+	if ( __writev(c->fd, &iov, 1) < 0 )
+	{
+		log_sys_error("capture: <writev> cannot write %s.\n", path);
+		close(c->fd);
+		c->fd = -1;
+		return(EX_ERR);
+	}
+
+	c->no_files++;
+	c->opened = time(NULL);
+	c->file_bytes = iov.iov_len;
+
+	return(EX_OK);
+
+}
+
+/* __drain; writes a batch of the messages committed, returns how many */
+static int __drain(capture_t *c)
+{
+
+	__epb_header_t headers[CAPTURE_BATCH];
+	__epb_trailer_t trailers[CAPTURE_BATCH];
+	struct iovec iov[3 * CAPTURE_BATCH];
+	int iovcnt = 0, packets = 0;
+	uint64_t bytes = 0;
+
+	pthread_mutex_lock(&c->lock);
+
+	uint64_t tail = c->tail;
+	uint64_t head = __atomic_load_n(&c->head, __ATOMIC_ACQUIRE);
+
+	// 1) blocks are built around the data, which stays in the ring
+	while ( ( tail < head ) && ( packets < CAPTURE_BATCH ) )
+	{
+
+		const capture_record_t *r = (const capture_record_t *)
+									( c->ring + tail % CAPTURE_RING );
+		tail += r->size;
+		if ( r->direction == CAPTURE_PAD ) { continue; }
+
+		__packet(r, &headers[packets], &trailers[packets]);
+		iov[iovcnt].iov_base = &headers[packets];
+		iov[iovcnt++].iov_len = LEN__EPB_HEADER;
+		iov[iovcnt].iov_base = (void *)( r + 1 );
+		iov[iovcnt++].iov_len = r->len;
+		iov[iovcnt].iov_base = trailers[packets].bytes;
+		iov[iovcnt++].iov_len = trailers[packets].len;
+		bytes += headers[packets].length;
+		packets++;
+
+	}
+
+	// 2) files are rotated between batches, never within a block
+	if ( packets > 0 )
+	{
+
+		bool rotate = ( c->fd < 0 )
+			|| ( ( c->max_size > 0 ) && ( c->file_bytes >= c->max_size ) )
+			|| ( ( c->max_age > 0 ) && ( time(NULL) - c->opened >= c->max_age ) );
+
+		if ( ( rotate == true ) && ( __rotate(c) < 0 ) )
+			{ __atomic_add_fetch(&c->dropped, packets, __ATOMIC_RELAXED); }
+		else if ( __writev(c->fd, iov, iovcnt) < 0 )
+			{ __atomic_add_fetch(&c->dropped, packets, __ATOMIC_RELAXED); }
+		else
+		{
+			c->file_bytes += bytes;
+			__atomic_add_fetch(&c->packets, packets, __ATOMIC_RELAXED);
+			__atomic_add_fetch(&c->bytes, bytes, __ATOMIC_RELAXED);
+		}
+
+	}
+
+	// 3) the ring is released only once the data has been written
+	__atomic_store_n(&c->tail, tail, __ATOMIC_RELEASE);
+
+	pthread_mutex_unlock(&c->lock);
+	return(packets);
+
+}
+
+/* __writer; capture thread */
+static void *__writer(void *arg)
+{
+
+	capture_t *c = (capture_t *)arg;
+	struct timespec idle;
+	idle.tv_sec = 0;
+	idle.tv_nsec = CAPTURE_PERIOD_NS;
+
+	for ( ;; )
+		{ if ( __drain(c) == 0 ) { nanosleep(&idle, NULL); } }
+
+	return(NULL);
+
+}
+
+/* __flush; messages committed are not lost at exit */
+static void __flush()
+{
+	while ( __drain(__capture) > 0 ) {}
+}
+
+/* new_capture */
+capture_t *new_capture()
+{
+	capture_t *s = NULL;
+	if ( ( s = (capture_t *)malloc(LEN__CAPTURE) ) == NULL )
+		{ handle_sys_error("new_capture: <malloc> returns NULL."); }
+	if ( memset(s, 0, LEN__CAPTURE) == NULL )
+		{ handle_sys_error("new_capture: <memset> returns NULL."); }
+	return(s);
+}
+
+/* init_capture */
+capture_t *init_capture(	const char *prefix, const char *if_name,
+							const int max_mb, const int max_age	)
+{
+
+	capture_t *s = new_capture();
+	pthread_attr_t attr;
+
+	strncpy(s->prefix, prefix, CAPTURE_PATH_LEN - 1);
+	strncpy(s->if_name, if_name, IF_NAMESIZE);
+	s->max_size = (uint64_t)max_mb << 20;
+	s->max_age = max_age;
+	s->fd = -1;
+	pthread_mutex_init(&s->lock, NULL);
+
+	if ( ( s->ring = (uint8_t *)malloc(CAPTURE_RING) ) == NULL )
+		{ handle_sys_error("init_capture: <malloc> returns NULL."); }
+
+	// 1) the first file is created now, so that a wrong prefix is reported
+	if ( __rotate(s) < 0 )
+		{ handle_app_error("init_capture: cannot create capture file.\n"); }
+
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	if ( pthread_create(&s->thread, &attr, __writer, s) != 0 )
+		{ handle_sys_error("init_capture: <pthread_create> returns error."); }
+	pthread_attr_destroy(&attr);
+
+	__capture = s;
+	atexit(__flush);
+
+	return(s);
+
+}
+
+/* capture_control */
+int capture_control(	void *arg, int argc, char **argv,
+						char *out, const int out_len	)
+{
+
+	capture_t *c = (capture_t *)arg;
+
+	return(control_append(out, out_len, "file=%s.%u.pcapng files=%u" \
+			" packets=%llu bytes=%llu dropped=%llu\n"
+			, c->prefix, c->no_files - 1, c->no_files
+			, (unsigned long long)__atomic_load_n(&c->packets
+												, __ATOMIC_RELAXED)
+			, (unsigned long long)__atomic_load_n(&c->bytes
+												, __ATOMIC_RELAXED)
+			, (unsigned long long)__atomic_load_n(&c->dropped
+												, __ATOMIC_RELAXED)));
+
+}
+
+/* print_capture */
+void print_capture(const capture_t *c)
+{
+	log_app_msg(">>> Capture = \n{\n");
+	log_app_msg("\t.prefix = %s\n", c->prefix);
+	log_app_msg("\t.if_name = %s\n", c->if_name);
+	log_app_msg("\t.max_size = %llu bytes\n", (unsigned long long)c->max_size);
+	log_app_msg("\t.max_age = %d secs\n", c->max_age);
+	log_app_msg("\t.ring = %d bytes\n", CAPTURE_RING);
+	log_app_msg("}\n");
+}
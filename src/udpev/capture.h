@@ -0,0 +1,238 @@
+/**
+ * @file capture.h
+ * @author Ricardo Tubío (rtpardavila[at]gmail.com)
+ * @version 0.1
+ *
+ * @section LICENSE
+ *
+ * This file is part of udpip-broadcaster.
+ * udpip-broadcaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * udpip-broadcaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with udpip-broadcaster.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Continuous capture of the messages received in both directions into
+ * rotating pcapng files. The loop only copies every message into a lock-free
+ * ring; a capture thread rebuilds its IPv4/UDP headers (LINKTYPE_IPV4) and
+ * writes enhanced packet blocks in batches with writev, the verdict and
+ * direction of every message in its comment and flags. Files are rotated by
+ * size and by age.
+ */
+
+#ifndef CAPTURE_H_
+#define CAPTURE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#include "../execution_codes.h"
+#include "../logger.h"
+
+#include "udp_socket.h"
+#include "latency.h"
+#include "recorder.h"
+
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// DATA STRUCTURES
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+#define CAPTURE_RING ( 1 << 23 )		/**< Bytes of the ring. */
+#define CAPTURE_ALIGN 32				/**< Records start at multiples. */
+#define CAPTURE_BATCH 64				/**< Messages per write. */
+#define CAPTURE_PERIOD_NS 2000000		/**< Thread sleep when idle (ns). */
+#define CAPTURE_PATH_LEN 256			/**< Max. length of a file name. */
+#define CAPTURE_PAD 0xFF				/**< Direction of the ring end. */
+
+#define CAPTURE_NET 0					/**< Messages from the network. */
+#define CAPTURE_APP 1					/**< Messages from applications. */
+
+/**
+ * @struct capture_record
+ * @brief Header of a message in the ring, followed by its data.
+ */
+typedef struct capture_record
+{
+	uint32_t size;					/**< Bytes of the record (aligned). */
+	uint16_t len;					/**< Bytes of data that follow. */
+	uint8_t direction;				/**< CAPTURE_NET, _APP or _PAD. */
+	uint8_t verdict;				/**< recorder_verdict_t. */
+	uint32_t src_addr;				/**< Source address (network order). */
+	uint32_t dst_addr;				/**< Local address (network order). */
+	uint16_t src_port;				/**< Source port (network order). */
+	uint16_t dst_port;				/**< Local port (network order). */
+	uint32_t __pad;					/**< Timestamp alignment. */
+	uint64_t at;					/**< RX time (ns, CLOCK_REALTIME). */
+} capture_record_t;
+
+#define LEN__CAPTURE_RECORD sizeof(capture_record_t)
+
+/**
+ * @struct capture
+ * @brief Capture ring, its thread and the current file.
+ */
+typedef struct capture
+{
+
+	pthread_t thread;				/**< Capture thread. */
+	pthread_mutex_t lock;			/**< Thread and exit flush. */
+	char prefix[CAPTURE_PATH_LEN];	/**< Files are <prefix>.<n>.pcapng */
+	char if_name[IF_NAMESIZE + 1];	/**< Network interface. */
+	uint64_t max_size;				/**< Rotation size (bytes, 0: none). */
+	int max_age;					/**< Rotation age (secs, 0: none). */
+
+	uint64_t head;					/**< Bytes written (loop). */
+	uint64_t pending;				/**< Bytes not committed yet (loop). */
+	capture_record_t *record;		/**< Record not committed yet (loop). */
+	uint64_t tail;					/**< Bytes consumed (capture thread). */
+	uint64_t dropped;				/**< Messages that did not fit. */
+	uint8_t *ring;					/**< CAPTURE_RING bytes. */
+
+	int fd;							/**< Current file (-1: none). */
+	unsigned int no_files;			/**< Files opened. */
+	time_t opened;					/**< When the file was opened. */
+	uint64_t file_bytes;			/**< Bytes of the current file. */
+	uint64_t packets;				/**< Messages written. */
+	uint64_t bytes;					/**< Bytes written. */
+
+} capture_t;
+
+#define LEN__CAPTURE sizeof(capture_t)
+
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// CAPTURE MANAGEMENT
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+/**
+ * @brief Allocates memory for a capture structure.
+ * @return A pointer to the newly allocated block of memory.
+ */
+capture_t *new_capture();
+
+/**
+ * @brief Opens the first file and starts the capture thread.
+ * @param prefix Prefix of the files.
+ * @param if_name Network interface, for the interface description blocks.
+ * @param max_mb Files are rotated when they reach this size (MB, 0: never).
+ * @param max_age Files are rotated after these seconds (0: never).
+ * @return A pointer to the initialized structure.
+ */
+capture_t *init_capture(	const char *prefix, const char *if_name,
+							const int max_mb, const int max_age	);
+
+/**
+ * @brief Handler of the "capture" control command: files and counters.
+ * @return Number of bytes written to the response.
+ */
+int capture_control(	void *arg, int argc, char **argv,
+						char *out, const int out_len	);
+
+/**
+ * @brief Prints the configuration of the capture.
+ * @param c The capture.
+ */
+void print_capture(const capture_t *c);
+
+/**
+ * @brief Copies a message that has just been received into the ring; it is
+ * 			not written until its verdict is known (capture_commit).
+ * @param c The capture (NULL if off).
+ * @param direction CAPTURE_NET or CAPTURE_APP.
+ * @param src Source of the message.
+ * @param dst Local address of the events (interface and port).
+ * @param iov Buffers where the message was received.
+ * @param iovlen Number of buffers.
+ * @param len Bytes of the message.
+ * @param rx_ns Kernel RX timestamp (ns, 0 if unknown).
+ */
+static inline void capture_add(	capture_t *c, const int direction,
+								const sockaddr_in_t *src,
+								const sockaddr_in_t *dst,
+								const struct iovec *iov, const int iovlen,
+								const int len, const uint64_t rx_ns	)
+{
+
+	if ( c == NULL ) { return; }
+
+	int copy = ( len > 0 ) ? len : 0;
+	uint32_t size = ( LEN__CAPTURE_RECORD + copy + CAPTURE_ALIGN - 1 )
+						& ~( CAPTURE_ALIGN - 1 );
+	uint64_t head = c->head;
+	uint64_t tail = __atomic_load_n(&c->tail, __ATOMIC_ACQUIRE);
+	uint64_t off = head % CAPTURE_RING;
+	uint64_t pad = ( off + size > CAPTURE_RING ) ? CAPTURE_RING - off : 0;
+
+	c->pending = 0;
+	if ( head + pad + size - tail > CAPTURE_RING )
+		{ __atomic_add_fetch(&c->dropped, 1, __ATOMIC_RELAXED); return; }
+
+	// records are never split, the end of the ring is skipped instead
+	if ( pad > 0 )
+	{
+		capture_record_t *e = (capture_record_t *)( c->ring + off );
+		e->size = pad;
+		e->direction = CAPTURE_PAD;
+		off = 0;
+	}
+
+	capture_record_t *r = (capture_record_t *)( c->ring + off );
+	r->size = size;
+	r->len = copy;
+	r->direction = direction;
+	r->verdict = RECORDER_PENDING;
+	r->src_addr = src->sin_addr.s_addr;
+	r->src_port = src->sin_port;
+	r->dst_addr = dst->sin_addr.s_addr;
+	r->dst_port = dst->sin_port;
+	r->at = ( rx_ns > 0 ) ? rx_ns : latency_now_ns();
+
+	uint8_t *p = (uint8_t *)( r + 1 );
+	for ( int i = 0; ( i < iovlen ) && ( copy > 0 ); i++ )
+	{
+		int n = ( (int)iov[i].iov_len < copy ) ? (int)iov[i].iov_len : copy;
+		memcpy(p, iov[i].iov_base, n);
+		p += n;
+		copy -= n;
+	}
+
+	c->record = r;
+	c->pending = pad + size;
+
+}
+
+/**
+ * @brief Sets the verdict of the last message added and hands it over to
+ * 			the capture thread.
+ * @param c The capture (NULL if off).
+ * @param verdict What happened to the message (recorder_verdict_t).
+ */
+static inline void capture_commit(capture_t *c, const int verdict)
+{
+
+	if ( ( c == NULL ) || ( c->pending == 0 ) ) { return; }
+
+	c->record->verdict = verdict;
+	__atomic_store_n(&c->head, c->head + c->pending, __ATOMIC_RELEASE);
+	c->pending = 0;
+
+}
+
+#endif /* CAPTURE_H_ */
@@ -33,7 +33,7 @@ void cb_print_recvfrom(public_ev_arg_t *arg)
 	//		(self-broadcast messages are not received)
 	if ( ( arg->len = recv_msg(arg->socket_fd, arg->msg_header
 								, arg->local_addr->sin_addr.s_addr
-								, &blocked) ) < 0 )
+								, &blocked, NULL) ) < 0 )
 	{
 		log_app_msg("cb_print_recvfrom: <recv_msg> " \
 						"Could not receive message.\n");
@@ -46,34 +46,63 @@ void cb_print_recvfrom(public_ev_arg_t *arg)
 
 }
 
-#define __TX_DELAY_US 1000000		/**< (usecs) without sending. */
+/* cb_analyze_recvfrom */
+void cb_analyze_recvfrom(public_ev_arg_t *arg)
+{
+
+	bool blocked = false;
+	arg->len = 0;
+
+	// (messages from this host are analyzed too, the generator may run here)
+	if ( ( arg->len = recv_msg(arg->socket_fd, arg->msg_header
+								, arg->local_addr->sin_addr.s_addr
+								, &blocked, &arg->rx_ns) ) < 0 )
+	{
+		log_app_msg("cb_analyze_recvfrom: <recv_msg> " \
+						"Could not receive message.\n");
+		return;
+	}
 
-#define __DATA_BUFFER_LEN 100		/**< Length of the buffer. */
-char data[__DATA_BUFFER_LEN];		/**< Static buffer. */
+	analyzer_add(arg->analyzer, (sockaddr_in_t *)arg->msg_header->msg_name
+					, arg->data, arg->len, arg->rx_ns);
 
-/* cb_broadcast_sendto */
-void cb_broadcast_sendto(public_ev_arg_t *arg)
+}
+
+/* __strip_nec_rx_header */
+static int __strip_nec_rx_header(	public_ev_arg_t *arg, __NEC__msg_t *msg,
+									const char **payload, int *payload_len	)
 {
 
-	sprintf(data, "BROADCAST-TEST#%d", arg->__test_number++);
-	int len = strlen(data);
+	const int sg_len = LEN____NEC__GNBTPAPI_TSB_RX_HEADER;
+	int extra = LEN____NEC__GNBTPAPI_MAX_HEADER - sg_len;
 
-	sockaddr_t *dest_addr = (sockaddr_t *)
-			init_broadcast_sockaddr_in(arg->port);
+	if ( arg->len < sg_len ) { return(EX_WRONG_PARAM); }
+	if ( arg->len - sg_len < extra ) { extra = arg->len - sg_len; }
 
-	printf(">>> BROADCAST TEST (fd = %d): sending test[%d] = %s\n"
-			, arg->socket_fd, len, data);
+	// 1) longer headers overflow into the data buffer: only those header
+	//		bytes are brought back next to the rest of the header
+	memcpy(arg->nec_rx_header + sg_len, arg->data, extra);
 
-	send_message(dest_addr, arg->socket_fd, data, len);
+	// 2) the view only covers the headers, but validation is done against
+	//		the total length of the message
+	if ( __NEC__parse_rx(arg->nec_rx_header, arg->len, msg) < 0 )
+		{ return(EX_WRONG_PARAM); }
 
-	if ( usleep(__TX_DELAY_US) < 0 )
-	{
-		log_app_msg("Could not sleep for %d (usecs).\n", __TX_DELAY_US);
-		return;
-	}
+	*payload = (const char *)arg->data + ( msg->header_len - sg_len );
+	*payload_len = msg->payload_len;
+
+	return(EX_OK);
 
 }
 
+/* __verdict; of a message, for the recorder and the capture */
+static inline void __verdict(	public_ev_arg_t *arg, recorder_slot_t *rec,
+								const int verdict	)
+{
+	recorder_verdict(rec, verdict);
+	capture_commit(arg->capture, verdict);
+}
+
 /* cb_forward_recvfrom */
 void cb_forward_recvfrom(public_ev_arg_t *arg)
 {
@@ -84,36 +113,123 @@ void cb_forward_recvfrom(public_ev_arg_t *arg)
 	// 1) read UDP message from network level
 	if ( ( arg->len = recv_msg(arg->socket_fd, arg->msg_header
 								, arg->local_addr->sin_addr.s_addr
-								, &blocked) ) < 0 )
+								, &blocked, &arg->rx_ns) ) < 0 )
 	{
 		log_app_msg("cb_forward_recvfrom: <recv_msg> " \
 						"Could not receive message.\n");
+		stats_error(arg->stats);
 		return;
 	}
 
+	stats_rx(arg->stats, arg->len);
+
+	sockaddr_in_t *src = (sockaddr_in_t *)arg->msg_header->msg_name;
+	recorder_slot_t *rec = recorder_add(arg->recorder, RECORDER_NET, src
+					, arg->msg_header->msg_iov, arg->msg_header->msg_iovlen
+					, arg->len, arg->rx_ns);
+	capture_add(arg->capture, CAPTURE_NET, src, arg->local_addr
+					, arg->msg_header->msg_iov, arg->msg_header->msg_iovlen
+					, arg->len, arg->rx_ns);
+
 	// 2) in case the message comes from the localhost, it is discarded
 	if ( blocked == true )
 	{
-		log_app_msg(">>>@cb_forward_recvfrom: Message blocked!\n");
+		async_log(ASYNC_LOG_BLOCKED, 0, 0, 0, NULL, 0);
+		__verdict(arg, rec, RECORDER_BLOCKED);
+		stats_blocked(arg->stats);
 		return;
 	}
 
+	// 3) every message is accounted to its source and to its flow, denied
+	//		ones too
+	flow_entry_t *flow = ( arg->flows != NULL ) ?
+		flow_table_update(arg->flows, src, arg->forwarding_addr
+							, FLOW_NET_TO_APP, arg->len) : NULL;
+
+	if ( arg->talkers != NULL )
+		{ top_talkers_add(arg->talkers, src, arg->len); }
+
+	trace_packet(arg->trace, TRACE_NET, flow, src
+					, arg->msg_header->msg_iov, arg->msg_header->msg_iovlen
+					, arg->len, arg->rx_ns);
+
+	// 4) sources denied by the access control list are dropped
+	if ( ( arg->acl != NULL ) &&
+			( acl_allow(arg->acl, src->sin_addr.s_addr) == false ) )
+	{
+		__verdict(arg, rec, RECORDER_DENIED);
+		flow_drop(flow);
+		stats_drop(arg->stats);
+		return;
+	}
+
+
+	// 5) in multi-hop relay mode, the message is also re-broadcast
+	if ( arg->relay != NULL )
+	{
+		nec_relay_process(	arg->relay,
+							arg->msg_header->msg_iov,
+							arg->msg_header->msg_iovlen, arg->len	);
+	}
+
+	// 6) NEC RX headers are stripped (if requested) without moving the data
+	const char *fwd_data = arg->data;
+	int fwd_len = arg->len;
+	__NEC__msg_t msg;
+
+	if ( arg->nec_rx_header != NULL )
+	{
+		if ( __strip_nec_rx_header(arg, &msg, &fwd_data, &fwd_len) < 0 )
+		{
+			async_log(ASYNC_LOG_WRONG_NEC, 0, 0, 0, NULL, 0);
+			__verdict(arg, rec, RECORDER_MALFORMED);
+			flow_drop(flow);
+			stats_drop(arg->stats);
+			return;
+		}
+	}
+	else if ( ( arg->geo_filter != NULL ) || ( arg->loc_table != NULL ) )
+		{ __NEC__parse_rx(arg->data, arg->len, &msg); }
+
+	// 7) the position of the sender is kept in the location table
+	if ( arg->loc_table != NULL )
+		{ loc_table_update_msg(arg->loc_table, &msg); }
 
+	// 8) geocasts whose area does not include the local position are not
+	//		delivered, applications are not even woken up
+	if ( ( arg->geo_filter != NULL ) &&
+			( geo_filter_match(arg->geo_filter, &msg) == false ) )
+	{
+		__verdict(arg, rec, RECORDER_FILTERED);
+		flow_drop(flow);
+		stats_drop(arg->stats);
+		return;
+	}
 
-	// 3) forward network level UDP message to application level
+	// 9) forward network level UDP message to application level
 	int fwd_bytes = send_message
 						(	(sockaddr_t *)arg->forwarding_addr,
 							arg->forwarding_socket_fd,
-							arg->data, arg->len	);
+							fwd_data, fwd_len	);
 
-	if ( arg->print_forwarding_message == true )
+	if ( fwd_bytes < 0 )
+	{
+		__verdict(arg, rec, RECORDER_ERROR);
+		flow_drop(flow);
+		stats_error(arg->stats);
+		stats_drop(arg->stats);
+	}
+	else
 	{
-		log_app_msg(">>> fwd(net:%d>app:%d), msg[%.2d] = {"
-				, arg->port, arg->forwarding_port, fwd_bytes);
-		print_hex_data(arg->data, arg->len);
-		log_app_msg("}\n");
+		__verdict(arg, rec, RECORDER_FORWARDED);
+		latency_record(arg->latency, arg->rx_ns);
+		stats_tx(arg->stats, fwd_bytes);
 	}
 
+	if ( arg->print_forwarding_message == true )
+		{ async_log(ASYNC_LOG_FWD, arg->port, arg->forwarding_port
+					, fwd_bytes, fwd_data, fwd_len); }
+
 }
 
 /* cb_broadcast_recvfrom */
@@ -127,25 +243,113 @@ void cb_broadcast_recvfrom(public_ev_arg_t *arg)
 	//		(self-broadcast messages are not received)
 	if ( ( arg->len = recv_msg(arg->socket_fd, arg->msg_header
 								, arg->local_addr->sin_addr.s_addr
-								, &blocked) ) < 0 )
+								, &blocked, &arg->rx_ns) ) < 0 )
 	{
 		log_app_msg("cb_broadcast_recvfrom: <recv_msg> " \
 						"Could not receive message.\n");
+		stats_error(arg->stats);
 		return;
 	}
 
+	// (messages sent are accounted by the scheduler, some are sent later)
+	stats_rx(arg->stats, arg->len);
+
 	// 2) broadcast application level UDP message to network level
-	int fwd_bytes = send_message
-						(	(sockaddr_t *)arg->forwarding_addr,
-							arg->forwarding_socket_fd,
-							arg->data, arg->len	);
+	sockaddr_in_t *src = (sockaddr_in_t *)arg->msg_header->msg_name;
+	recorder_slot_t *rec = recorder_add(arg->recorder, RECORDER_APP, src
+					, arg->msg_header->msg_iov, arg->msg_header->msg_iovlen
+					, arg->len, arg->rx_ns);
+	capture_add(arg->capture, CAPTURE_APP, src, arg->local_addr
+					, arg->msg_header->msg_iov, arg->msg_header->msg_iovlen
+					, arg->len, arg->rx_ns);
+	flow_entry_t *flow = ( arg->flows != NULL ) ?
+		flow_table_update(arg->flows, src, arg->forwarding_addr
+							, FLOW_APP_TO_NET, arg->len) : NULL;
 
-	if ( arg->print_forwarding_message == true )
+	if ( arg->talkers != NULL )
+		{ top_talkers_add(arg->talkers, src, arg->len); }
+
+	trace_packet(arg->trace, TRACE_APP, flow, src
+					, arg->msg_header->msg_iov, arg->msg_header->msg_iovlen
+					, arg->len, arg->rx_ns);
+
+	int port = ntohs(src->sin_port);
+	uint32_t lifetime = tx_scheduler_lifetime(arg->tx_scheduler, port);
+	int traffic_class = -1;
+	iovec_t iov[2];
+	int iovlen = 1;
+	__NEC__msg_t m;
+	bool nec_tx = false;
+
+	if ( arg->nec_templates != NULL )
 	{
-		log_app_msg(">>> BROADCAST(app:%d>net:%d), msg[%.2d] = {"
-				, arg->port, arg->forwarding_port, fwd_bytes);
-		print_hex_data(arg->data, arg->len);
-		log_app_msg("}\n");
+
+		// 2.a) raw payloads are wrapped with the header of their flow
+		nec_template_t *tpl = nec_template_lookup(arg->nec_templates, src);
+
+		if ( tpl == NULL )
+		{
+			async_log(ASYNC_LOG_NO_TEMPLATE, 0, 0, 0, NULL, 0);
+			__verdict(arg, rec, RECORDER_DROPPED);
+			flow_drop(flow);
+			stats_drop(arg->stats);
+			return;
+		}
+
+		if ( nec_template_wrap(tpl, arg->data, arg->len, iov) < 0 )
+		{
+			__verdict(arg, rec, RECORDER_MALFORMED);
+			flow_drop(flow);
+			stats_drop(arg->stats);
+			return;
+		}
+
+		iovlen = 2;
+		traffic_class = tpl->header[__NEC__OFF_TRAFFIC_CLASS];
+
 	}
+	else
+	{
+
+		iov[0].iov_base = arg->data;
+		iov[0].iov_len = arg->len;
+
+		// 2.b) NEC messages carry their own lifetime
+		if ( ( arg->nec_mode == true ) &&
+				( __NEC__parse_tx(arg->data, arg->len, &m) == EX_OK ) )
+		{
+			nec_tx = true;
+			traffic_class = __NEC__traffic_class(&m);
+			if ( __NEC__max_lifetime(&m) > 0 )
+				{ lifetime = __NEC__max_lifetime(&m); }
+		}
+
+	}
+
+	int tx_class = tx_scheduler_class(arg->tx_scheduler, port, traffic_class);
+	int fwd_bytes = ( arg->rate_limiter != NULL ) ?
+		rate_limiter_send(arg->rate_limiter, src, tx_class
+							, iov, iovlen, lifetime, arg->rx_ns) :
+		tx_scheduler_send(arg->tx_scheduler, tx_class
+							, iov, iovlen, lifetime, arg->rx_ns);
+
+	if ( fwd_bytes < 0 )
+	{
+		__verdict(arg, rec, RECORDER_DROPPED);
+		flow_drop(flow);
+		stats_drop(arg->stats);
+	}
+	else
+		{ __verdict(arg, rec, RECORDER_FORWARDED); }
+
+	// 3) messages with a repetition_interval are re-sent until their
+	//		max_lifetime expires
+	if ( ( arg->nec_repeat != NULL ) && ( nec_tx == true ) &&
+			( fwd_bytes >= 0 ) )
+		{ nec_repeat_schedule(arg->nec_repeat, src, &m, tx_class); }
+
+	if ( arg->print_forwarding_message == true )
+		{ async_log(ASYNC_LOG_BROADCAST, arg->port, arg->forwarding_port
+					, fwd_bytes, arg->data, arg->len); }
 
 }
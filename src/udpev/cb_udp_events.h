@@ -40,11 +40,11 @@
 void cb_print_recvfrom(public_ev_arg_t *arg);
 
 /**
- * @brief Callback function that writes the given socket which has just been
- * 			put available for writing. Messages are sent in broadcast mode.
+ * @brief Callback function that reads a message of the traffic generator
+ * 			and accounts it in the analyzer.
  * @param public_arg Public arguments for this callback function.
  */
-void cb_broadcast_sendto(public_ev_arg_t *arg);
+void cb_analyze_recvfrom(public_ev_arg_t *arg);
 
 /**
  * @brief Callback function that forwards an UDP message that it receives to
@@ -0,0 +1,202 @@
+/**
+ * @file control.c
+ * @author Ricardo Tubío (rtpardavila[at]gmail.com)
+ * @version 0.1
+ *
+ * @section LICENSE
+ *
+ * This file is part of udpip-broadcaster.
+ * udpip-broadcaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * udpip-broadcaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with udpip-broadcaster.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "control.h"
+
+/* __help; built-in command that lists the rest */
+static int __help(	void *arg, int argc, char **argv,
+					char *out, const int out_len	)
+{
+
+	control_t *c = (control_t *)arg;
+	int len = 0;
+
+	for ( int i = 0; i < c->no_commands; i++ )
+		{ len += control_append(out + len, out_len - len, "%-10s %s\n"
+								, c->commands[i].name, c->commands[i].help); }
+
+	return(len);
+
+}
+
+/* __split; words of a request, in place */
+static int __split(char *request, char **argv)
+{
+
+	int argc = 0;
+	char *save = NULL;
+
+	for ( char *w = strtok_r(request, " \t\r\n", &save);
+			( w != NULL ) && ( argc < CONTROL_ARGS );
+			w = strtok_r(NULL, " \t\r\n", &save) )
+		{ argv[argc++] = w; }
+
+	return(argc);
+
+}
+
+/* new_control */
+control_t *new_control()
+{
+	control_t *s = NULL;
+	if ( ( s = (control_t *)malloc(LEN__CONTROL) ) == NULL )
+		{ handle_sys_error("new_control: <malloc> returns NULL."); }
+	if ( memset(s, 0, LEN__CONTROL) == NULL )
+		{ handle_sys_error("new_control: <memset> returns NULL."); }
+	return(s);
+}
+
+/* init_control */
+control_t *init_control(struct ev_loop *loop, const int port)
+{
+
+	control_t *s = new_control();
+	sockaddr_in_t *addr = init_sockaddr_in(CONTROL_ADDRESS, port);
+
+	s->loop = loop;
+
+	if ( ( s->socket_fd = socket(AF_INET, SOCK_DGRAM, 0) ) < 0 )
+		{ handle_sys_error("init_control: <socket> returns error."); }
+	if ( bind(s->socket_fd, (sockaddr_t *)addr, LEN__SOCKADDR_IN) < 0 )
+		{ handle_sys_error("init_control: <bind> returns error."); }
+	if ( set_nonblocking_socket(s->socket_fd) < 0 )
+		{ handle_app_error("init_control: " \
+							"<set_nonblocking_socket> returns error.\n"); }
+
+	free(addr);
+
+	control_register(s, "help", "lists the commands available", __help, s);
+
+	ev_io_init(&s->watcher, cb_control_recv, s->socket_fd, EV_READ);
+	ev_io_start(loop, &s->watcher);
+
+	return(s);
+
+}
+
+/* control_register */
+int control_register(	control_t *c, const char *name, const char *help,
+						control_handler_t handler, void *arg	)
+{
+
+	if ( c->no_commands >= CONTROL_COMMANDS )
+	{
+		log_app_msg("control_register: no room for <%s>.\n", name);
+		return(EX_ERR);
+	}
+
+	control_command_t *cmd = &c->commands[c->no_commands++];
+
+	cmd->name = name;
+	cmd->help = help;
+	cmd->handler = handler;
+	cmd->arg = arg;
+
+	return(EX_OK);
+
+}
+
+/* control_append */
+int control_append(char *out, const int out_len, const char *format, ...)
+{
+
+	if ( out_len <= 0 ) { return(0); }
+
+	va_list args;
+	va_start(args, format);
+	int len = vsnprintf(out, out_len, format, args);
+	va_end(args);
+
+	if ( len < 0 ) { return(0); }
+	return( ( len < out_len ) ? len : out_len - 1 );
+
+}
+
+/* print_control */
+void print_control(const control_t *c)
+{
+
+	log_app_msg(">>> Control socket (fd = %d) = \n{\n", c->socket_fd);
+	for ( int i = 0; i < c->no_commands; i++ )
+		{ log_app_msg("\t* command = %s\n", c->commands[i].name); }
+	log_app_msg("\t.requests = %lu\n", c->requests);
+	log_app_msg("\t.errors = %lu\n", c->errors);
+	log_app_msg("}\n");
+
+}
+
+/* cb_control_recv */
+void cb_control_recv(struct ev_loop *loop, ev_io *watcher, int revents)
+{
+
+	control_t *c = (control_t *)watcher;
+	sockaddr_in_t src;
+	socklen_t src_len;
+	char *argv[CONTROL_ARGS];
+
+	// 1) every request pending is served within the same callback
+	for ( ;; )
+	{
+
+		src_len = LEN__SOCKADDR_IN;
+		int len = recvfrom(c->socket_fd, c->request, CONTROL_REQUEST_LEN - 1
+							, 0, (sockaddr_t *)&src, &src_len);
+		if ( len < 0 )
+		{
+			if ( would_block() == false )
+				{ log_sys_error("cb_control_recv: <recvfrom> error.\n"); }
+			return;
+		}
+
+		c->request[len] = '\0';
+		c->requests++;
+
+		int argc = __split(c->request, argv);
+		int out = -1;
+
+		if ( argc == 0 ) { continue; }
+
+		// 2) the first word selects the command
+		for ( int i = 0; i < c->no_commands; i++ )
+		{
+			if ( strcmp(argv[0], c->commands[i].name) != 0 ) { continue; }
+			out = c->commands[i].handler(c->commands[i].arg, argc, argv
+											, c->response
+											, CONTROL_RESPONSE_LEN);
+			break;
+		}
+
+		if ( out < 0 )
+		{
+			c->errors++;
+			out = control_append(c->response, CONTROL_RESPONSE_LEN
+									, "error: unknown command <%s>\n"
+									, argv[0]);
+		}
+
+		if ( sendto(c->socket_fd, c->response, out, 0
+						, (sockaddr_t *)&src, src_len) < 0 )
+			{ log_sys_error("cb_control_recv: <sendto> error.\n"); }
+
+	}
+
+}
@@ -0,0 +1,152 @@
+/**
+ * @file control.h
+ * @author Ricardo Tubío (rtpardavila[at]gmail.com)
+ * @version 0.1
+ *
+ * @section LICENSE
+ *
+ * This file is part of udpip-broadcaster.
+ * udpip-broadcaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * udpip-broadcaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with udpip-broadcaster.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Control socket: text commands received as UDP datagrams on the loopback
+ * interface are dispatched to the handlers registered by the modules of the
+ * daemon, and their responses are sent back to the requester, e.g.:
+ *     echo "loc near 42.34 -8.73 500" | nc -u -w1 127.0.0.1 PORT
+ */
+
+#ifndef CONTROL_H_
+#define CONTROL_H_
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <ev.h>
+
+#include "../execution_codes.h"
+#include "../logger.h"
+
+#include "udp_socket.h"
+
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// DATA STRUCTURES
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+#define CONTROL_ADDRESS "127.0.0.1"	/**< Only local requests are served. */
+#define CONTROL_COMMANDS 32			/**< Max. commands registered. */
+#define CONTROL_ARGS 16				/**< Max. words of a request. */
+#define CONTROL_REQUEST_LEN 512		/**< Max. length of a request. */
+#define CONTROL_RESPONSE_LEN 16384	/**< Max. length of a response. */
+
+/**
+ * @brief Handler of a control command.
+ * @param arg Argument given when the command was registered.
+ * @param argc Number of words of the request (command included).
+ * @param argv Words of the request.
+ * @param out Buffer where the response is to be written.
+ * @param out_len Length of the buffer.
+ * @return Number of bytes written to the response.
+ */
+typedef int (*control_handler_t)(	void *arg, int argc, char **argv,
+									char *out, const int out_len	);
+
+/**
+ * @struct control_command
+ * @brief Command registered in the control socket.
+ */
+typedef struct control_command
+{
+
+	const char *name;				/**< First word of the request. */
+	const char *help;				/**< One line description. */
+	control_handler_t handler;		/**< Function that serves it. */
+	void *arg;						/**< Argument for the handler. */
+
+} control_command_t;
+
+/**
+ * @struct control
+ * @brief Control socket and its table of commands.
+ */
+typedef struct control
+{
+
+	ev_io watcher;					/**< Reader (MUST be 1st). */
+	struct ev_loop *loop;			/**< Loop where the reader is run. */
+	int socket_fd;					/**< Socket bound to the loopback. */
+
+	control_command_t commands[CONTROL_COMMANDS];	/**< Commands. */
+	int no_commands;				/**< Number of commands registered. */
+
+	char request[CONTROL_REQUEST_LEN];		/**< Request being served. */
+	char response[CONTROL_RESPONSE_LEN];	/**< Response being built. */
+
+	unsigned long requests;			/**< Requests served. */
+	unsigned long errors;			/**< Unknown commands. */
+
+} control_t;
+
+#define LEN__CONTROL sizeof(control_t)
+
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// CONTROL MANAGEMENT
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+/**
+ * @brief Allocates memory for a control structure.
+ * @return A pointer to the newly allocated block of memory.
+ */
+control_t *new_control();
+
+/**
+ * @brief Opens the control socket and starts serving requests.
+ * @param loop Event loop where the socket is to be read.
+ * @param port Port of the loopback interface to bind to.
+ * @return A pointer to the initialized structure.
+ */
+control_t *init_control(struct ev_loop *loop, const int port);
+
+/**
+ * @brief Registers a command.
+ * @param c The control socket.
+ * @param name First word of the requests for this command.
+ * @param help One line description, listed by the "help" command.
+ * @param handler Function that serves the requests.
+ * @param arg Argument for the handler.
+ * @return EX_OK if registered, EX_ERR if there is no room left.
+ */
+int control_register(	control_t *c, const char *name, const char *help,
+						control_handler_t handler, void *arg	);
+
+/**
+ * @brief Appends formatted text to a response, truncating it if required.
+ * @param out Buffer where the response is being written.
+ * @param out_len Room left in the buffer.
+ * @param format printf-like format of the text.
+ * @return Number of bytes actually appended.
+ */
+int control_append(char *out, const int out_len, const char *format, ...);
+
+/**
+ * @brief Prints the commands and the counters of the control socket.
+ * @param c The control socket.
+ */
+void print_control(const control_t *c);
+
+/**
+ * @brief Callback that serves the requests received.
+ */
+void cb_control_recv(struct ev_loop *loop, ev_io *watcher, int revents);
+
+#endif /* CONTROL_H_ */
@@ -0,0 +1,157 @@
+/**
+ * @file cycles.c
+ * @author Ricardo Tubío (rtpardavila[at]gmail.com)
+ * @version 0.1
+ *
+ * @section LICENSE
+ *
+ * This file is part of udpip-broadcaster.
+ * udpip-broadcaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * udpip-broadcaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with udpip-broadcaster.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cycles.h"
+#include "control.h"
+
+__thread cycles_t *cycles_local = NULL;
+
+static const char *__stage_names[CYCLES_STAGES] =
+	{ "dispatch", "recv", "source", "process", "send", "wakeup" };
+
+/* __calibrate; cycles of the counter per ns of the monotonic clock */
+static double __calibrate()
+{
+
+	struct timespec t0, t1, period;
+	period.tv_sec = 0;
+	period.tv_nsec = CYCLES_CALIBRATION_NS;
+
+	clock_gettime(CLOCK_MONOTONIC_RAW, &t0);
+	uint64_t c0 = cycles_now();
+
+	while ( nanosleep(&period, &period) < 0 ) {}
+
+	uint64_t c1 = cycles_now();
+	clock_gettime(CLOCK_MONOTONIC_RAW, &t1);
+
+	uint64_t ns = latency_ns(&t1) - latency_ns(&t0);
+	if ( ( ns == 0 ) || ( c1 <= c0 ) ) { return(1.0); }
+
+	return( (double)( c1 - c0 ) / ns );
+
+}
+
+/* new_cycles */
+cycles_t *new_cycles()
+{
+	cycles_t *s = NULL;
+	if ( ( s = (cycles_t *)malloc(LEN__CYCLES) ) == NULL )
+		{ handle_sys_error("new_cycles: <malloc> returns NULL."); }
+	if ( memset(s, 0, LEN__CYCLES) == NULL )
+		{ handle_sys_error("new_cycles: <memset> returns NULL."); }
+	return(s);
+}
+
+/* init_cycles */
+cycles_t *init_cycles(struct ev_loop *loop)
+{
+
+	cycles_t *s = new_cycles();
+
+	s->loop = loop;
+	s->per_ns = __calibrate();
+
+	for ( int i = 0; i < CYCLES_STAGES; i++ )
+		{ s->stages[i] = init_latency(loop, __stage_names[i]); }
+
+	// the poll return is marked before any other callback is invoked
+	ev_check_init(&s->check, cb_cycles_check);
+	ev_set_priority(&s->check, EV_MAXPRI);
+	ev_check_start(loop, &s->check);
+
+	cycles_local = s;
+	return(s);
+
+}
+
+/* cycles_reset */
+void cycles_reset(cycles_t *y)
+{
+	for ( int i = 0; i < CYCLES_STAGES; i++ )
+		{ latency_reset(y->stages[i]); }
+}
+
+/* cycles_control */
+int cycles_control(	void *arg, int argc, char **argv,
+					char *out, const int out_len	)
+{
+
+	cycles_t *y = (cycles_t *)arg;
+
+	if ( ( argc == 2 ) && ( strcmp(argv[1], "reset") == 0 ) )
+	{
+		cycles_reset(y);
+		return(control_append(out, out_len, "cycles reset\n"));
+	}
+	if ( argc != 1 )
+		{ return(control_append(out, out_len, "usage: %s [reset]\n"
+									, argv[0])); }
+
+	uint64_t packets = y->stages[CYCLES_RECV]->total;
+	int n = control_append(out, out_len, "packets=%llu cycles/ns=%.3f\n"
+							, (unsigned long long)packets, y->per_ns);
+
+	for ( int i = 0; i < CYCLES_STAGES; i++ )
+	{
+
+		const latency_t *l = y->stages[i];
+		double per_packet = ( packets > 0 ) ? (double)l->sum / packets : 0;
+
+		n += control_append(out + n, out_len - n, "%-8s calls=%llu" \
+				" cycles/pkt=%.0f ns/pkt=%.0f p50=%llu p99=%llu max=%llu" \
+				" (cycles)\n"
+				, l->name, (unsigned long long)l->total
+				, per_packet, per_packet / y->per_ns
+				, (unsigned long long)latency_percentile(l, 0.5)
+				, (unsigned long long)latency_percentile(l, 0.99)
+				, (unsigned long long)l->max);
+
+	}
+
+	return(n);
+
+}
+
+/* print_cycles */
+void print_cycles(const cycles_t *y)
+{
+
+	uint64_t packets = y->stages[CYCLES_RECV]->total;
+
+	log_app_msg(">>> Cycles = \n{\n");
+	log_app_msg("\t.per_ns = %.3f\n", y->per_ns);
+	log_app_msg("\t.packets = %llu\n", (unsigned long long)packets);
+	for ( int i = 0; i < CYCLES_STAGES; i++ )
+		{ log_app_msg("\t.%s = %.0f cycles/pkt\n", y->stages[i]->name
+						, ( packets > 0 ) ?
+							(double)y->stages[i]->sum / packets : 0); }
+	log_app_msg("}\n");
+
+}
+
+/* cb_cycles_check */
+void cb_cycles_check(struct ev_loop *loop, ev_check *watcher, int revents)
+{
+	cycles_t *y = (cycles_t *)watcher;
+	y->mark = cycles_now();
+}
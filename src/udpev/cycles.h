@@ -0,0 +1,234 @@
+/**
+ * @file cycles.h
+ * @author Ricardo Tubío (rtpardavila[at]gmail.com)
+ * @version 0.1
+ *
+ * @section LICENSE
+ *
+ * This file is part of udpip-broadcaster.
+ * udpip-broadcaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * udpip-broadcaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with udpip-broadcaster.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Per-stage CPU cycle accounting of the receive-to-forward pipeline, an opt-in
+ * build mode (CPPFLAGS=-DUDPIP_CYCLES): the time stamp counter is read around
+ * every recvmsg, source address extraction and send, and around every wakeup
+ * of a socket; the rest of the wakeup (filters, accounting, logs) and the libev
+ * dispatch since the poll returned are derived from those marks. Every stage
+ * keeps a per-thread histogram and reports cycles per received packet. Without
+ * UDPIP_CYCLES all the marks compile to nothing.
+ */
+
+#ifndef CYCLES_H_
+#define CYCLES_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <ev.h>
+
+#include "../execution_codes.h"
+#include "../logger.h"
+
+#include "latency.h"
+
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// DATA STRUCTURES
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+#define CYCLES_CALIBRATION_NS 20000000	/**< Calibration period (ns). */
+
+/**
+ * @enum cycles_stage
+ * @brief Stages of the pipeline.
+ */
+typedef enum cycles_stage
+{
+	CYCLES_DISPATCH = 0,	/**< libev, from the poll to the wakeup. */
+	CYCLES_RECV,			/**< <recvmsg> call. */
+	CYCLES_SOURCE,			/**< Source address and RX timestamp. */
+	CYCLES_PROCESS,			/**< Filters, accounting and logs. */
+	CYCLES_SEND,			/**< <sendto>/<sendmsg> calls. */
+	CYCLES_WAKEUP,			/**< Whole wakeup. */
+	CYCLES_STAGES			/**< Number of stages. */
+} cycles_stage_t;
+
+/**
+ * @struct cycles
+ * @brief Cycle histograms of the pipeline of a thread.
+ */
+typedef struct cycles
+{
+
+	ev_check check;					/**< Poll return watcher (MUST be 1st). */
+	struct ev_loop *loop;			/**< Loop of the thread. */
+	double per_ns;					/**< Counter cycles per ns. */
+
+	uint64_t mark;					/**< Poll return or last wakeup end. */
+	uint64_t inner;					/**< Measured cycles of this wakeup. */
+	bool in_wakeup;					/**< Inside of a socket wakeup. */
+
+	latency_t *stages[CYCLES_STAGES];	/**< Cycles per stage. */
+
+} cycles_t;
+
+#define LEN__CYCLES sizeof(cycles_t)
+
+/**< Histograms of the calling thread, NULL if not accounted. */
+extern __thread cycles_t *cycles_local;
+
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// STAGE MARKS
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+#ifdef UDPIP_CYCLES
+
+#define CYCLES_BEGIN(t)				const uint64_t t = cycles_now()
+#define CYCLES_END(stage, t)		cycles_add(stage, cycles_now() - (t))
+#define CYCLES_WAKEUP_BEGIN(t)		const uint64_t t = cycles_wakeup_begin()
+#define CYCLES_WAKEUP_END(t)		cycles_wakeup_end(t)
+
+#else
+
+#define CYCLES_BEGIN(t)
+#define CYCLES_END(stage, t)
+#define CYCLES_WAKEUP_BEGIN(t)
+#define CYCLES_WAKEUP_END(t)
+
+#endif
+
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// ACCOUNTING MANAGEMENT
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+/**
+ * @brief Allocates memory for a cycles structure.
+ * @return A pointer to the newly allocated block of memory.
+ */
+cycles_t *new_cycles();
+
+/**
+ * @brief Calibrates the cycle counter and starts accounting the stages of
+ * 			the calling thread.
+ * @param loop Event loop of the thread.
+ * @return A pointer to the initialized structure.
+ */
+cycles_t *init_cycles(struct ev_loop *loop);
+
+/**
+ * @brief Empties the histograms.
+ * @param y The histograms.
+ */
+void cycles_reset(cycles_t *y);
+
+/**
+ * @brief Handler of the "cycles" control command.
+ * 			cycles: cycles per packet per stage; cycles reset: empties them.
+ * @return Number of bytes written to the response.
+ */
+int cycles_control(	void *arg, int argc, char **argv,
+					char *out, const int out_len	);
+
+/**
+ * @brief Prints the calibration and the cycles per packet.
+ * @param y The histograms.
+ */
+void print_cycles(const cycles_t *y);
+
+/**
+ * @brief Callback that marks the return of the poll.
+ */
+void cb_cycles_check(struct ev_loop *loop, ev_check *watcher, int revents);
+
+/**
+ * @brief Reads the cycle counter (TSC on x86, virtual counter on ARMv8,
+ * 			monotonic ns elsewhere).
+ */
+static inline uint64_t cycles_now()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return(__builtin_ia32_rdtsc());
+#elif defined(__aarch64__)
+	uint64_t v;
+	__asm__ __volatile__ ("mrs %0, cntvct_el0" : "=r" (v));
+	return(v);
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return(latency_ns(&ts));
+#endif
+}
+
+/**
+ * @brief Accounts the cycles of a stage to the calling thread.
+ * @param stage The stage.
+ * @param c Cycles spent.
+ */
+static inline void cycles_add(const int stage, const uint64_t c)
+{
+
+	cycles_t *y = cycles_local;
+	if ( y == NULL ) { return; }
+
+	latency_add(y->stages[stage], 0, c);
+	if ( y->in_wakeup == true ) { y->inner += c; }
+
+}
+
+/**
+ * @brief Marks the start of a socket wakeup; the libev dispatch is the time
+ * 			since the poll returned or since the previous wakeup ended.
+ * @return Cycle counter at the start.
+ */
+static inline uint64_t cycles_wakeup_begin()
+{
+
+	uint64_t now = cycles_now();
+	cycles_t *y = cycles_local;
+	if ( y == NULL ) { return(now); }
+
+	if ( ( y->mark > 0 ) && ( now >= y->mark ) )
+		{ cycles_add(CYCLES_DISPATCH, now - y->mark); }
+
+	y->in_wakeup = true;
+	y->inner = 0;
+
+	return(now);
+
+}
+
+/**
+ * @brief Marks the end of a socket wakeup; what was not measured inside of
+ * 			it is accounted as processing.
+ * @param start Cycle counter at the start.
+ */
+static inline void cycles_wakeup_end(const uint64_t start)
+{
+
+	uint64_t now = cycles_now();
+	cycles_t *y = cycles_local;
+	if ( y == NULL ) { return; }
+
+	uint64_t c = now - start;
+	y->in_wakeup = false;
+
+	cycles_add(CYCLES_WAKEUP, c);
+	cycles_add(CYCLES_PROCESS, ( c > y->inner ) ? c - y->inner : 0);
+	y->mark = now;
+
+}
+
+#endif /* CYCLES_H_ */
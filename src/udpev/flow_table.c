@@ -0,0 +1,398 @@
+/**
+ * @file flow_table.c
+ * @author Ricardo Tubío (rtpardavila[at]gmail.com)
+ * @version 0.1
+ *
+ * @section LICENSE
+ *
+ * This file is part of udpip-broadcaster.
+ * udpip-broadcaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * udpip-broadcaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with udpip-broadcaster.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "flow_table.h"
+#include "hash.h"
+#include "control.h"
+
+#define __MASK ( FLOW_TABLE_SLOTS - 1 )
+#define __LISTED 10						/**< Flows listed by default. */
+
+/* __key; addresses and ports are kept in network byte order */
+static inline flow_key_t __key(	const sockaddr_in_t *src,
+								const sockaddr_in_t *dst,
+								const flow_direction_t direction	)
+{
+
+	flow_key_t k;
+
+	k.addrs = ( (uint64_t)src->sin_addr.s_addr << 32 ) | dst->sin_addr.s_addr;
+	k.ports = ( (uint64_t)src->sin_port << 32 )
+				| ( (uint64_t)dst->sin_port << 16 ) | direction;
+
+	return(k);
+
+}
+
+/* __home; both words of the key */
+static inline int __home(const flow_key_t *k)
+	{ return((int)hash_u64(k->addrs ^ hash_u64(k->ports)) & __MASK); }
+
+/* __size_bucket; log2 buckets of the message size */
+static inline int __size_bucket(const int len)
+{
+
+	int b = 0;
+
+	for ( int bound = 1 << FLOW_SIZE_MIN_LOG2;
+			( len >= bound ) && ( b < FLOW_SIZE_BUCKETS - 1 ); bound <<= 1 )
+		{ b++; }
+
+	return(b);
+
+}
+
+/* __remove; backward shift deletion, no tombstones are left behind */
+static void __remove(flow_table_t *t, int i)
+{
+
+	for ( int j = ( i + 1 ) & __MASK; t->slots[j].key.ports != 0;
+			j = ( j + 1 ) & __MASK )
+	{
+
+		int home = __home(&t->slots[j].key);
+		if ( ( ( j - home ) & __MASK ) < ( ( j - i ) & __MASK ) )
+			{ continue; }
+
+		t->slots[i] = t->slots[j];
+		i = j;
+
+	}
+
+	memset(&t->slots[i], 0, LEN__FLOW_ENTRY);
+	t->count--;
+
+}
+
+/* __compare_flows; more bytes first */
+static int __compare_flows(const void *a, const void *b)
+{
+
+	const flow_entry_t *fa = (const flow_entry_t *)a;
+	const flow_entry_t *fb = (const flow_entry_t *)b;
+
+	if ( fa->bytes == fb->bytes ) { return(0); }
+	return( ( fa->bytes < fb->bytes ) ? 1 : -1 );
+
+}
+
+/* __print_flow */
+static int __print_flow(	const ev_tstamp now, const flow_entry_t *f,
+							const char *format, char *out, const int out_len	)
+{
+
+	struct in_addr src = { .s_addr = (in_addr_t)( f->key.addrs >> 32 ) };
+	struct in_addr dst = { .s_addr = (in_addr_t)f->key.addrs };
+	char src_addr[INET_ADDRSTRLEN], dst_addr[INET_ADDRSTRLEN];
+	char hist[FLOW_SIZE_BUCKETS * 11];
+	int len = 0;
+
+	inet_ntop(AF_INET, &src, src_addr, INET_ADDRSTRLEN);
+	inet_ntop(AF_INET, &dst, dst_addr, INET_ADDRSTRLEN);
+
+	for ( int b = 0; b < FLOW_SIZE_BUCKETS; b++ )
+		{ len += snprintf(hist + len, sizeof(hist) - len, "%s%u"
+							, ( b > 0 ) ? "/" : "", f->size_hist[b]); }
+
+	return(snprintf(out, out_len, format
+				, ( ( f->key.ports & 0xFF ) == FLOW_NET_TO_APP ) ? "net>app"
+																: "app>net"
+				, src_addr, ntohs((in_port_t)( f->key.ports >> 32 ))
+				, dst_addr, ntohs((in_port_t)( f->key.ports >> 16 ))
+				, (unsigned long long)f->packets, (unsigned long long)f->bytes
+				, f->drops, now - f->first_seen, now - f->last_seen, hist));
+
+}
+
+/**
+ * @struct __dump_job
+ * @brief Snapshot of the table, written by a background thread.
+ */
+typedef struct __dump_job
+{
+	flow_entry_t *flows;			/**< Copy of the flows in use. */
+	int no_flows;					/**< Flows copied. */
+	ev_tstamp now;					/**< Time of the snapshot. */
+	char path[FLOW_TABLE_PATH_LEN];	/**< File to be written. */
+} __dump_job_t;
+
+/* __write; CSV dump of a snapshot, one flow per line */
+static int __write(const __dump_job_t *job)
+{
+
+	FILE *f = NULL;
+	char line[256];
+
+	if ( ( f = fopen(job->path, "w") ) == NULL )
+	{
+		log_sys_error("flow_table: <fopen> cannot create %s.\n", job->path);
+		return(EX_ERR);
+	}
+
+	fprintf(f, "direction,src,src_port,dst,dst_port,packets,bytes,drops" \
+				",age,idle,size_hist\n");
+
+	for ( int i = 0; i < job->no_flows; i++ )
+	{
+		__print_flow(job->now, &job->flows[i], "%s,%s,%d,%s,%d,%llu,%llu,%u" \
+						",%.3f,%.3f,%s\n", line, sizeof(line));
+		fputs(line, f);
+	}
+
+	if ( fclose(f) != 0 )
+	{
+		log_sys_error("flow_table: <fclose> cannot write %s.\n", job->path);
+		return(EX_ERR);
+	}
+
+	return(job->no_flows);
+
+}
+
+/* __dumper; background thread of a dump */
+static void *__dumper(void *arg)
+{
+
+	__dump_job_t *job = (__dump_job_t *)arg;
+
+	int n = __write(job);
+	if ( n >= 0 )
+		{ log_app_msg(">>> Flow table: %d flows dumped to %s.\n"
+						, n, job->path); }
+
+	free(job->flows);
+	free(job);
+	return(NULL);
+
+}
+
+/* new_flow_table */
+flow_table_t *new_flow_table()
+{
+	flow_table_t *s = NULL;
+	if ( ( s = (flow_table_t *)malloc(LEN__FLOW_TABLE) ) == NULL )
+		{ handle_sys_error("new_flow_table: <malloc> returns NULL."); }
+	if ( memset(s, 0, LEN__FLOW_TABLE) == NULL )
+		{ handle_sys_error("new_flow_table: <memset> returns NULL."); }
+	return(s);
+}
+
+/* init_flow_table */
+flow_table_t *init_flow_table(struct ev_loop *loop, const char *path)
+{
+
+	flow_table_t *s = new_flow_table();
+
+	s->loop = loop;
+	snprintf(s->path, FLOW_TABLE_PATH_LEN, "%s"
+				, ( path != NULL ) ? path : FLOW_TABLE_DEFAULT_PATH);
+
+	if ( ( s->slots = (flow_entry_t *)calloc(FLOW_TABLE_SLOTS
+											, LEN__FLOW_ENTRY) ) == NULL )
+		{ handle_sys_error("init_flow_table: <calloc> returns NULL."); }
+
+	ev_timer_init(&s->sweep, cb_flow_table_sweep
+					, FLOW_TABLE_SWEEP, FLOW_TABLE_SWEEP);
+	ev_timer_start(loop, &s->sweep);
+
+	return(s);
+
+}
+
+/* flow_table_update */
+flow_entry_t *flow_table_update(	flow_table_t *t,
+									const sockaddr_in_t *src,
+									const sockaddr_in_t *dst,
+									const flow_direction_t direction,
+									const int len	)
+{
+
+	flow_key_t k = __key(src, dst, direction);
+	int i = __home(&k);
+	flow_entry_t *f = NULL;
+
+	// 1) the flow is looked for, stopping at the first free slot
+	for ( ; ; i = ( i + 1 ) & __MASK )
+	{
+
+		f = &t->slots[i];
+
+		if ( ( f->key.addrs == k.addrs ) && ( f->key.ports == k.ports ) )
+			{ break; }
+		if ( f->key.ports != 0 ) { continue; }
+
+		// 2) new flows take that free slot while below the max. load
+		if ( t->count >= FLOW_TABLE_MAX )
+			{ t->overflows++; return(NULL); }
+
+		f->key = k;
+		f->first_seen = ev_now(t->loop);
+		t->count++;
+		break;
+
+	}
+
+	f->packets++;
+	f->bytes += len;
+	f->last_seen = ev_now(t->loop);
+	f->size_hist[__size_bucket(len)]++;
+
+	return(f);
+
+}
+
+/* flow_table_snapshot */
+int flow_table_snapshot(const flow_table_t *t, flow_entry_t *out, const int max)
+{
+
+	int n = 0;
+
+	for ( int i = 0; ( i < FLOW_TABLE_SLOTS ) && ( n < max ); i++ )
+		{ if ( t->slots[i].key.ports != 0 ) { out[n++] = t->slots[i]; } }
+
+	qsort(out, n, LEN__FLOW_ENTRY, __compare_flows);
+
+	return(n);
+
+}
+
+/* flow_table_dump */
+int flow_table_dump(flow_table_t *t)
+{
+
+	__dump_job_t *job = NULL;
+	pthread_t dumper;
+	pthread_attr_t attr;
+
+	if ( ( job = (__dump_job_t *)malloc(sizeof(__dump_job_t)) ) == NULL )
+	{
+		log_sys_error("flow_table_dump: <malloc> returns NULL.\n");
+		return(EX_ERR);
+	}
+
+	if ( ( job->flows = (flow_entry_t *)malloc(t->count * LEN__FLOW_ENTRY
+												+ 1) ) == NULL )
+	{
+		log_sys_error("flow_table_dump: <malloc> returns NULL.\n");
+		free(job);
+		return(EX_ERR);
+	}
+
+	// 1) the snapshot is taken in the loop, so it is consistent
+	job->no_flows = flow_table_snapshot(t, job->flows, t->count);
+	job->now = ev_now(t->loop);
+	snprintf(job->path, FLOW_TABLE_PATH_LEN, "%s", t->path);
+
+	// 2) formatting and writing happen in the background
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+	if ( pthread_create(&dumper, &attr, __dumper, job) != 0 )
+	{
+		log_app_msg("flow_table_dump: <pthread_create> returns error.\n");
+		pthread_attr_destroy(&attr);
+		free(job->flows);
+		free(job);
+		return(EX_ERR);
+	}
+
+	pthread_attr_destroy(&attr);
+	return(EX_OK);
+
+}
+
+/* flow_table_control */
+int flow_table_control(	void *arg, int argc, char **argv,
+						char *out, const int out_len	)
+{
+
+	flow_table_t *t = (flow_table_t *)arg;
+	int max = __LISTED, len = 0;
+
+	if ( ( argc == 2 ) && ( strcmp(argv[1], "dump") == 0 ) )
+	{
+		if ( flow_table_dump(t) < 0 )
+			{ return(control_append(out, out_len, "dump failed\n")); }
+		return(control_append(out, out_len, "dumping to %s\n", t->path));
+	}
+
+	if ( ( argc > 2 ) ||
+			( ( argc == 2 ) && ( ( sscanf(argv[1], "%d", &max) != 1 )
+									|| ( max <= 0 ) ) ) )
+		{ return(control_append(out, out_len
+									, "usage: flows [N | dump]\n")); }
+
+	flow_entry_t *flows = (flow_entry_t *)malloc(t->count * LEN__FLOW_ENTRY
+													+ 1);
+	if ( flows == NULL )
+		{ return(control_append(out, out_len, "error: no memory\n")); }
+
+	int n = flow_table_snapshot(t, flows, t->count);
+
+	len = control_append(out, out_len, "flows=%d evicted=%lu overflows=%lu\n"
+							, t->count, t->evicted, t->overflows);
+
+	for ( int i = 0; ( i < n ) && ( i < max ); i++ )
+	{
+		int w = __print_flow(ev_now(t->loop), &flows[i], "%s %s:%d > %s:%d packets=%llu" \
+							" bytes=%llu drops=%u age=%.1f idle=%.1f" \
+							" sizes=%s\n", out + len, out_len - len);
+		if ( w >= out_len - len ) { break; }
+		len += w;
+	}
+
+	free(flows);
+	return(len);
+
+}
+
+/* print_flow_table */
+void print_flow_table(const flow_table_t *t)
+{
+	log_app_msg(">>> Flow table = \n{\n");
+	log_app_msg("\t.flows = %d\n", t->count);
+	log_app_msg("\t.evicted = %lu\n", t->evicted);
+	log_app_msg("\t.overflows = %lu\n", t->overflows);
+	log_app_msg("\t.path = %s\n", t->path);
+	log_app_msg("}\n");
+}
+
+/* cb_flow_table_sweep */
+void cb_flow_table_sweep(struct ev_loop *loop, ev_timer *watcher, int revents)
+{
+
+	flow_table_t *t = (flow_table_t *)watcher;
+	ev_tstamp now = ev_now(loop);
+
+	// backward shifts may move a flow into the slot just visited, so that
+	//		slot is visited again
+	for ( int i = 0; i < FLOW_TABLE_SLOTS; i++ )
+	{
+		flow_entry_t *f = &t->slots[i];
+		if ( ( f->key.ports == 0 ) || ( now - f->last_seen <= FLOW_TABLE_IDLE ) )
+			{ continue; }
+		__remove(t, i);
+		t->evicted++;
+		i--;
+	}
+
+}
@@ -0,0 +1,205 @@
+/**
+ * @file flow_table.h
+ * @author Ricardo Tubío (rtpardavila[at]gmail.com)
+ * @version 0.1
+ *
+ * @section LICENSE
+ *
+ * This file is part of udpip-broadcaster.
+ * udpip-broadcaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * udpip-broadcaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with udpip-broadcaster.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Per-flow statistics: packets, bytes, drops, first/last seen times and a
+ * size histogram for every flow (source addr:port -> destination addr:port
+ * plus direction). Entries are kept inline in an open-addressing table
+ * (linear probing, backward shift deletion), so an update touches a single
+ * entry and follows no pointers. Flows idle for longer than FLOW_TABLE_IDLE
+ * are evicted by a periodic sweep.
+ */
+
+#ifndef FLOW_TABLE_H_
+#define FLOW_TABLE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <ev.h>
+
+#include "../execution_codes.h"
+#include "../logger.h"
+
+#include "udp_socket.h"
+
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// DATA STRUCTURES
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+#define FLOW_TABLE_SLOTS 4096		/**< Slots of the table (power of 2). */
+#define FLOW_TABLE_MAX 3072			/**< Max. flows (75% load). */
+#define FLOW_TABLE_IDLE 60.0		/**< Idle time before eviction (secs). */
+#define FLOW_TABLE_SWEEP 5.0		/**< Period of the idle sweep (secs). */
+#define FLOW_SIZE_BUCKETS 8			/**< <64, <128, ... <4096, >=4096. */
+#define FLOW_SIZE_MIN_LOG2 6		/**< log2 of the first bucket bound. */
+#define FLOW_TABLE_DEFAULT_PATH "/tmp/udpipbroadcaster.flows.csv"	/**< Dump. */
+#define FLOW_TABLE_PATH_LEN 256		/**< Max. length of the dump path. */
+
+/**
+ * @enum flow_direction
+ * @brief Direction of the forwarded traffic.
+ */
+typedef enum flow_direction
+{
+
+	FLOW_NET_TO_APP = 1,			/**< Network to application level. */
+	FLOW_APP_TO_NET = 2				/**< Application to network level. */
+
+} flow_direction_t;
+
+/**
+ * @struct flow_key
+ * @brief Flow identifier, packed into two words for fast comparisons.
+ */
+typedef struct flow_key
+{
+
+	uint64_t addrs;					/**< Source and destination addresses. */
+	uint64_t ports;					/**< Ports and direction (0: free). */
+
+} flow_key_t;
+
+/**
+ * @struct flow_entry
+ * @brief Counters of a single flow.
+ */
+typedef struct flow_entry
+{
+
+	flow_key_t key;					/**< Flow (ports == 0 if free). */
+	uint64_t packets;				/**< Messages received. */
+	uint64_t bytes;					/**< Bytes received. */
+	ev_tstamp last_seen;			/**< Last message received. */
+	uint32_t drops;					/**< Messages not forwarded. */
+	uint32_t size_hist[FLOW_SIZE_BUCKETS];	/**< Messages per size. */
+	ev_tstamp first_seen;			/**< First message received. */
+
+} flow_entry_t;
+
+#define LEN__FLOW_ENTRY sizeof(flow_entry_t)
+
+/**
+ * @struct flow_table
+ * @brief Table of flows.
+ */
+typedef struct flow_table
+{
+
+	ev_timer sweep;					/**< Idle sweep timer (MUST be 1st). */
+	struct ev_loop *loop;			/**< Loop where the timer is run. */
+
+	flow_entry_t *slots;			/**< Flows, inline. */
+	int count;						/**< Flows in use. */
+
+	unsigned long evicted;			/**< Flows evicted for being idle. */
+	unsigned long overflows;		/**< Messages of flows not tracked. */
+
+	char path[FLOW_TABLE_PATH_LEN];	/**< Dump file. */
+
+} flow_table_t;
+
+#define LEN__FLOW_TABLE sizeof(flow_table_t)
+
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// TABLE MANAGEMENT
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+/**
+ * @brief Allocates memory for a flow_table structure.
+ * @return A pointer to the newly allocated block of memory.
+ */
+flow_table_t *new_flow_table();
+
+/**
+ * @brief Initializes an empty table and starts its idle sweep.
+ * @param loop Event loop where the sweep timer is to be run.
+ * @param path File where the table is dumped (NULL: default).
+ * @return A pointer to the initialized structure.
+ */
+flow_table_t *init_flow_table(struct ev_loop *loop, const char *path);
+
+/**
+ * @brief Accounts a message to its flow, which is created if new.
+ * @param t The table.
+ * @param src Source of the message.
+ * @param dst Destination where the message is forwarded.
+ * @param direction Direction of the message.
+ * @param len Length of the message.
+ * @return The entry of the flow, NULL if the table is full.
+ */
+flow_entry_t *flow_table_update(	flow_table_t *t,
+									const sockaddr_in_t *src,
+									const sockaddr_in_t *dst,
+									const flow_direction_t direction,
+									const int len	);
+
+/**
+ * @brief Accounts a message of the flow that was not forwarded.
+ * @param f The entry of the flow (NULL is allowed).
+ */
+static inline void flow_drop(flow_entry_t *f)
+	{ if ( f != NULL ) { f->drops++; } }
+
+/**
+ * @brief Copies the flows in use, sorted by bytes.
+ * @param t The table.
+ * @param out Array where the flows are to be copied.
+ * @param max Length of the array.
+ * @return Number of flows copied.
+ */
+int flow_table_snapshot(const flow_table_t *t, flow_entry_t *out, const int max);
+
+/**
+ * @brief Dumps a snapshot of the table as CSV to its file, one flow per
+ * 			line. The snapshot is taken at once, it is written by a
+ * 			background thread.
+ * @param t The table.
+ * @return EX_OK if the dump was started, EX_ERR otherwise.
+ */
+int flow_table_dump(flow_table_t *t);
+
+/**
+ * @brief Handler of the "flows" control command.
+ * 			flows [N]: top N flows by bytes.
+ * 			flows dump: snapshot of the table as CSV, to its file.
+ * @return Number of bytes written to the response.
+ */
+int flow_table_control(	void *arg, int argc, char **argv,
+						char *out, const int out_len	);
+
+/**
+ * @brief Prints the counters of the given table.
+ * @param t The table.
+ */
+void print_flow_table(const flow_table_t *t);
+
+/**
+ * @brief Callback that evicts the flows idle for too long.
+ */
+void cb_flow_table_sweep(struct ev_loop *loop, ev_timer *watcher, int revents);
+
+#endif /* FLOW_TABLE_H_ */
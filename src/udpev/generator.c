@@ -0,0 +1,311 @@
+/**
+ * @file generator.c
+ * @author Ricardo Tubío (rtpardavila[at]gmail.com)
+ * @version 0.1
+ *
+ * @section LICENSE
+ *
+ * This file is part of udpip-broadcaster.
+ * udpip-broadcaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * udpip-broadcaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with udpip-broadcaster.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE						/**< sendmmsg */
+
+#include <endian.h>
+
+#include "generator.h"
+
+#define __TICK_BATCHES 64				/**< Max. batches per tick. */
+
+static struct mmsghdr __msgs[GENERATOR_BATCH];	/**< Set up once. */
+static struct iovec __iov[GENERATOR_BATCH];		/**< Set up once. */
+
+static const int __imix[12] =
+	{ 64, 64, 64, 64, 64, 64, 64, 576, 576, 576, 576, 1472 };
+
+/* __random; xorshift64, for the sizes */
+static inline uint64_t __random(generator_t *g)
+{
+	g->random ^= g->random << 13;
+	g->random ^= g->random >> 7;
+	g->random ^= g->random << 17;
+	return(g->random);
+}
+
+/* __size; of the next message */
+static inline int __size(generator_t *g)
+{
+	switch ( g->sizes )
+	{
+		case GENERATOR_UNIFORM:
+			return( g->min_size + __random(g)
+						% ( g->max_size - g->min_size + 1 ) );
+		case GENERATOR_IMIX:
+			return(__imix[__random(g) % 12]);
+	}
+	return(g->min_size);
+}
+
+/* __now_ns; TX timestamp (ns, CLOCK_REALTIME) */
+static inline uint64_t __now_ns()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_REALTIME, &t);
+	return( (uint64_t)t.tv_sec * 1000000000ULL + t.tv_nsec );
+}
+
+/* __send; n messages, a batch per flow in turn */
+static void __send(generator_t *g, int n)
+{
+
+	while ( n > 0 )
+	{
+
+		// 1) batches are cut to GENERATOR_BATCH_NS, so that the timestamps
+		//		of their last messages are still close to the real sends
+		int k = ( n < GENERATOR_BATCH ) ? n : GENERATOR_BATCH;
+		int max = GENERATOR_BATCH_NS / ( g->send_ns + 1 );
+		if ( k > max ) { k = ( max > 0 ) ? max : 1; }
+
+		int flow = g->next_flow;
+		if ( ++g->next_flow == g->no_flows ) { g->next_flow = 0; }
+
+		// 2) only the headers and lengths change, the rest is reused
+		for ( int i = 0; i < k; i++ )
+		{
+			generator_header_t *h = (generator_header_t *)__iov[i].iov_base;
+			h->flow = htonl(flow);
+			h->seq = htobe64(g->seqs[flow]++);
+			__iov[i].iov_len = __size(g);
+		}
+
+		// 3) every message is stamped with the time when its turn comes,
+		//		as predicted by the cost of the previous messages
+		uint64_t tx_ns = __now_ns();
+		for ( int i = 0; i < k; i++ )
+			{ ((generator_header_t *)__iov[i].iov_base)->tx_ns
+					= htobe64(tx_ns + (uint64_t)i * g->send_ns); }
+
+		// 4) messages that are not sent are lost, their numbers are not reused
+		int sent = sendmmsg(g->sockets[flow], __msgs, k, 0);
+		g->batches++;
+
+		uint64_t now = __now_ns();
+		if ( ( sent > 0 ) && ( now > tx_ns ) )
+			{ g->send_ns = ( 7 * g->send_ns + ( now - tx_ns ) / sent ) / 8; }
+
+		if ( sent < 0 )
+		{
+			if ( g->errors == 0 )
+				{ log_sys_error("generator: <sendmmsg> returns error.\n"); }
+			sent = 0;
+		}
+
+		for ( int i = 0; i < sent; i++ ) { g->bytes += __iov[i].iov_len; }
+		g->sent += sent;
+		g->errors += k - sent;
+		n -= k;
+
+	}
+
+}
+
+/* __expired; stops the generator once its duration is over */
+static bool __expired(generator_t *g, const double now)
+{
+
+	if ( ( g->duration == 0 ) || ( now - g->start < g->duration ) )
+		{ return(false); }
+
+	ev_timer_stop(g->loop, &g->pace);
+	ev_idle_stop(g->loop, &g->burst);
+	ev_break(g->loop, EVBREAK_ALL);
+
+	return(true);
+
+}
+
+/* new_generator */
+generator_t *new_generator()
+{
+	generator_t *s = NULL;
+	if ( ( s = (generator_t *)malloc(LEN__GENERATOR) ) == NULL )
+		{ handle_sys_error("new_generator: <malloc> returns NULL."); }
+	if ( memset(s, 0, LEN__GENERATOR) == NULL )
+		{ handle_sys_error("new_generator: <memset> returns NULL."); }
+	return(s);
+}
+
+/* generator_parse_sizes */
+int generator_parse_sizes(	const char *spec, int *sizes,
+							int *min_size, int *max_size	)
+{
+
+	char end = '\0';
+
+	if ( strcmp(spec, "imix") == 0 )
+	{
+		*sizes = GENERATOR_IMIX;
+		*min_size = __imix[0];
+		*max_size = __imix[11];
+		return(EX_OK);
+	}
+
+	if ( sscanf(spec, "%d-%d%c", min_size, max_size, &end) == 2 )
+		{ *sizes = GENERATOR_UNIFORM; }
+	else if ( sscanf(spec, "%d%c", min_size, &end) == 1 )
+		{ *sizes = GENERATOR_FIXED; *max_size = *min_size; }
+	else
+		{ return(EX_WRONG_PARAM); }
+
+	if ( ( *min_size < (int)LEN__GENERATOR_HEADER ) ||
+			( *max_size > GENERATOR_MAX_SIZE ) || ( *min_size > *max_size ) )
+		{ return(EX_WRONG_PARAM); }
+
+	return(EX_OK);
+
+}
+
+/* init_generator */
+generator_t *init_generator(	struct ev_loop *loop, const char *if_name,
+								sockaddr_in_t *dest_addr, const int no_flows,
+								const int rate, const int sizes,
+								const int min_size, const int max_size,
+								const int duration	)
+{
+
+	generator_t *s = new_generator();
+
+	s->loop = loop;
+	s->dest_addr = dest_addr;
+	s->no_flows = no_flows;
+	s->rate = rate;
+	s->sizes = sizes;
+	s->min_size = min_size;
+	s->max_size = max_size;
+	s->duration = duration;
+	s->random = 0x9E3779B97F4A7C15ULL;
+	s->send_ns = GENERATOR_SEND_NS;
+
+	// 1) one socket per flow, flows are told apart by their source port
+	if ( ( s->sockets = (int *)malloc(no_flows * sizeof(int)) ) == NULL )
+		{ handle_sys_error("init_generator: <malloc> returns NULL."); }
+	if ( ( s->seqs = (uint64_t *)calloc(no_flows, sizeof(uint64_t)) ) == NULL )
+		{ handle_sys_error("init_generator: <calloc> returns NULL."); }
+
+	for ( int i = 0; i < no_flows; i++ )
+	{
+		s->sockets[i] = ( if_name != NULL ) ?
+			open_broadcast_udp_socket(if_name, ntohs(dest_addr->sin_port)) :
+			open_transmitter_udp_socket(ntohs(dest_addr->sin_port));
+	}
+
+	// 2) buffers and messages for a whole batch, set up once
+	size_t len = (size_t)GENERATOR_BATCH * max_size;
+	if ( ( s->buffers = (uint8_t *)malloc(len) ) == NULL )
+		{ handle_sys_error("init_generator: <malloc> returns NULL."); }
+	for ( size_t i = 0; i < len; i++ ) { s->buffers[i] = (uint8_t)i; }
+
+	memset(__msgs, 0, sizeof(__msgs));
+	for ( int i = 0; i < GENERATOR_BATCH; i++ )
+	{
+		__iov[i].iov_base = s->buffers + (size_t)i * max_size;
+		((generator_header_t *)__iov[i].iov_base)->magic
+			= htonl(GENERATOR_MAGIC);
+		__msgs[i].msg_hdr.msg_name = dest_addr;
+		__msgs[i].msg_hdr.msg_namelen = LEN__SOCKADDR_IN;
+		__msgs[i].msg_hdr.msg_iov = &__iov[i];
+		__msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	// 3) paced or as fast as possible
+	s->start = ev_time();
+
+	if ( rate == GENERATOR_RATE_MAX )
+	{
+		ev_idle_init(&s->burst, cb_generator_burst);
+		s->burst.data = s;
+		ev_idle_start(loop, &s->burst);
+	}
+	else
+	{
+		ev_timer_init(&s->pace, cb_generator_pace, 0.0, GENERATOR_TICK);
+		ev_timer_start(loop, &s->pace);
+	}
+
+	return(s);
+
+}
+
+/* print_generator */
+void print_generator(const generator_t *g)
+{
+
+	double elapsed = ev_time() - g->start;
+	static const char *sizes[] = { "fixed", "uniform", "imix" };
+
+	log_app_msg(">>> Generator = \n{\n");
+	log_app_msg("\t.dest = %s:%d\n", inet_ntoa(g->dest_addr->sin_addr)
+					, ntohs(g->dest_addr->sin_port));
+	log_app_msg("\t.flows = %d\n", g->no_flows);
+	log_app_msg("\t.rate = %d msgs/s%s\n", g->rate
+					, ( g->rate == GENERATOR_RATE_MAX ) ? " (max)" : "");
+	log_app_msg("\t.sizes = %s [%d, %d]\n", sizes[g->sizes]
+					, g->min_size, g->max_size);
+	log_app_msg("\t.duration = %d secs\n", g->duration);
+	log_app_msg("\t.sent = %llu (%llu bytes, errors = %llu)\n"
+					, (unsigned long long)g->sent
+					, (unsigned long long)g->bytes
+					, (unsigned long long)g->errors);
+	log_app_msg("\t.batches = %llu (%llu ns per message)\n"
+					, (unsigned long long)g->batches
+					, (unsigned long long)g->send_ns);
+	log_app_msg("\t.achieved = %.0f msgs/s\n"
+					, ( elapsed > 0 ) ? g->sent / elapsed : 0.0);
+	log_app_msg("}\n");
+
+}
+
+/* cb_generator_pace */
+void cb_generator_pace(struct ev_loop *loop, ev_timer *watcher, int revents)
+{
+
+	generator_t *g = (generator_t *)watcher;
+	double now = ev_time();
+
+	if ( __expired(g, now) == true ) { return; }
+
+	// messages due since the start, a stall is not made up all at once
+	uint64_t due = (uint64_t)( ( now - g->start ) * g->rate );
+	uint64_t done = g->sent + g->errors;
+	if ( due <= done ) { return; }
+
+	due -= done;
+	if ( due > __TICK_BATCHES * GENERATOR_BATCH )
+		{ due = __TICK_BATCHES * GENERATOR_BATCH; }
+
+	__send(g, due);
+
+}
+
+/* cb_generator_burst */
+void cb_generator_burst(struct ev_loop *loop, ev_idle *watcher, int revents)
+{
+
+	generator_t *g = (generator_t *)watcher->data;
+
+	if ( __expired(g, ev_time()) == true ) { return; }
+	__send(g, GENERATOR_BATCH);
+
+}
@@ -0,0 +1,184 @@
+/**
+ * @file generator.h
+ * @author Ricardo Tubío (rtpardavila[at]gmail.com)
+ * @version 0.1
+ *
+ * @section LICENSE
+ *
+ * This file is part of udpip-broadcaster.
+ * udpip-broadcaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * udpip-broadcaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with udpip-broadcaster.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Synthetic traffic generator for load tests: messages of a fixed, uniform
+ * or IMIX size distribution are sent from a number of flows (one socket each)
+ * at a given rate, paced by an ev_timer, or as fast as possible from an
+ * ev_idle watcher. Every payload starts with a header that carries the flow,
+ * a sequence number and the TX timestamp, so that receivers can measure
+ * losses, reordering and latency. Buffers are preallocated and messages are
+ * sent in batches with sendmmsg.
+ */
+
+#ifndef GENERATOR_H_
+#define GENERATOR_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <ev.h>
+#include <sys/socket.h>
+
+#include "../execution_codes.h"
+#include "../logger.h"
+
+#include "udp_socket.h"
+
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// DATA STRUCTURES
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+#define GENERATOR_BATCH 256				/**< Max. messages per sendmmsg. */
+#define GENERATOR_BATCH_NS 20000		/**< Max. time spent per sendmmsg. */
+#define GENERATOR_SEND_NS 1000			/**< Initial cost of a message (ns). */
+#define GENERATOR_TICK 0.001			/**< Pacing period (secs). */
+#define GENERATOR_MAX_FLOWS 1024		/**< Max. flows (sockets). */
+#define GENERATOR_MAX_SIZE 65507		/**< Max. UDP payload. */
+#define GENERATOR_MAGIC 0x55445047		/**< "UDPG", first payload bytes. */
+#define GENERATOR_RATE_MAX 0			/**< Rate: as fast as possible. */
+
+/**
+ * @enum generator_sizes
+ * @brief Distribution of the size of the messages.
+ */
+typedef enum generator_sizes
+{
+	GENERATOR_FIXED = 0,			/**< Always the minimum size. */
+	GENERATOR_UNIFORM,				/**< Uniform within [min, max]. */
+	GENERATOR_IMIX					/**< 7:4:1 of 64, 576 and 1472 bytes. */
+} generator_sizes_t;
+
+/**
+ * @struct generator_header
+ * @brief First bytes of every message generated (network order).
+ */
+typedef struct generator_header
+{
+	uint32_t magic;					/**< GENERATOR_MAGIC */
+	uint32_t flow;					/**< Flow that sent the message. */
+	uint64_t seq;					/**< Sequence number within its flow. */
+	uint64_t tx_ns;					/**< TX time (ns, CLOCK_REALTIME). */
+} __attribute__((packed)) generator_header_t;
+
+#define LEN__GENERATOR_HEADER sizeof(generator_header_t)
+
+/**
+ * @struct generator
+ * @brief Generator of synthetic traffic.
+ */
+typedef struct generator
+{
+
+	ev_timer pace;					/**< Pacing timer (MUST be 1st). */
+	ev_idle burst;					/**< Unpaced sending (.data = s). */
+	struct ev_loop *loop;			/**< Loop of the generator. */
+
+	sockaddr_in_t *dest_addr;		/**< Destination of the messages. */
+	int *sockets;					/**< One socket per flow. */
+	uint64_t *seqs;					/**< Next sequence number per flow. */
+	int no_flows;					/**< Number of flows. */
+
+	int rate;						/**< Messages/s (0: max). */
+	int sizes;						/**< generator_sizes_t */
+	int min_size;					/**< Minimum size (bytes). */
+	int max_size;					/**< Maximum size (bytes). */
+	int duration;					/**< Seconds (0: forever). */
+	uint64_t random;				/**< xorshift state for the sizes. */
+
+	uint8_t *buffers;				/**< GENERATOR_BATCH x max_size. */
+	int next_flow;					/**< Flow of the next message. */
+
+	double start;					/**< When the generator started. */
+	uint64_t sent;					/**< Messages sent. */
+	uint64_t bytes;					/**< Bytes sent. */
+	uint64_t errors;				/**< Messages that could not be sent. */
+	uint64_t batches;				/**< sendmmsg calls. */
+	uint64_t send_ns;				/**< Cost of a message (ns, average). */
+
+} generator_t;
+
+#define LEN__GENERATOR sizeof(generator_t)
+
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// GENERATOR MANAGEMENT
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+/**
+ * @brief Allocates memory for a generator structure.
+ * @return A pointer to the newly allocated block of memory.
+ */
+generator_t *new_generator();
+
+/**
+ * @brief Parses a size distribution: "N" (fixed), "MIN-MAX" (uniform) or
+ * 			"imix".
+ * @param spec Distribution.
+ * @param sizes Where the distribution is returned.
+ * @param min_size Where the minimum size is returned.
+ * @param max_size Where the maximum size is returned.
+ * @return EX_OK if parsed, EX_WRONG_PARAM otherwise.
+ */
+int generator_parse_sizes(	const char *spec, int *sizes,
+							int *min_size, int *max_size	);
+
+/**
+ * @brief Opens the sockets of the flows, preallocates the buffers and starts
+ * 			generating messages.
+ * @param loop Event loop of the generator.
+ * @param if_name Interface for broadcasting (NULL: unicast).
+ * @param dest_addr Destination of the messages.
+ * @param no_flows Number of flows (sockets).
+ * @param rate Messages/s for all the flows together (0: max).
+ * @param sizes Size distribution (generator_sizes_t).
+ * @param min_size Minimum (or fixed) size.
+ * @param max_size Maximum size.
+ * @param duration Seconds until the loop is broken (0: forever).
+ * @return A pointer to the initialized structure.
+ */
+generator_t *init_generator(	struct ev_loop *loop, const char *if_name,
+								sockaddr_in_t *dest_addr, const int no_flows,
+								const int rate, const int sizes,
+								const int min_size, const int max_size,
+								const int duration	);
+
+/**
+ * @brief Prints the generator and its counters.
+ * @param g The generator.
+ */
+void print_generator(const generator_t *g);
+
+/**
+ * @brief Callback that sends the messages due since the last tick.
+ */
+void cb_generator_pace(struct ev_loop *loop, ev_timer *watcher, int revents);
+
+/**
+ * @brief Callback that sends a whole batch, every loop iteration.
+ */
+void cb_generator_burst(struct ev_loop *loop, ev_idle *watcher, int revents);
+
+#endif /* GENERATOR_H_ */
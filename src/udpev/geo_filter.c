@@ -0,0 +1,160 @@
+/**
+ * @file nec_repeat.c
+ * @author Ricardo Tubío (rtpardavila[at]gmail.com)
+ * @version 0.1
+ *
+ * @section LICENSE
+ *
+ * This file is part of udpip-broadcaster.
+ * udpip-broadcaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * udpip-broadcaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with udpip-broadcaster.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "geo_filter.h"
+
+#define __ONE ( (int64_t)1 << GEO_Q_METERS )		/**< 1.0 in Q16. */
+#define __FAR ( (int64_t)1 << ( 17 + GEO_Q_METERS ) )	/**< 131 km, Q16. */
+#define __FULL_TURN ( 360LL * GEO_UNITS_PER_DEGREE )
+
+/* __to_units */
+static inline int32_t __to_units(const double degrees)
+	{ return((int32_t)lround(degrees * GEO_UNITS_PER_DEGREE)); }
+
+/* __inside; membership of the local position in a single area */
+static inline uint8_t __inside(const geo_filter_t *f, const __NEC__geo_area_t *a)
+{
+
+	int64_t dlon = (int64_t)f->longitude - a->longitude;
+	int64_t dlat = (int64_t)f->latitude - a->latitude;
+
+	if ( dlon > __FULL_TURN / 2 ) { dlon -= __FULL_TURN; }
+	if ( dlon < -__FULL_TURN / 2 ) { dlon += __FULL_TURN; }
+
+	// 1) local position relative to the center of the area, Q16 meters
+	int64_t dx = ( dlon * f->kx ) >> 16;
+	int64_t dy = ( dlat * f->ky ) >> 16;
+
+	if ( ( dx > __FAR ) || ( dx < -__FAR ) || ( dy > __FAR ) || ( dy < -__FAR ) )
+		{ return(0); }
+
+	// 2) rotated so that x runs along axis a (azimuth, clockwise from north)
+	int theta = a->orientation % 360;
+	int64_t x = ( dx * f->sin[theta] + dy * f->cos[theta] ) >> GEO_Q_TRIG;
+	int64_t y = ( dx * f->cos[theta] - dy * f->sin[theta] ) >> GEO_Q_TRIG;
+
+	// 3) normalized by the semi-axes, Q16 fractions of each axis
+	int64_t da = a->distance_a;
+	int64_t db = ( a->shape == __NEC__HST_AREA_CIRCLE ) ?
+					a->distance_a : a->distance_b;
+
+	if ( ( da == 0 ) || ( db == 0 ) ) { return(0); }
+
+	int64_t u = x / da, v = y / db;
+
+	if ( ( u > __ONE ) || ( u < -__ONE ) || ( v > __ONE ) || ( v < -__ONE ) )
+		{ return(0); }
+	if ( a->shape == __NEC__HST_AREA_RECTANGLE ) { return(1); }
+
+	return( ( u * u + v * v ) <= __ONE * __ONE );
+
+}
+
+/* new_geo_filter */
+geo_filter_t *new_geo_filter()
+{
+	geo_filter_t *s = NULL;
+	if ( ( s = (geo_filter_t *)malloc(LEN__GEO_FILTER) ) == NULL )
+		{ handle_sys_error("new_geo_filter: <malloc> returns NULL."); }
+	if ( memset(s, 0, LEN__GEO_FILTER) == NULL )
+		{ handle_sys_error("new_geo_filter: <memset> returns NULL."); }
+	return(s);
+}
+
+/* init_geo_filter */
+geo_filter_t *init_geo_filter(const double latitude, const double longitude)
+{
+
+	geo_filter_t *s = new_geo_filter();
+
+	for ( int d = 0; d < 360; d++ )
+	{
+		s->sin[d] = (int16_t)lround(sin(d * M_PI / 180.0) * ( 1 << GEO_Q_TRIG ));
+		s->cos[d] = (int16_t)lround(cos(d * M_PI / 180.0) * ( 1 << GEO_Q_TRIG ));
+	}
+
+	geo_filter_set_position(s, latitude, longitude);
+
+	return(s);
+
+}
+
+/* geo_filter_set_position */
+void geo_filter_set_position(	geo_filter_t *f,
+								const double latitude, const double longitude	)
+{
+
+	const double q32 = 4294967296.0;
+	const double m_per_unit = GEO_METERS_PER_DEGREE / GEO_UNITS_PER_DEGREE;
+
+	f->latitude = __to_units(latitude);
+	f->longitude = __to_units(longitude);
+
+	// meters per unit of each coordinate around the local position, Q32
+	f->ky = (int64_t)llround(m_per_unit * q32);
+	f->kx = (int64_t)llround(m_per_unit * cos(latitude * M_PI / 180.0) * q32);
+
+}
+
+/* geo_filter_batch */
+int geo_filter_batch(	const geo_filter_t *f,
+						const __NEC__geo_area_t *areas, const int n,
+						uint8_t *inside	)
+{
+	int count = 0;
+	for ( int i = 0; i < n; i++ )
+		{ count += ( inside[i] = __inside(f, &areas[i]) ); }
+	return(count);
+}
+
+/* geo_filter_match */
+bool geo_filter_match(geo_filter_t *f, const __NEC__msg_t *m)
+{
+
+	__NEC__geo_area_t area;
+	uint8_t inside = 0;
+
+	if ( m->type != __NEC__MSG_GEOCAST_RX ) { return(true); }
+	if ( __NEC__geo_area(m, &area) < 0 ) { return(true); }
+
+	f->checked++;
+	geo_filter_batch(f, &area, 1, &inside);
+
+	if ( inside == 0 ) { f->outside++; return(false); }
+
+	f->inside++;
+	return(true);
+
+}
+
+/* print_geo_filter */
+void print_geo_filter(const geo_filter_t *f)
+{
+	log_app_msg(">>> Geocast filter = \n{\n");
+	log_app_msg("\t.position = { lat = %.7f, lon = %.7f }\n"
+					, (double)f->latitude / GEO_UNITS_PER_DEGREE
+					, (double)f->longitude / GEO_UNITS_PER_DEGREE);
+	log_app_msg("\t.checked = %lu\n", f->checked);
+	log_app_msg("\t.inside = %lu\n", f->inside);
+	log_app_msg("\t.outside = %lu\n", f->outside);
+	log_app_msg("}\n");
+}
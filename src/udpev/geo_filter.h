@@ -0,0 +1,131 @@
+/**
+ * @file geo_filter.h
+ * @author Ricardo Tubío (rtpardavila[at]gmail.com)
+ * @version 0.1
+ *
+ * @section LICENSE
+ *
+ * This file is part of udpip-broadcaster.
+ * udpip-broadcaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * udpip-broadcaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with udpip-broadcaster.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Geocast area membership (ETSI EN 302 931) of the local position. The
+ * kernel only uses integer arithmetic: positions are projected onto a local
+ * plane in Q16 meters, rotated with a Q14 sin/cos table and normalized by
+ * the semi-axes of the area, so membership reduces to u^2 + v^2 <= 1 for
+ * circles and ellipses or |u|, |v| <= 1 for rectangles.
+ */
+
+#ifndef GEO_FILTER_H_
+#define GEO_FILTER_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "../execution_codes.h"
+#include "../logger.h"
+
+#include "__NEC__gnbtpapi_udp_msg.h"
+
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// DATA STRUCTURES
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+#define GEO_UNITS_PER_DEGREE 10000000	/**< Coordinates, 1/10 micro-degree. */
+#define GEO_METERS_PER_DEGREE 111319.49	/**< Length of a degree of latitude. */
+#define GEO_Q_METERS 16					/**< Fraction bits, local plane. */
+#define GEO_Q_TRIG 14					/**< Fraction bits, sin/cos table. */
+
+/**
+ * @struct geo_filter
+ * @brief Local position and precomputed factors for the membership kernel.
+ */
+typedef struct geo_filter
+{
+
+	int32_t latitude;				/**< Local latitude, 1/10 micro-degree. */
+	int32_t longitude;				/**< Local longitude, 1/10 micro-degree. */
+
+	int64_t kx;						/**< Q16 meters per unit of longitude. */
+	int64_t ky;						/**< Q16 meters per unit of latitude. */
+
+	int16_t sin[360];				/**< Q14 sin(degrees). */
+	int16_t cos[360];				/**< Q14 cos(degrees). */
+
+	unsigned long checked;			/**< Geocast messages checked. */
+	unsigned long inside;			/**< Geocasts for the local position. */
+	unsigned long outside;			/**< Geocasts filtered out. */
+
+} geo_filter_t;
+
+#define LEN__GEO_FILTER sizeof(geo_filter_t)
+
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// FILTER MANAGEMENT
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+/**
+ * @brief Allocates memory for a geo_filter structure.
+ * @return A pointer to the newly allocated block of memory.
+ */
+geo_filter_t *new_geo_filter();
+
+/**
+ * @brief Initializes a filter for the given local position.
+ * @param latitude Latitude of the local position (degrees).
+ * @param longitude Longitude of the local position (degrees).
+ * @return A pointer to the initialized structure.
+ */
+geo_filter_t *init_geo_filter(const double latitude, const double longitude);
+
+/**
+ * @brief Updates the local position of the filter.
+ * @param f The filter.
+ * @param latitude Latitude of the local position (degrees).
+ * @param longitude Longitude of the local position (degrees).
+ */
+void geo_filter_set_position(	geo_filter_t *f,
+								const double latitude, const double longitude	);
+
+/**
+ * @brief Checks a batch of areas against the local position.
+ * @param f The filter.
+ * @param areas Areas to be checked.
+ * @param n Number of areas.
+ * @param inside Array where membership (1 inside, 0 outside) is stored.
+ * @return Number of areas that include the local position.
+ */
+int geo_filter_batch(	const geo_filter_t *f,
+						const __NEC__geo_area_t *areas, const int n,
+						uint8_t *inside	);
+
+/**
+ * @brief Checks whether a message is relevant for the local position: only
+ * 			geocast messages whose area does not include it are not.
+ * @param f The filter.
+ * @param m View of the message.
+ * @return 'true' if the message is to be delivered.
+ */
+bool geo_filter_match(geo_filter_t *f, const __NEC__msg_t *m);
+
+/**
+ * @brief Prints the position and the counters of the given filter.
+ * @param f The filter.
+ */
+void print_geo_filter(const geo_filter_t *f);
+
+#endif /* GEO_FILTER_H_ */
@@ -0,0 +1,69 @@
+/**
+ * @file hash.h
+ * @author Ricardo Tubío (rtpardavila[at]gmail.com)
+ * @version 0.1
+ *
+ * @section LICENSE
+ *
+ * This file is part of udpip-broadcaster.
+ * udpip-broadcaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * udpip-broadcaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with udpip-broadcaster.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Hashes of the lookup tables. Keys are mixed with the murmur3 finalizers so
+ * that every bit of a key reaches the low bits of its hash: hosts of the same
+ * subnet only differ in the highest bits of an address in network order, and
+ * a plain multiplication would leave them in a handful of buckets.
+ */
+
+#ifndef HASH_H_
+#define HASH_H_
+
+#include <stdint.h>
+
+/**
+ * @brief 32-bit murmur3 finalizer.
+ * @param h Key.
+ * @return Hash of the key.
+ */
+static inline uint32_t hash_u32(uint32_t h)
+{
+	h ^= h >> 16; h *= 0x85EBCA6Bu;
+	h ^= h >> 13; h *= 0xC2B2AE35u;
+	h ^= h >> 16;
+	return(h);
+}
+
+/**
+ * @brief 64-bit murmur3 finalizer.
+ * @param h Key.
+ * @return Hash of the key.
+ */
+static inline uint64_t hash_u64(uint64_t h)
+{
+	h ^= h >> 33; h *= 0xFF51AFD7ED558CCDULL;
+	h ^= h >> 33; h *= 0xC4CEB9FE1A85EC53ULL;
+	h ^= h >> 33;
+	return(h);
+}
+
+/**
+ * @brief Hash of a UDP source (address and port, network order).
+ */
+static inline uint64_t hash_source(const uint32_t addr, const uint16_t port)
+{
+	return(hash_u64( ( (uint64_t)addr << 16 ) | port ));
+}
+
+#endif /* HASH_H_ */
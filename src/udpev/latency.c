@@ -0,0 +1,155 @@
+/**
+ * @file latency.c
+ * @author Ricardo Tubío (rtpardavila[at]gmail.com)
+ * @version 0.1
+ *
+ * @section LICENSE
+ *
+ * This file is part of udpip-broadcaster.
+ * udpip-broadcaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * udpip-broadcaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with udpip-broadcaster.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "latency.h"
+#include "control.h"
+
+/* __upper; highest latency that falls in the given bucket */
+static inline uint64_t __upper(const int i)
+{
+
+	if ( i < LATENCY_SUB ) { return((uint64_t)i); }
+
+	int j = i - LATENCY_SUB;
+	int shift = j / LATENCY_HALF + 1;
+	uint64_t sub = j % LATENCY_HALF + LATENCY_HALF;
+
+	return( ( ( sub + 1 ) << shift ) - 1 );
+
+}
+
+/* new_latency */
+latency_t *new_latency()
+{
+	latency_t *s = NULL;
+	if ( ( s = (latency_t *)malloc(LEN__LATENCY) ) == NULL )
+		{ handle_sys_error("new_latency: <malloc> returns NULL."); }
+	if ( memset(s, 0, LEN__LATENCY) == NULL )
+		{ handle_sys_error("new_latency: <memset> returns NULL."); }
+	return(s);
+}
+
+/* init_latency */
+latency_t *init_latency(struct ev_loop *loop, const char *name)
+{
+
+	latency_t *s = new_latency();
+
+	s->loop = loop;
+	s->name = name;
+	ev_timer_init(&s->publish, cb_latency_publish
+					, LATENCY_PUBLISH, LATENCY_PUBLISH);
+
+	return(s);
+
+}
+
+/* latency_set_stats */
+void latency_set_stats(latency_t *l, stats_block_t *b)
+{
+	l->stats = b;
+	if ( b != NULL ) { ev_timer_again(l->loop, &l->publish); }
+	else { ev_timer_stop(l->loop, &l->publish); }
+}
+
+/* latency_reset */
+void latency_reset(latency_t *l)
+{
+	memset(l->counts, 0, sizeof(l->counts));
+	l->total = l->min = l->max = l->sum = 0;
+	l->skipped = 0;
+}
+
+/* latency_percentile */
+uint64_t latency_percentile(const latency_t *l, const double p)
+{
+
+	if ( l->total == 0 ) { return(0); }
+
+	uint64_t rank = (uint64_t)( p * l->total + 0.5 ), seen = 0;
+	if ( rank < 1 ) { rank = 1; }
+
+	for ( int i = 0; i < LATENCY_BUCKETS; i++ )
+	{
+		if ( ( seen += l->counts[i] ) < rank ) { continue; }
+		uint64_t v = __upper(i);
+		return( ( v < l->max ) ? v : l->max );
+	}
+
+	return(l->max);
+
+}
+
+/* latency_control */
+int latency_control(	void *arg, int argc, char **argv,
+						char *out, const int out_len	)
+{
+
+	latency_t *l = (latency_t *)arg;
+
+	if ( ( argc == 2 ) && ( strcmp(argv[1], "reset") == 0 ) )
+	{
+		latency_reset(l);
+		return(control_append(out, out_len, "%s reset\n", l->name));
+	}
+	if ( argc != 1 )
+		{ return(control_append(out, out_len, "usage: %s [reset]\n"
+									, argv[0])); }
+
+	return(control_append(out, out_len, "%s count=%llu skipped=%lu" \
+			" min=%llu mean=%llu p50=%llu p90=%llu p99=%llu p999=%llu" \
+			" max=%llu (ns)\n"
+			, l->name, (unsigned long long)l->total, l->skipped
+			, (unsigned long long)l->min
+			, (unsigned long long)( ( l->total > 0 ) ?
+										l->sum / l->total : 0 )
+			, (unsigned long long)latency_percentile(l, 0.5)
+			, (unsigned long long)latency_percentile(l, 0.9)
+			, (unsigned long long)latency_percentile(l, 0.99)
+			, (unsigned long long)latency_percentile(l, 0.999)
+			, (unsigned long long)l->max));
+
+}
+
+/* print_latency */
+void print_latency(const latency_t *l)
+{
+	log_app_msg(">>> Latency (%s) = \n{\n", l->name);
+	log_app_msg("\t.buckets = %d\n", LATENCY_BUCKETS);
+	log_app_msg("\t.count = %llu\n", (unsigned long long)l->total);
+	log_app_msg("\t.p50 = %llu ns\n"
+					, (unsigned long long)latency_percentile(l, 0.5));
+	log_app_msg("\t.p99 = %llu ns\n"
+					, (unsigned long long)latency_percentile(l, 0.99));
+	log_app_msg("\t.p999 = %llu ns\n"
+					, (unsigned long long)latency_percentile(l, 0.999));
+	log_app_msg("}\n");
+}
+
+/* cb_latency_publish */
+void cb_latency_publish(struct ev_loop *loop, ev_timer *watcher, int revents)
+{
+	latency_t *l = (latency_t *)watcher;
+	stats_latency(l->stats, latency_percentile(l, 0.5)
+						, latency_percentile(l, 0.99)
+						, latency_percentile(l, 0.999));
+}
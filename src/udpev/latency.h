@@ -0,0 +1,212 @@
+/**
+ * @file latency.h
+ * @author Ricardo Tubío (rtpardavila[at]gmail.com)
+ * @version 0.1
+ *
+ * @section LICENSE
+ *
+ * This file is part of udpip-broadcaster.
+ * udpip-broadcaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * udpip-broadcaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with udpip-broadcaster.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Forwarding latency: log-linear histograms (HdrHistogram style) of the time
+ * spent by every message inside the broadcaster, from the kernel RX
+ * timestamp of its socket (SO_TIMESTAMPNS) until the return of the sendmsg
+ * call that forwards it. Values below LATENCY_SUB ns are kept exactly, the
+ * rest in buckets of 1/LATENCY_HALF of their power of two (< 0.8% error).
+ */
+
+#ifndef LATENCY_H_
+#define LATENCY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <ev.h>
+
+#include "../execution_codes.h"
+#include "../logger.h"
+
+#include "stats.h"
+
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// DATA STRUCTURES
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+#define LATENCY_SUB_BITS 8			/**< log2 of the exact range (ns). */
+#define LATENCY_SUB ( 1 << LATENCY_SUB_BITS )	/**< Exact values. */
+#define LATENCY_HALF ( LATENCY_SUB / 2 )		/**< Buckets per power of 2. */
+#define LATENCY_MAX_LOG2 36			/**< Values up to 2^36 ns (~68 s). */
+#define LATENCY_BUCKETS \
+	( LATENCY_SUB + ( LATENCY_MAX_LOG2 - LATENCY_SUB_BITS ) * LATENCY_HALF )
+#define LATENCY_PUBLISH 1.0			/**< Period of the percentiles (secs). */
+
+/**
+ * @struct latency
+ * @brief Latency histogram of a direction.
+ */
+typedef struct latency
+{
+
+	ev_timer publish;				/**< Publication timer (MUST be 1st). */
+	struct ev_loop *loop;			/**< Loop where the timer is run. */
+	const char *name;				/**< Direction, for reports. */
+	stats_block_t *stats;			/**< Where percentiles are published. */
+
+	uint64_t total;					/**< Messages recorded. */
+	uint64_t min;					/**< Min. latency (ns). */
+	uint64_t max;					/**< Max. latency (ns). */
+	uint64_t sum;					/**< Sum of latencies (ns). */
+	unsigned long skipped;			/**< Messages with a clock step. */
+
+	uint64_t counts[LATENCY_BUCKETS];	/**< Messages per bucket. */
+
+} latency_t;
+
+#define LEN__LATENCY sizeof(latency_t)
+
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// HISTOGRAM MANAGEMENT
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+/**
+ * @brief Allocates memory for a latency structure.
+ * @return A pointer to the newly allocated block of memory.
+ */
+latency_t *new_latency();
+
+/**
+ * @brief Initializes an empty histogram.
+ * @param loop Event loop for the publication timer.
+ * @param name Direction of the traffic, for reports.
+ * @return A pointer to the initialized structure.
+ */
+latency_t *init_latency(struct ev_loop *loop, const char *name);
+
+/**
+ * @brief Publishes the percentiles of the histogram every LATENCY_PUBLISH
+ * 			seconds in a block of the shared statistics segment.
+ * @param l The histogram.
+ * @param b The block.
+ */
+void latency_set_stats(latency_t *l, stats_block_t *b);
+
+/**
+ * @brief Empties the histogram.
+ * @param l The histogram.
+ */
+void latency_reset(latency_t *l);
+
+/**
+ * @brief Gets the latency below which the given fraction of the messages
+ * 			was forwarded (upper bound of its bucket).
+ * @param l The histogram.
+ * @param p Fraction, within [0, 1].
+ * @return Latency (ns), 0 if the histogram is empty.
+ */
+uint64_t latency_percentile(const latency_t *l, const double p);
+
+/**
+ * @brief Handler of the "lat" control commands.
+ * 			lat[net|app]: percentiles; lat[net|app] reset: empties it.
+ * @return Number of bytes written to the response.
+ */
+int latency_control(	void *arg, int argc, char **argv,
+						char *out, const int out_len	);
+
+/**
+ * @brief Prints the percentiles of the histogram.
+ * @param l The histogram.
+ */
+void print_latency(const latency_t *l);
+
+/**
+ * @brief Callback that publishes the percentiles.
+ */
+void cb_latency_publish(struct ev_loop *loop, ev_timer *watcher, int revents);
+
+/**
+ * @brief Converts a timestamp into nanoseconds.
+ */
+static inline uint64_t latency_ns(const struct timespec *ts)
+{
+	return( (uint64_t)ts->tv_sec * 1000000000ULL + ts->tv_nsec );
+}
+
+/**
+ * @brief Current time in the clock of the kernel RX timestamps (ns).
+ */
+static inline uint64_t latency_now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return(latency_ns(&ts));
+}
+
+/**
+ * @brief Bucket of a latency; the exponent selects the power of two and the
+ * 			LATENCY_SUB_BITS most significant bits the bucket within it.
+ */
+static inline int latency_bucket(const uint64_t ns)
+{
+
+	if ( ns < LATENCY_SUB ) { return((int)ns); }
+
+	int e = 63 - __builtin_clzll(ns);
+	if ( e >= LATENCY_MAX_LOG2 ) { return(LATENCY_BUCKETS - 1); }
+
+	int shift = e - LATENCY_SUB_BITS + 1;
+	return( LATENCY_SUB + ( shift - 1 ) * LATENCY_HALF
+				+ (int)( ns >> shift ) - LATENCY_HALF );
+
+}
+
+/**
+ * @brief Records the time elapsed between two timestamps of the clock of
+ * 			the kernel timestamps.
+ * @param l The histogram.
+ * @param from Timestamp of the start (ns).
+ * @param to Timestamp of the end (ns); before the start if the clock stepped.
+ */
+static inline void latency_add(latency_t *l, const uint64_t from
+								, const uint64_t to)
+{
+
+	if ( to < from ) { l->skipped++; return; }
+
+	uint64_t ns = to - from;
+
+	l->counts[latency_bucket(ns)]++;
+	l->sum += ns;
+	if ( ( l->total == 0 ) || ( ns < l->min ) ) { l->min = ns; }
+	if ( ns > l->max ) { l->max = ns; }
+	l->total++;
+
+}
+
+/**
+ * @brief Records the latency of a message just sent (l may be NULL).
+ * @param l The histogram.
+ * @param rx_ns Kernel RX time of the message (ns, 0: unknown).
+ */
+static inline void latency_record(latency_t *l, const uint64_t rx_ns)
+{
+	if ( ( l == NULL ) || ( rx_ns == 0 ) ) { return; }
+	latency_add(l, rx_ns, latency_now_ns());
+}
+
+#endif /* LATENCY_H_ */
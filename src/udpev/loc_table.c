@@ -0,0 +1,595 @@
+/**
+ * @file loc_table.c
+ * @author Ricardo Tubío (rtpardavila[at]gmail.com)
+ * @version 0.1
+ *
+ * @section LICENSE
+ *
+ * This file is part of udpip-broadcaster.
+ * udpip-broadcaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * udpip-broadcaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with udpip-broadcaster.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "loc_table.h"
+#include "hash.h"
+#include "control.h"
+
+#define __SLOT_MASK ( LOC_TABLE_SLOTS - 1 )
+#define __CELL_MASK ( LOC_TABLE_CELLS - 1 )
+#define __FULL_TURN ( 360LL * GEO_UNITS_PER_DEGREE )
+#define __MAX_LISTED 64			/**< Max. neighbours listed per query. */
+
+/* __to_units */
+static inline int32_t __to_units(const double degrees)
+	{ return((int32_t)lround(degrees * GEO_UNITS_PER_DEGREE)); }
+
+/* __slot; home slot of a GN address */
+static inline int __slot(const uint64_t gn_address)
+	{ return((int)hash_u64(gn_address) & __SLOT_MASK); }
+
+/* __floor_cell; grid coordinate of a plane coordinate */
+static inline int32_t __floor_cell(const int64_t v)
+{
+	return( (int32_t)( ( v >= 0 ) ? v / LOC_TABLE_CELL_DM :
+						-( ( -v + LOC_TABLE_CELL_DM - 1 ) / LOC_TABLE_CELL_DM ) ) );
+}
+
+/* __cell; grid bucket of a cell */
+static inline int __cell(const int32_t cx, const int32_t cy)
+{
+	return((int)( ( (uint32_t)cx * 73856093U ) ^ ( (uint32_t)cy * 19349663U ) )
+				& __CELL_MASK);
+}
+
+/* __fresh */
+static inline bool __fresh(const loc_table_t *t, const loc_entry_t *e)
+	{ return( ( ev_now(t->loop) - e->updated ) <= t->lifetime ); }
+
+/* __project; position onto the local plane, decimeters */
+static void __project(	const loc_table_t *t,
+						const int32_t latitude, const int32_t longitude,
+						int64_t *x, int64_t *y	)
+{
+
+	int64_t dlon = (int64_t)longitude - t->ref_longitude;
+
+	if ( dlon > __FULL_TURN / 2 ) { dlon -= __FULL_TURN; }
+	if ( dlon < -__FULL_TURN / 2 ) { dlon += __FULL_TURN; }
+
+	*x = llround(dlon * t->kx);
+	*y = llround(( (int64_t)latitude - t->ref_latitude ) * t->ky);
+
+}
+
+/* __set_reference; origin of the local plane */
+static void __set_reference(	loc_table_t *t,
+								const int32_t latitude, const int32_t longitude	)
+{
+
+	const double dm_per_unit = 10.0 * GEO_METERS_PER_DEGREE
+								/ GEO_UNITS_PER_DEGREE;
+	const double lat = (double)latitude / GEO_UNITS_PER_DEGREE;
+
+	t->ref_latitude = latitude;
+	t->ref_longitude = longitude;
+	t->ky = dm_per_unit;
+	t->kx = dm_per_unit * cos(lat * M_PI / 180.0);
+	t->referenced = true;
+
+}
+
+/* __grid_link */
+static void __grid_link(loc_table_t *t, const int idx)
+{
+
+	loc_entry_t *e = &t->entries[idx];
+	int64_t x, y;
+
+	__project(t, e->latitude, e->longitude, &x, &y);
+	e->x = (int32_t)x;
+	e->y = (int32_t)y;
+	e->cx = __floor_cell(x);
+	e->cy = __floor_cell(y);
+	e->cell = __cell(e->cx, e->cy);
+
+	e->cell_prev = LOC_TABLE_NONE;
+	e->cell_next = t->cells[e->cell];
+	if ( e->cell_next != LOC_TABLE_NONE )
+		{ t->entries[e->cell_next].cell_prev = idx; }
+	t->cells[e->cell] = idx;
+
+}
+
+/* __grid_unlink */
+static void __grid_unlink(loc_table_t *t, const int idx)
+{
+
+	loc_entry_t *e = &t->entries[idx];
+
+	if ( e->cell_prev != LOC_TABLE_NONE )
+		{ t->entries[e->cell_prev].cell_next = e->cell_next; }
+	else
+		{ t->cells[e->cell] = e->cell_next; }
+
+	if ( e->cell_next != LOC_TABLE_NONE )
+		{ t->entries[e->cell_next].cell_prev = e->cell_prev; }
+
+}
+
+/* __probe; slot of a GN address, or the empty slot where it belongs */
+static int __probe(const loc_table_t *t, const uint64_t gn_address, int *slot)
+{
+
+	int i = __slot(gn_address);
+
+	while ( t->slots[i] != LOC_TABLE_NONE )
+	{
+		if ( t->entries[t->slots[i]].gn_address == gn_address )
+			{ *slot = i; return(t->slots[i]); }
+		i = ( i + 1 ) & __SLOT_MASK;
+	}
+
+	*slot = i;
+	return(LOC_TABLE_NONE);
+
+}
+
+/* __remove; backward shift deletion, no tombstones are left behind */
+static void __remove(loc_table_t *t, const int idx)
+{
+
+	loc_entry_t *e = &t->entries[idx];
+	int i = 0;
+
+	__probe(t, e->gn_address, &i);
+
+	for ( int j = ( i + 1 ) & __SLOT_MASK; t->slots[j] != LOC_TABLE_NONE;
+			j = ( j + 1 ) & __SLOT_MASK )
+	{
+
+		// entries that would not be found from their home slot are moved
+		int home = __slot(t->entries[t->slots[j]].gn_address);
+		if ( ( ( j - home ) & __SLOT_MASK ) < ( ( j - i ) & __SLOT_MASK ) )
+			{ continue; }
+
+		t->slots[i] = t->slots[j];
+		i = j;
+
+	}
+
+	t->slots[i] = LOC_TABLE_NONE;
+
+	__grid_unlink(t, idx);
+	e->used = false;
+	e->cell_next = t->free;
+	t->free = idx;
+	t->count--;
+
+}
+
+/* __scan_cell; closest fresh entry of a cell to a point of the plane */
+static void __scan_cell(	loc_table_t *t, const int32_t cx, const int32_t cy,
+							const int64_t px, const int64_t py,
+							loc_entry_t **best, int64_t *best_d2	)
+{
+
+	for ( int idx = t->cells[__cell(cx, cy)]; idx != LOC_TABLE_NONE;
+			idx = t->entries[idx].cell_next )
+	{
+
+		loc_entry_t *e = &t->entries[idx];
+		if ( ( e->cx != cx ) || ( e->cy != cy ) || !__fresh(t, e) )
+			{ continue; }
+
+		int64_t dx = e->x - px, dy = e->y - py;
+		int64_t d2 = dx * dx + dy * dy;
+		if ( d2 < *best_d2 ) { *best = e; *best_d2 = d2; }
+
+	}
+
+}
+
+/* new_loc_table */
+loc_table_t *new_loc_table()
+{
+	loc_table_t *s = NULL;
+	if ( ( s = (loc_table_t *)malloc(LEN__LOC_TABLE) ) == NULL )
+		{ handle_sys_error("new_loc_table: <malloc> returns NULL."); }
+	if ( memset(s, 0, LEN__LOC_TABLE) == NULL )
+		{ handle_sys_error("new_loc_table: <memset> returns NULL."); }
+	return(s);
+}
+
+/* init_loc_table */
+loc_table_t *init_loc_table(struct ev_loop *loop, const ev_tstamp lifetime)
+{
+
+	if ( lifetime <= 0.0 )
+		{ handle_app_error("init_loc_table: wrong lifetime.\n"); }
+
+	loc_table_t *s = new_loc_table();
+
+	s->loop = loop;
+	s->lifetime = lifetime;
+
+	for ( int i = 0; i < LOC_TABLE_SLOTS; i++ )
+		{ s->slots[i] = LOC_TABLE_NONE; }
+	for ( int i = 0; i < LOC_TABLE_CELLS; i++ )
+		{ s->cells[i] = LOC_TABLE_NONE; }
+
+	// all the entries are chained in the free list
+	for ( int i = 0; i < LOC_TABLE_ENTRIES; i++ )
+		{ s->entries[i].cell_next = ( i + 1 < LOC_TABLE_ENTRIES ) ?
+										i + 1 : LOC_TABLE_NONE; }
+	s->free = 0;
+
+	ev_timer_init(&s->sweep, cb_loc_table_sweep
+					, LOC_TABLE_SWEEP, LOC_TABLE_SWEEP);
+	ev_timer_start(loop, &s->sweep);
+
+	return(s);
+
+}
+
+/* loc_table_set_position */
+void loc_table_set_position(	loc_table_t *t,
+								const double latitude, const double longitude	)
+{
+
+	t->latitude = __to_units(latitude);
+	t->longitude = __to_units(longitude);
+	t->positioned = true;
+
+	// the plane is centered on the local position, so the entries already
+	//		in the table are projected again
+	__set_reference(t, t->latitude, t->longitude);
+
+	for ( int i = 0; i < LOC_TABLE_ENTRIES; i++ )
+	{
+		if ( t->entries[i].used == false ) { continue; }
+		__grid_unlink(t, i);
+		__grid_link(t, i);
+	}
+
+}
+
+/* loc_table_update */
+loc_entry_t *loc_table_update(	loc_table_t *t, const uint64_t gn_address,
+								const int32_t latitude, const int32_t longitude,
+								const uint16_t speed, const uint16_t heading	)
+{
+
+	int slot = 0;
+	int idx = __probe(t, gn_address, &slot);
+
+	if ( t->referenced == false )
+		{ __set_reference(t, latitude, longitude); }
+
+	if ( idx == LOC_TABLE_NONE )
+	{
+
+		if ( ( idx = t->free ) == LOC_TABLE_NONE )
+			{ t->overflows++; return(NULL); }
+
+		t->free = t->entries[idx].cell_next;
+		t->slots[slot] = idx;
+		t->count++;
+		t->inserted++;
+
+		t->entries[idx].used = true;
+		t->entries[idx].gn_address = gn_address;
+
+	}
+	else
+	{
+		__grid_unlink(t, idx);
+		t->updated++;
+	}
+
+	loc_entry_t *e = &t->entries[idx];
+
+	e->latitude = latitude;
+	e->longitude = longitude;
+	e->speed = speed;
+	e->heading = heading;
+	e->updated = ev_now(t->loop);
+	__grid_link(t, idx);
+
+	return(e);
+
+}
+
+/* loc_table_update_msg */
+loc_entry_t *loc_table_update_msg(loc_table_t *t, const __NEC__msg_t *m)
+{
+
+	const uint8_t *rxi = __NEC__rx_info(m);
+	if ( rxi == NULL ) { return(NULL); }
+
+	return(loc_table_update(t, __NEC__rxi_gn_address(rxi)
+							, __NEC__rxi_latitude(rxi)
+							, __NEC__rxi_longitude(rxi)
+							, __NEC__rxi_speed(rxi)
+							, __NEC__rxi_heading(rxi)));
+
+}
+
+/* loc_table_lookup */
+loc_entry_t *loc_table_lookup(loc_table_t *t, const uint64_t gn_address)
+{
+
+	int slot = 0;
+	int idx = __probe(t, gn_address, &slot);
+
+	if ( idx == LOC_TABLE_NONE ) { return(NULL); }
+	if ( !__fresh(t, &t->entries[idx]) ) { return(NULL); }
+
+	return(&t->entries[idx]);
+
+}
+
+/* loc_table_within */
+int loc_table_within(	loc_table_t *t,
+						const int32_t latitude, const int32_t longitude,
+						const int radius, loc_entry_t **out, const int max	)
+{
+
+	if ( ( t->referenced == false ) || ( radius < 0 ) ) { return(0); }
+
+	int64_t px, py, r = (int64_t)radius * 10;
+	int n = 0;
+
+	__project(t, latitude, longitude, &px, &py);
+
+	int32_t cx0 = __floor_cell(px - r), cx1 = __floor_cell(px + r);
+	int32_t cy0 = __floor_cell(py - r), cy1 = __floor_cell(py + r);
+	bool scan = ( (int64_t)( cx1 - cx0 + 1 ) * ( cy1 - cy0 + 1 )
+					> LOC_TABLE_CELLS );
+
+	// 1) large radii cover more cells than buckets, the pool is scanned
+	for ( int i = 0; scan && ( i < LOC_TABLE_ENTRIES ) && ( n < max ); i++ )
+	{
+		loc_entry_t *e = &t->entries[i];
+		int64_t dx = e->x - px, dy = e->y - py;
+		if ( e->used && __fresh(t, e) && ( dx * dx + dy * dy <= r * r ) )
+			{ out[n++] = e; }
+	}
+
+	// 2) otherwise, only the cells that overlap the circle are visited
+	for ( int32_t cx = cx0; !scan && ( cx <= cx1 ); cx++ )
+	for ( int32_t cy = cy0; cy <= cy1; cy++ )
+	{
+		for ( int idx = t->cells[__cell(cx, cy)]; idx != LOC_TABLE_NONE;
+				idx = t->entries[idx].cell_next )
+		{
+
+			loc_entry_t *e = &t->entries[idx];
+			if ( ( e->cx != cx ) || ( e->cy != cy ) || !__fresh(t, e) )
+				{ continue; }
+
+			int64_t dx = e->x - px, dy = e->y - py;
+			if ( dx * dx + dy * dy > r * r ) { continue; }
+
+			out[n++] = e;
+			if ( n >= max ) { return(n); }
+
+		}
+	}
+
+	return(n);
+
+}
+
+/* loc_table_closest */
+loc_entry_t *loc_table_closest(	loc_table_t *t,
+								const int32_t latitude, const int32_t longitude,
+								double *distance	)
+{
+
+	if ( ( t->referenced == false ) || ( t->count == 0 ) ) { return(NULL); }
+
+	loc_entry_t *best = NULL;
+	int64_t px, py, best_d2 = INT64_MAX;
+	int k = 0;
+
+	__project(t, latitude, longitude, &px, &py);
+
+	int32_t pcx = __floor_cell(px), pcy = __floor_cell(py);
+
+	// 1) rings of cells around the point; entries in ring k are at least
+	//		(k - 1) cells away, so the search stops once that is farther
+	//		than the best entry found so far
+	for ( k = 0; k <= LOC_TABLE_RINGS; k++ )
+	{
+
+		int64_t edge = (int64_t)( k - 1 ) * LOC_TABLE_CELL_DM;
+		if ( ( best != NULL ) && ( k > 0 ) && ( edge * edge > best_d2 ) )
+			{ break; }
+
+		if ( k == 0 )
+			{ __scan_cell(t, pcx, pcy, px, py, &best, &best_d2); continue; }
+
+		for ( int d = -k; d <= k; d++ )
+		{
+			__scan_cell(t, pcx + d, pcy - k, px, py, &best, &best_d2);
+			__scan_cell(t, pcx + d, pcy + k, px, py, &best, &best_d2);
+		}
+		for ( int d = -k + 1; d <= k - 1; d++ )
+		{
+			__scan_cell(t, pcx - k, pcy + d, px, py, &best, &best_d2);
+			__scan_cell(t, pcx + k, pcy + d, px, py, &best, &best_d2);
+		}
+
+	}
+
+	// 2) far away neighbours are found by scanning the whole pool
+	if ( k > LOC_TABLE_RINGS )
+	{
+		for ( int i = 0; i < LOC_TABLE_ENTRIES; i++ )
+		{
+			loc_entry_t *e = &t->entries[i];
+			if ( ( e->used == false ) || !__fresh(t, e) ) { continue; }
+			int64_t dx = e->x - px, dy = e->y - py;
+			if ( dx * dx + dy * dy < best_d2 )
+				{ best = e; best_d2 = dx * dx + dy * dy; }
+		}
+	}
+
+	if ( ( best != NULL ) && ( distance != NULL ) )
+		{ *distance = sqrt((double)best_d2) / 10.0; }
+
+	return(best);
+
+}
+
+/* loc_table_distance */
+double loc_table_distance(	loc_table_t *t,
+							const int32_t latitude, const int32_t longitude	)
+{
+
+	if ( t->positioned == false ) { return(-1.0); }
+
+	int64_t px, py, lx, ly;
+
+	__project(t, latitude, longitude, &px, &py);
+	__project(t, t->latitude, t->longitude, &lx, &ly);
+
+	return(sqrt((double)( ( px - lx ) * ( px - lx ) + ( py - ly ) * ( py - ly ) ))
+				/ 10.0);
+
+}
+
+/* loc_table_progress */
+bool loc_table_progress(	loc_table_t *t,
+							const int32_t latitude, const int32_t longitude	)
+{
+
+	if ( t->positioned == false ) { return(true); }
+
+	double d = 0.0;
+	loc_entry_t *e = loc_table_closest(t, latitude, longitude, &d);
+
+	return( ( e != NULL ) && ( d < loc_table_distance(t, latitude, longitude) ) );
+
+}
+
+/* __print_entry */
+static int __print_entry(	loc_table_t *t, const loc_entry_t *e,
+							char *out, const int out_len	)
+{
+
+	double d = loc_table_distance(t, e->latitude, e->longitude);
+
+	return(control_append(out, out_len
+				, "%016llx lat=%.7f lon=%.7f speed=%u heading=%u" \
+				" age=%.1f dist=%.1f\n"
+				, (unsigned long long)e->gn_address
+				, (double)e->latitude / GEO_UNITS_PER_DEGREE
+				, (double)e->longitude / GEO_UNITS_PER_DEGREE
+				, e->speed, e->heading
+				, ev_now(t->loop) - e->updated, d));
+
+}
+
+/* loc_table_control */
+int loc_table_control(	void *arg, int argc, char **argv,
+						char *out, const int out_len	)
+{
+
+	loc_table_t *t = (loc_table_t *)arg;
+	loc_entry_t *found[__MAX_LISTED];
+	double lat = 0.0, lon = 0.0, d = 0.0;
+	unsigned long long gn = 0;
+	int radius = 0, n = 0, len = 0;
+
+	if ( argc < 2 )
+	{
+		return(control_append(out, out_len
+					, "entries=%d inserted=%lu updated=%lu expired=%lu" \
+					" overflows=%lu\n"
+					, t->count, t->inserted, t->updated, t->expired
+					, t->overflows));
+	}
+
+	if ( ( strcmp(argv[1], "get") == 0 ) && ( argc == 3 ) &&
+			( sscanf(argv[2], "%llx", &gn) == 1 ) )
+	{
+		loc_entry_t *e = loc_table_lookup(t, (uint64_t)gn);
+		if ( e == NULL )
+			{ return(control_append(out, out_len, "not found\n")); }
+		return(__print_entry(t, e, out, out_len));
+	}
+
+	if ( ( strcmp(argv[1], "near") == 0 ) && ( argc == 5 ) &&
+			( sscanf(argv[2], "%lf", &lat) == 1 ) &&
+			( sscanf(argv[3], "%lf", &lon) == 1 ) &&
+			( sscanf(argv[4], "%d", &radius) == 1 ) )
+	{
+		n = loc_table_within(t, __to_units(lat), __to_units(lon), radius
+								, found, __MAX_LISTED);
+		len = control_append(out, out_len, "found=%d\n", n);
+		for ( int i = 0; i < n; i++ )
+			{ len += __print_entry(t, found[i], out + len, out_len - len); }
+		return(len);
+	}
+
+	if ( ( strcmp(argv[1], "toward") == 0 ) && ( argc == 4 ) &&
+			( sscanf(argv[2], "%lf", &lat) == 1 ) &&
+			( sscanf(argv[3], "%lf", &lon) == 1 ) )
+	{
+		loc_entry_t *e = loc_table_closest(t, __to_units(lat), __to_units(lon)
+											, &d);
+		if ( e == NULL )
+			{ return(control_append(out, out_len, "not found\n")); }
+		len = control_append(out, out_len, "distance=%.1f\n", d);
+		return(len + __print_entry(t, e, out + len, out_len - len));
+	}
+
+	return(control_append(out, out_len, "usage: loc [get GN_ADDRESS" \
+							" | near LAT LON R | toward LAT LON]\n"));
+
+}
+
+/* print_loc_table */
+void print_loc_table(const loc_table_t *t)
+{
+
+	log_app_msg(">>> Location table (lifetime = %.1f s) = \n{\n", t->lifetime);
+	if ( t->positioned == true )
+		{ log_app_msg("\t.position = (%.7f, %.7f)\n"
+						, (double)t->latitude / GEO_UNITS_PER_DEGREE
+						, (double)t->longitude / GEO_UNITS_PER_DEGREE); }
+	log_app_msg("\t.entries = %d\n", t->count);
+	log_app_msg("\t.inserted = %lu\n", t->inserted);
+	log_app_msg("\t.updated = %lu\n", t->updated);
+	log_app_msg("\t.expired = %lu\n", t->expired);
+	log_app_msg("\t.overflows = %lu\n", t->overflows);
+	log_app_msg("}\n");
+
+}
+
+/* cb_loc_table_sweep */
+void cb_loc_table_sweep(struct ev_loop *loop, ev_timer *watcher, int revents)
+{
+
+	loc_table_t *t = (loc_table_t *)watcher;
+
+	for ( int i = 0; ( i < LOC_TABLE_ENTRIES ) && ( t->count > 0 ); i++ )
+	{
+		if ( ( t->entries[i].used == false ) || __fresh(t, &t->entries[i]) )
+			{ continue; }
+		__remove(t, i);
+		t->expired++;
+	}
+
+}
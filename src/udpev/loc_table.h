@@ -0,0 +1,250 @@
+/**
+ * @file loc_table.h
+ * @author Ricardo Tubío (rtpardavila[at]gmail.com)
+ * @version 0.1
+ *
+ * @section LICENSE
+ *
+ * This file is part of udpip-broadcaster.
+ * udpip-broadcaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * udpip-broadcaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with udpip-broadcaster.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * GeoNetworking location table: position, speed and heading of every
+ * neighbour heard from, keyed by its GN address. Entries live in a fixed
+ * pool indexed by an open-addressing hash map (linear probing, backward shift
+ * deletion) and by a uniform grid over a local plane, so that range and
+ * nearest neighbour queries only visit the cells around the point of
+ * interest. Entries that are not refreshed within their lifetime are aged
+ * out.
+ */
+
+#ifndef LOC_TABLE_H_
+#define LOC_TABLE_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <ev.h>
+
+#include "../execution_codes.h"
+#include "../logger.h"
+
+#include "__NEC__gnbtpapi_udp_msg.h"
+#include "geo_filter.h"
+
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// DATA STRUCTURES
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+#define LOC_TABLE_ENTRIES 8192		/**< Max. neighbours in the table. */
+#define LOC_TABLE_SLOTS 16384		/**< Hash slots (power of 2, 2x entries).*/
+#define LOC_TABLE_CELLS 4096		/**< Grid buckets (power of 2). */
+#define LOC_TABLE_CELL_DM 2500		/**< Side of a grid cell (decimeters). */
+#define LOC_TABLE_RINGS 16			/**< Max. rings for nearest searches. */
+#define LOC_TABLE_LIFETIME 20.0		/**< Lifetime of an entry (secs). */
+#define LOC_TABLE_SWEEP 1.0			/**< Period of the aging sweep (secs). */
+#define LOC_TABLE_NONE -1			/**< Null index. */
+
+/**
+ * @struct loc_entry
+ * @brief Last known state of a neighbour.
+ */
+typedef struct loc_entry
+{
+
+	uint64_t gn_address;			/**< GN address of the neighbour. */
+	int32_t latitude;				/**< Latitude, 1/10 micro-degree. */
+	int32_t longitude;				/**< Longitude, 1/10 micro-degree. */
+	uint16_t speed;					/**< Speed, as read from the wire. */
+	uint16_t heading;				/**< Heading, as read from the wire. */
+	ev_tstamp updated;				/**< Last time it was heard from. */
+
+	int32_t x;						/**< Local plane east (decimeters). */
+	int32_t y;						/**< Local plane north (decimeters). */
+	int32_t cx;						/**< Grid column. */
+	int32_t cy;						/**< Grid row. */
+	int cell;						/**< Grid bucket of (cx, cy). */
+	int cell_prev;					/**< Previous entry in the bucket. */
+	int cell_next;					/**< Next entry in the bucket (or free).*/
+
+	bool used;						/**< Flag that indicates entry in use. */
+
+} loc_entry_t;
+
+#define LEN__LOC_ENTRY sizeof(loc_entry_t)
+
+/**
+ * @struct loc_table
+ * @brief Location table with its hash and grid indexes.
+ */
+typedef struct loc_table
+{
+
+	ev_timer sweep;					/**< Aging timer (MUST be 1st). */
+	struct ev_loop *loop;			/**< Loop where the timer is run. */
+	ev_tstamp lifetime;				/**< Lifetime of the entries (secs). */
+
+	bool positioned;				/**< The local position is known. */
+	int32_t latitude;				/**< Local latitude, 1/10 micro-degree. */
+	int32_t longitude;				/**< Local longitude, 1/10 micro-deg. */
+
+	bool referenced;				/**< Origin of the local plane is set. */
+	int32_t ref_latitude;			/**< Origin latitude, 1/10 micro-deg. */
+	int32_t ref_longitude;			/**< Origin longitude, 1/10 micro-deg. */
+	double kx;						/**< Decimeters per unit of longitude. */
+	double ky;						/**< Decimeters per unit of latitude. */
+
+	loc_entry_t entries[LOC_TABLE_ENTRIES];	/**< Pool of entries. */
+	int free;						/**< First free entry of the pool. */
+	int count;						/**< Entries in use. */
+
+	int slots[LOC_TABLE_SLOTS];		/**< Hash map, GN address to entry. */
+	int cells[LOC_TABLE_CELLS];		/**< Grid, first entry of each bucket. */
+
+	unsigned long inserted;			/**< Neighbours added. */
+	unsigned long updated;			/**< Positions refreshed. */
+	unsigned long expired;			/**< Neighbours aged out. */
+	unsigned long overflows;		/**< Neighbours lost, table full. */
+
+} loc_table_t;
+
+#define LEN__LOC_TABLE sizeof(loc_table_t)
+
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// TABLE MANAGEMENT
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+/**
+ * @brief Allocates memory for a loc_table structure.
+ * @return A pointer to the newly allocated block of memory.
+ */
+loc_table_t *new_loc_table();
+
+/**
+ * @brief Initializes an empty table and starts its aging timer.
+ * @param loop Event loop where the aging timer is to be run.
+ * @param lifetime Seconds an entry is kept without being refreshed.
+ * @return A pointer to the initialized structure.
+ */
+loc_table_t *init_loc_table(struct ev_loop *loop, const ev_tstamp lifetime);
+
+/**
+ * @brief Sets the local position, which becomes the origin of the plane.
+ * @param t The table.
+ * @param latitude Latitude of the local position (degrees).
+ * @param longitude Longitude of the local position (degrees).
+ */
+void loc_table_set_position(	loc_table_t *t,
+								const double latitude, const double longitude	);
+
+/**
+ * @brief Adds a neighbour to the table or refreshes its state.
+ * @param t The table.
+ * @param gn_address GN address of the neighbour.
+ * @param latitude Latitude (1/10 micro-degree).
+ * @param longitude Longitude (1/10 micro-degree).
+ * @param speed Speed, as read from the wire.
+ * @param heading Heading, as read from the wire.
+ * @return The entry of the neighbour, NULL if the table is full.
+ */
+loc_entry_t *loc_table_update(	loc_table_t *t, const uint64_t gn_address,
+								const int32_t latitude, const int32_t longitude,
+								const uint16_t speed, const uint16_t heading	);
+
+/**
+ * @brief Updates the table with the rx_info header of a received message.
+ * @param t The table.
+ * @param m View of the message.
+ * @return The entry of the sender, NULL if none was updated.
+ */
+loc_entry_t *loc_table_update_msg(loc_table_t *t, const __NEC__msg_t *m);
+
+/**
+ * @brief Looks up a neighbour by its GN address.
+ * @param t The table.
+ * @param gn_address GN address of the neighbour.
+ * @return The entry of the neighbour, NULL if unknown or expired.
+ */
+loc_entry_t *loc_table_lookup(loc_table_t *t, const uint64_t gn_address);
+
+/**
+ * @brief Finds the neighbours within a given distance of a point.
+ * @param t The table.
+ * @param latitude Latitude of the point (1/10 micro-degree).
+ * @param longitude Longitude of the point (1/10 micro-degree).
+ * @param radius Distance (meters).
+ * @param out Array where the entries found are stored.
+ * @param max Length of the array.
+ * @return Number of entries stored.
+ */
+int loc_table_within(	loc_table_t *t,
+						const int32_t latitude, const int32_t longitude,
+						const int radius, loc_entry_t **out, const int max	);
+
+/**
+ * @brief Finds the neighbour closest to a point.
+ * @param t The table.
+ * @param latitude Latitude of the point (1/10 micro-degree).
+ * @param longitude Longitude of the point (1/10 micro-degree).
+ * @param distance Where the distance to the point (meters) is stored, NULL
+ * 			if not required.
+ * @return The closest entry, NULL if the table is empty.
+ */
+loc_entry_t *loc_table_closest(	loc_table_t *t,
+								const int32_t latitude, const int32_t longitude,
+								double *distance	);
+
+/**
+ * @brief Checks whether some neighbour is closer to a point than the local
+ * 			position, so that relaying toward that point makes progress.
+ * @param t The table.
+ * @param latitude Latitude of the point (1/10 micro-degree).
+ * @param longitude Longitude of the point (1/10 micro-degree).
+ * @return 'true' if so or if the local position is unknown.
+ */
+bool loc_table_progress(	loc_table_t *t,
+							const int32_t latitude, const int32_t longitude	);
+
+/**
+ * @brief Distance from the local position to a point.
+ * @return Distance (meters), < 0 if the local position is unknown.
+ */
+double loc_table_distance(	loc_table_t *t,
+							const int32_t latitude, const int32_t longitude	);
+
+/**
+ * @brief Handler of the "loc" control command.
+ * 			loc: summary of the table.
+ * 			loc get GN_ADDRESS: state of a neighbour (hex address).
+ * 			loc near LAT LON R: neighbours within R meters of a point.
+ * 			loc toward LAT LON: neighbour closest to a point.
+ * @return Number of bytes written to the response.
+ */
+int loc_table_control(	void *arg, int argc, char **argv,
+						char *out, const int out_len	);
+
+/**
+ * @brief Prints the counters of the given table.
+ * @param t The table.
+ */
+void print_loc_table(const loc_table_t *t);
+
+/**
+ * @brief Callback that ages out the entries not refreshed in time.
+ */
+void cb_loc_table_sweep(struct ev_loop *loop, ev_timer *watcher, int revents);
+
+#endif /* LOC_TABLE_H_ */
@@ -0,0 +1,247 @@
+/**
+ * @file nec_relay.c
+ * @author Ricardo Tubío (rtpardavila[at]gmail.com)
+ * @version 0.1
+ *
+ * @section LICENSE
+ *
+ * This file is part of udpip-broadcaster.
+ * udpip-broadcaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * udpip-broadcaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with udpip-broadcaster.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "nec_relay.h"
+
+#include <time.h>
+#include <unistd.h>
+
+/* __digest; FNV-1a that skips the hop_limit, which changes per hop */
+static uint32_t __digest(const char *data, const int len)
+{
+
+	uint32_t h = 2166136261u;
+
+	for ( int i = 0; i < len; i++ )
+	{
+		if ( i == __NEC__OFF_HOP_LIMIT ) { continue; }
+		h ^= (uint8_t)data[i];
+		h *= 16777619u;
+	}
+
+	return(h);
+
+}
+
+/* __random_delay */
+static ev_tstamp __random_delay(const nec_relay_t *relay)
+{
+	double r = (double)random() / (double)RAND_MAX;
+	return(relay->delay_min + r * ( relay->delay_max - relay->delay_min ));
+}
+
+/* new_nec_relay */
+nec_relay_t *new_nec_relay()
+{
+	nec_relay_t *s = NULL;
+	if ( ( s = (nec_relay_t *)malloc(LEN__NEC_RELAY) ) == NULL )
+		{ handle_sys_error("new_nec_relay: <malloc> returns NULL."); }
+	if ( memset(s, 0, LEN__NEC_RELAY) == NULL )
+		{ handle_sys_error("new_nec_relay: <memset> returns NULL."); }
+	return(s);
+}
+
+/* init_nec_relay */
+nec_relay_t *init_nec_relay(struct ev_loop *loop
+							, const char *if_name, const int port
+							, const int delay_min_ms, const int delay_max_ms)
+{
+
+	if ( ( delay_min_ms < 0 ) || ( delay_max_ms < delay_min_ms ) )
+		{ handle_app_error("init_nec_relay: wrong contention delays.\n"); }
+
+	nec_relay_t *s = new_nec_relay();
+
+	s->loop = loop;
+	s->socket_fd = open_broadcast_udp_socket(if_name, port);
+	s->relay_addr = init_broadcast_sockaddr_in(port);
+	s->delay_min = (ev_tstamp)delay_min_ms / 1000.0;
+	s->delay_max = (ev_tstamp)delay_max_ms / 1000.0;
+
+	if ( ( s->scratch = (char *)malloc(NEC_RELAY_MSG_LEN) ) == NULL )
+		{ handle_sys_error("init_nec_relay: <malloc> returns NULL."); }
+
+	for ( int i = 0; i < NEC_RELAY_SLOTS; i++ )
+	{
+		if ( ( s->slots[i].data = (char *)malloc(NEC_RELAY_MSG_LEN) ) == NULL )
+			{ handle_sys_error("init_nec_relay: <malloc> returns NULL."); }
+		s->slots[i].relay = s;
+		ev_timer_init(&s->slots[i].timer, cb_nec_relay_timer, 0.0, 0.0);
+	}
+
+	srandom((unsigned int)time(NULL) ^ (unsigned int)getpid());
+
+	return(s);
+
+}
+
+/* free_nec_relay */
+void free_nec_relay(nec_relay_t *relay)
+{
+
+	for ( int i = 0; i < NEC_RELAY_SLOTS; i++ )
+	{
+		ev_timer_stop(relay->loop, &relay->slots[i].timer);
+		free(relay->slots[i].data);
+	}
+
+	free(relay->scratch);
+	close(relay->socket_fd);
+	free(relay->relay_addr);
+	free(relay);
+
+}
+
+/* nec_relay_process */
+int nec_relay_process(	nec_relay_t *relay,
+						const iovec_t *iov, const int iovlen, const int len	)
+{
+
+	__NEC__msg_t msg;
+	char *data = relay->scratch;
+
+	if ( ( len < 0 ) || ( len > NEC_RELAY_MSG_LEN ) )
+		{ relay->invalid++; return(EX_WRONG_PARAM); }
+
+	// 0) messages scattered during reception are gathered back together
+	for ( int i = 0, copied = 0; ( i < iovlen ) && ( copied < len ); i++ )
+	{
+		int n = ( (int)iov[i].iov_len < len - copied ) ?
+					(int)iov[i].iov_len : len - copied;
+		memcpy(data + copied, iov[i].iov_base, n);
+		copied += n;
+	}
+
+	if ( __NEC__parse_rx(data, len, &msg) < 0 )
+		{ relay->invalid++; return(EX_WRONG_PARAM); }
+
+	uint32_t digest = __digest(data, len);
+	nec_relay_entry_t *free_slot = NULL;
+
+	// 1) a neighbour relayed this message first, the local copy is useless
+	for ( int i = 0; i < NEC_RELAY_SLOTS; i++ )
+	{
+
+		nec_relay_entry_t *e = &relay->slots[i];
+
+		if ( e->pending == false )
+		{
+			if ( free_slot == NULL ) { free_slot = e; }
+			continue;
+		}
+
+		if ( e->digest != digest ) { continue; }
+
+		ev_timer_stop(relay->loop, &e->timer);
+		e->pending = false;
+		relay->cancelled++;
+		return(EX_OK);
+
+	}
+
+	// 2) messages already relayed (or cancelled) are not relayed again
+	for ( int i = 0; i < NEC_RELAY_SEEN; i++ )
+	{
+		if ( relay->seen[i] == digest )
+			{ relay->duplicates++; return(EX_ERR); }
+	}
+
+	relay->seen[relay->seen_next] = digest;
+	relay->seen_next = ( relay->seen_next + 1 ) % NEC_RELAY_SEEN;
+
+	// 3) messages whose hop_limit is exhausted are not relayed
+	uint8_t hop_limit = __NEC__hop_limit(&msg);
+
+	if ( hop_limit <= 1 )
+		{ relay->hop_limited++; return(EX_ERR); }
+
+	// 4) geocasts heard outside of their area are only relayed if some
+	//		neighbour is closer to the area than the local position
+	__NEC__geo_area_t area;
+
+	if ( ( relay->loc_table != NULL ) &&
+			( __NEC__geo_area(&msg, &area) == EX_OK ) )
+	{
+
+		double d = loc_table_distance(relay->loc_table
+										, area.latitude, area.longitude);
+		double r = ( area.distance_a > area.distance_b ) ?
+						area.distance_a : area.distance_b;
+
+		if ( ( d > r ) && ( loc_table_progress(relay->loc_table
+								, area.latitude, area.longitude) == false ) )
+			{ relay->no_progress++; return(EX_ERR); }
+
+	}
+
+	if ( free_slot == NULL )
+		{ relay->overflows++; return(EX_ERR); }
+
+	// 5) re-broadcast scheduled after a random contention delay
+	relay->scratch = free_slot->data;
+	free_slot->data = data;
+	__NEC__set_hop_limit(free_slot->data, hop_limit - 1);
+	free_slot->len = len;
+	free_slot->digest = digest;
+	free_slot->pending = true;
+
+	ev_timer_set(&free_slot->timer, __random_delay(relay), 0.0);
+	ev_timer_start(relay->loop, &free_slot->timer);
+
+	return(EX_OK);
+
+}
+
+/* print_nec_relay */
+void print_nec_relay(const nec_relay_t *relay)
+{
+	log_app_msg(">>> NEC relay = \n{\n");
+	log_app_msg("\t.relayed = %lu\n", relay->relayed);
+	log_app_msg("\t.invalid = %lu\n", relay->invalid);
+	log_app_msg("\t.cancelled = %lu\n", relay->cancelled);
+	log_app_msg("\t.duplicates = %lu\n", relay->duplicates);
+	log_app_msg("\t.hop_limited = %lu\n", relay->hop_limited);
+	log_app_msg("\t.overflows = %lu\n", relay->overflows);
+	log_app_msg("\t.no_progress = %lu\n", relay->no_progress);
+	log_app_msg("}\n");
+}
+
+/* cb_nec_relay_timer */
+void cb_nec_relay_timer(struct ev_loop *loop, ev_timer *watcher, int revents)
+{
+
+	nec_relay_entry_t *e = (nec_relay_entry_t *)watcher;
+	nec_relay_t *relay = e->relay;
+
+	e->pending = false;
+
+	if ( send_message(	(sockaddr_t *)relay->relay_addr, relay->socket_fd,
+						e->data, e->len	) < 0 )
+	{
+		log_app_msg("cb_nec_relay_timer: <send_message> " \
+						"Could not relay message.\n");
+		return;
+	}
+
+	relay->relayed++;
+
+}
@@ -0,0 +1,162 @@
+/**
+ * @file nec_relay.h
+ * @author Ricardo Tubío (rtpardavila[at]gmail.com)
+ * @version 0.1
+ *
+ * @section LICENSE
+ *
+ * This file is part of udpip-broadcaster.
+ * udpip-broadcaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * udpip-broadcaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with udpip-broadcaster.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Multi-hop relay for NEC GN-BTP API messages. Every message received from
+ * the network whose hop_limit allows it is re-broadcast after a small random
+ * contention delay; if a copy of the same message is heard from a neighbour
+ * before that delay expires, the local re-broadcast is cancelled.
+ */
+
+#ifndef NEC_RELAY_H_
+#define NEC_RELAY_H_
+
+#include <stdint.h>
+#include <ev.h>
+
+#include "../execution_codes.h"
+#include "../logger.h"
+
+#include "udp_socket.h"
+#include "__NEC__gnbtpapi_udp_msg.h"
+#include "loc_table.h"
+
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// DATA STRUCTURES
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+#define NEC_RELAY_SLOTS 64			/**< Max. pending re-broadcasts. */
+#define NEC_RELAY_SEEN 256			/**< Size of the duplicates cache. */
+
+/** Max. message gathered: stripped RX headers are scattered before the data */
+#define NEC_RELAY_MSG_LEN ( UDP_BUFFER_LEN + LEN____NEC__GNBTPAPI_MAX_HEADER )
+
+struct nec_relay;
+
+/**
+ * @struct nec_relay_entry
+ * @brief Re-broadcast waiting for its contention delay to expire.
+ */
+typedef struct nec_relay_entry
+{
+
+	ev_timer timer;					/**< Contention timer (MUST be 1st). */
+	struct nec_relay *relay;		/**< Relay that owns this entry. */
+
+	bool pending;					/**< Flag that indicates slot in use. */
+	uint32_t digest;				/**< Digest of the relayed message. */
+
+	int len;						/**< Length of the message. */
+	char *data;						/**< Copy of the message to relay. */
+
+} nec_relay_entry_t;
+
+/**
+ * @struct nec_relay
+ * @brief State of the multi-hop relay.
+ */
+typedef struct nec_relay
+{
+
+	struct ev_loop *loop;			/**< Loop where timers are run. */
+
+	int socket_fd;					/**< Broadcast socket for relaying. */
+	sockaddr_in_t *relay_addr;		/**< Broadcast address for relaying. */
+
+	ev_tstamp delay_min;			/**< Min. contention delay (secs). */
+	ev_tstamp delay_max;			/**< Max. contention delay (secs). */
+
+	nec_relay_entry_t slots[NEC_RELAY_SLOTS];	/**< Pending relays. */
+	char *scratch;					/**< Buffer for gathering messages. */
+
+	loc_table_t *loc_table;			/**< Neighbours, for geocast progress. */
+
+	uint32_t seen[NEC_RELAY_SEEN];	/**< Digests of messages already seen. */
+	int seen_next;					/**< Next position to overwrite. */
+
+	unsigned long relayed;			/**< Messages re-broadcast. */
+	unsigned long invalid;			/**< Messages that could not be parsed. */
+	unsigned long cancelled;		/**< Relays cancelled by neighbours. */
+	unsigned long duplicates;		/**< Duplicates not relayed. */
+	unsigned long hop_limited;		/**< Messages whose hop_limit ran out. */
+	unsigned long overflows;		/**< Messages dropped, no free slots. */
+	unsigned long no_progress;		/**< Geocasts no neighbour gets closer. */
+
+} nec_relay_t;
+
+#define LEN__NEC_RELAY sizeof(nec_relay_t)
+
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// RELAY MANAGEMENT
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+/**
+ * @brief Allocates memory for a nec_relay structure.
+ * @return A pointer to the newly allocated block of memory.
+ */
+nec_relay_t *new_nec_relay();
+
+/**
+ * @brief Initializes a relay that re-broadcasts messages through the given
+ * 			interface and port.
+ * @param loop Event loop where the contention timers are to be run.
+ * @param if_name Name of the interface for re-broadcasting.
+ * @param port Port where messages are re-broadcast to.
+ * @param delay_min_ms Minimum contention delay (milliseconds).
+ * @param delay_max_ms Maximum contention delay (milliseconds).
+ * @return A pointer to the initialized structure.
+ */
+nec_relay_t *init_nec_relay(struct ev_loop *loop
+							, const char *if_name, const int port
+							, const int delay_min_ms, const int delay_max_ms);
+
+/**
+ * @brief Stops all pending timers and releases the given relay.
+ * @param relay The relay to be released.
+ */
+void free_nec_relay(nec_relay_t *relay);
+
+/**
+ * @brief Processes a message just received from the network: it either
+ * 			cancels a pending re-broadcast of the same message or schedules
+ * 			a new re-broadcast with its hop_limit decremented.
+ * @param relay The relay state.
+ * @param iov Buffers where the message was received (scattered).
+ * @param iovlen Number of buffers.
+ * @param len Length of the received message.
+ * @return EX_OK if a re-broadcast was scheduled or cancelled; otherwise < 0.
+ */
+int nec_relay_process(	nec_relay_t *relay,
+						const iovec_t *iov, const int iovlen, const int len	);
+
+/**
+ * @brief Prints the counters of the given relay.
+ * @param relay The relay whose counters are to be printed.
+ */
+void print_nec_relay(const nec_relay_t *relay);
+
+/**
+ * @brief Callback function for the contention timers, <libev>.
+ */
+void cb_nec_relay_timer(struct ev_loop *loop, ev_timer *watcher, int revents);
+
+#endif /* NEC_RELAY_H_ */
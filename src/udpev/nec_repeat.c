@@ -0,0 +1,208 @@
+/**
+ * @file nec_repeat.c
+ * @author Ricardo Tubío (rtpardavila[at]gmail.com)
+ * @version 0.1
+ *
+ * @section LICENSE
+ *
+ * This file is part of udpip-broadcaster.
+ * udpip-broadcaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * udpip-broadcaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with udpip-broadcaster.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "nec_repeat.h"
+#include "hash.h"
+
+#define __TICK ( (ev_tstamp)NEC_REPEAT_TICK_MS / 1000.0 )
+
+/* __ms_to_ticks */
+static inline uint64_t __ms_to_ticks(const uint32_t ms)
+	{ return( ( (uint64_t)ms + NEC_REPEAT_TICK_MS - 1 ) / NEC_REPEAT_TICK_MS ); }
+
+/* __now_tick */
+static inline uint64_t __now_tick(const nec_repeat_t *r)
+	{ return((uint64_t)( ( ev_now(r->loop) - r->origin ) / __TICK )); }
+
+/* __bucket */
+static inline nec_repeat_entry_t **__bucket(	nec_repeat_t *r,
+												const in_addr_t addr,
+												const in_port_t port,
+												const uint16_t btp_port	)
+{
+	uint64_t h = hash_u64( ( (uint64_t)addr << 32 )
+							| ( (uint32_t)port << 16 ) | btp_port );
+	return(&r->buckets[h & ( NEC_REPEAT_BUCKETS - 1 )]);
+}
+
+/* __remove; unlinks an entry from its bucket and from the wheel */
+static void __remove(nec_repeat_t *r, nec_repeat_entry_t *e)
+{
+
+	nec_repeat_entry_t **p = __bucket(r, e->addr, e->port, e->btp_port);
+
+	while ( *p != e ) { p = &(*p)->hnext; }
+	*p = e->hnext;
+
+	timer_wheel_cancel(r->wheel, &e->node);
+	r->count--;
+	free(e);
+
+}
+
+/* __expire; sends a repetition and reschedules the next one */
+static void __expire(timer_wheel_node_t *node, void *arg)
+{
+
+	nec_repeat_t *r = (nec_repeat_t *)arg;
+	nec_repeat_entry_t *e = (nec_repeat_entry_t *)node;
+
+	iovec_t iov = { .iov_base = e->data, .iov_len = e->len };
+
+	// a repetition that waits in the queue expires along with the message
+	uint64_t remaining = e->deadline - node->expires + 1;
+
+	if ( tx_scheduler_send(r->tx_scheduler, e->tx_class, &iov, 1
+						, (uint32_t)( remaining * NEC_REPEAT_TICK_MS )
+						, 0) >= 0 )
+		{ e->repetitions++; r->repetitions++; }
+
+	uint64_t next = node->expires + e->interval;
+
+	if ( next > e->deadline )
+		{ r->expired++; __remove(r, e); return; }
+
+	timer_wheel_add(r->wheel, node, next);
+
+}
+
+/* new_nec_repeat */
+nec_repeat_t *new_nec_repeat()
+{
+	nec_repeat_t *s = NULL;
+	if ( ( s = (nec_repeat_t *)malloc(LEN__NEC_REPEAT) ) == NULL )
+		{ handle_sys_error("new_nec_repeat: <malloc> returns NULL."); }
+	if ( memset(s, 0, LEN__NEC_REPEAT) == NULL )
+		{ handle_sys_error("new_nec_repeat: <memset> returns NULL."); }
+	return(s);
+}
+
+/* init_nec_repeat */
+nec_repeat_t *init_nec_repeat(	struct ev_loop *loop,
+								tx_scheduler_t *tx_scheduler	)
+{
+
+	nec_repeat_t *s = new_nec_repeat();
+
+	s->loop = loop;
+	s->origin = ev_now(loop);
+	s->wheel = init_timer_wheel(0);
+	s->tx_scheduler = tx_scheduler;
+
+	ev_timer_init(&s->timer, cb_nec_repeat_timer, __TICK, __TICK);
+	s->timer.data = s;
+
+	return(s);
+
+}
+
+/* nec_repeat_schedule */
+int nec_repeat_schedule(nec_repeat_t *r
+						, const sockaddr_in_t *src, const __NEC__msg_t *m
+						, const int tx_class)
+{
+
+	in_addr_t addr = src->sin_addr.s_addr;
+	in_port_t port = src->sin_port;
+	uint16_t btp_port = __NEC__destination_port(m);
+	uint64_t interval = __ms_to_ticks(__NEC__repetition_interval(m));
+	uint64_t lifetime = __ms_to_ticks(__NEC__max_lifetime(m));
+
+	// 1) a newer message replaces the one that is being repeated
+	for ( nec_repeat_entry_t *e = *__bucket(r, addr, port, btp_port);
+			e != NULL; e = e->hnext )
+	{
+		if ( ( e->addr != addr ) || ( e->port != port ) ||
+				( e->btp_port != btp_port ) )
+			{ continue; }
+		__remove(r, e);
+		r->replaced++;
+		break;
+	}
+
+	if ( ( interval == 0 ) || ( interval > lifetime ) )
+		{ return(EX_WRONG_PARAM); }
+
+	if ( r->count >= NEC_REPEAT_MAX )
+		{ r->overflows++; return(EX_ERR); }
+
+	// 2) the message is copied once, repetitions are sent from that copy
+	nec_repeat_entry_t *e = NULL;
+	if ( ( e = (nec_repeat_entry_t *)malloc(sizeof(nec_repeat_entry_t) + m->len) )
+			== NULL )
+		{ handle_sys_error("nec_repeat_schedule: <malloc> returns NULL."); }
+
+	memset(e, 0, sizeof(nec_repeat_entry_t));
+	memcpy(e->data, m->buffer, m->len);
+	e->len = m->len;
+	e->addr = addr;
+	e->port = port;
+	e->btp_port = btp_port;
+	e->interval = interval;
+	e->tx_class = tx_class;
+
+	uint64_t now = __now_tick(r);
+	e->deadline = now + lifetime;
+
+	nec_repeat_entry_t **b = __bucket(r, addr, port, btp_port);
+	e->hnext = *b;
+	*b = e;
+
+	// 3) an idle wheel is moved to the current tick before adding timers
+	if ( r->wheel->count == 0 ) { r->wheel->now = now; }
+	timer_wheel_add(r->wheel, &e->node, now + interval);
+
+	r->count++;
+	r->scheduled++;
+
+	if ( ev_is_active(&r->timer) == false )
+		{ ev_timer_again(r->loop, &r->timer); }
+
+	return(EX_OK);
+
+}
+
+/* print_nec_repeat */
+void print_nec_repeat(const nec_repeat_t *r)
+{
+	log_app_msg(">>> NEC repetitions = \n{\n");
+	log_app_msg("\t.active = %d\n", r->count);
+	log_app_msg("\t.scheduled = %lu\n", r->scheduled);
+	log_app_msg("\t.repetitions = %lu\n", r->repetitions);
+	log_app_msg("\t.replaced = %lu\n", r->replaced);
+	log_app_msg("\t.expired = %lu\n", r->expired);
+	log_app_msg("\t.overflows = %lu\n", r->overflows);
+	log_app_msg("}\n");
+}
+
+/* cb_nec_repeat_timer */
+void cb_nec_repeat_timer(struct ev_loop *loop, ev_timer *watcher, int revents)
+{
+
+	nec_repeat_t *r = (nec_repeat_t *)watcher->data;
+
+	timer_wheel_advance(r->wheel, __now_tick(r), __expire, r);
+
+	// the tick timer only runs while there are messages to be repeated
+	if ( r->wheel->count == 0 ) { ev_timer_stop(loop, watcher); }
+
+}
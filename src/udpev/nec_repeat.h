@@ -0,0 +1,147 @@
+/**
+ * @file nec_repeat.h
+ * @author Ricardo Tubío (rtpardavila[at]gmail.com)
+ * @version 0.1
+ *
+ * @section LICENSE
+ *
+ * This file is part of udpip-broadcaster.
+ * udpip-broadcaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * udpip-broadcaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with udpip-broadcaster.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Repetition scheduler for NEC GN-BTP messages. Messages whose extended
+ * header carries a repetition_interval are re-broadcast by the daemon at
+ * that interval until their max_lifetime expires. Every message is copied
+ * once when it is scheduled and re-sent as is from that copy afterwards.
+ */
+
+#ifndef NEC_REPEAT_H_
+#define NEC_REPEAT_H_
+
+#include <stdint.h>
+#include <ev.h>
+
+#include "../execution_codes.h"
+#include "../logger.h"
+
+#include "udp_socket.h"
+#include "timer_wheel.h"
+#include "tx_scheduler.h"
+#include "__NEC__gnbtpapi_udp_msg.h"
+
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// DATA STRUCTURES
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+#define NEC_REPEAT_TICK_MS 5		/**< Granularity of the scheduler (ms). */
+#define NEC_REPEAT_MAX 65536		/**< Max. messages being repeated. */
+#define NEC_REPEAT_BUCKETS 4096		/**< Buckets of the table (power of 2). */
+
+/**
+ * @struct nec_repeat_entry
+ * @brief Message being repeated, allocated together with its copy.
+ */
+typedef struct nec_repeat_entry
+{
+
+	timer_wheel_node_t node;		/**< Timer for next rep. (MUST be 1st). */
+	struct nec_repeat_entry *hnext;	/**< Next entry in the same bucket. */
+
+	in_addr_t addr;					/**< Source address of the message. */
+	in_port_t port;					/**< Source port of the message. */
+	uint16_t btp_port;				/**< Destination BTP port. */
+
+	int tx_class;					/**< Traffic class for the repetitions. */
+	uint64_t deadline;				/**< Tick when its lifetime expires. */
+	uint64_t interval;				/**< Repetition interval (ticks). */
+	unsigned long repetitions;		/**< Number of repetitions sent. */
+
+	int len;						/**< Length of the message. */
+	char data[];					/**< Copy of the message. */
+
+} nec_repeat_entry_t;
+
+/**
+ * @struct nec_repeat
+ * @brief State of the repetition scheduler.
+ */
+typedef struct nec_repeat
+{
+
+	struct ev_loop *loop;			/**< Loop where the ticks are run. */
+	ev_timer timer;					/**< Tick timer, only while not empty. */
+	ev_tstamp origin;				/**< Time of tick #0. */
+
+	timer_wheel_t *wheel;			/**< Wheel with the next repetitions. */
+	nec_repeat_entry_t *buckets[NEC_REPEAT_BUCKETS];	/**< Entries. */
+	int count;						/**< Number of messages being repeated. */
+
+	tx_scheduler_t *tx_scheduler;	/**< Scheduler for the repetitions. */
+
+	unsigned long scheduled;		/**< Messages scheduled. */
+	unsigned long repetitions;		/**< Repetitions sent. */
+	unsigned long replaced;			/**< Messages replaced by newer ones. */
+	unsigned long expired;			/**< Messages whose lifetime expired. */
+	unsigned long overflows;		/**< Messages not scheduled, table full. */
+
+} nec_repeat_t;
+
+#define LEN__NEC_REPEAT sizeof(nec_repeat_t)
+
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// SCHEDULER MANAGEMENT
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+/**
+ * @brief Allocates memory for a nec_repeat structure.
+ * @return A pointer to the newly allocated block of memory.
+ */
+nec_repeat_t *new_nec_repeat();
+
+/**
+ * @brief Initializes a repetition scheduler.
+ * @param loop Event loop where the ticks are to be run.
+ * @param tx_scheduler Scheduler through which repetitions are sent.
+ * @return A pointer to the initialized structure.
+ */
+nec_repeat_t *init_nec_repeat(	struct ev_loop *loop,
+								tx_scheduler_t *tx_scheduler	);
+
+/**
+ * @brief Schedules the repetitions of a message just sent. A message from
+ * 			the same source for the same BTP port replaces the one being
+ * 			repeated; a message with repetition_interval = 0 just cancels it.
+ * @param r The scheduler.
+ * @param src Source address of the message.
+ * @param m View of a valid NEC TX message.
+ * @param tx_class Traffic class for the repetitions.
+ * @return EX_OK if repetitions were scheduled; otherwise < 0.
+ */
+int nec_repeat_schedule(nec_repeat_t *r
+						, const sockaddr_in_t *src, const __NEC__msg_t *m
+						, const int tx_class);
+
+/**
+ * @brief Prints the counters of the given scheduler.
+ * @param r The scheduler.
+ */
+void print_nec_repeat(const nec_repeat_t *r);
+
+/**
+ * @brief Callback function for the tick timer, <libev>.
+ */
+void cb_nec_repeat_timer(struct ev_loop *loop, ev_timer *watcher, int revents);
+
+#endif /* NEC_REPEAT_H_ */
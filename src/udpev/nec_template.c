@@ -0,0 +1,215 @@
+/**
+ * @file nec_template.c
+ * @author Ricardo Tubío (rtpardavila[at]gmail.com)
+ * @version 0.1
+ *
+ * @section LICENSE
+ *
+ * This file is part of udpip-broadcaster.
+ * udpip-broadcaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * udpip-broadcaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with udpip-broadcaster.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "nec_template.h"
+#include "hash.h"
+
+#define __MASK ( NEC_TEMPLATE_FLOWS - 1 )
+
+/* __hash */
+static inline unsigned int __hash(const in_addr_t addr, const in_port_t port)
+	{ return( hash_source(addr, port) & __MASK ); }
+
+/* __remove; backward shift deletion, no tombstones are left behind */
+static void __remove(nec_templates_t *t, unsigned int i)
+{
+
+	for ( unsigned int j = ( i + 1 ) & __MASK; t->flows[j].used == true;
+			j = ( j + 1 ) & __MASK )
+	{
+
+		unsigned int home = __hash(t->flows[j].addr, t->flows[j].port);
+		if ( ( ( j - home ) & __MASK ) < ( ( j - i ) & __MASK ) )
+			{ continue; }
+
+		t->flows[i] = t->flows[j];
+		i = j;
+
+	}
+
+	memset(&t->flows[i], 0, sizeof(nec_template_t));
+	t->count--;
+
+}
+
+/* __build_template */
+static void __build_template(const nec_templates_t *t, nec_template_t *tpl)
+{
+
+	uint8_t *h = tpl->header;
+	uint16_t port = ntohs(tpl->port);
+
+	memset(h, 0, LEN____NEC__GNBTPAPI_TSB_TX_HEADER);
+
+	h[__NEC__OFF_HEADER_TYPE] = __NEC__HT_TSB;
+	h[__NEC__OFF_HEADER_SUBTYPE] = ( t->hop_limit > 1 ) ?
+			__NEC__HST_TSB_MULTI_HOP : __NEC__HST_TSB_SINGLE_HOP;
+	h[__NEC__OFF_HOP_LIMIT] = t->hop_limit;
+	h[__NEC__OFF_TRAFFIC_CLASS] = t->traffic_class;
+
+	__NEC__wr16(h + __NEC__TSB_TX_DESTINATION_PORT, port);
+	__NEC__wr16(h + __NEC__TSB_TX_SOURCE_PORT, port);
+
+}
+
+/* new_nec_templates */
+nec_templates_t *new_nec_templates()
+{
+	nec_templates_t *s = NULL;
+	if ( ( s = (nec_templates_t *)malloc(LEN__NEC_TEMPLATES) ) == NULL )
+		{ handle_sys_error("new_nec_templates: <malloc> returns NULL."); }
+	if ( memset(s, 0, LEN__NEC_TEMPLATES) == NULL )
+		{ handle_sys_error("new_nec_templates: <memset> returns NULL."); }
+	return(s);
+}
+
+/* init_nec_templates */
+nec_templates_t *init_nec_templates(	struct ev_loop *loop,
+										const int hop_limit,
+										const int traffic_class	)
+{
+
+	if ( ( hop_limit < 1 ) || ( hop_limit > 0xFF ) )
+		{ handle_app_error("init_nec_templates: wrong hop_limit.\n"); }
+	if ( ( traffic_class < 0 ) || ( traffic_class > 0xFF ) )
+		{ handle_app_error("init_nec_templates: wrong traffic_class.\n"); }
+
+	nec_templates_t *s = new_nec_templates();
+	s->hop_limit = (uint8_t)hop_limit;
+	s->traffic_class = (uint8_t)traffic_class;
+	s->loop = loop;
+
+	ev_timer_init(&s->sweep, cb_nec_templates_sweep
+					, NEC_TEMPLATE_SWEEP, NEC_TEMPLATE_SWEEP);
+	ev_timer_start(loop, &s->sweep);
+
+	return(s);
+
+}
+
+/* nec_template_lookup */
+nec_template_t *nec_template_lookup(nec_templates_t *t
+									, const sockaddr_in_t *src)
+{
+
+	in_addr_t addr = src->sin_addr.s_addr;
+	in_port_t port = src->sin_port;
+	unsigned int i = __hash(addr, port);
+
+	// flows are never placed further than NEC_TEMPLATE_PROBES from their
+	//		home slot, and deletions shift them back, so the search stops
+	//		at the first free slot or after that many probes
+	for ( int probes = 0; probes < NEC_TEMPLATE_PROBES; probes++ )
+	{
+
+		nec_template_t *tpl = &t->flows[i];
+
+		if ( tpl->used == false )
+		{
+			if ( t->count >= NEC_TEMPLATE_MAX ) { break; }
+			tpl->used = true;
+			tpl->addr = addr;
+			tpl->port = port;
+			__build_template(t, tpl);
+			tpl->last_seen = ev_now(t->loop);
+			t->count++;
+			return(tpl);
+		}
+
+		if ( ( tpl->addr == addr ) && ( tpl->port == port ) )
+			{ tpl->last_seen = ev_now(t->loop); return(tpl); }
+
+		i = ( i + 1 ) & __MASK;
+
+	}
+
+	t->overflows++;
+	return(NULL);
+
+}
+
+/* nec_template_wrap */
+int nec_template_wrap(	nec_template_t *tpl,
+						const void *payload, const int len, iovec_t *iov	)
+{
+
+	if ( ( len < 0 ) || ( len > 0xFFFF ) ) { return(EX_WRONG_PARAM); }
+
+	// only the length of the payload changes from message to message
+	__NEC__wr16(tpl->header + __NEC__OFF_PAYLOAD_LENGTH, (uint16_t)len);
+
+	iov[0].iov_base = tpl->header;
+	iov[0].iov_len = LEN____NEC__GNBTPAPI_TSB_TX_HEADER;
+	iov[1].iov_base = (void *)payload;
+	iov[1].iov_len = len;
+
+	tpl->packets++;
+
+	return(EX_OK);
+
+}
+
+/* print_nec_templates */
+void print_nec_templates(const nec_templates_t *t)
+{
+
+	log_app_msg(">>> NEC templates (flows = %d, overflows = %lu" \
+					", evicted = %lu) = \n{\n"
+					, t->count, t->overflows, t->evicted);
+
+	for ( int i = 0; i < NEC_TEMPLATE_FLOWS; i++ )
+	{
+		const nec_template_t *tpl = &t->flows[i];
+		if ( tpl->used == false ) { continue; }
+
+		struct in_addr addr = { .s_addr = tpl->addr };
+		log_app_msg("\t* %s:%d, packets = %lu\n"
+					, inet_ntoa(addr)
+					, ntohs(tpl->port), tpl->packets);
+	}
+
+	log_app_msg("}\n");
+
+}
+
+/* cb_nec_templates_sweep */
+void cb_nec_templates_sweep(	struct ev_loop *loop, ev_timer *watcher,
+								int revents	)
+{
+
+	nec_templates_t *t = (nec_templates_t *)watcher;
+	ev_tstamp now = ev_now(loop);
+
+	// backward shifts may move a flow into the slot just visited, so that
+	//		slot is visited again
+	for ( int i = 0; i < NEC_TEMPLATE_FLOWS; i++ )
+	{
+		nec_template_t *tpl = &t->flows[i];
+		if ( ( tpl->used == false ) ||
+				( now - tpl->last_seen <= NEC_TEMPLATE_IDLE ) )
+			{ continue; }
+		__remove(t, i);
+		t->evicted++;
+		i--;
+	}
+
+}
@@ -0,0 +1,148 @@
+/**
+ * @file nec_template.h
+ * @author Ricardo Tubío (rtpardavila[at]gmail.com)
+ * @version 0.1
+ *
+ * @section LICENSE
+ *
+ * This file is part of udpip-broadcaster.
+ * udpip-broadcaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * udpip-broadcaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with udpip-broadcaster.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Per-flow NEC GN-BTP TX header templates. Raw payloads from applications
+ * are wrapped by sending the precomputed header of their flow and the
+ * payload as two separate iovecs, so payload bytes are never copied.
+ */
+
+#ifndef NEC_TEMPLATE_H_
+#define NEC_TEMPLATE_H_
+
+#include <stdint.h>
+#include <ev.h>
+
+#include "../execution_codes.h"
+#include "../logger.h"
+
+#include "udp_socket.h"
+#include "__NEC__gnbtpapi_udp_msg.h"
+
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// DATA STRUCTURES
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+#define NEC_TEMPLATE_FLOWS 256		/**< Slots of the table (power of 2). */
+#define NEC_TEMPLATE_MAX 192		/**< Max. flows (75% load). */
+#define NEC_TEMPLATE_PROBES 16		/**< Max. distance to the home slot. */
+#define NEC_TEMPLATE_IDLE 60.0		/**< Idle time before eviction (secs). */
+#define NEC_TEMPLATE_SWEEP 5.0		/**< Period of the idle sweep (secs). */
+
+/**
+ * @struct nec_template
+ * @brief Precomputed TX header for the messages of a given flow.
+ */
+typedef struct nec_template
+{
+
+	bool used;						/**< Flag that indicates slot in use. */
+	in_addr_t addr;					/**< Source address of the flow. */
+	in_port_t port;					/**< Source port of the flow. */
+
+	uint8_t header[LEN____NEC__GNBTPAPI_TSB_TX_HEADER];	/**< Template. */
+
+	unsigned long packets;			/**< Messages wrapped with this template.*/
+	ev_tstamp last_seen;			/**< Last message wrapped. */
+
+} nec_template_t;
+
+/**
+ * @struct nec_templates
+ * @brief Table with the templates of all the flows.
+ */
+typedef struct nec_templates
+{
+
+	ev_timer sweep;					/**< Idle sweep timer (MUST be 1st). */
+	struct ev_loop *loop;			/**< Loop where the timer is run. */
+
+	nec_template_t flows[NEC_TEMPLATE_FLOWS];	/**< Open addressing table. */
+	int count;						/**< Number of flows in the table. */
+
+	uint8_t hop_limit;				/**< hop_limit for new templates. */
+	uint8_t traffic_class;			/**< traffic_class for new templates. */
+
+	unsigned long overflows;		/**< Messages of flows not in table. */
+	unsigned long evicted;			/**< Flows evicted for being idle. */
+
+} nec_templates_t;
+
+#define LEN__NEC_TEMPLATES sizeof(nec_templates_t)
+
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// TEMPLATES MANAGEMENT
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+/**
+ * @brief Allocates memory for a nec_templates structure.
+ * @return A pointer to the newly allocated block of memory.
+ */
+nec_templates_t *new_nec_templates();
+
+/**
+ * @brief Initializes an empty table of templates and starts its idle sweep.
+ * @param loop Event loop where the sweep timer is to be run.
+ * @param hop_limit Value for the hop_limit field of the templates.
+ * @param traffic_class Value for the traffic_class field of the templates.
+ * @return A pointer to the initialized structure.
+ */
+nec_templates_t *init_nec_templates(	struct ev_loop *loop,
+										const int hop_limit,
+										const int traffic_class	);
+
+/**
+ * @brief Gets the template for the flow of the given source address,
+ * 			creating it the first time that the flow is seen.
+ * @param t Table of templates.
+ * @param src Source address of the flow.
+ * @return Template of the flow, NULL if the table is full (or the flow
+ * 			would be too far from its home slot).
+ */
+nec_template_t *nec_template_lookup(nec_templates_t *t
+									, const sockaddr_in_t *src);
+
+/**
+ * @brief Wraps the given payload with the template, without copying the
+ * 			payload: iov[0] points to the header and iov[1] to the payload.
+ * @param tpl Template of the flow.
+ * @param payload Payload of the message.
+ * @param len Length of the payload.
+ * @param iov Array with (at least) 2 buffers to be filled in.
+ * @return EX_OK if the message was wrapped; otherwise, < 0.
+ */
+int nec_template_wrap(	nec_template_t *tpl,
+						const void *payload, const int len, iovec_t *iov	);
+
+/**
+ * @brief Prints the flows of the given table.
+ * @param t Table of templates.
+ */
+void print_nec_templates(const nec_templates_t *t);
+
+/**
+ * @brief Callback that evicts the templates idle for too long.
+ */
+void cb_nec_templates_sweep(	struct ev_loop *loop, ev_timer *watcher,
+								int revents	);
+
+#endif /* NEC_TEMPLATE_H_ */
@@ -0,0 +1,71 @@
+/**
+ * @file probes.h
+ * @author Ricardo Tubío (rtpardavila[at]gmail.com)
+ * @version 0.1
+ *
+ * @section LICENSE
+ *
+ * This file is part of udpip-broadcaster.
+ * udpip-broadcaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * udpip-broadcaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with udpip-broadcaster.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * USDT static tracepoints (provider "udpipbroadcaster") on the forwarding
+ * path, for bpftrace, perf or systemtap. With <sys/sdt.h> every probe is a
+ * single nop plus an ELF note that describes where its arguments live, so a
+ * probe costs nothing while no tracer is attached. Without that header (or
+ * when built with -DUDPIP_NO_PROBES) the probes are compiled out.
+ *
+ *   wakeup(fd, revents, now_ns)              loop wakeup for a socket
+ *   done(fd)                                 that wakeup was handled
+ *   rx(fd, len, src_addr, src_port, rx_ns)   message received
+ *   blocked(fd, len, src_addr)               self-originated message
+ *   tx(fd, len, dst_addr, dst_port)          message sent, sendmsg returned
+ *   tx_error(fd, len, errno)                 message not sent
+ *
+ * Addresses and ports are in network byte order and times in ns: rx_ns is
+ * the kernel RX timestamp (CLOCK_REALTIME, 0 if none), now_ns the loop time.
+ */
+
+#ifndef PROBES_H_
+#define PROBES_H_
+
+#if !defined(UDPIP_NO_PROBES) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define UDPIP_PROBES 1
+#endif
+#endif
+
+#ifdef UDPIP_PROBES
+
+#define UDPIP_PROBE1(name, a1) \
+			DTRACE_PROBE1(udpipbroadcaster, name, a1)
+#define UDPIP_PROBE3(name, a1, a2, a3) \
+			DTRACE_PROBE3(udpipbroadcaster, name, a1, a2, a3)
+#define UDPIP_PROBE4(name, a1, a2, a3, a4) \
+			DTRACE_PROBE4(udpipbroadcaster, name, a1, a2, a3, a4)
+#define UDPIP_PROBE5(name, a1, a2, a3, a4, a5) \
+			DTRACE_PROBE5(udpipbroadcaster, name, a1, a2, a3, a4, a5)
+
+#else
+
+#define UDPIP_PROBE1(name, a1) do { } while (0)
+#define UDPIP_PROBE3(name, a1, a2, a3) do { } while (0)
+#define UDPIP_PROBE4(name, a1, a2, a3, a4) do { } while (0)
+#define UDPIP_PROBE5(name, a1, a2, a3, a4, a5) do { } while (0)
+
+#endif
+
+#endif /* PROBES_H_ */
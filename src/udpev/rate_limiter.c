@@ -0,0 +1,477 @@
+/**
+ * @file nec_repeat.c
+ * @author Ricardo Tubío (rtpardavila[at]gmail.com)
+ * @version 0.1
+ *
+ * @section LICENSE
+ *
+ * This file is part of udpip-broadcaster.
+ * udpip-broadcaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * udpip-broadcaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with udpip-broadcaster.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "rate_limiter.h"
+#include "hash.h"
+
+#define __MASK ( RATE_LIMITER_DEFERRED - 1 )
+
+/**< Names of the policies. */
+static const char *__policies[] = { "drop", "queue", "downgrade" };
+
+#define __SLOTS ( RATE_LIMITER_SOURCES - 1 )
+
+/* __hash */
+static inline unsigned int __hash(const in_addr_t addr, const in_port_t port)
+	{ return( hash_source(addr, port) & __SLOTS ); }
+
+/* __now_ns */
+static inline uint64_t __now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return( (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec );
+}
+
+/* __refill; tokens are only computed when the bucket is used */
+static inline void __refill(rate_bucket_t *b, const uint64_t now)
+{
+
+	uint64_t full = (uint64_t)b->burst * RATE_LIMITER_NS;
+	uint64_t elapsed = now - b->last;
+
+	b->last = now;
+
+	// long idle periods fill the bucket, this also avoids overflows
+	if ( elapsed >= (uint64_t)b->burst * 1000000000ULL / b->rate )
+		{ b->tokens = full; return; }
+
+	b->tokens += elapsed * b->rate;
+	if ( b->tokens > full ) { b->tokens = full; }
+
+}
+
+/* __take */
+static inline bool __take(rate_bucket_t *b, const uint64_t now)
+{
+	__refill(b, now);
+	if ( b->tokens < RATE_LIMITER_NS ) { return(false); }
+	b->tokens -= RATE_LIMITER_NS;
+	return(true);
+}
+
+/* __wait; time (s) until the bucket gets its next token */
+static inline ev_tstamp __wait(const rate_bucket_t *b)
+{
+	if ( b->tokens >= RATE_LIMITER_NS ) { return(0); }
+	return( (double)( RATE_LIMITER_NS - b->tokens ) / b->rate / 1e9 );
+}
+
+/* __idle; buckets full for longer than burst / rate are not needed */
+static inline bool __idle(const rate_bucket_t *b, const uint64_t now)
+{
+
+	if ( b->pending > 0 ) { return(false); }
+	if ( b->rate == 0 ) { return(true); }
+
+	uint64_t full = (uint64_t)b->burst * RATE_LIMITER_NS;
+	uint64_t fill = (uint64_t)b->burst * 1000000000ULL / b->rate;
+	uint64_t full_at = b->last + ( full - b->tokens ) / b->rate;
+
+	return( now > full_at + fill );
+
+}
+
+/* __remove; backward shift deletion, deferred messages follow their bucket */
+static void __remove(rate_limiter_t *rl, unsigned int i)
+{
+
+	for ( unsigned int j = ( i + 1 ) & __SLOTS; rl->buckets[j].used == true;
+			j = ( j + 1 ) & __SLOTS )
+	{
+
+		unsigned int home = __hash(rl->buckets[j].addr, rl->buckets[j].port);
+		if ( ( ( j - home ) & __SLOTS ) < ( ( j - i ) & __SLOTS ) )
+			{ continue; }
+
+		rl->buckets[i] = rl->buckets[j];
+		if ( rl->buckets[i].pending > 0 )
+		{
+			for ( unsigned int k = rl->head; k != rl->tail; k++ )
+			{
+				rate_deferred_t *d = &rl->deferred[k & __MASK];
+				if ( d->bucket == &rl->buckets[j] )
+					{ d->bucket = &rl->buckets[i]; }
+			}
+		}
+		i = j;
+
+	}
+
+	memset(&rl->buckets[i], 0, sizeof(rate_bucket_t));
+	rl->count--;
+
+}
+
+/* __shared_limit; the default one or, without it, the strictest rule */
+static void __shared_limit(rate_limiter_t *rl)
+{
+
+	rate_bucket_t *b = &rl->shared;
+
+	b->rate = rl->rate;
+	b->burst = rl->burst;
+
+	for ( int r = 0; ( rl->rate == 0 ) && ( r < rl->no_rules ); r++ )
+	{
+		if ( rl->rules[r].rate == 0 ) { continue; }
+		if ( ( b->rate == 0 ) || ( rl->rules[r].rate < b->rate ) )
+		{
+			b->rate = rl->rules[r].rate;
+			b->burst = rl->rules[r].burst;
+		}
+	}
+
+	b->tokens = (uint64_t)b->burst * RATE_LIMITER_NS;
+	b->last = __now_ns();
+
+}
+
+/* __defer */
+static int __defer(	rate_limiter_t *rl, rate_bucket_t *b, const int tx_class,
+					const iovec_t *iov, const int iovlen,
+					const uint32_t lifetime, const uint64_t rx_ns	)
+{
+
+	if ( rl->tail - rl->head >= RATE_LIMITER_DEFERRED )
+		{ rl->deferred_overflows++; b->dropped++; return(EX_ERR); }
+
+	rate_deferred_t *d = &rl->deferred[rl->tail & __MASK];
+	ev_tstamp now = ev_now(rl->loop);
+
+	d->len = 0;
+	for ( int i = 0; i < iovlen; i++ ) { d->len += iov[i].iov_len; }
+
+	if ( ( d->data = (char *)malloc(d->len) ) == NULL )
+		{ handle_sys_error("rate_limiter: <malloc> returns NULL."); }
+
+	for ( int i = 0, off = 0; i < iovlen; off += iov[i].iov_len, i++ )
+		{ memcpy(d->data + off, iov[i].iov_base, iov[i].iov_len); }
+
+	d->bucket = b;
+	d->tx_class = tx_class;
+	d->deadline = ( lifetime > 0 ) ? now + lifetime / 1000.0 : 0;
+	d->rx_ns = rx_ns;
+
+	rl->tail++;
+	b->pending++;
+	b->deferred++;
+
+	if ( ev_is_active(&rl->timer) == false )
+	{
+		ev_timer_set(&rl->timer, __wait(b), 0);
+		ev_timer_start(rl->loop, &rl->timer);
+	}
+
+	return(0);
+
+}
+
+/* new_rate_limiter */
+rate_limiter_t *new_rate_limiter()
+{
+	rate_limiter_t *s = NULL;
+	if ( ( s = (rate_limiter_t *)malloc(LEN__RATE_LIMITER) ) == NULL )
+		{ handle_sys_error("new_rate_limiter: <malloc> returns NULL."); }
+	if ( memset(s, 0, LEN__RATE_LIMITER) == NULL )
+		{ handle_sys_error("new_rate_limiter: <memset> returns NULL."); }
+	return(s);
+}
+
+/* init_rate_limiter */
+rate_limiter_t *init_rate_limiter(	struct ev_loop *loop,
+									tx_scheduler_t *tx_scheduler,
+									const uint32_t rate, const uint32_t burst,
+									const rate_policy_t policy	)
+{
+
+	rate_limiter_t *s = new_rate_limiter();
+
+	s->loop = loop;
+	s->tx_scheduler = tx_scheduler;
+	s->rate = rate;
+	s->burst = ( burst > 0 ) ? burst : rate;
+	s->policy = policy;
+
+	ev_timer_init(&s->timer, cb_rate_limiter_timer, 0, 0);
+	s->timer.data = s;
+
+	ev_timer_init(&s->sweep, cb_rate_limiter_sweep
+					, RATE_LIMITER_SWEEP, RATE_LIMITER_SWEEP);
+	s->sweep.data = s;
+	ev_timer_start(loop, &s->sweep);
+
+	s->shared.used = true;
+	__shared_limit(s);
+
+	return(s);
+
+}
+
+/* rate_limiter_set_limit */
+int rate_limiter_set_limit(	rate_limiter_t *rl, const int port,
+							const uint32_t rate, const uint32_t burst	)
+{
+
+	rate_rule_t *r = NULL;
+
+	for ( int i = 0; ( i < rl->no_rules ) && ( r == NULL ); i++ )
+		{ if ( rl->rules[i].port == port ) { r = &rl->rules[i]; } }
+
+	if ( r == NULL )
+	{
+		if ( rl->no_rules >= RATE_LIMITER_MAX_RULES )
+		{
+			log_app_msg("rate_limiter_set_limit: too many rules, max = %d.\n"
+							, RATE_LIMITER_MAX_RULES);
+			return(EX_ERR);
+		}
+		r = &rl->rules[rl->no_rules++];
+	}
+
+	r->port = port;
+	r->rate = rate;
+	r->burst = ( burst > 0 ) ? burst : rate;
+	__shared_limit(rl);
+
+	return(EX_OK);
+
+}
+
+/* rate_limiter_lookup */
+rate_bucket_t *rate_limiter_lookup(rate_limiter_t *rl
+									, const sockaddr_in_t *src)
+{
+
+	in_addr_t addr = src->sin_addr.s_addr;
+	in_port_t port = src->sin_port;
+	unsigned int i = __hash(addr, port);
+
+	// buckets are never placed further than RATE_LIMITER_PROBES from their
+	//		home slot, and deletions shift them back, so the search stops
+	//		at the first free slot or after that many probes
+	for ( int probes = 0; probes < RATE_LIMITER_PROBES; probes++ )
+	{
+
+		rate_bucket_t *b = &rl->buckets[i];
+
+		if ( b->used == false )
+		{
+
+			if ( rl->count >= RATE_LIMITER_MAX ) { break; }
+
+			b->used = true;
+			b->addr = addr;
+			b->port = port;
+			b->rate = rl->rate;
+			b->burst = rl->burst;
+
+			for ( int r = 0; r < rl->no_rules; r++ )
+			{
+				if ( rl->rules[r].port != ntohs(port) ) { continue; }
+				b->rate = rl->rules[r].rate;
+				b->burst = rl->rules[r].burst;
+			}
+
+			// new sources start with a full bucket
+			b->tokens = (uint64_t)b->burst * RATE_LIMITER_NS;
+			b->last = __now_ns();
+			rl->count++;
+
+			return(b);
+
+		}
+
+		if ( ( b->addr == addr ) && ( b->port == port ) ) { return(b); }
+
+		i = ( i + 1 ) & __SLOTS;
+
+	}
+
+	rl->overflows++;
+	return(&rl->shared);
+
+}
+
+/* rate_limiter_send */
+int rate_limiter_send(	rate_limiter_t *rl, const sockaddr_in_t *src,
+						const int tx_class,
+						const iovec_t *iov, const int iovlen,
+						const uint32_t lifetime, const uint64_t rx_ns	)
+{
+
+	rate_bucket_t *b = rate_limiter_lookup(rl, src);
+
+	// 1) sources without a limit just go by
+	if ( b->rate == 0 )
+		{ return(tx_scheduler_send(rl->tx_scheduler, tx_class
+									, iov, iovlen, lifetime, rx_ns)); }
+
+	// 2) messages never overtake the deferred ones of their source
+	if ( ( b->pending == 0 ) && ( __take(b, __now_ns()) == true ) )
+	{
+		b->admitted++;
+		return(tx_scheduler_send(rl->tx_scheduler, tx_class
+									, iov, iovlen, lifetime, rx_ns));
+	}
+
+	// 3) over the limit
+	switch ( rl->policy )
+	{
+		case RATE_POLICY_QUEUE:
+
+			return(__defer(rl, b, tx_class, iov, iovlen, lifetime, rx_ns));
+
+		case RATE_POLICY_DOWNGRADE:
+
+			b->downgraded++;
+			return(tx_scheduler_send(rl->tx_scheduler, TX_SCHED_CLASSES - 1
+										, iov, iovlen, lifetime, rx_ns));
+
+		default:
+
+			b->dropped++;
+			return(EX_ERR);
+	}
+
+}
+
+/* rate_policy_parse */
+int rate_policy_parse(const char *name)
+{
+	for ( int i = RATE_POLICY_DROP; i <= RATE_POLICY_DOWNGRADE; i++ )
+		{ if ( strcmp(name, __policies[i]) == 0 ) { return(i); } }
+	return(EX_WRONG_PARAM);
+}
+
+/* print_rate_limiter */
+void print_rate_limiter(const rate_limiter_t *rl)
+{
+
+	log_app_msg(">>> Rate limiter (rate = %u/s, burst = %u, policy = %s) = \n{\n"
+					, rl->rate, rl->burst, __policies[rl->policy]);
+
+	for ( int i = 0; i < rl->no_rules; i++ )
+		{ log_app_msg("\t* limit[port=%d] = { rate = %u/s, burst = %u }\n"
+						, rl->rules[i].port, rl->rules[i].rate
+						, rl->rules[i].burst); }
+
+	log_app_msg("\t.sources = %d\n", rl->count);
+	log_app_msg("\t.overflows = %lu (shared = { rate = %u/s, burst = %u })\n"
+					, rl->overflows, rl->shared.rate, rl->shared.burst);
+	log_app_msg("\t.evicted = %lu\n", rl->evicted);
+	log_app_msg("\t.deferred = %u\n", rl->tail - rl->head);
+	log_app_msg("\t.deferred_overflows = %lu\n", rl->deferred_overflows);
+	log_app_msg("\t.deferred_expired = %lu\n", rl->deferred_expired);
+
+	for ( int i = 0; i < RATE_LIMITER_SOURCES; i++ )
+	{
+
+		const rate_bucket_t *b = &rl->buckets[i];
+		if ( b->used == false ) { continue; }
+
+		log_app_msg("\t* source[%s:%d] = { admitted = %lu, dropped = %lu"
+						", deferred = %lu, downgraded = %lu }\n"
+						, inet_ntoa(*(struct in_addr *)&b->addr)
+						, ntohs(b->port), b->admitted, b->dropped
+						, b->deferred, b->downgraded);
+
+	}
+
+	log_app_msg("}\n");
+
+}
+
+/* cb_rate_limiter_timer */
+void cb_rate_limiter_timer(struct ev_loop *loop, ev_timer *watcher, int revents)
+{
+
+	rate_limiter_t *rl = (rate_limiter_t *)watcher->data;
+	ev_tstamp now = ev_now(loop), next = -1;
+	uint64_t now_ns = __now_ns();
+
+	// 1) every source releases, in order, as many messages as tokens it has;
+	//		sources that wait do not block the rest
+	for ( unsigned int i = rl->head; i != rl->tail; i++ )
+	{
+
+		rate_deferred_t *d = &rl->deferred[i & __MASK];
+		rate_bucket_t *b = d->bucket;
+
+		if ( d->data == NULL ) { continue; }
+
+		if ( ( d->deadline > 0 ) && ( now >= d->deadline ) )
+			{ rl->deferred_expired++; b->dropped++; }
+		else if ( __take(b, now_ns) == true )
+		{
+			b->admitted++;
+			iovec_t iov = { .iov_base = d->data, .iov_len = d->len };
+			tx_scheduler_send(rl->tx_scheduler, d->tx_class, &iov, 1
+								, ( d->deadline > 0 ) ?
+									(uint32_t)( 1000 * ( d->deadline - now ) )
+										+ 1 : 0, d->rx_ns);
+		}
+		else
+		{
+			ev_tstamp wait = __wait(b);
+			if ( ( next < 0 ) || ( wait < next ) ) { next = wait; }
+			continue;
+		}
+
+		free(d->data);
+		d->data = NULL;
+		b->pending--;
+
+	}
+
+	while ( ( rl->head != rl->tail )
+			&& ( rl->deferred[rl->head & __MASK].data == NULL ) )
+		{ rl->head++; }
+
+	// 2) the timer is armed again for the source that gets a token first
+	if ( next >= 0 )
+	{
+		ev_timer_set(watcher, next, 0);
+		ev_timer_start(loop, watcher);
+	}
+
+}
+
+/* cb_rate_limiter_sweep */
+void cb_rate_limiter_sweep(struct ev_loop *loop, ev_timer *watcher, int revents)
+{
+
+	rate_limiter_t *rl = (rate_limiter_t *)watcher->data;
+	uint64_t now = __now_ns();
+
+	// backward shifts may move a bucket into the slot just visited, so that
+	//		slot is visited again
+	for ( int i = 0; i < RATE_LIMITER_SOURCES; i++ )
+	{
+		rate_bucket_t *b = &rl->buckets[i];
+		if ( ( b->used == false ) || ( __idle(b, now) == false ) ) { continue; }
+		__remove(rl, i);
+		rl->evicted++;
+		i--;
+	}
+
+}
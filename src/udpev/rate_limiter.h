@@ -0,0 +1,231 @@
+/**
+ * @file rate_limiter.h
+ * @author Ricardo Tubío (rtpardavila[at]gmail.com)
+ * @version 0.1
+ *
+ * @section LICENSE
+ *
+ * This file is part of udpip-broadcaster.
+ * udpip-broadcaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * udpip-broadcaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with udpip-broadcaster.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Per source token bucket rate limiter for the broadcast transmission path.
+ * Buckets are kept in an open addressing table keyed by the address and
+ * port of the applications; tokens are refilled lazily from a monotonic
+ * clock whenever a bucket is used, no timers are needed per bucket.
+ */
+
+#ifndef RATE_LIMITER_H_
+#define RATE_LIMITER_H_
+
+#include <stdint.h>
+#include <time.h>
+#include <ev.h>
+
+#include "../execution_codes.h"
+#include "../logger.h"
+
+#include "udp_socket.h"
+#include "tx_scheduler.h"
+
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// DATA STRUCTURES
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+#define RATE_LIMITER_SOURCES 1024	/**< Slots of the table (power of 2). */
+#define RATE_LIMITER_MAX 768		/**< Max. sources (75% load). */
+#define RATE_LIMITER_PROBES 16		/**< Max. distance to the home slot. */
+#define RATE_LIMITER_SWEEP 5.0		/**< Period of the idle sweep (secs). */
+#define RATE_LIMITER_DEFERRED 256	/**< Max. deferred msgs (power of 2). */
+#define RATE_LIMITER_MAX_RULES 32	/**< Max. number of per port limits. */
+#define RATE_LIMITER_NS 1000000000ULL	/**< Nano-tokens per token. */
+
+/**
+ * @enum rate_policy_t
+ * @brief What is done with the messages over the limit of their source.
+ */
+typedef enum
+{
+	RATE_POLICY_DROP = 0,			/**< Messages are dropped. */
+	RATE_POLICY_QUEUE = 1,			/**< Messages wait for a token. */
+	RATE_POLICY_DOWNGRADE = 2		/**< Messages sent with the lowest class.*/
+} rate_policy_t;
+
+/**
+ * @struct rate_bucket
+ * @brief Token bucket of a source.
+ */
+typedef struct rate_bucket
+{
+
+	bool used;						/**< Flag that indicates slot in use. */
+	in_addr_t addr;					/**< Source address. */
+	in_port_t port;					/**< Source port. */
+
+	uint32_t rate;					/**< Tokens per second (0: no limit). */
+	uint32_t burst;					/**< Max. tokens in the bucket. */
+	uint64_t tokens;				/**< Tokens available (nano-tokens). */
+	uint64_t last;					/**< Time of the last refill (ns). */
+	int pending;					/**< Messages deferred, waiting. */
+
+	unsigned long admitted;			/**< Messages within the limit. */
+	unsigned long dropped;			/**< Messages dropped. */
+	unsigned long deferred;			/**< Messages that waited for a token. */
+	unsigned long downgraded;		/**< Messages sent with lowest class. */
+
+} rate_bucket_t;
+
+/**
+ * @struct rate_deferred
+ * @brief Message over the limit that waits for a token.
+ */
+typedef struct rate_deferred
+{
+	rate_bucket_t *bucket;			/**< Bucket of its source. */
+	int tx_class;					/**< Traffic class of the message. */
+	ev_tstamp deadline;				/**< Time when it expires (0: never). */
+	uint64_t rx_ns;					/**< Kernel RX time (ns, 0: unknown). */
+	char *data;						/**< Copy of the message (NULL: freed).*/
+	int len;						/**< Length of the message. */
+} rate_deferred_t;
+
+/**
+ * @struct rate_rule
+ * @brief Limit for the sources with a given port.
+ */
+typedef struct rate_rule
+{
+	int port;						/**< Source port of the application. */
+	uint32_t rate;					/**< Tokens per second (0: no limit). */
+	uint32_t burst;					/**< Max. tokens in the bucket. */
+} rate_rule_t;
+
+/**
+ * @struct rate_limiter
+ * @brief Table with the buckets of all the sources.
+ */
+typedef struct rate_limiter
+{
+
+	rate_bucket_t buckets[RATE_LIMITER_SOURCES];	/**< Open addressing. */
+	int count;						/**< Number of sources in the table. */
+	unsigned long overflows;		/**< Messages from sources not in table.*/
+	unsigned long evicted;			/**< Sources evicted for being idle. */
+	rate_bucket_t shared;			/**< Bucket of sources not in table. */
+
+	uint32_t rate;					/**< Default rate (0: no limit). */
+	uint32_t burst;					/**< Default burst. */
+	rate_rule_t rules[RATE_LIMITER_MAX_RULES];	/**< Per port limits. */
+	int no_rules;					/**< Number of per port limits. */
+	rate_policy_t policy;			/**< Policy for messages over the limit. */
+
+	tx_scheduler_t *tx_scheduler;	/**< Where admitted messages are sent. */
+
+	struct ev_loop *loop;			/**< Loop for the deferred messages. */
+	ev_timer timer;					/**< Fires when the 1st gets a token. */
+	ev_timer sweep;					/**< Evicts the idle sources. */
+	rate_deferred_t deferred[RATE_LIMITER_DEFERRED];	/**< FIFO ring. */
+	unsigned int head;				/**< Index of the oldest deferred. */
+	unsigned int tail;				/**< Index of the next free entry. */
+	unsigned long deferred_overflows;	/**< Dropped, no room for waiting. */
+	unsigned long deferred_expired;	/**< Expired while waiting. */
+
+} rate_limiter_t;
+
+#define LEN__RATE_LIMITER sizeof(rate_limiter_t)
+
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// RATE LIMITER MANAGEMENT
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+/**
+ * @brief Allocates memory for a rate_limiter structure.
+ * @return A pointer to the newly allocated block of memory.
+ */
+rate_limiter_t *new_rate_limiter();
+
+/**
+ * @brief Initializes a rate limiter.
+ * @param loop Event loop where deferred messages are released.
+ * @param tx_scheduler Scheduler where admitted messages are sent.
+ * @param rate Default rate, messages per second (0: no limit).
+ * @param burst Default burst, messages (0: same as the rate).
+ * @param policy Policy for the messages over the limit.
+ * @return A pointer to the initialized structure.
+ */
+rate_limiter_t *init_rate_limiter(	struct ev_loop *loop,
+									tx_scheduler_t *tx_scheduler,
+									const uint32_t rate, const uint32_t burst,
+									const rate_policy_t policy	);
+
+/**
+ * @brief Sets the limit for the sources with the given port, it applies to
+ * 			the sources that have not sent any message yet.
+ * @return EX_OK if the limit was set; otherwise, < 0.
+ */
+int rate_limiter_set_limit(	rate_limiter_t *rl, const int port,
+							const uint32_t rate, const uint32_t burst	);
+
+/**
+ * @brief Gets the bucket of the given source, it is created if not found.
+ * 			Sources that do not fit in the table (or that would be too far
+ * 			from their home slot) share a single bucket, so that they are
+ * 			still limited.
+ * @return The bucket of the source, or the shared one.
+ */
+rate_bucket_t *rate_limiter_lookup(rate_limiter_t *rl
+									, const sockaddr_in_t *src);
+
+/**
+ * @brief Sends a message through the scheduler if its source has a token
+ * 			left; otherwise, the policy is applied.
+ * @param rl The rate limiter.
+ * @param src Source address of the message.
+ * @param tx_class Traffic class of the message.
+ * @param iov Array with the buffers of the message.
+ * @param iovlen Number of buffers in the array.
+ * @param lifetime Time that the message stays valid (ms, 0: no deadline).
+ * @param rx_ns Kernel RX time of the message (ns, 0: unknown).
+ * @return Number of bytes sent, 0 if queued or deferred; < 0 if dropped.
+ */
+int rate_limiter_send(	rate_limiter_t *rl, const sockaddr_in_t *src,
+						const int tx_class,
+						const iovec_t *iov, const int iovlen,
+						const uint32_t lifetime, const uint64_t rx_ns	);
+
+/**
+ * @brief Parses the name of a policy (drop, queue or downgrade).
+ * @return The policy; < 0 if the name is not valid.
+ */
+int rate_policy_parse(const char *name);
+
+/**
+ * @brief Prints the configuration and the per source counters.
+ * @param rl The rate limiter.
+ */
+void print_rate_limiter(const rate_limiter_t *rl);
+
+/**
+ * @brief Callback function for releasing deferred messages, <libev>.
+ */
+void cb_rate_limiter_timer(struct ev_loop *loop, ev_timer *watcher, int revents);
+
+/**
+ * @brief Callback that evicts the sources whose bucket has been full for
+ * 			longer than it takes to fill it (burst / rate), <libev>.
+ */
+void cb_rate_limiter_sweep(struct ev_loop *loop, ev_timer *watcher, int revents);
+
+#endif /* RATE_LIMITER_H_ */
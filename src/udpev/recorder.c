@@ -0,0 +1,260 @@
+/**
+ * @file recorder.c
+ * @author Ricardo Tubío (rtpardavila[at]gmail.com)
+ * @version 0.1
+ *
+ * @section LICENSE
+ *
+ * This file is part of udpip-broadcaster.
+ * udpip-broadcaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * udpip-broadcaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with udpip-broadcaster.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "recorder.h"
+#include "control.h"
+
+static const char *__verdicts[RECORDER_VERDICTS] =
+{
+	"pending", "forwarded", "blocked", "denied",
+	"filtered", "malformed", "dropped", "error"
+};
+
+static const char *__directions[] = { "net", "app" };
+
+/**
+ * @struct __dump_job
+ * @brief Snapshot of the ring, written by a background thread.
+ */
+typedef struct __dump_job
+{
+	recorder_slot_t *slots;			/**< Copy of the ring. */
+	uint32_t no_slots;				/**< Slots of the ring. */
+	uint32_t next;					/**< Oldest slot. */
+	char path[RECORDER_PATH_LEN];	/**< File to be written. */
+} __dump_job_t;
+
+/* __write; text dump of a ring, oldest message first */
+static int __write(	const recorder_slot_t *slots, const uint32_t no_slots,
+					const uint32_t next, const char *path	)
+{
+
+	FILE *f = NULL;
+	char prefix[2 * RECORDER_PREFIX + 1];
+	char addr[INET_ADDRSTRLEN];
+	int written = 0;
+
+	if ( ( f = fopen(path, "w") ) == NULL )
+	{
+		log_sys_error("recorder: <fopen> cannot create %s.\n", path);
+		return(EX_ERR);
+	}
+
+	fprintf(f, "# udpipbroadcaster flight recorder, pid %d\n" \
+				"# at_ns seq direction source len verdict prefix\n"
+				, (int)getpid());
+
+	for ( uint32_t k = 0; k < no_slots; k++ )
+	{
+
+		const recorder_slot_t *s = &slots[( next + k ) % no_slots];
+		if ( s->seq == 0 ) { continue; }
+
+		struct in_addr in;
+		in.s_addr = s->src_addr;
+		inet_ntop(AF_INET, &in, addr, sizeof(addr));
+
+		int n = hex_encode(prefix, s->prefix, ( s->len < RECORDER_PREFIX ) ?
+												s->len : RECORDER_PREFIX, '\0');
+		prefix[n] = '\0';
+
+		fprintf(f, "%llu %llu %s %s:%u %u %s %s%s\n"
+				, (unsigned long long)s->at, (unsigned long long)s->seq
+				, __directions[s->direction & 1], addr, s->src_port, s->len
+				, ( s->verdict < RECORDER_VERDICTS ) ?
+					__verdicts[s->verdict] : "?"
+				, prefix, ( s->len > RECORDER_PREFIX ) ? "..." : "");
+		written++;
+
+	}
+
+	if ( fclose(f) != 0 )
+	{
+		log_sys_error("recorder: <fclose> cannot write %s.\n", path);
+		return(EX_ERR);
+	}
+
+	return(written);
+
+}
+
+/* __dumper; background thread of a dump */
+static void *__dumper(void *arg)
+{
+
+	__dump_job_t *job = (__dump_job_t *)arg;
+
+	int n = __write(job->slots, job->no_slots, job->next, job->path);
+	if ( n >= 0 )
+		{ log_app_msg(">>> Recorder: %d messages dumped to %s.\n"
+						, n, job->path); }
+
+	free(job->slots);
+	free(job);
+	return(NULL);
+
+}
+
+/* __on_exit; the ring is written (by the exiting thread) on fatal errors */
+static void __on_exit(int status, void *arg)
+{
+
+	recorder_t *r = (recorder_t *)arg;
+	if ( status == EXIT_SUCCESS ) { return; }
+
+	int n = __write(r->slots, r->no_slots, r->next, r->path);
+	if ( n >= 0 )
+		{ fprintf(stderr, ">>> Recorder: %d messages dumped to %s.\n"
+					, n, r->path); }
+
+}
+
+/* new_recorder */
+recorder_t *new_recorder()
+{
+	recorder_t *s = NULL;
+	if ( ( s = (recorder_t *)malloc(LEN__RECORDER) ) == NULL )
+		{ handle_sys_error("new_recorder: <malloc> returns NULL."); }
+	if ( memset(s, 0, LEN__RECORDER) == NULL )
+		{ handle_sys_error("new_recorder: <memset> returns NULL."); }
+	return(s);
+}
+
+/* init_recorder */
+recorder_t *init_recorder(	struct ev_loop *loop, const int kb,
+							const char *path	)
+{
+
+	recorder_t *s = new_recorder();
+
+	s->loop = loop;
+	snprintf(s->path, RECORDER_PATH_LEN, "%s"
+				, ( path != NULL ) ? path : RECORDER_DEFAULT_PATH);
+
+	// 1) the ring is touched now, not while forwarding
+	s->no_slots = (uint32_t)( (uint64_t)kb * 1024 / LEN__RECORDER_SLOT );
+	if ( s->no_slots == 0 ) { s->no_slots = 1; }
+	if ( ( s->slots = (recorder_slot_t *)calloc(s->no_slots
+											, LEN__RECORDER_SLOT) ) == NULL )
+		{ handle_sys_error("init_recorder: <calloc> returns NULL."); }
+	memset(s->slots, 0, (size_t)s->no_slots * LEN__RECORDER_SLOT);
+
+	// 2) dump triggers: signal and fatal errors (handle_*_error)
+	ev_signal_init(&s->dump, cb_recorder_dump, RECORDER_SIGNAL);
+	ev_signal_start(loop, &s->dump);
+
+	if ( on_exit(__on_exit, s) != 0 )
+		{ log_app_msg("init_recorder: <on_exit> returns error.\n"); }
+
+	return(s);
+
+}
+
+/* recorder_dump */
+int recorder_dump(recorder_t *r)
+{
+
+	__dump_job_t *job = NULL;
+	pthread_t dumper;
+	pthread_attr_t attr;
+
+	if ( ( job = (__dump_job_t *)malloc(sizeof(__dump_job_t)) ) == NULL )
+	{
+		log_sys_error("recorder_dump: <malloc> returns NULL.\n");
+		return(EX_ERR);
+	}
+
+	size_t len = (size_t)r->no_slots * LEN__RECORDER_SLOT;
+	if ( ( job->slots = (recorder_slot_t *)malloc(len) ) == NULL )
+	{
+		log_sys_error("recorder_dump: <malloc> returns NULL.\n");
+		free(job);
+		return(EX_ERR);
+	}
+
+	// 1) the snapshot is taken by the recording thread, so it is consistent
+	memcpy(job->slots, r->slots, len);
+	job->no_slots = r->no_slots;
+	job->next = r->next;
+	snprintf(job->path, RECORDER_PATH_LEN, "%s", r->path);
+	r->dumps++;
+
+	// 2) formatting and writing happen in the background
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+	if ( pthread_create(&dumper, &attr, __dumper, job) != 0 )
+	{
+		log_app_msg("recorder_dump: <pthread_create> returns error.\n");
+		pthread_attr_destroy(&attr);
+		free(job->slots);
+		free(job);
+		return(EX_ERR);
+	}
+
+	pthread_attr_destroy(&attr);
+	return(EX_OK);
+
+}
+
+/* recorder_control */
+int recorder_control(	void *arg, int argc, char **argv,
+						char *out, const int out_len	)
+{
+
+	recorder_t *r = (recorder_t *)arg;
+
+	if ( ( argc == 2 ) && ( strcmp(argv[1], "dump") == 0 ) )
+	{
+		if ( recorder_dump(r) < 0 )
+			{ return(control_append(out, out_len, "dump failed\n")); }
+		return(control_append(out, out_len, "dumping to %s\n", r->path));
+	}
+	if ( argc != 1 )
+		{ return(control_append(out, out_len, "usage: %s [dump]\n"
+									, argv[0])); }
+
+	return(control_append(out, out_len, "slots=%u recorded=%llu dumps=%llu" \
+			" path=%s\n"
+			, r->no_slots, (unsigned long long)r->seq
+			, (unsigned long long)r->dumps, r->path));
+
+}
+
+/* print_recorder */
+void print_recorder(const recorder_t *r)
+{
+	log_app_msg(">>> Recorder = \n{\n");
+	log_app_msg("\t.slots = %u (%d bytes each)\n", r->no_slots
+					, (int)LEN__RECORDER_SLOT);
+	log_app_msg("\t.prefix = %d bytes\n", RECORDER_PREFIX);
+	log_app_msg("\t.path = %s\n", r->path);
+	log_app_msg("\t.signal = %d\n", RECORDER_SIGNAL);
+	log_app_msg("}\n");
+}
+
+/* cb_recorder_dump */
+void cb_recorder_dump(struct ev_loop *loop, ev_signal *watcher, int revents)
+{
+	recorder_t *r = (recorder_t *)watcher;
+	recorder_dump(r);
+}
@@ -0,0 +1,225 @@
+/**
+ * @file recorder.h
+ * @author Ricardo Tubío (rtpardavila[at]gmail.com)
+ * @version 0.1
+ *
+ * @section LICENSE
+ *
+ * This file is part of udpip-broadcaster.
+ * udpip-broadcaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * udpip-broadcaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with udpip-broadcaster.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Flight recorder: a preallocated ring that keeps the metadata (timestamp,
+ * direction, source, length and verdict) and a prefix of the payload of the
+ * last messages received, overwritten in place without locks. The ring is
+ * dumped to a text file on SIGUSR1, with the "recorder dump" control command
+ * and when the process exits on a fatal error.
+ */
+
+#ifndef RECORDER_H_
+#define RECORDER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <ev.h>
+
+#include "../execution_codes.h"
+#include "../logger.h"
+
+#include "udp_socket.h"
+#include "latency.h"
+
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// DATA STRUCTURES
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+#define RECORDER_SLOT 128				/**< Bytes per message recorded. */
+#define RECORDER_PREFIX ( RECORDER_SLOT - 32 )	/**< Payload kept. */
+#define RECORDER_SIGNAL SIGUSR1			/**< Dumps the ring. */
+#define RECORDER_DEFAULT_PATH "/tmp/udpipbroadcaster.rec"	/**< Dump. */
+#define RECORDER_PATH_LEN 256			/**< Max. length of a dump path. */
+
+#define RECORDER_NET 0					/**< Messages from the network. */
+#define RECORDER_APP 1					/**< Messages from applications. */
+
+/**
+ * @enum recorder_verdict
+ * @brief What happened to a recorded message.
+ */
+typedef enum recorder_verdict
+{
+	RECORDER_PENDING = 0,			/**< Still being processed. */
+	RECORDER_FORWARDED,				/**< Sent (or queued to be sent). */
+	RECORDER_BLOCKED,				/**< Self-originated. */
+	RECORDER_DENIED,				/**< Denied by the access control list. */
+	RECORDER_FILTERED,				/**< Geocast out of its area. */
+	RECORDER_MALFORMED,				/**< Wrong NEC message. */
+	RECORDER_DROPPED,				/**< No template, rate, queue or lifetime. */
+	RECORDER_ERROR,					/**< Socket error. */
+	RECORDER_VERDICTS				/**< Number of verdicts. */
+} recorder_verdict_t;
+
+/**
+ * @struct recorder_slot
+ * @brief Message recorded.
+ */
+typedef struct recorder_slot
+{
+	uint64_t at;					/**< RX time (ns, CLOCK_REALTIME). */
+	uint64_t seq;					/**< Sequence number (0: empty slot). */
+	uint32_t src_addr;				/**< Source address (network order). */
+	uint16_t src_port;				/**< Source port. */
+	uint8_t direction;				/**< RECORDER_NET or RECORDER_APP. */
+	uint8_t verdict;				/**< What happened to the message. */
+	uint32_t len;					/**< Length of the whole message. */
+	uint32_t __pad;					/**< Prefix alignment. */
+	uint8_t prefix[RECORDER_PREFIX];	/**< First bytes of the message. */
+} recorder_slot_t;
+
+#define LEN__RECORDER_SLOT sizeof(recorder_slot_t)
+
+/**
+ * @struct recorder
+ * @brief Ring of the last messages received.
+ */
+typedef struct recorder
+{
+
+	ev_signal dump;					/**< Dump request (MUST be 1st). */
+	struct ev_loop *loop;			/**< Loop of the recording thread. */
+	char path[RECORDER_PATH_LEN];	/**< Dump file. */
+
+	uint32_t no_slots;				/**< Messages that fit in the ring. */
+	uint32_t next;					/**< Next slot to be overwritten. */
+	uint64_t seq;					/**< Messages recorded. */
+	uint64_t dumps;					/**< Dumps requested. */
+
+	recorder_slot_t *slots;			/**< The ring. */
+
+} recorder_t;
+
+#define LEN__RECORDER sizeof(recorder_t)
+
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// RECORDER MANAGEMENT
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+/**
+ * @brief Allocates memory for a recorder structure.
+ * @return A pointer to the newly allocated block of memory.
+ */
+recorder_t *new_recorder();
+
+/**
+ * @brief Preallocates (and touches) the ring and installs the dump triggers.
+ * @param loop Event loop of the recording thread.
+ * @param kb Memory for the ring (KB).
+ * @param path Dump file (NULL: RECORDER_DEFAULT_PATH).
+ * @return A pointer to the initialized structure.
+ */
+recorder_t *init_recorder(	struct ev_loop *loop, const int kb,
+							const char *path	);
+
+/**
+ * @brief Dumps a snapshot of the ring from a background thread, oldest
+ * 			message first, so that recording is not stopped.
+ * 			The ring is always written to the file of the recorder.
+ * @param r The recorder.
+ * @return EX_OK if the dump was started, EX_ERR otherwise.
+ */
+int recorder_dump(recorder_t *r);
+
+/**
+ * @brief Handler of the "recorder" control command.
+ * 			recorder: counters; recorder dump: dumps the ring to its file.
+ * @return Number of bytes written to the response.
+ */
+int recorder_control(	void *arg, int argc, char **argv,
+						char *out, const int out_len	);
+
+/**
+ * @brief Prints the configuration of the recorder.
+ * @param r The recorder.
+ */
+void print_recorder(const recorder_t *r);
+
+/**
+ * @brief Callback that dumps the ring on RECORDER_SIGNAL.
+ */
+void cb_recorder_dump(struct ev_loop *loop, ev_signal *watcher, int revents);
+
+/**
+ * @brief Records a message that has just been received.
+ * @param r The recorder (NULL if off).
+ * @param direction RECORDER_NET or RECORDER_APP.
+ * @param src Source of the message.
+ * @param iov Buffers where the message was received.
+ * @param iovlen Number of buffers.
+ * @param len Bytes of the message.
+ * @param rx_ns Kernel RX timestamp (ns, 0 if unknown).
+ * @return Slot of the message, for its verdict (NULL if off).
+ */
+static inline recorder_slot_t *recorder_add(	recorder_t *r,
+												const int direction,
+												const sockaddr_in_t *src,
+												const struct iovec *iov,
+												const int iovlen,
+												const int len,
+												const uint64_t rx_ns	)
+{
+
+	if ( r == NULL ) { return(NULL); }
+
+	recorder_slot_t *s = &r->slots[r->next];
+	if ( ++r->next == r->no_slots ) { r->next = 0; }
+
+	s->seq = ++r->seq;
+	s->at = ( rx_ns > 0 ) ? rx_ns : latency_now_ns();
+	s->src_addr = src->sin_addr.s_addr;
+	s->src_port = ntohs(src->sin_port);
+	s->direction = direction;
+	s->verdict = RECORDER_PENDING;
+	s->len = ( len > 0 ) ? len : 0;
+
+	// the prefix is gathered, headers may have been received apart
+	uint8_t *p = s->prefix;
+	int copy = ( s->len < RECORDER_PREFIX ) ? s->len : RECORDER_PREFIX;
+	for ( int i = 0; ( i < iovlen ) && ( copy > 0 ); i++ )
+	{
+		int n = ( (int)iov[i].iov_len < copy ) ? (int)iov[i].iov_len : copy;
+		memcpy(p, iov[i].iov_base, n);
+		p += n;
+		copy -= n;
+	}
+
+	return(s);
+
+}
+
+/**
+ * @brief Sets the verdict of a recorded message (s may be NULL).
+ */
+static inline void recorder_verdict(recorder_slot_t *s, const int verdict)
+{
+	if ( s != NULL ) { s->verdict = verdict; }
+}
+
+#endif /* RECORDER_H_ */
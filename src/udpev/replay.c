@@ -0,0 +1,489 @@
+/**
+ * @file replay.c
+ * @author Ricardo Tubío (rtpardavila[at]gmail.com)
+ * @version 0.1
+ *
+ * @section LICENSE
+ *
+ * This file is part of udpip-broadcaster.
+ * udpip-broadcaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * udpip-broadcaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with udpip-broadcaster.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE						/**< sendmmsg */
+
+#include "replay.h"
+
+#define __PCAP_US 0xA1B2C3D4			/**< pcap, microseconds. */
+#define __PCAP_NS 0xA1B23C4D			/**< pcap, nanoseconds. */
+#define __PCAPNG_SHB 0x0A0D0D0A			/**< pcapng section header. */
+#define __PCAPNG_IDB 0x00000001			/**< pcapng interface. */
+#define __PCAPNG_EPB 0x00000006			/**< pcapng enhanced packet. */
+#define __PCAPNG_BOM 0x1A2B3C4D			/**< pcapng byte order magic. */
+#define __PCAPNG_IFS 32					/**< Max. interfaces per section. */
+#define __IF_TSRESOL 9					/**< if_tsresol option. */
+
+#define __LINKTYPE_NULL 0				/**< BSD loopback. */
+#define __LINKTYPE_ETHERNET 1			/**< Ethernet. */
+#define __LINKTYPE_RAW 101				/**< Raw IP. */
+#define __LINKTYPE_LOOP 108				/**< OpenBSD loopback. */
+#define __LINKTYPE_LINUX_SLL 113		/**< Linux cooked. */
+#define __LINKTYPE_IPV4 228				/**< Raw IPv4. */
+#define __LINKTYPE_LINUX_SLL2 276		/**< Linux cooked v2. */
+
+/**
+ * @struct __reader
+ * @brief Position and byte order while a capture is indexed.
+ */
+typedef struct __reader
+{
+	const uint8_t *data;			/**< Whole file. */
+	size_t len;						/**< Its length. */
+	bool swap;						/**< Written with the other byte order. */
+} __reader_t;
+
+/* __get16; of the capture, in host order */
+static uint16_t __get16(const __reader_t *rd, const size_t off)
+{
+	uint16_t v;
+	memcpy(&v, rd->data + off, 2);
+	return( ( rd->swap == true ) ? __builtin_bswap16(v) : v );
+}
+
+/* __get32; of the capture, in host order */
+static uint32_t __get32(const __reader_t *rd, const size_t off)
+{
+	uint32_t v;
+	memcpy(&v, rd->data + off, 4);
+	return( ( rd->swap == true ) ? __builtin_bswap32(v) : v );
+}
+
+/* __now; monotonic time (ns) */
+static uint64_t __now()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return( (uint64_t)t.tv_sec * 1000000000ULL + t.tv_nsec );
+}
+
+/* __udp_payload; of a link layer frame, returns its length (-1: none) */
+static int __udp_payload(	const uint8_t *frame, const int len,
+							const int linktype, int *offset	)
+{
+
+	int ip = 0;
+	uint16_t ethertype = 0;
+
+	// 1) link layer
+	switch ( linktype )
+	{
+		case __LINKTYPE_ETHERNET:
+			if ( len < 14 ) { return(-1); }
+			ethertype = ( frame[12] << 8 ) | frame[13];
+			ip = 14;
+			while ( ( ethertype == 0x8100 ) && ( len >= ip + 4 ) )
+				{ ethertype = ( frame[ip + 2] << 8 ) | frame[ip + 3]; ip += 4; }
+			if ( ethertype != 0x0800 ) { return(-1); }
+			break;
+		case __LINKTYPE_LINUX_SLL:
+			if ( ( len < 16 ) || ( ( ( frame[14] << 8 ) | frame[15] ) != 0x0800 ) )
+				{ return(-1); }
+			ip = 16;
+			break;
+		case __LINKTYPE_LINUX_SLL2:
+			if ( ( len < 20 ) || ( ( ( frame[0] << 8 ) | frame[1] ) != 0x0800 ) )
+				{ return(-1); }
+			ip = 20;
+			break;
+		case __LINKTYPE_NULL:
+		case __LINKTYPE_LOOP:
+			ip = 4;
+			break;
+		case __LINKTYPE_RAW:
+		case __LINKTYPE_IPV4:
+			ip = 0;
+			break;
+		default:
+			return(-1);
+	}
+
+	// 2) IPv4, first fragments only
+	if ( len < ip + 20 ) { return(-1); }
+	const uint8_t *h = frame + ip;
+	int ihl = ( h[0] & 0x0F ) * 4;
+	if ( ( ( h[0] >> 4 ) != 4 ) || ( h[9] != IPPROTO_UDP ) || ( ihl < 20 ) )
+		{ return(-1); }
+	if ( ( ( ( h[6] << 8 ) | h[7] ) & 0x3FFF ) != 0 ) { return(-1); }
+
+	// 3) UDP, bounded by what was captured
+	int udp = ip + ihl;
+	if ( len < udp + 8 ) { return(-1); }
+	int udp_len = ( ( frame[udp + 4] << 8 ) | frame[udp + 5] ) - 8;
+	if ( ( udp_len < 0 ) || ( udp + 8 + udp_len > len ) ) { return(-1); }
+
+	*offset = udp + 8;
+	return(udp_len);
+
+}
+
+/* __add; indexes the payload of a frame */
+static void __add(	replay_t *r, const size_t frame, const int len,
+					const int linktype, const uint64_t at, size_t *size	)
+{
+
+	int offset = 0;
+	int payload = __udp_payload(r->file + frame, len, linktype, &offset);
+
+	if ( payload < 0 ) { r->skipped++; return; }
+
+	if ( r->no_packets == *size )
+	{
+		*size = ( *size > 0 ) ? 2 * *size : 1024;
+		if ( ( r->packets = (replay_packet_t *)
+				realloc(r->packets, *size * LEN__REPLAY_PACKET) ) == NULL )
+			{ handle_sys_error("__add: <realloc> returns NULL."); }
+	}
+
+	replay_packet_t *p = &r->packets[r->no_packets++];
+	p->at = at;
+	p->offset = frame + offset;
+	p->len = payload;
+
+}
+
+/* __load_pcap; classic pcap */
+static int __load_pcap(replay_t *r, __reader_t *rd, const bool ns)
+{
+
+	size_t size = 0, off = 24;
+	int linktype = __get32(rd, 20);
+
+	while ( off + 16 <= rd->len )
+	{
+
+		uint64_t secs = __get32(rd, off), frac = __get32(rd, off + 4);
+		uint32_t caplen = __get32(rd, off + 8);
+		if ( off + 16 + caplen > rd->len ) { break; }
+
+		__add(r, off + 16, caplen, linktype
+				, secs * 1000000000ULL + ( ( ns == true ) ? frac : frac * 1000 )
+				, &size);
+		off += 16 + caplen;
+
+	}
+
+	return(EX_OK);
+
+}
+
+/* __tsresol; nanoseconds per unit of an if_tsresol value */
+static double __tsresol(const uint8_t v)
+{
+	double unit = 1.0;
+	if ( v & 0x80 ) { for ( int i = 0; i < ( v & 0x7F ); i++ ) { unit /= 2; } }
+	else { for ( int i = 0; i < v; i++ ) { unit /= 10; } }
+	return(unit * 1e9);
+}
+
+/* __load_pcapng; every section, interfaces and enhanced packets */
+static int __load_pcapng(replay_t *r, __reader_t *rd)
+{
+
+	size_t size = 0, off = 0;
+	int linktypes[__PCAPNG_IFS];
+	double units[__PCAPNG_IFS];
+	int no_ifs = 0;
+
+	while ( off + 12 <= rd->len )
+	{
+
+		// 1) the byte order is set by every section header
+		if ( ( __get32(rd, off) == __PCAPNG_SHB ) ||
+				( __builtin_bswap32(__get32(rd, off)) == __PCAPNG_SHB ) )
+		{
+			rd->swap = false;
+			if ( __get32(rd, off + 8) != __PCAPNG_BOM ) { rd->swap = true; }
+			no_ifs = 0;
+		}
+
+		uint32_t type = __get32(rd, off), block = __get32(rd, off + 4);
+		if ( ( block < 12 ) || ( off + block > rd->len ) ) { break; }
+
+		// 2) interfaces, with their timestamp resolution (us by default)
+		if ( ( type == __PCAPNG_IDB ) && ( no_ifs < __PCAPNG_IFS ) )
+		{
+			linktypes[no_ifs] = __get16(rd, off + 8);
+			units[no_ifs] = 1000.0;
+			for ( size_t o = off + 16; o + 4 <= off + block - 4; )
+			{
+				uint16_t code = __get16(rd, o), len = __get16(rd, o + 2);
+				if ( code == 0 ) { break; }
+				if ( ( code == __IF_TSRESOL ) && ( len == 1 ) )
+					{ units[no_ifs] = __tsresol(rd->data[o + 4]); }
+				o += 4 + ( ( len + 3 ) & ~3 );
+			}
+			no_ifs++;
+		}
+
+		// 3) packets
+		if ( ( type == __PCAPNG_EPB ) && ( block >= 32 ) )
+		{
+			uint32_t iface = __get32(rd, off + 8), caplen = __get32(rd, off + 20);
+			uint64_t ts = ( (uint64_t)__get32(rd, off + 12) << 32 )
+							| __get32(rd, off + 16);
+			if ( ( iface < (uint32_t)no_ifs ) && ( 28 + caplen <= block ) )
+				{ __add(r, off + 28, caplen, linktypes[iface]
+						, (uint64_t)( ts * units[iface] ), &size); }
+			else
+				{ r->skipped++; }
+		}
+
+		off += block;
+
+	}
+
+	return(EX_OK);
+
+}
+
+/* __load; reads the whole capture and indexes it */
+static int __load(replay_t *r, const char *path)
+{
+
+	FILE *f = NULL;
+	__reader_t rd;
+	uint32_t magic = 0;
+
+	if ( ( f = fopen(path, "rb") ) == NULL )
+	{
+		log_sys_error("replay: <fopen> cannot open %s.\n", path);
+		return(EX_ERR);
+	}
+
+	fseek(f, 0, SEEK_END);
+	r->file_len = ftell(f);
+	fseek(f, 0, SEEK_SET);
+
+	if ( ( r->file = (uint8_t *)malloc(r->file_len + 1) ) == NULL )
+		{ handle_sys_error("__load: <malloc> returns NULL."); }
+	if ( fread(r->file, 1, r->file_len, f) != r->file_len )
+	{
+		log_sys_error("replay: <fread> cannot read %s.\n", path);
+		fclose(f);
+		return(EX_ERR);
+	}
+	fclose(f);
+
+	if ( r->file_len < 24 )
+		{ log_app_msg("replay: %s is not a capture.\n", path); return(EX_ERR); }
+
+	rd.data = r->file;
+	rd.len = r->file_len;
+	rd.swap = false;
+	memcpy(&magic, r->file, 4);
+
+	switch ( magic )
+	{
+		case __PCAP_US:
+			return(__load_pcap(r, &rd, false));
+		case __PCAP_NS:
+			return(__load_pcap(r, &rd, true));
+		case __PCAPNG_SHB:
+			return(__load_pcapng(r, &rd));
+	}
+
+	rd.swap = true;
+	switch ( __builtin_bswap32(magic) )
+	{
+		case __PCAP_US:
+			return(__load_pcap(r, &rd, false));
+		case __PCAP_NS:
+			return(__load_pcap(r, &rd, true));
+	}
+
+	log_app_msg("replay: %s is not a pcap or pcapng file.\n", path);
+	return(EX_ERR);
+
+}
+
+/* __due; time when a message has to be sent */
+static uint64_t __due(const replay_t *r, const uint64_t start, const uint32_t i)
+{
+	if ( r->speed == REPLAY_SPEED_MAX ) { return(start); }
+	return( start + (uint64_t)( ( r->packets[i].at - r->packets[0].at )
+								/ r->speed ) );
+}
+
+/* __relax; hint for the CPU while spinning */
+static inline void __relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__)
+	__asm__ __volatile__("yield");
+#endif
+}
+
+/* __wait; sleeps most of the wait and spins the last REPLAY_SPIN_NS */
+static uint64_t __wait(const uint64_t due)
+{
+
+	uint64_t now = __now();
+
+	if ( due > now + REPLAY_SPIN_NS )
+	{
+		struct timespec t;
+		uint64_t sleep = due - now - REPLAY_SPIN_NS;
+		t.tv_sec = sleep / 1000000000ULL;
+		t.tv_nsec = sleep % 1000000000ULL;
+		nanosleep(&t, NULL);
+	}
+
+	while ( ( now = __now() ) < due ) { __relax(); }
+
+	return(now);
+
+}
+
+/* __compare_packets; by time, then by position in the file (stable) */
+static int __compare_packets(const void *a, const void *b)
+{
+
+	const replay_packet_t *pa = (const replay_packet_t *)a;
+	const replay_packet_t *pb = (const replay_packet_t *)b;
+
+	if ( pa->at != pb->at ) { return( ( pa->at < pb->at ) ? -1 : 1 ); }
+	if ( pa->offset == pb->offset ) { return(0); }
+	return( ( pa->offset < pb->offset ) ? -1 : 1 );
+
+}
+
+/* new_replay */
+replay_t *new_replay()
+{
+	replay_t *s = NULL;
+	if ( ( s = (replay_t *)malloc(LEN__REPLAY) ) == NULL )
+		{ handle_sys_error("new_replay: <malloc> returns NULL."); }
+	if ( memset(s, 0, LEN__REPLAY) == NULL )
+		{ handle_sys_error("new_replay: <memset> returns NULL."); }
+	return(s);
+}
+
+/* init_replay */
+replay_t *init_replay(	const char *path, const int socket_fd,
+						sockaddr_in_t *dest_addr, const double speed	)
+{
+
+	replay_t *s = new_replay();
+
+	s->socket_fd = socket_fd;
+	s->dest_addr = dest_addr;
+	s->speed = speed;
+
+	if ( __load(s, path) < 0 )
+		{ handle_app_error("init_replay: cannot load capture.\n"); }
+
+	// captures are not always in order, payloads are sorted by time
+	qsort(s->packets, s->no_packets, LEN__REPLAY_PACKET, __compare_packets);
+
+	return(s);
+
+}
+
+/* replay_run */
+int replay_run(replay_t *r)
+{
+
+	struct mmsghdr msgs[REPLAY_BATCH];
+	struct iovec iov[REPLAY_BATCH];
+	uint64_t start = __now();
+	uint32_t i = 0;
+
+	memset(msgs, 0, sizeof(msgs));
+	for ( int k = 0; k < REPLAY_BATCH; k++ )
+	{
+		msgs[k].msg_hdr.msg_name = r->dest_addr;
+		msgs[k].msg_hdr.msg_namelen = LEN__SOCKADDR_IN;
+		msgs[k].msg_hdr.msg_iov = &iov[k];
+		msgs[k].msg_hdr.msg_iovlen = 1;
+	}
+
+	while ( i < r->no_packets )
+	{
+
+		// 1) wait for the next message, and take those due right after it
+		uint64_t due = __due(r, start, i);
+		uint64_t now = __wait(due);
+		int n = 0;
+
+		if ( now - due > r->late_max_ns ) { r->late_max_ns = now - due; }
+
+		while ( ( i + n < r->no_packets ) && ( n < REPLAY_BATCH ) &&
+				( __due(r, start, i + n) <= now + REPLAY_SLACK_NS ) )
+		{
+			iov[n].iov_base = r->file + r->packets[i + n].offset;
+			iov[n].iov_len = r->packets[i + n].len;
+			n++;
+		}
+
+		// 2) one call for the whole batch, a failed message is skipped
+		int done = 0;
+		while ( done < n )
+		{
+
+			int sent = sendmmsg(r->socket_fd, msgs + done, n - done, 0);
+			r->batches++;
+
+			if ( sent < 0 )
+			{
+				if ( errno == EINTR ) { continue; }
+				if ( r->errors++ == 0 )
+					{ log_sys_error("replay: <sendmmsg> returns error.\n"); }
+				done++;
+				continue;
+			}
+
+			for ( int k = done; k < done + sent; k++ )
+				{ r->bytes += iov[k].iov_len; }
+			r->sent += sent;
+			done += sent;
+
+		}
+
+		i += n;
+
+	}
+
+	r->elapsed_ns = __now() - start;
+	return( ( r->errors == 0 ) ? EX_OK : EX_ERR );
+
+}
+
+/* print_replay */
+void print_replay(const replay_t *r)
+{
+	log_app_msg(">>> Replay = \n{\n");
+	log_app_msg("\t.dest = %s:%d\n", inet_ntoa(r->dest_addr->sin_addr)
+					, ntohs(r->dest_addr->sin_port));
+	log_app_msg("\t.speed = %.2f%s\n", r->speed
+					, ( r->speed == REPLAY_SPEED_MAX ) ? " (max)" : "");
+	log_app_msg("\t.packets = %u (skipped = %u)\n", r->no_packets, r->skipped);
+	log_app_msg("\t.sent = %llu (%llu bytes, errors = %llu)\n"
+					, (unsigned long long)r->sent
+					, (unsigned long long)r->bytes
+					, (unsigned long long)r->errors);
+	log_app_msg("\t.batches = %llu\n", (unsigned long long)r->batches);
+	log_app_msg("\t.late_max = %llu ns\n", (unsigned long long)r->late_max_ns);
+	log_app_msg("\t.elapsed = %llu ns\n", (unsigned long long)r->elapsed_ns);
+	log_app_msg("}\n");
+}
@@ -0,0 +1,133 @@
+/**
+ * @file replay.h
+ * @author Ricardo Tubío (rtpardavila[at]gmail.com)
+ * @version 0.1
+ *
+ * @section LICENSE
+ *
+ * This file is part of udpip-broadcaster.
+ * udpip-broadcaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * udpip-broadcaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with udpip-broadcaster.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Replay load generator: the UDP payloads of a pcap or pcapng capture are
+ * re-sent towards the network or the application side of a broadcaster,
+ * either with their original timing (scaled by a speed multiplier) or as
+ * fast as possible. Messages due within the same instant are sent with a
+ * single sendmmsg call; waits sleep first and spin for the last stretch.
+ */
+
+#ifndef REPLAY_H_
+#define REPLAY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/socket.h>
+
+#include "../execution_codes.h"
+#include "../logger.h"
+
+#include "udp_socket.h"
+
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// DATA STRUCTURES
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+#define REPLAY_BATCH 64					/**< Max. messages per sendmmsg. */
+#define REPLAY_SLACK_NS 20000			/**< Sent together if due within. */
+#define REPLAY_SPIN_NS 200000			/**< Last stretch of a wait, spun. */
+#define REPLAY_SPEED_MAX 0.0			/**< Speed: as fast as possible. */
+
+/**
+ * @struct replay_packet
+ * @brief UDP payload of a captured packet, still in the file buffer.
+ */
+typedef struct replay_packet
+{
+	uint64_t at;					/**< Capture time (ns). */
+	uint32_t offset;				/**< Payload offset in the file. */
+	uint32_t len;					/**< Payload length. */
+} replay_packet_t;
+
+#define LEN__REPLAY_PACKET sizeof(replay_packet_t)
+
+/**
+ * @struct replay
+ * @brief Capture loaded in memory and its destination.
+ */
+typedef struct replay
+{
+
+	int socket_fd;					/**< Socket for sending. */
+	sockaddr_in_t *dest_addr;		/**< Where the payloads are sent. */
+	double speed;					/**< Timing multiplier (0: max). */
+
+	uint8_t *file;					/**< Whole capture file. */
+	size_t file_len;				/**< Its length. */
+	replay_packet_t *packets;		/**< UDP payloads, in order. */
+	uint32_t no_packets;			/**< Number of payloads. */
+	uint32_t skipped;				/**< Packets that are not IPv4/UDP. */
+
+	uint64_t sent;					/**< Messages sent. */
+	uint64_t bytes;					/**< Bytes sent. */
+	uint64_t errors;				/**< Messages that could not be sent. */
+	uint64_t batches;				/**< sendmmsg calls. */
+	uint64_t late_max_ns;			/**< Worst delay over the schedule. */
+	uint64_t elapsed_ns;			/**< Duration of the replay. */
+
+} replay_t;
+
+#define LEN__REPLAY sizeof(replay_t)
+
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// REPLAY MANAGEMENT
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+/**
+ * @brief Allocates memory for a replay structure.
+ * @return A pointer to the newly allocated block of memory.
+ */
+replay_t *new_replay();
+
+/**
+ * @brief Loads a capture and indexes the UDP payloads it holds.
+ * @param path pcap (us or ns) or pcapng file, with Ethernet, raw IPv4,
+ * 			Linux cooked or BSD loopback link types.
+ * @param socket_fd Socket for sending.
+ * @param dest_addr Destination of the payloads.
+ * @param speed Timing multiplier (REPLAY_SPEED_MAX: as fast as possible).
+ * @return A pointer to the initialized structure.
+ */
+replay_t *init_replay(	const char *path, const int socket_fd,
+						sockaddr_in_t *dest_addr, const double speed	);
+
+/**
+ * @brief Sends every payload at its time, blocking until all have been sent.
+ * @param r The replay.
+ * @return EX_OK if every message was sent, EX_ERR otherwise.
+ */
+int replay_run(replay_t *r);
+
+/**
+ * @brief Prints the replay and its counters.
+ * @param r The replay.
+ */
+void print_replay(const replay_t *r);
+
+#endif /* REPLAY_H_ */
@@ -0,0 +1,175 @@
+/**
+ * @file stats.c
+ * @author Ricardo Tubío (rtpardavila[at]gmail.com)
+ * @version 0.1
+ *
+ * @section LICENSE
+ *
+ * This file is part of udpip-broadcaster.
+ * udpip-broadcaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * udpip-broadcaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with udpip-broadcaster.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "stats.h"
+
+static const char *__names[STATS_BLOCKS] = { "net", "app" };
+
+/* new_stats */
+stats_t *new_stats()
+{
+	stats_t *s = NULL;
+	if ( ( s = (stats_t *)malloc(LEN__STATS) ) == NULL )
+		{ handle_sys_error("new_stats: <malloc> returns NULL."); }
+	if ( memset(s, 0, LEN__STATS) == NULL )
+		{ handle_sys_error("new_stats: <memset> returns NULL."); }
+	return(s);
+}
+
+/* init_stats */
+stats_t *init_stats(const char *name)
+{
+
+	stats_t *s = new_stats();
+	int fd = -1;
+
+	if ( ( s->name = strdup(name) ) == NULL )
+		{ handle_sys_error("init_stats: <strdup> returns NULL."); }
+
+	// 1) readers of a previous run keep their own (stale) object
+	if ( ( shm_unlink(name) < 0 ) && ( errno != ENOENT ) )
+		{ handle_sys_error("init_stats: <shm_unlink> error."); }
+
+	if ( ( fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644) ) < 0 )
+		{ handle_sys_error("init_stats: <shm_open> error."); }
+	if ( ftruncate(fd, LEN__STATS_SEGMENT) < 0 )
+		{ handle_sys_error("init_stats: <ftruncate> error."); }
+
+	if ( ( s->segment = mmap(NULL, LEN__STATS_SEGMENT, PROT_READ | PROT_WRITE
+								, MAP_SHARED, fd, 0) ) == MAP_FAILED )
+		{ handle_sys_error("init_stats: <mmap> error."); }
+
+	close(fd);
+
+	// 2) blocks are zeroed by ftruncate, only names and header are set; the
+	//		magic is the last field written
+	for ( int i = 0; i < STATS_BLOCKS; i++ )
+		{ strncpy(s->segment->blocks[i].name, __names[i]
+					, STATS_NAME_LEN - 1); }
+
+	stats_header_t *h = &s->segment->header;
+	h->version = STATS_VERSION;
+	h->header_len = LEN__STATS_HEADER;
+	h->block_len = LEN__STATS_BLOCK;
+	h->no_blocks = STATS_BLOCKS;
+	h->pid = getpid();
+	h->started = time(NULL);
+	__atomic_store_n(&h->magic, STATS_MAGIC, __ATOMIC_RELEASE);
+
+	return(s);
+
+}
+
+/* stats_block */
+stats_block_t *stats_block(stats_t *s, const int index)
+{
+	if ( ( index < 0 ) || ( index >= STATS_BLOCKS ) ) { return(NULL); }
+	return(&s->segment->blocks[index]);
+}
+
+/* free_stats */
+void free_stats(stats_t *s)
+{
+	munmap(s->segment, LEN__STATS_SEGMENT);
+	shm_unlink(s->name);
+	free(s->name);
+	free(s);
+}
+
+/* print_stats */
+void print_stats(const stats_t *s)
+{
+	log_app_msg(">>> Statistics segment = \n{\n");
+	log_app_msg("\t.name = %s\n", s->name);
+	log_app_msg("\t.version = %d\n", STATS_VERSION);
+	log_app_msg("\t.size = %lu\n", (unsigned long)LEN__STATS_SEGMENT);
+	log_app_msg("\t.blocks = %d x %lu bytes\n"
+					, STATS_BLOCKS, (unsigned long)LEN__STATS_BLOCK);
+	log_app_msg("}\n");
+}
+
+/* open_stats_segment */
+const stats_segment_t *open_stats_segment(const char *name)
+{
+
+	int fd = -1;
+	struct stat st;
+	stats_segment_t *g = NULL;
+
+	if ( ( fd = shm_open(name, O_RDONLY, 0) ) < 0 ) { return(NULL); }
+
+	if ( ( fstat(fd, &st) < 0 ) ||
+			( st.st_size < (off_t)LEN__STATS_HEADER ) )
+		{ close(fd); return(NULL); }
+
+	g = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if ( g == MAP_FAILED ) { return(NULL); }
+
+	// blocks may grow in later versions, but never move nor shrink
+	const stats_header_t *h = &g->header;
+	if ( 	( __atomic_load_n(&h->magic, __ATOMIC_ACQUIRE) != STATS_MAGIC ) ||
+			( h->version != STATS_VERSION ) ||
+			( h->block_len < LEN__STATS_BLOCK ) ||
+			( h->header_len + (off_t)h->no_blocks * h->block_len
+				> st.st_size ) )
+	{
+		munmap(g, st.st_size);
+		return(NULL);
+	}
+
+	return(g);
+
+}
+
+/* stats_segment_block */
+const stats_block_t *stats_segment_block
+						(const stats_segment_t *g, const int index)
+{
+	if ( ( index < 0 ) || ( index >= (int)g->header.no_blocks ) )
+		{ return(NULL); }
+	return((const stats_block_t *)((const uint8_t *)g + g->header.header_len
+										+ index * g->header.block_len));
+}
+
+/* stats_snapshot */
+int stats_snapshot(const stats_block_t *b, stats_block_t *copy)
+{
+
+	// a writer killed while updating leaves the sequence odd forever
+	for ( int i = 0; i < STATS_RETRIES; i++ )
+	{
+
+		uint32_t seq = __atomic_load_n(&b->seq, __ATOMIC_ACQUIRE);
+		if ( seq & 1 ) { continue; }
+
+		memcpy(copy, (const void *)b, LEN__STATS_BLOCK);
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+		if ( __atomic_load_n(&b->seq, __ATOMIC_RELAXED) == seq )
+			{ return(EX_OK); }
+
+	}
+
+	return(EX_ERR);
+
+}
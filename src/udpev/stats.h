@@ -0,0 +1,330 @@
+/**
+ * @file stats.h
+ * @author Ricardo Tubío (rtpardavila[at]gmail.com)
+ * @version 0.1
+ *
+ * @section LICENSE
+ *
+ * This file is part of udpip-broadcaster.
+ * udpip-broadcaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * udpip-broadcaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with udpip-broadcaster.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Statistics segment: per direction counters (RX/TX messages and bytes,
+ * blocked self-origin messages, errors, drops, TX queue depths and latency
+ * percentiles) published in a POSIX shared memory object that external tools
+ * (udpipstat) can map and read with no help from the daemon. Every block has
+ * its own cache lines and is guarded by a sequence lock: the single writer
+ * makes the sequence odd while it updates the block, readers retry until
+ * they copy a block with the same even sequence before and after.
+ */
+
+#ifndef STATS_H_
+#define STATS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../execution_codes.h"
+#include "../logger.h"
+
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// DATA STRUCTURES
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+#define STATS_MAGIC 0x53504455		/**< "UDPS", little endian. */
+#define STATS_VERSION 1				/**< Layout version of the segment. */
+#define STATS_DEFAULT_NAME "/udpipbroadcaster"	/**< Default shm object. */
+
+#define STATS_LINE 64				/**< Cache line size (bytes). */
+#define STATS_BLOCK_LEN 128			/**< Block size, 2 lines (bytes). */
+#define STATS_NAME_LEN 8			/**< Length of the names of blocks. */
+#define STATS_QUEUES 8				/**< Max. TX queues per block. */
+
+#define STATS_NET 0					/**< Block of the network side. */
+#define STATS_APP 1					/**< Block of the application side. */
+#define STATS_BLOCKS 2				/**< Number of blocks. */
+#define STATS_RETRIES 1000000		/**< Max. attempts to read a block. */
+
+/**
+ * @struct stats_header
+ * @brief Header of the segment, readers locate the blocks with it.
+ */
+typedef struct stats_header
+{
+
+	uint32_t magic;					/**< STATS_MAGIC. */
+	uint32_t version;				/**< STATS_VERSION. */
+	uint32_t header_len;			/**< Offset of the first block. */
+	uint32_t block_len;				/**< Size of every block. */
+	uint32_t no_blocks;				/**< Number of blocks. */
+	uint32_t pid;					/**< Process that writes the blocks. */
+	uint64_t started;				/**< Creation time (s, UNIX epoch). */
+
+	uint8_t __pad[STATS_LINE - 32];	/**< Up to the next cache line. */
+
+} stats_header_t;
+
+#define LEN__STATS_HEADER sizeof(stats_header_t)
+
+/**
+ * @struct stats_block
+ * @brief Counters of a single writer.
+ */
+typedef struct stats_block
+{
+
+	volatile uint32_t seq;			/**< Sequence lock (odd: updating). */
+	uint32_t no_queues;				/**< TX queues in use. */
+	char name[STATS_NAME_LEN];		/**< Name of the block. */
+
+	uint64_t rx_packets;			/**< Messages received (blocked too). */
+	uint64_t rx_bytes;				/**< Bytes received. */
+	uint64_t tx_packets;			/**< Messages forwarded. */
+	uint64_t tx_bytes;				/**< Bytes forwarded. */
+	uint64_t blocked;				/**< Self-originated messages. */
+	uint64_t errors;				/**< Socket errors. */
+	uint64_t drops;					/**< Messages not forwarded. */
+
+	uint32_t queued[STATS_QUEUES];	/**< Messages waiting per TX queue. */
+
+	uint32_t lat_p50;				/**< Forwarding latency, p50 (ns). */
+	uint32_t lat_p99;				/**< Forwarding latency, p99 (ns). */
+	uint32_t lat_p999;				/**< Forwarding latency, p99.9 (ns). */
+
+	uint32_t stalls;				/**< Loop iterations over the threshold. */
+	uint32_t lag_max;				/**< Longest loop iteration (us). */
+
+	uint8_t __pad[STATS_BLOCK_LEN - 124];	/**< Up to the block size. */
+
+} stats_block_t;
+
+#define LEN__STATS_BLOCK sizeof(stats_block_t)
+
+/**
+ * @struct stats_segment
+ * @brief Layout of the shared memory object.
+ */
+typedef struct stats_segment
+{
+
+	stats_header_t header;				/**< Header (first cache line). */
+	stats_block_t blocks[STATS_BLOCKS];	/**< Blocks, one per writer. */
+
+} stats_segment_t;
+
+#define LEN__STATS_SEGMENT sizeof(stats_segment_t)
+
+/**
+ * @struct stats
+ * @brief Segment owned by the daemon.
+ */
+typedef struct stats
+{
+
+	char *name;						/**< Name of the shm object. */
+	stats_segment_t *segment;		/**< Mapping of the object. */
+
+} stats_t;
+
+#define LEN__STATS sizeof(stats_t)
+
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// WRITER
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+/**
+ * @brief Allocates memory for a stats structure.
+ * @return A pointer to the newly allocated block of memory.
+ */
+stats_t *new_stats();
+
+/**
+ * @brief Creates the shared memory object with all of its counters set to
+ * 			zero. An older object with the same name is unlinked first, so
+ * 			that readers still attached to it are not affected.
+ * @param name Name of the object (POSIX shm, "/name").
+ * @return A pointer to the initialized structure.
+ */
+stats_t *init_stats(const char *name);
+
+/**
+ * @brief Gets one of the blocks of the segment.
+ * @param s The segment.
+ * @param index Index of the block (STATS_NET, STATS_APP).
+ * @return The block, only one writer should update it.
+ */
+stats_block_t *stats_block(stats_t *s, const int index);
+
+/**
+ * @brief Unmaps and unlinks the shared memory object.
+ * @param s The segment.
+ */
+void free_stats(stats_t *s);
+
+/**
+ * @brief Prints the configuration of the segment.
+ * @param s The segment.
+ */
+void print_stats(const stats_t *s);
+
+/* __stats_begin; the sequence becomes odd before any counter changes */
+static inline void __stats_begin(stats_block_t *b)
+{
+	b->seq++;
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+/* __stats_end; the sequence becomes even after all counters changed */
+static inline void __stats_end(stats_block_t *b)
+{
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	b->seq++;
+}
+
+/**
+ * @brief Accounts a message received (b may be NULL).
+ */
+static inline void stats_rx(stats_block_t *b, const int bytes)
+{
+	if ( b == NULL ) { return; }
+	__stats_begin(b); b->rx_packets++; b->rx_bytes += bytes; __stats_end(b);
+}
+
+/**
+ * @brief Accounts a message forwarded (b may be NULL).
+ */
+static inline void stats_tx(stats_block_t *b, const int bytes)
+{
+	if ( b == NULL ) { return; }
+	__stats_begin(b); b->tx_packets++; b->tx_bytes += bytes; __stats_end(b);
+}
+
+/**
+ * @brief Accounts a self-originated message (b may be NULL).
+ */
+static inline void stats_blocked(stats_block_t *b)
+{
+	if ( b == NULL ) { return; }
+	__stats_begin(b); b->blocked++; __stats_end(b);
+}
+
+/**
+ * @brief Accounts a socket error (b may be NULL).
+ */
+static inline void stats_error(stats_block_t *b)
+{
+	if ( b == NULL ) { return; }
+	__stats_begin(b); b->errors++; __stats_end(b);
+}
+
+/**
+ * @brief Accounts a message that is not forwarded (b may be NULL).
+ */
+static inline void stats_drop(stats_block_t *b)
+{
+	if ( b == NULL ) { return; }
+	__stats_begin(b); b->drops++; __stats_end(b);
+}
+
+/**
+ * @brief Publishes the depth of all TX queues at once (b may be NULL).
+ * @param b The block.
+ * @param queued Messages waiting in every queue.
+ * @param no_queues Number of queues (at most STATS_QUEUES).
+ */
+static inline void stats_queues(stats_block_t *b
+								, const int *queued, const int no_queues)
+{
+	if ( b == NULL ) { return; }
+	__stats_begin(b);
+	for ( int i = 0; i < no_queues; i++ ) { b->queued[i] = queued[i]; }
+	b->no_queues = no_queues;
+	__stats_end(b);
+}
+
+/* __stats_ns; latencies saturate at ~4.29 s */
+static inline uint32_t __stats_ns(const uint64_t ns)
+{
+	return( ( ns > UINT32_MAX ) ? UINT32_MAX : (uint32_t)ns );
+}
+
+/**
+ * @brief Publishes the percentiles of the forwarding latency (b may be NULL).
+ */
+static inline void stats_latency(stats_block_t *b, const uint64_t p50
+									, const uint64_t p99, const uint64_t p999)
+{
+	if ( b == NULL ) { return; }
+	__stats_begin(b);
+	b->lat_p50 = __stats_ns(p50);
+	b->lat_p99 = __stats_ns(p99);
+	b->lat_p999 = __stats_ns(p999);
+	__stats_end(b);
+}
+
+/**
+ * @brief Publishes the stall counters of the event loop, the longest
+ * 			iteration in ns (b may be NULL).
+ */
+static inline void stats_loop(stats_block_t *b, const uint64_t stalls
+								, const uint64_t lag_max)
+{
+	if ( b == NULL ) { return; }
+	__stats_begin(b);
+	b->stalls = (uint32_t)stalls;
+	b->lag_max = __stats_ns(lag_max / 1000);
+	__stats_end(b);
+}
+
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// READER
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+/**
+ * @brief Maps an existing shared memory object for reading, its header is
+ * 			checked against the layout of this build.
+ * @param name Name of the object (POSIX shm, "/name").
+ * @return The mapping, NULL if it does not exist or is not compatible.
+ */
+const stats_segment_t *open_stats_segment(const char *name);
+
+/**
+ * @brief Gets one of the blocks of a mapped segment, located through the
+ * 			offsets of its header.
+ * @param g The segment.
+ * @param index Index of the block.
+ * @return The block, NULL if there is no such block.
+ */
+const stats_block_t *stats_segment_block
+						(const stats_segment_t *g, const int index);
+
+/**
+ * @brief Copies a consistent snapshot of a block; no system calls are made
+ * 			and the writer is never delayed.
+ * @param b The block.
+ * @param copy Buffer for the snapshot.
+ * @return EX_OK if consistent, EX_ERR if the block was always being updated.
+ */
+int stats_snapshot(const stats_block_t *b, stats_block_t *copy);
+
+#endif /* STATS_H_ */
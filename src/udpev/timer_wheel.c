@@ -0,0 +1,173 @@
+/**
+ * @file timer_wheel.c
+ * @author Ricardo Tubío (rtpardavila[at]gmail.com)
+ * @version 0.1
+ *
+ * @section LICENSE
+ *
+ * This file is part of udpip-broadcaster.
+ * udpip-broadcaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * udpip-broadcaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with udpip-broadcaster.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../logger.h"
+#include "timer_wheel.h"
+
+#define __INDEX(tick, level) \
+	( ( (tick) >> ( TIMER_WHEEL_BITS * (level) ) ) & TIMER_WHEEL_MASK )
+
+/* __link */
+static inline void __link(timer_wheel_node_t *head, timer_wheel_node_t *node)
+{
+	node->prev = head->prev;
+	node->next = head;
+	head->prev->next = node;
+	head->prev = node;
+}
+
+/* __unlink */
+static inline void __unlink(timer_wheel_node_t *node)
+{
+	node->prev->next = node->next;
+	node->next->prev = node->prev;
+	node->next = node->prev = NULL;
+}
+
+/* __place; puts the node in the slot of the level that covers its expiry */
+static void __place(timer_wheel_t *w, timer_wheel_node_t *node)
+{
+
+	uint64_t delta = ( node->expires > w->now ) ? node->expires - w->now : 0;
+	int level = 0;
+
+	if ( delta == 0 ) { node->expires = w->now; }
+
+	while ( 	( level < TIMER_WHEEL_LEVELS - 1 ) &&
+				( delta >> ( TIMER_WHEEL_BITS * ( level + 1 ) ) ) )
+		{ level++; }
+
+	__link(&w->slots[level][__INDEX(node->expires, level)], node);
+
+}
+
+/* __cascade; moves the timers of a coarse slot down to finer levels */
+static int __cascade(timer_wheel_t *w, const int level)
+{
+
+	int index = __INDEX(w->now, level);
+	timer_wheel_node_t *head = &w->slots[level][index];
+
+	while ( head->next != head )
+	{
+		timer_wheel_node_t *node = head->next;
+		__unlink(node);
+		__place(w, node);
+	}
+
+	return(index);
+
+}
+
+/* new_timer_wheel */
+timer_wheel_t *new_timer_wheel()
+{
+	timer_wheel_t *s = NULL;
+	if ( ( s = (timer_wheel_t *)malloc(LEN__TIMER_WHEEL) ) == NULL )
+		{ handle_sys_error("new_timer_wheel: <malloc> returns NULL."); }
+	if ( memset(s, 0, LEN__TIMER_WHEEL) == NULL )
+		{ handle_sys_error("new_timer_wheel: <memset> returns NULL."); }
+	return(s);
+}
+
+/* init_timer_wheel */
+timer_wheel_t *init_timer_wheel(const uint64_t now)
+{
+
+	timer_wheel_t *s = new_timer_wheel();
+	s->now = now;
+
+	for ( int l = 0; l < TIMER_WHEEL_LEVELS; l++ )
+	{
+		for ( int i = 0; i < TIMER_WHEEL_SLOTS; i++ )
+			{ s->slots[l][i].next = s->slots[l][i].prev = &s->slots[l][i]; }
+	}
+
+	return(s);
+
+}
+
+/* timer_wheel_add */
+void timer_wheel_add(timer_wheel_t *w, timer_wheel_node_t *node
+						, uint64_t expires)
+{
+
+	if ( expires > w->now + TIMER_WHEEL_MAX_TICKS )
+		{ expires = w->now + TIMER_WHEEL_MAX_TICKS; }
+
+	node->expires = expires;
+	__place(w, node);
+	w->count++;
+
+}
+
+/* timer_wheel_cancel */
+void timer_wheel_cancel(timer_wheel_t *w, timer_wheel_node_t *node)
+{
+	if ( timer_wheel_pending(node) == false ) { return; }
+	__unlink(node);
+	w->count--;
+}
+
+/* timer_wheel_advance */
+int timer_wheel_advance(timer_wheel_t *w, const uint64_t now
+						, const timer_wheel_cb_t cb, void *arg)
+{
+
+	int expired = 0;
+
+	// an empty wheel has nothing to cascade, it jumps straight to now
+	if ( ( w->count == 0 ) && ( now > w->now ) ) { w->now = now; }
+
+	while ( w->now <= now )
+	{
+
+		int index = __INDEX(w->now, 0);
+
+		// when a level wraps around, the next coarser slot is cascaded
+		for ( int l = 1; ( index == 0 ) && ( l < TIMER_WHEEL_LEVELS ); l++ )
+		{
+			if ( __cascade(w, l) != 0 ) { break; }
+		}
+
+		timer_wheel_node_t *head = &w->slots[0][index];
+		w->now++;
+
+		while ( head->next != head )
+		{
+			timer_wheel_node_t *node = head->next;
+			__unlink(node);
+			w->count--;
+			expired++;
+			cb(node, arg);
+		}
+
+		if ( w->count == 0 ) { w->now = ( now >= w->now ) ? now + 1 : w->now; }
+
+	}
+
+	return(expired);
+
+}
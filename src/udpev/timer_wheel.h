@@ -0,0 +1,140 @@
+/**
+ * @file timer_wheel.h
+ * @author Ricardo Tubío (rtpardavila[at]gmail.com)
+ * @version 0.1
+ *
+ * @section LICENSE
+ *
+ * This file is part of udpip-broadcaster.
+ * udpip-broadcaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * udpip-broadcaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with udpip-broadcaster.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Hierarchical timer wheel. Timers are intrusive nodes kept in doubly linked
+ * lists, so that both inserting and cancelling a timer take O(1); timers
+ * far in the future are kept in coarser levels and cascaded down to finer
+ * levels as time advances.
+ */
+
+#ifndef TIMER_WHEEL_H_
+#define TIMER_WHEEL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "../execution_codes.h"
+
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// DATA STRUCTURES
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+#define TIMER_WHEEL_BITS 6							/**< Bits per level. */
+#define TIMER_WHEEL_SLOTS ( 1 << TIMER_WHEEL_BITS )	/**< Slots per level. */
+#define TIMER_WHEEL_MASK ( TIMER_WHEEL_SLOTS - 1 )	/**< Slot index mask. */
+#define TIMER_WHEEL_LEVELS 4						/**< Number of levels. */
+
+/*!< Maximum distance (in ticks) of a timer into the future. */
+#define TIMER_WHEEL_MAX_TICKS \
+	( ( (uint64_t)1 << ( TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS ) ) - 1 )
+
+/**
+ * @struct timer_wheel_node
+ * @brief Timer to be embedded within the structure that it times out.
+ */
+typedef struct timer_wheel_node
+{
+
+	struct timer_wheel_node *next;	/**< Next timer in the slot. */
+	struct timer_wheel_node *prev;	/**< Previous timer in the slot. */
+
+	uint64_t expires;				/**< Tick when the timer expires. */
+
+} timer_wheel_node_t;
+
+/**
+ * @struct timer_wheel
+ * @brief Levels of slots plus the current tick of the wheel.
+ */
+typedef struct timer_wheel
+{
+
+	uint64_t now;					/**< Next tick to be processed. */
+	int count;						/**< Number of timers in the wheel. */
+
+	/**< Heads (sentinels) of the lists of timers in every slot. */
+	timer_wheel_node_t slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+
+} timer_wheel_t;
+
+#define LEN__TIMER_WHEEL sizeof(timer_wheel_t)
+
+/*!< Function to be called for every timer that expires. */
+typedef void (*timer_wheel_cb_t)(timer_wheel_node_t *node, void *arg);
+
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// TIMER WHEEL MANAGEMENT
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+/**
+ * @brief Allocates memory for a timer_wheel structure.
+ * @return A pointer to the newly allocated block of memory.
+ */
+timer_wheel_t *new_timer_wheel();
+
+/**
+ * @brief Initializes an empty timer wheel.
+ * @param now Current tick.
+ * @return A pointer to the initialized structure.
+ */
+timer_wheel_t *init_timer_wheel(const uint64_t now);
+
+/**
+ * @brief Checks whether the given timer is pending in a wheel.
+ */
+static inline bool timer_wheel_pending(const timer_wheel_node_t *node)
+	{ return(node->next != NULL); }
+
+/**
+ * @brief Adds a timer to the wheel, O(1). Timers that already expired are
+ * 			run during the next tick; those too far in the future are
+ * 			clamped to TIMER_WHEEL_MAX_TICKS.
+ * @param w The timer wheel.
+ * @param node The timer (it must not be pending).
+ * @param expires Tick when the timer expires.
+ */
+void timer_wheel_add(timer_wheel_t *w, timer_wheel_node_t *node
+						, uint64_t expires);
+
+/**
+ * @brief Removes a pending timer from the wheel, O(1).
+ * @param w The timer wheel.
+ * @param node The timer (nothing is done if it is not pending).
+ */
+void timer_wheel_cancel(timer_wheel_t *w, timer_wheel_node_t *node);
+
+/**
+ * @brief Advances the wheel up to the given tick, calling the given function
+ * 			for every timer that expires. Expired timers are removed from the
+ * 			wheel before the function is called, so they can be added again.
+ * @param w The timer wheel.
+ * @param now Current tick.
+ * @param cb Function to be called for every expired timer.
+ * @param arg Argument for that function.
+ * @return Number of timers that expired.
+ */
+int timer_wheel_advance(timer_wheel_t *w, const uint64_t now
+						, const timer_wheel_cb_t cb, void *arg);
+
+#endif /* TIMER_WHEEL_H_ */
@@ -0,0 +1,371 @@
+/**
+ * @file top_talkers.c
+ * @author Ricardo Tubío (rtpardavila[at]gmail.com)
+ * @version 0.1
+ *
+ * @section LICENSE
+ *
+ * This file is part of udpip-broadcaster.
+ * udpip-broadcaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * udpip-broadcaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with udpip-broadcaster.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "top_talkers.h"
+#include "hash.h"
+#include "control.h"
+
+#define __MASK ( TOP_TALKERS_SLOTS - 1 )
+#define __MERGED ( TOP_TALKERS_WINDOWS * TOP_TALKERS_K )
+#define __LISTED 10						/**< Sources listed by default. */
+
+/* __home; home slot of a key */
+static inline int __home(const uint64_t key)
+	{ return((int)hash_u64(key) & __MASK); }
+
+/* __key; a source is identified by its address and port */
+static inline uint64_t __key(const sockaddr_in_t *src)
+	{ return( ( (uint64_t)src->sin_addr.s_addr << 16 )
+				| ntohs(src->sin_port) ); }
+
+/* __find; position of a key in the heap, NONE if not monitored */
+static int __find(const ss_summary_t *s, const uint64_t key, int *slot)
+{
+
+	int i = __home(key);
+
+	while ( s->slots[i] != TOP_TALKERS_NONE )
+	{
+		if ( s->heap[(int)s->slots[i]].key == key )
+			{ *slot = i; return(s->slots[i]); }
+		i = ( i + 1 ) & __MASK;
+	}
+
+	*slot = i;
+	return(TOP_TALKERS_NONE);
+
+}
+
+/* __unindex; backward shift deletion of a hash slot */
+static void __unindex(ss_summary_t *s, int i)
+{
+
+	for ( int j = ( i + 1 ) & __MASK; s->slots[j] != TOP_TALKERS_NONE;
+			j = ( j + 1 ) & __MASK )
+	{
+
+		int home = __home(s->heap[(int)s->slots[j]].key);
+		if ( ( ( j - home ) & __MASK ) < ( ( j - i ) & __MASK ) )
+			{ continue; }
+
+		s->slots[i] = s->slots[j];
+		s->heap[(int)s->slots[i]].slot = i;
+		i = j;
+
+	}
+
+	s->slots[i] = TOP_TALKERS_NONE;
+
+}
+
+/* __swap; swaps two counters of the heap, keeping the index coherent */
+static inline void __swap(ss_summary_t *s, const int a, const int b)
+{
+
+	ss_counter_t tmp = s->heap[a];
+	s->heap[a] = s->heap[b];
+	s->heap[b] = tmp;
+
+	s->slots[s->heap[a].slot] = a;
+	s->slots[s->heap[b].slot] = b;
+
+}
+
+/* __sift_down */
+static void __sift_down(ss_summary_t *s, int i)
+{
+
+	for ( ;; )
+	{
+
+		int l = 2 * i + 1, r = l + 1, min = i;
+
+		if ( ( l < s->n ) && ( s->heap[l].count < s->heap[min].count ) )
+			{ min = l; }
+		if ( ( r < s->n ) && ( s->heap[r].count < s->heap[min].count ) )
+			{ min = r; }
+		if ( min == i ) { return; }
+
+		__swap(s, i, min);
+		i = min;
+
+	}
+
+}
+
+/* __sift_up */
+static void __sift_up(ss_summary_t *s, int i)
+{
+	while ( ( i > 0 ) && ( s->heap[( i - 1 ) / 2].count > s->heap[i].count ) )
+		{ __swap(s, i, ( i - 1 ) / 2); i = ( i - 1 ) / 2; }
+}
+
+/* __compare_talkers; larger counts first */
+static int __compare_talkers(const void *a, const void *b)
+{
+
+	const top_talker_t *ta = (const top_talker_t *)a;
+	const top_talker_t *tb = (const top_talker_t *)b;
+
+	if ( ta->count == tb->count ) { return(0); }
+	return( ( ta->count < tb->count ) ? 1 : -1 );
+
+}
+
+/* new_top_talkers */
+top_talkers_t *new_top_talkers()
+{
+	top_talkers_t *s = NULL;
+	if ( ( s = (top_talkers_t *)malloc(LEN__TOP_TALKERS) ) == NULL )
+		{ handle_sys_error("new_top_talkers: <malloc> returns NULL."); }
+	if ( memset(s, 0, LEN__TOP_TALKERS) == NULL )
+		{ handle_sys_error("new_top_talkers: <memset> returns NULL."); }
+	return(s);
+}
+
+/* init_top_talkers */
+top_talkers_t *init_top_talkers(struct ev_loop *loop, const char *name)
+{
+
+	top_talkers_t *s = new_top_talkers();
+
+	s->loop = loop;
+	s->name = name;
+	s->windows = 1;
+
+	for ( int w = 0; w < TOP_TALKERS_WINDOWS; w++ )
+	{
+		ss_summary_reset(&s->packets[w]);
+		ss_summary_reset(&s->bytes[w]);
+	}
+
+	ev_timer_init(&s->rotate, cb_top_talkers_rotate
+					, TOP_TALKERS_PERIOD, TOP_TALKERS_PERIOD);
+	ev_timer_start(loop, &s->rotate);
+
+	return(s);
+
+}
+
+/* ss_summary_reset */
+void ss_summary_reset(ss_summary_t *s)
+{
+	s->n = 0;
+	memset(s->slots, TOP_TALKERS_NONE, TOP_TALKERS_SLOTS);
+}
+
+/* ss_summary_add */
+void ss_summary_add(ss_summary_t *s, const uint64_t key, const uint64_t weight)
+{
+
+	int slot = 0;
+	int pos = __find(s, key, &slot);
+
+	// 1) monitored items just increase their count
+	if ( pos != TOP_TALKERS_NONE )
+	{
+		s->heap[pos].count += weight;
+		__sift_down(s, pos);
+		return;
+	}
+
+	// 2) new items take a free counter while there is one
+	if ( s->n < TOP_TALKERS_K )
+	{
+		pos = s->n++;
+		s->heap[pos].key = key;
+		s->heap[pos].count = weight;
+		s->heap[pos].error = 0;
+		s->heap[pos].slot = slot;
+		s->slots[slot] = pos;
+		__sift_up(s, pos);
+		return;
+	}
+
+	// 3) otherwise, they replace the item with the minimum count, which
+	//		becomes the max. overestimation of their count
+	ss_counter_t *min = &s->heap[0];
+
+	__unindex(s, min->slot);
+	__find(s, key, &slot);
+
+	min->key = key;
+	min->error = min->count;
+	min->count += weight;
+	min->slot = slot;
+	s->slots[slot] = 0;
+
+	__sift_down(s, 0);
+
+}
+
+/* top_talkers_add */
+void top_talkers_add(top_talkers_t *t, const sockaddr_in_t *src, const int len)
+{
+
+	uint64_t key = __key(src);
+
+	ss_summary_add(&t->packets[t->current], key, 1);
+	ss_summary_add(&t->bytes[t->current], key, len);
+
+	t->total_packets++;
+	t->total_bytes += len;
+
+}
+
+/* top_talkers_report */
+int top_talkers_report(	const top_talkers_t *t, const bool bytes,
+						top_talker_t *out, const int max	)
+{
+
+	top_talker_t merged[__MERGED];
+	uint8_t seen[__MERGED];
+	uint64_t mins[TOP_TALKERS_WINDOWS];
+	int n = 0;
+
+	// 1) counts of the same source are added up over all the sub-windows
+	for ( int w = 0; w < TOP_TALKERS_WINDOWS; w++ )
+	{
+
+		const ss_summary_t *s = bytes ? &t->bytes[w] : &t->packets[w];
+		mins[w] = ( s->n == TOP_TALKERS_K ) ? s->heap[0].count : 0;
+
+		for ( int i = 0; i < s->n; i++ )
+		{
+
+			int j = 0;
+			while ( ( j < n ) && ( merged[j].key != s->heap[i].key ) ) { j++; }
+
+			if ( j == n )
+			{
+				merged[n].key = s->heap[i].key;
+				merged[n].count = merged[n].error = 0;
+				seen[n++] = 0;
+			}
+
+			merged[j].count += s->heap[i].count;
+			merged[j].error += s->heap[i].error;
+			seen[j] |= 1 << w;
+
+		}
+
+	}
+
+	// 2) a source missing from a full summary may have been counted up to
+	//		the minimum count of that summary
+	for ( int j = 0; j < n; j++ )
+	{
+		for ( int w = 0; w < TOP_TALKERS_WINDOWS; w++ )
+			{ if ( ( seen[j] & ( 1 << w ) ) == 0 ) { merged[j].error += mins[w]; } }
+	}
+
+	qsort(merged, n, sizeof(top_talker_t), __compare_talkers);
+
+	if ( n > max ) { n = max; }
+	memcpy(out, merged, n * sizeof(top_talker_t));
+
+	return(n);
+
+}
+
+/* top_talkers_control */
+int top_talkers_control(	void *arg, int argc, char **argv,
+							char *out, const int out_len	)
+{
+
+	top_talkers_t *t = (top_talkers_t *)arg;
+	top_talker_t top[TOP_TALKERS_K];
+	bool bytes = false;
+	int max = __LISTED, len = 0;
+
+	for ( int i = 1; i < argc; i++ )
+	{
+		if ( strcmp(argv[i], "bytes") == 0 ) { bytes = true; }
+		else if ( strcmp(argv[i], "packets") == 0 ) { bytes = false; }
+		else if ( ( sscanf(argv[i], "%d", &max) != 1 ) || ( max <= 0 ) )
+		{
+			return(control_append(out, out_len, "usage: %s [packets|bytes]" \
+									" [N]\n", argv[0]));
+		}
+	}
+
+	if ( max > TOP_TALKERS_K ) { max = TOP_TALKERS_K; }
+	int n = top_talkers_report(t, bytes, top, max);
+
+	len = control_append(out, out_len, "%s window=%.0fs packets=%lu" \
+							" bytes=%llu\n"
+							, t->name, t->windows * TOP_TALKERS_PERIOD
+							, t->total_packets, t->total_bytes);
+
+	for ( int i = 0; i < n; i++ )
+	{
+		struct in_addr addr = { .s_addr = (in_addr_t)( top[i].key >> 16 ) };
+		len += control_append(out + len, out_len - len
+								, "%s:%d %s=%llu error=%llu\n"
+								, inet_ntoa(addr), (int)( top[i].key & 0xFFFF )
+								, bytes ? "bytes" : "packets"
+								, (unsigned long long)top[i].count
+								, (unsigned long long)top[i].error);
+	}
+
+	return(len);
+
+}
+
+/* print_top_talkers */
+void print_top_talkers(const top_talkers_t *t)
+{
+
+	top_talker_t top[__LISTED];
+	int n = top_talkers_report(t, false, top, __LISTED);
+
+	log_app_msg(">>> Top talkers (%s) = \n{\n", t->name);
+	log_app_msg("\t.packets = %lu\n", t->total_packets);
+	log_app_msg("\t.bytes = %llu\n", t->total_bytes);
+
+	for ( int i = 0; i < n; i++ )
+	{
+		struct in_addr addr = { .s_addr = (in_addr_t)( top[i].key >> 16 ) };
+		log_app_msg("\t* source[%s:%d] = %llu packets (error = %llu)\n"
+						, inet_ntoa(addr), (int)( top[i].key & 0xFFFF )
+						, (unsigned long long)top[i].count
+						, (unsigned long long)top[i].error);
+	}
+
+	log_app_msg("}\n");
+
+}
+
+/* cb_top_talkers_rotate */
+void cb_top_talkers_rotate(struct ev_loop *loop, ev_timer *watcher, int revents)
+{
+
+	top_talkers_t *t = (top_talkers_t *)watcher;
+
+	// the oldest sub-window is dropped and reused for the new one
+	t->current = ( t->current + 1 ) % TOP_TALKERS_WINDOWS;
+	ss_summary_reset(&t->packets[t->current]);
+	ss_summary_reset(&t->bytes[t->current]);
+
+	if ( t->windows < TOP_TALKERS_WINDOWS ) { t->windows++; }
+
+}
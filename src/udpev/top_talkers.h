@@ -0,0 +1,192 @@
+/**
+ * @file top_talkers.h
+ * @author Ricardo Tubío (rtpardavila[at]gmail.com)
+ * @version 0.1
+ *
+ * @section LICENSE
+ *
+ * This file is part of udpip-broadcaster.
+ * udpip-broadcaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * udpip-broadcaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with udpip-broadcaster.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Top talkers: heavy hitter sources by packets and by bytes, tracked with
+ * the Space-Saving algorithm (Metwally et al.) in a fixed amount of memory.
+ * Every summary monitors TOP_TALKERS_K sources in a min-heap indexed by a
+ * small hash, so each message costs O(log K). Summaries are kept for the
+ * last TOP_TALKERS_WINDOWS sub-windows and merged when queried, which gives
+ * a sliding window of TOP_TALKERS_WINDOWS x TOP_TALKERS_PERIOD seconds.
+ */
+
+#ifndef TOP_TALKERS_H_
+#define TOP_TALKERS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <ev.h>
+
+#include "../execution_codes.h"
+#include "../logger.h"
+
+#include "udp_socket.h"
+
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// DATA STRUCTURES
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+#define TOP_TALKERS_K 64			/**< Sources monitored per summary. */
+#define TOP_TALKERS_SLOTS 128		/**< Hash slots (power of 2, 2x K). */
+#define TOP_TALKERS_WINDOWS 6		/**< Sub-windows kept. */
+#define TOP_TALKERS_PERIOD 10.0		/**< Length of a sub-window (secs). */
+#define TOP_TALKERS_NONE -1			/**< Null index. */
+
+/**
+ * @struct ss_counter
+ * @brief Source monitored by a Space-Saving summary.
+ */
+typedef struct ss_counter
+{
+
+	uint64_t key;					/**< Source, address and port. */
+	uint64_t count;					/**< Estimated count (upper bound). */
+	uint64_t error;					/**< Max. overestimation of count. */
+	int slot;						/**< Hash slot that points here. */
+
+} ss_counter_t;
+
+/**
+ * @struct ss_summary
+ * @brief Space-Saving summary: min-heap of counters plus a hash index.
+ */
+typedef struct ss_summary
+{
+
+	ss_counter_t heap[TOP_TALKERS_K];	/**< Min-heap by count. */
+	int n;							/**< Counters in use. */
+	int8_t slots[TOP_TALKERS_SLOTS];	/**< Key to position in the heap. */
+
+} ss_summary_t;
+
+#define LEN__SS_SUMMARY sizeof(ss_summary_t)
+
+/**
+ * @struct top_talker
+ * @brief Entry of a top-K report.
+ */
+typedef struct top_talker
+{
+
+	uint64_t key;					/**< Source, address and port. */
+	uint64_t count;					/**< Estimated count over the window. */
+	uint64_t error;					/**< Max. overestimation of count. */
+
+} top_talker_t;
+
+/**
+ * @struct top_talkers
+ * @brief Summaries of one direction of the traffic.
+ */
+typedef struct top_talkers
+{
+
+	ev_timer rotate;				/**< Sub-window timer (MUST be 1st). */
+	struct ev_loop *loop;			/**< Loop where the timer is run. */
+	const char *name;				/**< Direction, for reports. */
+
+	ss_summary_t packets[TOP_TALKERS_WINDOWS];	/**< Summaries, packets. */
+	ss_summary_t bytes[TOP_TALKERS_WINDOWS];	/**< Summaries, bytes. */
+	int current;					/**< Sub-window being filled. */
+	int windows;					/**< Sub-windows filled so far. */
+
+	unsigned long total_packets;	/**< Packets seen since start. */
+	unsigned long long total_bytes;	/**< Bytes seen since start. */
+
+} top_talkers_t;
+
+#define LEN__TOP_TALKERS sizeof(top_talkers_t)
+
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// TOP TALKERS MANAGEMENT
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+/**
+ * @brief Allocates memory for a top_talkers structure.
+ * @return A pointer to the newly allocated block of memory.
+ */
+top_talkers_t *new_top_talkers();
+
+/**
+ * @brief Initializes empty summaries and starts rotating the sub-windows.
+ * @param loop Event loop where the timer is to be run.
+ * @param name Direction of the traffic, for reports.
+ * @return A pointer to the initialized structure.
+ */
+top_talkers_t *init_top_talkers(struct ev_loop *loop, const char *name);
+
+/**
+ * @brief Initializes an empty Space-Saving summary.
+ * @param s The summary.
+ */
+void ss_summary_reset(ss_summary_t *s);
+
+/**
+ * @brief Adds the weight of an item to a Space-Saving summary.
+ * @param s The summary.
+ * @param key Item.
+ * @param weight Weight of the item.
+ */
+void ss_summary_add(ss_summary_t *s, const uint64_t key, const uint64_t weight);
+
+/**
+ * @brief Accounts a message to its source.
+ * @param t The summaries.
+ * @param src Source of the message.
+ * @param len Length of the message.
+ */
+void top_talkers_add(top_talkers_t *t, const sockaddr_in_t *src, const int len);
+
+/**
+ * @brief Top-K sources over the sliding window.
+ * @param t The summaries.
+ * @param bytes 'true' for ranking by bytes, 'false' for packets.
+ * @param out Array where the report is stored, sorted by count.
+ * @param max Length of the array.
+ * @return Number of entries stored.
+ */
+int top_talkers_report(	const top_talkers_t *t, const bool bytes,
+						top_talker_t *out, const int max	);
+
+/**
+ * @brief Handler of the "top" control commands.
+ * 			top[net|app] [packets|bytes] [N]: top N sources.
+ * @return Number of bytes written to the response.
+ */
+int top_talkers_control(	void *arg, int argc, char **argv,
+							char *out, const int out_len	);
+
+/**
+ * @brief Prints the top sources by packets of the given summaries.
+ * @param t The summaries.
+ */
+void print_top_talkers(const top_talkers_t *t);
+
+/**
+ * @brief Callback that starts a new sub-window.
+ */
+void cb_top_talkers_rotate(struct ev_loop *loop, ev_timer *watcher, int revents);
+
+#endif /* TOP_TALKERS_H_ */
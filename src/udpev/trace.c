@@ -0,0 +1,91 @@
+/**
+ * @file trace.c
+ * @author Ricardo Tubío (rtpardavila[at]gmail.com)
+ * @version 0.1
+ *
+ * @section LICENSE
+ *
+ * This file is part of udpip-broadcaster.
+ * udpip-broadcaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * udpip-broadcaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with udpip-broadcaster.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "trace.h"
+#include "control.h"
+
+/* new_trace */
+trace_t *new_trace()
+{
+	trace_t *s = NULL;
+	if ( ( s = (trace_t *)malloc(LEN__TRACE) ) == NULL )
+		{ handle_sys_error("new_trace: <malloc> returns NULL."); }
+	if ( memset(s, 0, LEN__TRACE) == NULL )
+		{ handle_sys_error("new_trace: <memset> returns NULL."); }
+	return(s);
+}
+
+/* init_trace */
+trace_t *init_trace(const int every, const int first)
+{
+
+	trace_t *s = new_trace();
+
+	s->enabled = true;
+	s->json = false;
+	s->every = every;
+	s->first = first;
+
+	return(s);
+
+}
+
+/* trace_control */
+int trace_control(	void *arg, int argc, char **argv,
+					char *out, const int out_len	)
+{
+
+	trace_t *t = (trace_t *)arg;
+
+	if ( argc == 2 )
+	{
+		if ( strcmp(argv[1], "hex") == 0 ) { t->json = false; }
+		else if ( strcmp(argv[1], "json") == 0 ) { t->json = true; }
+		else if ( strcmp(argv[1], "on") == 0 ) { t->enabled = true; }
+		else if ( strcmp(argv[1], "off") == 0 ) { t->enabled = false; }
+		else { argc = 0; }
+	}
+	if ( argc > 2 || argc == 0 )
+		{ return(control_append(out, out_len
+						, "usage: %s [hex|json|on|off]\n", argv[0])); }
+
+	return(control_append(out, out_len, "%s format=%s every=%d first=%d" \
+			" net=%llu/%llu app=%llu/%llu (traced/seen)\n"
+			, ( t->enabled == true ) ? "on" : "off"
+			, ( t->json == true ) ? "json" : "hex", t->every, t->first
+			, (unsigned long long)t->directions[TRACE_NET].traced
+			, (unsigned long long)t->directions[TRACE_NET].seen
+			, (unsigned long long)t->directions[TRACE_APP].traced
+			, (unsigned long long)t->directions[TRACE_APP].seen));
+
+}
+
+/* print_trace */
+void print_trace(const trace_t *t)
+{
+	log_app_msg(">>> Trace = \n{\n");
+	log_app_msg("\t.enabled = %s\n", t->enabled ? "true" : "false");
+	log_app_msg("\t.json = %s\n", t->json ? "true" : "false");
+	log_app_msg("\t.every = %d\n", t->every);
+	log_app_msg("\t.first = %d\n", t->first);
+	log_app_msg("}\n");
+}
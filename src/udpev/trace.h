@@ -0,0 +1,150 @@
+/**
+ * @file trace.h
+ * @author Ricardo Tubío (rtpardavila[at]gmail.com)
+ * @version 0.1
+ *
+ * @section LICENSE
+ *
+ * This file is part of udpip-broadcaster.
+ * udpip-broadcaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * udpip-broadcaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with udpip-broadcaster.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Sampled packet tracing: per direction, one message out of every N and/or
+ * the first K messages of every flow are dumped through the asynchronous
+ * logger, either as hexadecimal lines or as JSON lines. The format can be
+ * switched at runtime with the "trace" control command.
+ */
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../execution_codes.h"
+#include "../logger.h"
+
+#include "async_log.h"
+#include "flow_table.h"
+
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// DATA STRUCTURES
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+#define TRACE_NET 0					/**< Messages from the network. */
+#define TRACE_APP 1					/**< Messages from the applications. */
+#define TRACE_DIRECTIONS 2			/**< Number of directions. */
+
+/**
+ * @struct trace_direction
+ * @brief Sampling counters of a direction.
+ */
+typedef struct trace_direction
+{
+	uint64_t seen;					/**< Messages received. */
+	uint64_t traced;				/**< Messages dumped. */
+} trace_direction_t;
+
+/**
+ * @struct trace
+ * @brief Sampled tracing of both directions.
+ */
+typedef struct trace
+{
+
+	bool enabled;					/**< Messages are being sampled. */
+	bool json;						/**< JSON lines instead of hex. */
+	int every;						/**< One out of every N (0: off). */
+	int first;						/**< First K per flow (0: off). */
+
+	trace_direction_t directions[TRACE_DIRECTIONS];	/**< Counters. */
+
+} trace_t;
+
+#define LEN__TRACE sizeof(trace_t)
+
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// TRACE MANAGEMENT
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+/**
+ * @brief Allocates memory for a trace structure.
+ * @return A pointer to the newly allocated block of memory.
+ */
+trace_t *new_trace();
+
+/**
+ * @brief Starts sampling messages in hexadecimal.
+ * @param every One message out of every N is traced (0: off).
+ * @param first First K messages of every flow are traced (0: off).
+ * @return A pointer to the initialized structure.
+ */
+trace_t *init_trace(const int every, const int first);
+
+/**
+ * @brief Handler of the "trace" control command.
+ * 			trace: counters; trace hex|json: output format;
+ * 			trace on|off: sampling.
+ * @return Number of bytes written to the response.
+ */
+int trace_control(	void *arg, int argc, char **argv,
+					char *out, const int out_len	);
+
+/**
+ * @brief Prints the configuration and the counters of the trace.
+ * @param t The trace.
+ */
+void print_trace(const trace_t *t);
+
+/**
+ * @brief Traces a received message if it is sampled.
+ * @param t The trace (NULL if off).
+ * @param direction TRACE_NET or TRACE_APP.
+ * @param flow Flow of the message, already updated (NULL if unknown).
+ * @param src Source of the message.
+ * @param iov Buffers where the message was received.
+ * @param iovlen Number of buffers.
+ * @param len Bytes of the message.
+ * @param rx_ns Kernel RX timestamp (ns, 0 if unknown).
+ */
+static inline void trace_packet(	trace_t *t, const int direction,
+									const flow_entry_t *flow,
+									const sockaddr_in_t *src,
+									const struct iovec *iov,
+									const int iovlen, const int len,
+									const uint64_t rx_ns	)
+{
+
+	if ( ( t == NULL ) || ( t->enabled == false ) ) { return; }
+
+	trace_direction_t *d = &t->directions[direction];
+	d->seen++;
+
+	if ( ( ( t->every == 0 ) || ( d->seen % t->every != 0 ) ) &&
+			( ( t->first == 0 ) || ( flow == NULL ) ||
+				( flow->packets > (uint64_t)t->first ) ) )
+		{ return; }
+
+	d->traced++;
+	async_log_iov_at(	( t->json == true ) ?
+							ASYNC_LOG_TRACE_JSON : ASYNC_LOG_TRACE_HEX,
+						rx_ns, direction, (int)src->sin_addr.s_addr
+						, ntohs(src->sin_port), iov, iovlen, len	);
+
+}
+
+#endif /* TRACE_H_ */
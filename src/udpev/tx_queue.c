@@ -0,0 +1,184 @@
+/**
+ * @file nec_repeat.c
+ * @author Ricardo Tubío (rtpardavila[at]gmail.com)
+ * @version 0.1
+ *
+ * @section LICENSE
+ *
+ * This file is part of udpip-broadcaster.
+ * udpip-broadcaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * udpip-broadcaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with udpip-broadcaster.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tx_queue.h"
+
+#define __MASK(q) ( (q)->size - 1 )
+
+/* __expired */
+static inline bool __expired(const tx_entry_t *e, const ev_tstamp now)
+	{ return( ( e->deadline > 0 ) && ( now >= e->deadline ) ); }
+
+/* __release; frees the buffer of an entry, it stays in the ring */
+static inline void __release(tx_queue_t *q, tx_entry_t *e)
+{
+	free(e->data);
+	e->data = NULL;
+	q->queued--;
+}
+
+/* __expire */
+static inline void __expire(tx_queue_t *q, tx_entry_t *e, const ev_tstamp now)
+{
+	q->expired_age[tx_queue_age_bucket(now - e->enqueued)]++;
+	__release(q, e);
+}
+
+/* new_tx_queue */
+tx_queue_t *new_tx_queue()
+{
+	tx_queue_t *s = NULL;
+	if ( ( s = (tx_queue_t *)malloc(LEN__TX_QUEUE) ) == NULL )
+		{ handle_sys_error("new_tx_queue: <malloc> returns NULL."); }
+	if ( memset(s, 0, LEN__TX_QUEUE) == NULL )
+		{ handle_sys_error("new_tx_queue: <memset> returns NULL."); }
+	return(s);
+}
+
+/* init_tx_queue */
+tx_queue_t *init_tx_queue(const int size)
+{
+
+	tx_queue_t *s = new_tx_queue();
+
+	s->size = 1;
+	while ( s->size < (unsigned int)size ) { s->size <<= 1; }
+
+	if ( ( s->ring = (tx_entry_t *)calloc(s->size, LEN__TX_ENTRY) ) == NULL )
+		{ handle_sys_error("init_tx_queue: <calloc> returns NULL."); }
+
+	return(s);
+
+}
+
+/* tx_queue_push */
+int tx_queue_push(	tx_queue_t *q, const iovec_t *iov, const int iovlen,
+					const uint32_t lifetime, const uint64_t rx_ns,
+					const ev_tstamp now	)
+{
+
+	if ( q->tail - q->head >= q->size ) { q->overflows++; return(EX_ERR); }
+
+	tx_entry_t *e = &q->ring[q->tail & __MASK(q)];
+	int len = 0;
+
+	for ( int i = 0; i < iovlen; i++ ) { len += iov[i].iov_len; }
+
+	if ( ( e->data = (char *)malloc(len) ) == NULL )
+		{ handle_sys_error("tx_queue_push: <malloc> returns NULL."); }
+
+	e->len = 0;
+	for ( int i = 0; i < iovlen; i++ )
+	{
+		memcpy(e->data + e->len, iov[i].iov_base, iov[i].iov_len);
+		e->len += iov[i].iov_len;
+	}
+
+	e->enqueued = now;
+	e->deadline = ( lifetime > 0 ) ? now + lifetime / 1000.0 : 0;
+	e->rx_ns = rx_ns;
+
+	q->tail++;
+	q->queued++;
+	q->deferred++;
+
+	return(EX_OK);
+
+}
+
+/* tx_queue_head */
+tx_entry_t *tx_queue_head(tx_queue_t *q, const ev_tstamp now)
+{
+
+	for ( ; q->head != q->tail; q->head++ )
+	{
+
+		tx_entry_t *e = &q->ring[q->head & __MASK(q)];
+
+		// swept entries and expired messages are skipped in O(1)
+		if ( e->data == NULL ) { continue; }
+		if ( __expired(e, now) == true )
+			{ q->expired_dequeue++; __expire(q, e, now); continue; }
+
+		return(e);
+
+	}
+
+	return(NULL);
+
+}
+
+/* tx_queue_pop */
+void tx_queue_pop(tx_queue_t *q)
+{
+	if ( q->head == q->tail ) { return; }
+	tx_entry_t *e = &q->ring[q->head & __MASK(q)];
+	if ( e->data != NULL ) { __release(q, e); }
+	q->head++;
+}
+
+/* tx_queue_sweep */
+int tx_queue_sweep(tx_queue_t *q, const ev_tstamp now)
+{
+
+	int swept = 0;
+
+	// buffers of expired messages are released before they reach the head
+	for ( unsigned int i = q->head; i != q->tail; i++ )
+	{
+		tx_entry_t *e = &q->ring[i & __MASK(q)];
+		if ( ( e->data == NULL ) || ( __expired(e, now) == false ) )
+			{ continue; }
+		q->expired_sweep++;
+		__expire(q, e, now);
+		swept++;
+	}
+
+	while ( ( q->head != q->tail ) && ( q->ring[q->head & __MASK(q)].data == NULL ) )
+		{ q->head++; }
+
+	return(swept);
+
+}
+
+/* print_tx_queue */
+void print_tx_queue(const tx_queue_t *q)
+{
+
+	log_app_msg("\t.queued = %d (size = %u)\n", q->queued, q->size);
+	log_app_msg("\t.deferred = %lu\n", q->deferred);
+	log_app_msg("\t.overflows = %lu\n", q->overflows);
+	log_app_msg("\t.expired_dequeue = %lu\n", q->expired_dequeue);
+	log_app_msg("\t.expired_sweep = %lu\n", q->expired_sweep);
+
+	for ( int b = 0, limit = TX_QUEUE_AGE_BASE_MS; b < TX_QUEUE_AGE_BUCKETS;
+			b++, limit *= 2 )
+	{
+		if ( b < TX_QUEUE_AGE_BUCKETS - 1 )
+			{ log_app_msg("\t* expired[age < %d ms] = %lu\n"
+							, limit, q->expired_age[b]); }
+		else
+			{ log_app_msg("\t* expired[age >= %d ms] = %lu\n"
+							, limit / 2, q->expired_age[b]); }
+	}
+
+}
@@ -0,0 +1,165 @@
+/**
+ * @file tx_queue.h
+ * @author Ricardo Tubío (rtpardavila[at]gmail.com)
+ * @version 0.1
+ *
+ * @section LICENSE
+ *
+ * This file is part of udpip-broadcaster.
+ * udpip-broadcaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * udpip-broadcaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with udpip-broadcaster.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Transmission queue, a ring of messages in FIFO order that wait for their
+ * socket to become writable again. Every queued message carries a deadline,
+ * expired messages are discarded instead of being sent.
+ */
+
+#ifndef TX_QUEUE_H_
+#define TX_QUEUE_H_
+
+#include <stdint.h>
+#include <ev.h>
+
+#include "../execution_codes.h"
+#include "../logger.h"
+
+#include "udp_socket.h"
+
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// DATA STRUCTURES
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+#define TX_QUEUE_AGE_BUCKETS 8		/**< Buckets for the ages at expiry. */
+#define TX_QUEUE_AGE_BASE_MS 10		/**< Upper bound of the 1st bucket. */
+
+/**
+ * @struct tx_entry
+ * @brief Message waiting in a transmission queue.
+ */
+typedef struct tx_entry
+{
+
+	char *data;						/**< Copy of the message (NULL: freed).*/
+	int len;						/**< Length of the message. */
+	ev_tstamp enqueued;				/**< Time when it was queued. */
+	ev_tstamp deadline;				/**< Time when it expires (0: never). */
+	uint64_t rx_ns;					/**< Kernel RX time (ns, 0: unknown). */
+
+} tx_entry_t;
+
+/**
+ * @struct tx_queue
+ * @brief Transmission queue, a ring of messages in FIFO order.
+ */
+typedef struct tx_queue
+{
+
+	tx_entry_t *ring;				/**< Entries of the queue. */
+	unsigned int size;				/**< Size of the ring (power of 2). */
+	unsigned int head;				/**< Index of the oldest entry. */
+	unsigned int tail;				/**< Index of the next free entry. */
+	int queued;						/**< Messages (with buffer) queued. */
+
+	unsigned long deferred;			/**< Messages that had to be queued. */
+	unsigned long overflows;		/**< Messages dropped, queue full. */
+	unsigned long expired_dequeue;	/**< Expired messages found at dequeue.*/
+	unsigned long expired_sweep;	/**< Expired messages swept. */
+	unsigned long expired_age[TX_QUEUE_AGE_BUCKETS];	/**< Age at expiry. */
+
+} tx_queue_t;
+
+#define LEN__TX_QUEUE sizeof(tx_queue_t)
+#define LEN__TX_ENTRY sizeof(tx_entry_t)
+
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// QUEUE MANAGEMENT
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+/**
+ * @brief Allocates memory for a tx_queue structure.
+ * @return A pointer to the newly allocated block of memory.
+ */
+tx_queue_t *new_tx_queue();
+
+/**
+ * @brief Initializes a transmission queue.
+ * @param size Max. number of queued messages (rounded up to a power of 2).
+ * @return A pointer to the initialized structure.
+ */
+tx_queue_t *init_tx_queue(const int size);
+
+/**
+ * @brief Checks whether the given queue has no entries left.
+ */
+static inline bool tx_queue_empty(const tx_queue_t *q)
+	{ return(q->head == q->tail); }
+
+/**
+ * @brief Gets the bucket for the given age (s), buckets double their width
+ * 			starting at TX_QUEUE_AGE_BASE_MS.
+ */
+static inline int tx_queue_age_bucket(const ev_tstamp age)
+{
+	int b = 0;
+	for ( double limit = TX_QUEUE_AGE_BASE_MS / 1000.0;
+			( age >= limit ) && ( b < TX_QUEUE_AGE_BUCKETS - 1 ); limit *= 2 )
+		{ b++; }
+	return(b);
+}
+
+/**
+ * @brief Queues a copy of the given message.
+ * @param q The transmission queue.
+ * @param iov Array with the buffers of the message.
+ * @param iovlen Number of buffers in the array.
+ * @param lifetime Time that the message stays valid (ms, 0: no deadline).
+ * @param rx_ns Kernel RX time of the message (ns, 0: unknown).
+ * @param now Current time.
+ * @return EX_OK if the message was queued; otherwise (queue full), < 0.
+ */
+int tx_queue_push(	tx_queue_t *q, const iovec_t *iov, const int iovlen,
+					const uint32_t lifetime, const uint64_t rx_ns,
+					const ev_tstamp now	);
+
+/**
+ * @brief Gets the oldest message that has not expired yet, expired messages
+ * 			found on the way are discarded in O(1) each.
+ * @param q The transmission queue.
+ * @param now Current time.
+ * @return The oldest valid message; NULL if there is none.
+ */
+tx_entry_t *tx_queue_head(tx_queue_t *q, const ev_tstamp now);
+
+/**
+ * @brief Removes the message returned by tx_queue_head from the queue.
+ * @param q The transmission queue.
+ */
+void tx_queue_pop(tx_queue_t *q);
+
+/**
+ * @brief Releases the buffers of all the expired messages in the queue.
+ * @param q The transmission queue.
+ * @param now Current time.
+ * @return Number of messages released.
+ */
+int tx_queue_sweep(tx_queue_t *q, const ev_tstamp now);
+
+/**
+ * @brief Prints the counters of the given queue.
+ * @param q The transmission queue.
+ */
+void print_tx_queue(const tx_queue_t *q);
+
+#endif /* TX_QUEUE_H_ */
@@ -0,0 +1,432 @@
+/**
+ * @file nec_repeat.c
+ * @author Ricardo Tubío (rtpardavila[at]gmail.com)
+ * @version 0.1
+ *
+ * @section LICENSE
+ *
+ * This file is part of udpip-broadcaster.
+ * udpip-broadcaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * udpip-broadcaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with udpip-broadcaster.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tx_scheduler.h"
+
+/**< Names, SO_PRIORITY, DSCP and DRR weights of the classes. */
+static const char *__names[TX_SCHED_CLASSES] = { "VO", "VI", "BE", "BK" };
+static const int __priorities[TX_SCHED_CLASSES] = { 6, 5, 0, 1 };
+static const int __dscps[TX_SCHED_CLASSES] = { 46, 34, 0, 8 };
+static const int __weights[TX_SCHED_CLASSES] = { 0, 4, 2, 1 };
+
+/**< Class of every TC ID, as 802.1D user priorities map to access categories:
+ * 		0 and 3 are BE, 1 and 2 are BK, 4 and 5 are VI and 6 and 7 are VO. */
+static const int __tc_classes[TX_SCHED_TC_IDS] = { 2, 3, 3, 2, 1, 1, 0, 0 };
+
+/* __rule */
+static tx_rule_t *__rule(tx_scheduler_t *s, const int port)
+{
+
+	for ( int i = 0; i < s->no_rules; i++ )
+		{ if ( s->rules[i].port == port ) { return(&s->rules[i]); } }
+
+	if ( s->no_rules >= TX_SCHED_MAX_RULES )
+	{
+		log_app_msg("tx_scheduler: too many rules, max = %d.\n"
+						, TX_SCHED_MAX_RULES);
+		return(NULL);
+	}
+
+	tx_rule_t *r = &s->rules[s->no_rules++];
+	r->port = port;
+	r->lifetime = -1;
+	r->tx_class = -1;
+
+	return(r);
+
+}
+
+/* __find_rule */
+static const tx_rule_t *__find_rule(const tx_scheduler_t *s, const int port)
+{
+	for ( int i = 0; i < s->no_rules; i++ )
+		{ if ( s->rules[i].port == port ) { return(&s->rules[i]); } }
+	return(NULL);
+}
+
+/* __idle */
+static inline bool __idle(const tx_scheduler_t *s)
+{
+	for ( int i = 0; i < TX_SCHED_CLASSES; i++ )
+		{ if ( tx_queue_empty(s->classes[i].queue) == false ) { return(false); } }
+	return(true);
+}
+
+/* __account */
+static inline void __account(	tx_class_t *c, const ev_tstamp residency,
+								const int len, const uint64_t rx_ns	)
+{
+	latency_record(c->sched->latency, rx_ns);
+	tx_tstamp_sent(c->tstamp);
+	stats_tx(c->sched->stats, len);
+	c->sent++;
+	c->sum_residency += residency;
+	if ( residency > c->max_residency ) { c->max_residency = residency; }
+	c->residency[tx_queue_age_bucket(residency)]++;
+}
+
+/* __publish; depths of the queues, for the shared statistics segment */
+static inline void __publish(tx_scheduler_t *s)
+{
+
+	int queued[TX_SCHED_CLASSES];
+
+	if ( s->stats == NULL ) { return; }
+
+	for ( int i = 0; i < TX_SCHED_CLASSES; i++ )
+		{ queued[i] = s->classes[i].queue->queued; }
+	stats_queues(s->stats, queued, TX_SCHED_CLASSES);
+
+}
+
+/* __block; the class waits until its socket becomes writable again, it
+ * does not keep the credit it could not use */
+static inline void __block(tx_scheduler_t *s, tx_class_t *c)
+{
+	c->blocked = true;
+	c->deficit = 0;
+	c->fresh = true;
+	ev_io_start(s->loop, &c->writer);
+}
+
+/* __next; picks the class whose head message is to be sent next */
+static tx_class_t *__next(tx_scheduler_t *s, const ev_tstamp now
+							, tx_entry_t **e)
+{
+
+	// 1) strict priority for the top class
+	tx_class_t *c = &s->classes[TX_SCHED_TOP_CLASS];
+	if ( ( c->blocked == false ) && ( ( *e = tx_queue_head(c->queue, now) )
+			!= NULL ) )
+		{ return(c); }
+
+	// 2) deficit round robin for the rest; quanta are larger than any message
+	//		so a full round always finds one, if there is any
+	const int n = TX_SCHED_CLASSES - 1;
+
+	for ( int i = 0; i <= 2 * n; i++ )
+	{
+
+		c = &s->classes[TX_SCHED_TOP_CLASS + 1 + s->cursor];
+
+		if ( c->blocked == false )
+		{
+
+			if ( ( *e = tx_queue_head(c->queue, now) ) != NULL )
+			{
+				if ( c->fresh == true )
+					{ c->deficit += c->quantum; c->fresh = false; }
+				if ( (*e)->len <= c->deficit ) { return(c); }
+			}
+			else { c->deficit = 0; }
+
+		}
+
+		c->fresh = true;
+		s->cursor = ( s->cursor + 1 ) % n;
+
+	}
+
+	return(NULL);
+
+}
+
+/* __drain */
+static void __drain(tx_scheduler_t *s)
+{
+
+	ev_tstamp now = ev_now(s->loop);
+	tx_entry_t *e = NULL;
+	tx_class_t *c = NULL;
+
+	while ( ( c = __next(s, now, &e) ) != NULL )
+	{
+
+		tx_tstamp_sending(c->tstamp);
+		if ( send_message((const sockaddr_t *)s->dest_addr, c->socket_fd
+							, e->data, e->len) < 0 )
+		{
+			if ( would_block() == true ) { __block(s, c); continue; }
+			stats_error(s->stats);
+			c->errors++;
+		}
+		else { __account(c, now - e->enqueued, e->len, e->rx_ns); }
+
+		if ( c->index != TX_SCHED_TOP_CLASS ) { c->deficit -= e->len; }
+		tx_queue_pop(c->queue);
+
+	}
+
+	__publish(s);
+
+}
+
+/* new_tx_scheduler */
+tx_scheduler_t *new_tx_scheduler()
+{
+	tx_scheduler_t *s = NULL;
+	if ( ( s = (tx_scheduler_t *)malloc(LEN__TX_SCHEDULER) ) == NULL )
+		{ handle_sys_error("new_tx_scheduler: <malloc> returns NULL."); }
+	if ( memset(s, 0, LEN__TX_SCHEDULER) == NULL )
+		{ handle_sys_error("new_tx_scheduler: <memset> returns NULL."); }
+	return(s);
+}
+
+/* init_tx_scheduler */
+tx_scheduler_t *init_tx_scheduler(	struct ev_loop *loop,
+									const char *if_name, const int port,
+									const sockaddr_in_t *dest_addr,
+									const int size, const uint32_t lifetime	)
+{
+
+	tx_scheduler_t *s = new_tx_scheduler();
+
+	s->loop = loop;
+	s->dest_addr = dest_addr;
+	s->lifetime = lifetime;
+
+	for ( int i = 0; i < TX_SCHED_CLASSES; i++ )
+	{
+
+		tx_class_t *c = &s->classes[i];
+
+		c->sched = s;
+		c->index = i;
+		c->queue = init_tx_queue(size);
+		c->quantum = __weights[i] * TX_SCHED_QUANTUM;
+		c->fresh = true;
+
+		c->socket_fd = open_broadcast_udp_socket(if_name, port);
+		set_nonblocking_socket(c->socket_fd);
+		set_priority_socket(c->socket_fd, __priorities[i], __dscps[i]);
+
+		ev_io_init(&c->writer, cb_tx_scheduler_writable
+					, c->socket_fd, EV_WRITE);
+
+	}
+
+	ev_idle_init(&s->drainer, cb_tx_scheduler_drain);
+	s->drainer.data = s;
+
+	ev_timer_init(&s->sweeper, cb_tx_scheduler_sweep
+					, TX_SCHED_SWEEP_PERIOD, TX_SCHED_SWEEP_PERIOD);
+	s->sweeper.data = s;
+
+	return(s);
+
+}
+
+/* tx_scheduler_set_lifetime */
+int tx_scheduler_set_lifetime(tx_scheduler_t *s, const int port
+								, const uint32_t lifetime)
+{
+	tx_rule_t *r = NULL;
+	if ( ( r = __rule(s, port) ) == NULL ) { return(EX_ERR); }
+	r->lifetime = lifetime;
+	return(EX_OK);
+}
+
+/* tx_scheduler_set_class */
+int tx_scheduler_set_class(tx_scheduler_t *s, const int port
+							, const int tx_class)
+{
+
+	tx_rule_t *r = NULL;
+
+	if ( ( tx_class < 0 ) || ( tx_class >= TX_SCHED_CLASSES ) )
+		{ return(EX_WRONG_PARAM); }
+	if ( ( r = __rule(s, port) ) == NULL ) { return(EX_ERR); }
+
+	r->tx_class = tx_class;
+	return(EX_OK);
+
+}
+
+/* tx_scheduler_lifetime */
+uint32_t tx_scheduler_lifetime(const tx_scheduler_t *s, const int port)
+{
+	const tx_rule_t *r = __find_rule(s, port);
+	if ( ( r != NULL ) && ( r->lifetime >= 0 ) ) { return(r->lifetime); }
+	return(s->lifetime);
+}
+
+/* tx_scheduler_class */
+int tx_scheduler_class(	const tx_scheduler_t *s,
+						const int port, const int traffic_class	)
+{
+
+	const tx_rule_t *r = __find_rule(s, port);
+
+	if ( ( r != NULL ) && ( r->tx_class >= 0 ) ) { return(r->tx_class); }
+	if ( traffic_class < 0 ) { return(TX_SCHED_DEFAULT_CLASS); }
+
+	// TC ID, the 6 least significant bits (unknown ones are background)
+	int tc_id = traffic_class & 0x3F;
+	return( ( tc_id < TX_SCHED_TC_IDS ) ? __tc_classes[tc_id]
+										: TX_SCHED_CLASSES - 1 );
+
+}
+
+/* tx_scheduler_send */
+int tx_scheduler_send(	tx_scheduler_t *s, const int tx_class,
+						const iovec_t *iov, const int iovlen,
+						const uint32_t lifetime, const uint64_t rx_ns	)
+{
+
+	tx_class_t *c = &s->classes[tx_class];
+
+	// 1) nothing waiting, the message is sent straight away if possible
+	if ( ( c->blocked == false ) && ( __idle(s) == true ) )
+	{
+
+		tx_tstamp_sending(c->tstamp);
+		int sent = send_message_iov((const sockaddr_t *)s->dest_addr
+										, c->socket_fd, iov, iovlen);
+
+		if ( sent >= 0 ) { __account(c, 0, sent, rx_ns); return(sent); }
+		if ( would_block() == false )
+			{ stats_error(s->stats); c->errors++; return(EX_ERR); }
+
+		__block(s, c);
+
+	}
+
+	// 2) otherwise, it waits for the scheduler to pick its class
+	if ( tx_queue_push(c->queue, iov, iovlen, lifetime, rx_ns
+						, ev_now(s->loop)) < 0 )
+		{ return(EX_ERR); }
+
+	if ( ev_is_active(&s->sweeper) == false )
+		{ ev_timer_again(s->loop, &s->sweeper); }
+
+	__drain(s);
+
+	return(0);
+
+}
+
+/* tx_scheduler_set_stats */
+void tx_scheduler_set_stats(tx_scheduler_t *s, stats_block_t *b)
+{
+	s->stats = b;
+	__publish(s);
+}
+
+/* tx_scheduler_set_tstamp */
+int tx_scheduler_set_tstamp(tx_scheduler_t *s, tx_tstamp_t *t)
+{
+
+	for ( int i = 0; i < TX_SCHED_CLASSES; i++ )
+	{
+		tx_class_t *c = &s->classes[i];
+		if ( ( c->tstamp = tx_tstamp_add(t, c->socket_fd) ) == NULL )
+			{ return(EX_ERR); }
+	}
+
+	return(EX_OK);
+
+}
+
+/* print_tx_scheduler */
+void print_tx_scheduler(const tx_scheduler_t *s)
+{
+
+	log_app_msg(">>> TX scheduler (lifetime = %u ms) = \n{\n", s->lifetime);
+
+	for ( int i = 0; i < s->no_rules; i++ )
+		{ log_app_msg("\t* rule[port=%d] = { lifetime = %d, class = %d }\n"
+						, s->rules[i].port, s->rules[i].lifetime
+						, s->rules[i].tx_class); }
+
+	for ( int i = 0; i < TX_SCHED_CLASSES; i++ )
+	{
+
+		const tx_class_t *c = &s->classes[i];
+
+		log_app_msg("\t.class[%d] (%s, fd = %d, prio = %d, dscp = %d"
+						", quantum = %d) = {\n"
+						, i, __names[i], c->socket_fd, __priorities[i]
+						, __dscps[i], c->quantum);
+		log_app_msg("\t.sent = %lu\n", c->sent);
+		log_app_msg("\t.errors = %lu\n", c->errors);
+		log_app_msg("\t.residency = { avg = %.3f ms, max = %.3f ms }\n"
+						, ( c->sent > 0 ) ?
+							1000.0 * c->sum_residency / c->sent : 0.0
+						, 1000.0 * c->max_residency);
+
+		for ( int b = 0, limit = TX_QUEUE_AGE_BASE_MS;
+				b < TX_QUEUE_AGE_BUCKETS; b++, limit *= 2 )
+		{
+			if ( b < TX_QUEUE_AGE_BUCKETS - 1 )
+				{ log_app_msg("\t* residency[< %d ms] = %lu\n"
+								, limit, c->residency[b]); }
+			else
+				{ log_app_msg("\t* residency[>= %d ms] = %lu\n"
+								, limit / 2, c->residency[b]); }
+		}
+
+		print_tx_queue(c->queue);
+		log_app_msg("\t}\n");
+
+	}
+
+	log_app_msg("}\n");
+
+}
+
+/* cb_tx_scheduler_writable */
+void cb_tx_scheduler_writable(struct ev_loop *loop, ev_io *watcher, int revents)
+{
+
+	tx_class_t *c = (tx_class_t *)watcher;
+
+	ev_io_stop(loop, watcher);
+	c->blocked = false;
+
+	// the rest of sockets that became writable are collected before draining,
+	//		otherwise the first one would be served regardless of its class
+	ev_idle_start(loop, &c->sched->drainer);
+
+}
+
+/* cb_tx_scheduler_drain */
+void cb_tx_scheduler_drain(struct ev_loop *loop, ev_idle *watcher, int revents)
+{
+	ev_idle_stop(loop, watcher);
+	__drain((tx_scheduler_t *)watcher->data);
+}
+
+/* cb_tx_scheduler_sweep */
+void cb_tx_scheduler_sweep(struct ev_loop *loop, ev_timer *watcher, int revents)
+{
+
+	tx_scheduler_t *s = (tx_scheduler_t *)watcher->data;
+	ev_tstamp now = ev_now(loop);
+
+	for ( int i = 0; i < TX_SCHED_CLASSES; i++ )
+		{ tx_queue_sweep(s->classes[i].queue, now); }
+
+	__publish(s);
+
+	if ( __idle(s) == true ) { ev_timer_stop(loop, watcher); }
+
+}
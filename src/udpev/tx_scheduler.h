@@ -0,0 +1,236 @@
+/**
+ * @file tx_scheduler.h
+ * @author Ricardo Tubío (rtpardavila[at]gmail.com)
+ * @version 0.1
+ *
+ * @section LICENSE
+ *
+ * This file is part of udpip-broadcaster.
+ * udpip-broadcaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * udpip-broadcaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with udpip-broadcaster.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Traffic class scheduler for the broadcast transmission path. Each class
+ * (VO, VI, BE and BK, as the EDCA access categories) has its own queue and
+ * its own socket, with SO_PRIORITY and DSCP set for that class. Messages
+ * are sent right away while nothing is waiting; otherwise, the top class is
+ * served with strict priority and the rest with deficit round robin.
+ */
+
+#ifndef TX_SCHEDULER_H_
+#define TX_SCHEDULER_H_
+
+#include <stdint.h>
+#include <ev.h>
+
+#include "../execution_codes.h"
+#include "../logger.h"
+
+#include "udp_socket.h"
+#include "tx_queue.h"
+#include "stats.h"
+#include "latency.h"
+#include "tx_tstamp.h"
+
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// DATA STRUCTURES
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+#define TX_SCHED_CLASSES 4			/**< Number of traffic classes. */
+#define TX_SCHED_TOP_CLASS 0		/**< Class served with strict priority. */
+#define TX_SCHED_DEFAULT_CLASS 2	/**< Class for unclassified messages. */
+#define TX_SCHED_TC_IDS 8			/**< TC IDs with a class of their own. */
+#define TX_SCHED_QUANTUM 8192		/**< DRR quantum of weight 1 (bytes). */
+#define TX_SCHED_SWEEP_PERIOD 0.1	/**< Period of the sweeps (s). */
+#define TX_SCHED_MAX_RULES 32		/**< Max. number of per port rules. */
+
+/**
+ * @struct tx_class
+ * @brief Traffic class: its socket, its queue and its counters.
+ */
+typedef struct tx_class
+{
+
+	ev_io writer;					/**< Write watcher (MUST be 1st). */
+	struct tx_scheduler *sched;		/**< Scheduler that owns this class. */
+
+	int index;						/**< Index of the class. */
+	int socket_fd;					/**< Socket with the class priority. */
+	bool blocked;					/**< Socket full, waiting for EV_WRITE. */
+	tx_queue_t *queue;				/**< Messages waiting to be sent. */
+
+	int quantum;					/**< DRR quantum (bytes). */
+	int deficit;					/**< DRR deficit counter (bytes). */
+	bool fresh;						/**< DRR, quantum not added yet. */
+
+	unsigned long sent;				/**< Messages sent. */
+	unsigned long errors;			/**< Messages dropped, socket error. */
+	ev_tstamp max_residency;		/**< Max. time spent queued (s). */
+	ev_tstamp sum_residency;		/**< Total time spent queued (s). */
+	unsigned long residency[TX_QUEUE_AGE_BUCKETS];	/**< Time queued. */
+
+	tx_tstamp_socket_t *tstamp;		/**< TX timestamps (NULL if off). */
+
+} tx_class_t;
+
+/**
+ * @struct tx_rule
+ * @brief Lifetime and class for the messages from a given application port.
+ */
+typedef struct tx_rule
+{
+	int port;						/**< Source port of the application. */
+	int lifetime;					/**< Lifetime (ms, < 0: default). */
+	int tx_class;					/**< Traffic class (< 0: default). */
+} tx_rule_t;
+
+/**
+ * @struct tx_scheduler
+ * @brief Scheduler of the traffic classes of a transmission path.
+ */
+typedef struct tx_scheduler
+{
+
+	struct ev_loop *loop;			/**< Loop where the watchers are run. */
+	ev_timer sweeper;				/**< Releases expired buffers early. */
+	ev_idle drainer;				/**< Drains after the writable events. */
+	const sockaddr_in_t *dest_addr;	/**< Destination of the messages. */
+
+	tx_class_t classes[TX_SCHED_CLASSES];	/**< Traffic classes. */
+	int cursor;						/**< DRR, class being served. */
+
+	uint32_t lifetime;				/**< Default lifetime (ms, 0: none). */
+	tx_rule_t rules[TX_SCHED_MAX_RULES];	/**< Per port rules. */
+	int no_rules;					/**< Number of per port rules. */
+
+	stats_block_t *stats;			/**< Shared counters (NULL if off). */
+	latency_t *latency;				/**< Forwarding latency (NULL if off). */
+
+} tx_scheduler_t;
+
+#define LEN__TX_SCHEDULER sizeof(tx_scheduler_t)
+
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// SCHEDULER MANAGEMENT
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+/**
+ * @brief Allocates memory for a tx_scheduler structure.
+ * @return A pointer to the newly allocated block of memory.
+ */
+tx_scheduler_t *new_tx_scheduler();
+
+/**
+ * @brief Initializes a scheduler, opening one non-blocking broadcast socket
+ * 			per traffic class.
+ * @param loop Event loop where the watchers are to be run.
+ * @param if_name Interface where the sockets are bound.
+ * @param port Port for the broadcast sockets.
+ * @param dest_addr Address where messages are sent to.
+ * @param size Max. number of queued messages per class.
+ * @param lifetime Default lifetime of the messages (ms, 0: no deadline).
+ * @return A pointer to the initialized structure.
+ */
+tx_scheduler_t *init_tx_scheduler(	struct ev_loop *loop,
+									const char *if_name, const int port,
+									const sockaddr_in_t *dest_addr,
+									const int size, const uint32_t lifetime	);
+
+/**
+ * @brief Sets the default lifetime of the messages from the given port.
+ * @return EX_OK if the rule was set; otherwise, < 0.
+ */
+int tx_scheduler_set_lifetime(tx_scheduler_t *s, const int port
+								, const uint32_t lifetime);
+
+/**
+ * @brief Sets the traffic class of the messages from the given port.
+ * @return EX_OK if the rule was set; otherwise, < 0.
+ */
+int tx_scheduler_set_class(tx_scheduler_t *s, const int port
+							, const int tx_class);
+
+/**
+ * @brief Gets the default lifetime of the messages from the given port.
+ * @return Lifetime of its messages (ms, 0: no deadline).
+ */
+uint32_t tx_scheduler_lifetime(const tx_scheduler_t *s, const int port);
+
+/**
+ * @brief Gets the traffic class of a message: the one set for its port or,
+ * 			if none, the one given by the TC ID of its NEC traffic_class,
+ * 			mapped as 802.1D user priorities: 0 and 3 are BE (as TC ID 0,
+ * 			the default of wrapped messages), 1 and 2 are BK, 4 and 5 are VI
+ * 			and 6 and 7 are VO; higher TC IDs are BK.
+ * @param s The scheduler.
+ * @param port Source port of the application.
+ * @param traffic_class NEC traffic_class of the message (< 0: not NEC).
+ * @return Index of the traffic class.
+ */
+int tx_scheduler_class(	const tx_scheduler_t *s,
+						const int port, const int traffic_class	);
+
+/**
+ * @brief Sends a message or, if it must wait, queues a copy in its class.
+ * @param s The scheduler.
+ * @param tx_class Traffic class of the message.
+ * @param iov Array with the buffers of the message.
+ * @param iovlen Number of buffers in the array.
+ * @param lifetime Time that the message stays valid (ms, 0: no deadline).
+ * @param rx_ns Kernel RX time of the message (ns, 0: unknown).
+ * @return Number of bytes sent, 0 if queued; < 0 if dropped.
+ */
+int tx_scheduler_send(	tx_scheduler_t *s, const int tx_class,
+						const iovec_t *iov, const int iovlen,
+						const uint32_t lifetime, const uint64_t rx_ns	);
+
+/**
+ * @brief Accounts the messages sent, the socket errors and the depth of the
+ * 			queues in a block of the shared statistics segment.
+ * @param s The scheduler.
+ * @param b The block, NULL to stop accounting.
+ */
+void tx_scheduler_set_stats(tx_scheduler_t *s, stats_block_t *b);
+
+/**
+ * @brief Enables the kernel TX timestamps of the sockets of all classes.
+ * @param s The scheduler, no message must have been sent yet.
+ * @param t Set where the sockets are added.
+ * @return EX_OK if enabled for all classes; otherwise < 0.
+ */
+int tx_scheduler_set_tstamp(tx_scheduler_t *s, tx_tstamp_t *t);
+
+/**
+ * @brief Prints the configuration and counters of the given scheduler.
+ * @param s The scheduler.
+ */
+void print_tx_scheduler(const tx_scheduler_t *s);
+
+/**
+ * @brief Callback function for the sockets becoming writable, <libev>.
+ */
+void cb_tx_scheduler_writable(struct ev_loop *loop, ev_io *watcher, int revents);
+
+/**
+ * @brief Callback function for draining the queues once all the sockets
+ * 			that became writable have been collected, <libev>.
+ */
+void cb_tx_scheduler_drain(struct ev_loop *loop, ev_idle *watcher, int revents);
+
+/**
+ * @brief Callback function for the periodic sweeps, <libev>.
+ */
+void cb_tx_scheduler_sweep(struct ev_loop *loop, ev_timer *watcher, int revents);
+
+#endif /* TX_SCHEDULER_H_ */
@@ -0,0 +1,180 @@
+/**
+ * @file tx_tstamp.c
+ * @author Ricardo Tubío (rtpardavila[at]gmail.com)
+ * @version 0.1
+ *
+ * @section LICENSE
+ *
+ * This file is part of udpip-broadcaster.
+ * udpip-broadcaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * udpip-broadcaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with udpip-broadcaster.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tx_tstamp.h"
+
+#define __CONTROL_LEN 128		/**< Control buffer per report. */
+
+/* new_tx_tstamp */
+tx_tstamp_t *new_tx_tstamp()
+{
+	tx_tstamp_t *s = NULL;
+	if ( ( s = (tx_tstamp_t *)malloc(LEN__TX_TSTAMP) ) == NULL )
+		{ handle_sys_error("new_tx_tstamp: <malloc> returns NULL."); }
+	if ( memset(s, 0, LEN__TX_TSTAMP) == NULL )
+		{ handle_sys_error("new_tx_tstamp: <memset> returns NULL."); }
+	return(s);
+}
+
+/* init_tx_tstamp */
+tx_tstamp_t *init_tx_tstamp(struct ev_loop *loop)
+{
+
+	tx_tstamp_t *s = new_tx_tstamp();
+
+	s->loop = loop;
+	s->to_sched = init_latency(loop, "sched");
+	s->to_driver = init_latency(loop, "driver");
+
+	return(s);
+
+}
+
+/* tx_tstamp_add */
+tx_tstamp_socket_t *tx_tstamp_add(tx_tstamp_t *t, const int socket_fd)
+{
+
+	tx_tstamp_socket_t *s = NULL;
+
+	if ( t->no_sockets >= TX_TSTAMP_SOCKETS ) { return(NULL); }
+	if ( set_tx_timestamp_socket(socket_fd) < 0 ) { return(NULL); }
+
+	if ( ( s = (tx_tstamp_socket_t *)malloc(LEN__TX_TSTAMP_SOCKET) ) == NULL )
+		{ handle_sys_error("tx_tstamp_add: <malloc> returns NULL."); }
+	if ( memset(s, 0, LEN__TX_TSTAMP_SOCKET) == NULL )
+		{ handle_sys_error("tx_tstamp_add: <memset> returns NULL."); }
+
+	s->owner = t;
+	s->socket_fd = socket_fd;
+
+	// reports make the socket readable (POLLERR)
+	ev_io_init(&s->reader, cb_tx_tstamp_read, socket_fd, EV_READ);
+	ev_io_start(t->loop, &s->reader);
+
+	t->sockets[t->no_sockets++] = s;
+
+	return(s);
+
+}
+
+/* __report; matches a report with its message */
+static void __report(	tx_tstamp_t *t, tx_tstamp_socket_t *s,
+						const struct sock_extended_err *ee,
+						const struct timespec *ts	)
+{
+
+	int i = ee->ee_data & ( TX_TSTAMP_RING - 1 );
+	uint64_t ns = latency_ns(ts);
+
+	t->reports++;
+
+	// the slot was reused by a later message, that one was forgotten
+	if ( ( s->ids[i] != ee->ee_data ) || ( s->sent_ns[i] == 0 ) )
+		{ t->unmatched++; return; }
+
+	switch ( ee->ee_info )
+	{
+		case SCM_TSTAMP_SCHED:
+
+			latency_add(t->to_sched, s->sent_ns[i], ns);
+			s->sched_ns[i] = ns;
+			break;
+
+		case SCM_TSTAMP_SND:
+
+			if ( s->sched_ns[i] != 0 )
+				{ latency_add(t->to_driver, s->sched_ns[i], ns); }
+			s->sent_ns[i] = 0;
+			break;
+
+		default:
+
+			t->unmatched++;
+			break;
+	}
+
+}
+
+/* print_tx_tstamp */
+void print_tx_tstamp(const tx_tstamp_t *t)
+{
+	log_app_msg(">>> TX timestamps = \n{\n");
+	log_app_msg("\t.sockets = %d\n", t->no_sockets);
+	log_app_msg("\t.reports = %lu\n", t->reports);
+	log_app_msg("\t.unmatched = %lu\n", t->unmatched);
+	log_app_msg("}\n");
+	print_latency(t->to_sched);
+	print_latency(t->to_driver);
+}
+
+/* cb_tx_tstamp_read */
+void cb_tx_tstamp_read(struct ev_loop *loop, ev_io *watcher, int revents)
+{
+
+	tx_tstamp_socket_t *s = (tx_tstamp_socket_t *)watcher;
+	char control[__CONTROL_LEN];
+	msg_header_t msg;
+
+	// OPT_TSONLY, reports carry no payload
+	for ( int n = 0; n < TX_TSTAMP_BATCH; n++ )
+	{
+
+		memset(&msg, 0, LEN__MSG_HEADER);
+		msg.msg_control = control;
+		msg.msg_controllen = __CONTROL_LEN;
+
+		if ( recvmsg(s->socket_fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0 )
+		{
+			if ( would_block() == false )
+				{ log_sys_error("cb_tx_tstamp_read: <recvmsg> error.\n"); }
+			return;
+		}
+
+		const struct timespec *ts = NULL;
+		const struct sock_extended_err *ee = NULL;
+
+		for	(
+				struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+				cmsg != NULL;
+				cmsg = CMSG_NXTHDR(&msg, cmsg)
+			)
+		{
+
+			if (	( cmsg->cmsg_level == SOL_SOCKET ) &&
+					( cmsg->cmsg_type == SCM_TIMESTAMPING ) )
+				{ ts = &((struct scm_timestamping *)CMSG_DATA(cmsg))->ts[0]; }
+			else if (	( cmsg->cmsg_level == IPPROTO_IP ) &&
+						( cmsg->cmsg_type == IP_RECVERR ) )
+				{ ee = (struct sock_extended_err *)CMSG_DATA(cmsg); }
+
+		}
+
+		if ( ( ts == NULL ) || ( ee == NULL ) ||
+				( ee->ee_errno != ENOMSG ) ||
+				( ee->ee_origin != SO_EE_ORIGIN_TIMESTAMPING ) )
+			{ continue; }
+
+		__report(s->owner, s, ee, ts);
+
+	}
+
+}
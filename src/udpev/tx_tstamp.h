@@ -0,0 +1,166 @@
+/**
+ * @file tx_tstamp.h
+ * @author Ricardo Tubío (rtpardavila[at]gmail.com)
+ * @version 0.1
+ *
+ * @section LICENSE
+ *
+ * This file is part of udpip-broadcaster.
+ * udpip-broadcaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * udpip-broadcaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with udpip-broadcaster.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Kernel TX timestamps: the sockets of the broadcast path report through their
+ * error queue when every message enters the packet scheduler (TX_SCHED) and
+ * when the driver hands it to the device (TX_SOFTWARE). Reports are matched
+ * with the messages sent by their OPT_ID, the per socket number of the
+ * message, so that the time spent in the stack (sendmsg -> scheduler) and in
+ * the qdisc and driver queues (scheduler -> driver) can be told apart.
+ */
+
+#ifndef TX_TSTAMP_H_
+#define TX_TSTAMP_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <linux/errqueue.h>
+#include <ev.h>
+
+#include "../execution_codes.h"
+#include "../logger.h"
+
+#include "udp_socket.h"
+#include "latency.h"
+
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// DATA STRUCTURES
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+#define TX_TSTAMP_SOCKETS 8			/**< Max. sockets timestamped. */
+#define TX_TSTAMP_RING 1024			/**< Messages in flight (power of 2). */
+#define TX_TSTAMP_BATCH 64			/**< Max. reports read per event. */
+
+/**
+ * @struct tx_tstamp_socket
+ * @brief Messages sent through a socket and waiting for their reports.
+ */
+typedef struct tx_tstamp_socket
+{
+
+	ev_io reader;					/**< Error queue watcher (MUST be 1st). */
+	struct tx_tstamp *owner;		/**< Set of sockets it belongs to. */
+
+	int socket_fd;					/**< Socket timestamped. */
+	uint32_t next_id;				/**< OPT_ID of the next message. */
+
+	uint32_t ids[TX_TSTAMP_RING];	/**< OPT_ID of every slot. */
+	uint64_t sent_ns[TX_TSTAMP_RING];	/**< Time of the sendmsg call. */
+	uint64_t sched_ns[TX_TSTAMP_RING];	/**< Time it was scheduled (0: no). */
+
+} tx_tstamp_socket_t;
+
+#define LEN__TX_TSTAMP_SOCKET sizeof(tx_tstamp_socket_t)
+
+/**
+ * @struct tx_tstamp
+ * @brief Timestamped sockets and their histograms.
+ */
+typedef struct tx_tstamp
+{
+
+	struct ev_loop *loop;			/**< Loop where the watchers are run. */
+
+	tx_tstamp_socket_t *sockets[TX_TSTAMP_SOCKETS];	/**< Sockets. */
+	int no_sockets;					/**< Number of sockets. */
+
+	latency_t *to_sched;			/**< sendmsg -> packet scheduler. */
+	latency_t *to_driver;			/**< Packet scheduler -> driver. */
+
+	unsigned long reports;			/**< Reports read. */
+	unsigned long unmatched;		/**< Reports of forgotten messages. */
+
+} tx_tstamp_t;
+
+#define LEN__TX_TSTAMP sizeof(tx_tstamp_t)
+
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// TIMESTAMPS MANAGEMENT
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+/**
+ * @brief Allocates memory for a tx_tstamp structure.
+ * @return A pointer to the newly allocated block of memory.
+ */
+tx_tstamp_t *new_tx_tstamp();
+
+/**
+ * @brief Initializes an empty set of sockets and its histograms.
+ * @param loop Event loop where the error queue watchers are to be run.
+ * @return A pointer to the initialized structure.
+ */
+tx_tstamp_t *init_tx_tstamp(struct ev_loop *loop);
+
+/**
+ * @brief Enables the TX timestamps of a socket and starts reading its error
+ * 			queue.
+ * @param t The set of sockets.
+ * @param socket_fd The socket, no message must have been sent through it.
+ * @return The state of the socket; NULL if it could not be enabled.
+ */
+tx_tstamp_socket_t *tx_tstamp_add(tx_tstamp_t *t, const int socket_fd);
+
+/**
+ * @brief Prints the counters and percentiles of the given set.
+ * @param t The set of sockets.
+ */
+void print_tx_tstamp(const tx_tstamp_t *t);
+
+/**
+ * @brief Callback that reads the reports of the error queue of a socket.
+ */
+void cb_tx_tstamp_read(struct ev_loop *loop, ev_io *watcher, int revents);
+
+/**
+ * @brief Takes the time of a message about to be sent (s may be NULL); it
+ * 			must be called right before its sendmsg call.
+ * @param s The socket.
+ */
+static inline void tx_tstamp_sending(tx_tstamp_socket_t *s)
+{
+
+	if ( s == NULL ) { return; }
+
+	int i = s->next_id & ( TX_TSTAMP_RING - 1 );
+	s->ids[i] = s->next_id;
+	s->sent_ns[i] = latency_now_ns();
+	s->sched_ns[i] = 0;
+
+}
+
+/**
+ * @brief Confirms that the message whose time was taken was sent, the kernel
+ * 			numbered it (s may be NULL).
+ * @param s The socket.
+ */
+static inline void tx_tstamp_sent(tx_tstamp_socket_t *s)
+{
+	if ( s == NULL ) { return; }
+	s->next_id++;
+}
+
+#endif /* TX_TSTAMP_H_ */
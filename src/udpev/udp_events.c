@@ -128,6 +128,61 @@ udp_events_t *init_app_udp_events
 
 }
 
+/* init_nec_wrap_udp_events */
+void init_nec_wrap_udp_events(	udp_events_t *m,
+								const int hop_limit, const int traffic_class	)
+{
+	get_public_arg(m)->nec_templates
+		= init_nec_templates(m->loop, hop_limit, traffic_class);
+}
+
+/* init_nec_strip_udp_events */
+void init_nec_strip_udp_events(udp_events_t *m)
+{
+
+	public_ev_arg_t *arg = get_public_arg(m);
+
+	if ( ( arg->nec_rx_header = malloc(LEN____NEC__GNBTPAPI_MAX_HEADER) )
+			== NULL )
+		{ handle_sys_error("init_nec_strip_udp_events: " \
+							"<malloc> returns NULL."); }
+
+	// the shortest RX header is scattered apart from the rest of the message
+	free_msg_header(arg->msg_header);
+	arg->msg_header = init_msg_header_sg
+						(	arg->nec_rx_header,
+							LEN____NEC__GNBTPAPI_TSB_RX_HEADER,
+							arg->data, UDP_BUFFER_LEN	);
+
+}
+
+/* init_tx_scheduler_udp_events */
+tx_scheduler_t *init_tx_scheduler_udp_events
+					(	udp_events_t *m, const char *if_name,
+						const int size, const uint32_t lifetime	)
+{
+
+	public_ev_arg_t *arg = get_public_arg(m);
+
+	arg->tx_scheduler = init_tx_scheduler(m->loop, if_name
+											, arg->forwarding_port
+											, arg->forwarding_addr
+											, size, lifetime);
+
+	close(arg->forwarding_socket_fd);
+	arg->forwarding_socket_fd
+		= arg->tx_scheduler->classes[TX_SCHED_DEFAULT_CLASS].socket_fd;
+
+	return(arg->tx_scheduler);
+
+}
+
+/* get_public_arg */
+public_ev_arg_t *get_public_arg(const udp_events_t *m)
+{
+	return(&((ev_io_arg_t *)m->watcher)->public_arg);
+}
+
 /* free_udp_events */
 void free_udp_events(udp_events_t *m)
 {
@@ -211,6 +266,9 @@ void cb_common
 	if ( EV_ERROR & revents )
 		{ log_sys_error("Invalid event"); return; }
 
+	UDPIP_PROBE3(wakeup, watcher->fd, revents
+					, (uint64_t)( ev_now(loop) * 1e9 ));
+
 	ev_io_arg_t *arg = (ev_io_arg_t *)watcher;
 	public_ev_arg_t *public_arg = &arg->public_arg;
 	public_arg->socket_fd = watcher->fd;
@@ -222,6 +280,11 @@ void cb_common
 		return;
 	}
 
+	watchdog_enter(watcher->fd, (uintptr_t)arg->cb_specfic);
+	CYCLES_WAKEUP_BEGIN(c_wakeup);
 	arg->cb_specfic(public_arg);
+	CYCLES_WAKEUP_END(c_wakeup);
+	watchdog_leave();
+	UDPIP_PROBE1(done, watcher->fd);
 
 }
@@ -31,6 +31,24 @@
 #include "../execution_codes.h"
 
 #include "udp_socket.h"
+#include "nec_relay.h"
+#include "nec_template.h"
+#include "nec_repeat.h"
+#include "tx_scheduler.h"
+#include "rate_limiter.h"
+#include "geo_filter.h"
+#include "loc_table.h"
+#include "acl.h"
+#include "top_talkers.h"
+#include "flow_table.h"
+#include "stats.h"
+#include "latency.h"
+#include "watchdog.h"
+#include "async_log.h"
+#include "trace.h"
+#include "recorder.h"
+#include "capture.h"
+#include "analyzer.h"
 
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 // DATA STRUCTURES
@@ -59,10 +77,28 @@ typedef struct public_ev_arg
 
 	void *data;						/**< Buffer for frames reception. */
 	int len;						/**< Data length within the buffer. */
+	uint64_t rx_ns;					/**< Kernel RX time (ns, 0: unknown). */
 
 	msg_header_t *msg_header;		/**< Buffer for msg_header reception. */
 
 	bool nec_mode;					/**< Flag that indicates NEC mode. */
+	nec_relay_t *relay;				/**< Multi-hop relay (NULL if off). */
+	nec_templates_t *nec_templates;	/**< TX headers for wrapping payloads. */
+	uint8_t *nec_rx_header;			/**< Buffer for stripping RX headers. */
+	nec_repeat_t *nec_repeat;		/**< Repetitions of NEC TX messages. */
+	tx_scheduler_t *tx_scheduler;	/**< Scheduler for message forwarding. */
+	rate_limiter_t *rate_limiter;	/**< Per source limits (NULL if off). */
+	geo_filter_t *geo_filter;		/**< Geocast area filter (NULL if off).*/
+	loc_table_t *loc_table;			/**< Neighbours heard (NULL if off). */
+	acl_t *acl;						/**< Source allow/deny list (or NULL). */
+	top_talkers_t *talkers;			/**< Heavy hitters (NULL if off). */
+	flow_table_t *flows;			/**< Per-flow counters (NULL if off). */
+	stats_block_t *stats;			/**< Shared counters (NULL if off). */
+	latency_t *latency;				/**< Forwarding latency (NULL if off). */
+	trace_t *trace;					/**< Sampled tracing (NULL if off). */
+	recorder_t *recorder;			/**< Flight recorder (NULL if off). */
+	capture_t *capture;				/**< pcapng capture (NULL if off). */
+	analyzer_t *analyzer;			/**< Test traffic analyzer (RX test). */
 
 	int __test_number;				/**< For testing, counts no tests. */
 
@@ -168,6 +204,47 @@ udp_events_t *init_app_udp_events
 					const char* if_name, const int net_fwd_port,
 					const ev_cb_t callback);
 
+/**
+ * @brief Configures the manager of the application side so that raw payloads
+ * 			from applications are wrapped with NEC GN-BTP TX headers.
+ * @param m Manager of the application side (see init_app_udp_events).
+ * @param hop_limit Value of the hop_limit field for the TX headers.
+ * @param traffic_class Value of the traffic_class field for the TX headers.
+ */
+void init_nec_wrap_udp_events(	udp_events_t *m,
+								const int hop_limit, const int traffic_class	);
+
+/**
+ * @brief Configures the manager of the network side so that NEC GN-BTP RX
+ * 			headers are stripped before messages are delivered to the
+ * 			applications. Headers and payloads are received in separate
+ * 			buffers.
+ * @param m Manager of the network side (see init_net_udp_events).
+ */
+void init_nec_strip_udp_events(udp_events_t *m);
+
+/**
+ * @brief Configures the manager of the application side so that messages are
+ * 			forwarded through the per traffic class queues and sockets of a
+ * 			scheduler, which replace the forwarding socket.
+ * @param m Manager of the application side (see init_app_udp_events).
+ * @param if_name Name of the network interface.
+ * @param size Max. number of queued messages per class.
+ * @param lifetime Default lifetime of the queued messages (ms, 0: none).
+ * @return The scheduler, for further configuration.
+ */
+tx_scheduler_t *init_tx_scheduler_udp_events
+					(	udp_events_t *m, const char *if_name,
+						const int size, const uint32_t lifetime	);
+
+/**
+ * @brief Gets the public arguments that are passed to the callback function
+ * 			of the given manager.
+ * @param m The manager whose public arguments are requested.
+ * @return A pointer to the public arguments of the manager.
+ */
+public_ev_arg_t *get_public_arg(const udp_events_t *m);
+
 /**
  * @brief Releases all resources that previously were allocated for this
  * 			manager.
@@ -146,6 +146,36 @@ msg_header_t *init_msg_header(void* buffer, const int buffer_len)
 
 }
 
+/* init_msg_header_sg */
+msg_header_t *init_msg_header_sg(	void *header, const int header_len,
+									void *buffer, const int buffer_len	)
+{
+
+	msg_header_t *s = new_msg_header();
+
+	free(s->msg_iov);
+	if ( ( s->msg_iov = (iovec_t *)malloc(2 * LEN__IOVEC) ) == NULL )
+		{ handle_sys_error("init_msg_header_sg: <malloc> returns NULL.\n"); }
+
+	s->msg_iovlen = 2;
+	s->msg_iov[0].iov_base = header;
+	s->msg_iov[0].iov_len = header_len;
+	s->msg_iov[1].iov_base = buffer;
+	s->msg_iov[1].iov_len = buffer_len;
+
+	return(s);
+
+}
+
+/* free_msg_header */
+void free_msg_header(msg_header_t *m)
+{
+	free(m->msg_control);
+	free(m->msg_name);
+	free(m->msg_iov);
+	free(m);
+}
+
 /* init_broadcast_sockaddr_in */
 sockaddr_in_t *init_broadcast_sockaddr_in(const int port)
 {
@@ -267,6 +297,9 @@ int open_receiver_udp_socket(const int port)
 		{ handle_app_error("open_receiver_udp_socket: " \
 							"<set_msghdrs_socket> returns error.\n"); }
 
+	// 4) for measuring the forwarding latency (not critical)
+	set_timestamp_socket(fd);
+
 	return(fd);
 
 }
@@ -358,6 +391,80 @@ int set_msghdrs_socket(const int socket_fd)
 
 }
 
+/* set_timestamp_socket */
+int set_timestamp_socket(const int socket_fd)
+{
+
+	int on = 1;
+
+	if ( setsockopt(socket_fd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(int))
+			< 0 )
+	{
+		log_sys_error("set_timestamp_socket: <setsockopt> returns error.\n");
+		return(EX_ERR);
+	}
+
+	return(EX_OK);
+
+}
+
+/* set_tx_timestamp_socket */
+int set_tx_timestamp_socket(const int socket_fd)
+{
+
+	int flags = SOF_TIMESTAMPING_TX_SCHED | SOF_TIMESTAMPING_TX_SOFTWARE
+				| SOF_TIMESTAMPING_SOFTWARE | SOF_TIMESTAMPING_OPT_ID
+				| SOF_TIMESTAMPING_OPT_TSONLY;
+
+	if ( setsockopt(socket_fd, SOL_SOCKET, SO_TIMESTAMPING
+						, &flags, sizeof(int)) < 0 )
+	{
+		log_sys_error("set_tx_timestamp_socket: " \
+						"<setsockopt> returns error.\n");
+		return(EX_ERR);
+	}
+
+	return(EX_OK);
+
+}
+
+/* set_nonblocking_socket */
+int set_nonblocking_socket(const int socket_fd)
+{
+
+	int flags = 0;
+
+	if ( ( flags = fcntl(socket_fd, F_GETFL, 0) ) < 0 )
+		{ handle_sys_error("set_nonblocking_socket: " \
+							"<fcntl> returns error"); }
+
+	if ( fcntl(socket_fd, F_SETFL, flags | O_NONBLOCK) < 0 )
+		{ handle_sys_error("set_nonblocking_socket: " \
+							"<fcntl> returns error"); }
+
+	return(EX_OK);
+
+}
+
+/* set_priority_socket */
+int set_priority_socket(const int socket_fd, const int priority, const int dscp)
+{
+
+	int tos = dscp << 2;
+
+	if ( setsockopt(socket_fd, SOL_SOCKET, SO_PRIORITY
+						, &priority, sizeof(int)) < 0 )
+		{ handle_sys_error("set_priority_socket: " \
+							"<setsockopt> returns error"); }
+
+	if ( setsockopt(socket_fd, IPPROTO_IP, IP_TOS, &tos, sizeof(int)) < 0 )
+		{ handle_sys_error("set_priority_socket: " \
+							"<setsockopt> returns error"); }
+
+	return(EX_OK);
+
+}
+
 /* send_message */
 int send_message(	const sockaddr_t* dest_addr, const int socket_fd,
 					const void *buffer, const int len	)
@@ -365,12 +472,16 @@ int send_message(	const sockaddr_t* dest_addr, const int socket_fd,
 
 	int sent_bytes = 0;
 
-	if ( ( sent_bytes = sendto(socket_fd, buffer, len
-								, 0, dest_addr, LEN__SOCKADDR_IN) ) < 0 )
+	CYCLES_BEGIN(c_send);
+	sent_bytes = sendto(socket_fd, buffer, len, 0, dest_addr, LEN__SOCKADDR_IN);
+	CYCLES_END(CYCLES_SEND, c_send);
+
+	if ( sent_bytes < 0 )
 	{
-		log_sys_error("cb_broadcast_sendto (fd=%d): <sendto> ERROR.\n"
-						, socket_fd);
-		getchar();
+		UDPIP_PROBE3(tx_error, socket_fd, len, errno);
+		if ( would_block() == false )
+			{ log_sys_error("send_message (fd=%d): <sendto> ERROR.\n"
+							, socket_fd); }
 		return(EX_ERR);
 	}
 
@@ -381,6 +492,54 @@ int send_message(	const sockaddr_t* dest_addr, const int socket_fd,
 		return(EX_ERR);
 	}
 
+	UDPIP_PROBE4(tx, socket_fd, sent_bytes
+					, ((const sockaddr_in_t *)dest_addr)->sin_addr.s_addr
+					, ((const sockaddr_in_t *)dest_addr)->sin_port);
+
+	return(sent_bytes);
+
+}
+
+/* send_message_iov */
+int send_message_iov(	const sockaddr_t* dest_addr, const int socket_fd,
+						const iovec_t *iov, const int iovlen	)
+{
+
+	msg_header_t msg;
+	int sent_bytes = 0, len = 0;
+
+	for ( int i = 0; i < iovlen; i++ ) { len += iov[i].iov_len; }
+
+	memset(&msg, 0, LEN__MSG_HEADER);
+	msg.msg_name = (void *)dest_addr;
+	msg.msg_namelen = LEN__SOCKADDR_IN;
+	msg.msg_iov = (iovec_t *)iov;
+	msg.msg_iovlen = iovlen;
+
+	CYCLES_BEGIN(c_send);
+	sent_bytes = sendmsg(socket_fd, &msg, 0);
+	CYCLES_END(CYCLES_SEND, c_send);
+
+	if ( sent_bytes < 0 )
+	{
+		UDPIP_PROBE3(tx_error, socket_fd, len, errno);
+		if ( would_block() == false )
+			{ log_sys_error("send_message_iov (fd=%d): <sendmsg> ERROR.\n"
+							, socket_fd); }
+		return(EX_ERR);
+	}
+
+	if ( sent_bytes < len )
+	{
+		log_app_msg("send_message_iov: sent %d bytes, requested %d.\n"
+						, sent_bytes, len);
+		return(EX_ERR);
+	}
+
+	UDPIP_PROBE4(tx, socket_fd, sent_bytes
+					, ((const sockaddr_in_t *)dest_addr)->sin_addr.s_addr
+					, ((const sockaddr_in_t *)dest_addr)->sin_port);
+
 	return(sent_bytes);
 
 }
@@ -404,22 +563,38 @@ int recv_message(const int socket_fd, void *data)
 
 /* recv_msg */
 int recv_msg(	const int socket_fd, msg_header_t *msg,
-				const in_addr_t block_ip, bool *blocked	)
+				const in_addr_t block_ip, bool *blocked, uint64_t *rx_ns	)
 {
 
 	int rx_bytes = 0;
 
-	// 1) read UDP message from network level
-	if ( ( rx_bytes = recvmsg(socket_fd, msg, 0) ) < 0 )
+	// 1) read UDP message from network level (<recvmsg> shrinks the control
+	//		buffer to the headers of the previous message)
+	msg->msg_controllen = CONTROL_BUFFER_LEN;
+
+	CYCLES_BEGIN(c_recv);
+	rx_bytes = recvmsg(socket_fd, msg, 0);
+	CYCLES_END(CYCLES_RECV, c_recv);
+
+	if ( rx_bytes < 0 )
 	{
 		log_sys_error("recv_msg: wrong <recvmsg> call. ");
 		return(EX_ERR);
 	}
 
-	in_addr_t src_addr = get_source_address(msg);
+	CYCLES_BEGIN(c_source);
+	in_addr_t src_addr = get_source_address(msg, rx_ns);
+	CYCLES_END(CYCLES_SOURCE, c_source);
+
+	UDPIP_PROBE5(rx, socket_fd, rx_bytes, src_addr
+					, ((sockaddr_in_t *)msg->msg_name)->sin_port
+					, ( rx_ns != NULL ) ? *rx_ns : 0);
 
 	if ( block_ip == src_addr )
-		{ *blocked = true; }
+	{
+		UDPIP_PROBE3(blocked, socket_fd, rx_bytes, src_addr);
+		*blocked = true;
+	}
 	else
 		{ *blocked = false; }
 
@@ -428,10 +603,11 @@ int recv_msg(	const int socket_fd, msg_header_t *msg,
 }
 
 /* get_source_address */
-in_addr_t get_source_address(msg_header_t *msg)
+in_addr_t get_source_address(msg_header_t *msg, uint64_t *rx_ns)
 {
 
 	sockaddr_in_t *src = NULL;
+	if ( rx_ns != NULL ) { *rx_ns = 0; }
 
 	// iterate through all the control headers
 	for	(
@@ -441,6 +617,17 @@ in_addr_t get_source_address(msg_header_t *msg)
 		)
 	{
 
+		// kernel RX timestamp, SO_TIMESTAMPNS
+		if (	( rx_ns != NULL ) &&
+				( cmsg->cmsg_level	== SOL_SOCKET ) &&
+				( cmsg->cmsg_type	== SCM_TIMESTAMPNS ) )
+		{
+			struct timespec ts;
+			memcpy(&ts, CMSG_DATA(cmsg), sizeof(struct timespec));
+			*rx_ns = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+			continue;
+		}
+
 		// ignore the control headers that don't match what we want
 	    if (	( cmsg->cmsg_level 	!= IPPROTO_IP ) 	||
 	    		( cmsg->cmsg_type 	!= IP_PKTINFO ) )
@@ -448,7 +635,6 @@ in_addr_t get_source_address(msg_header_t *msg)
 
 	    //struct in_pktinfo *pi = CMSG_DATA(cmsg);
 	    src = (sockaddr_in_t *)msg->msg_name;
-	    break;
 
 	}
 
@@ -456,19 +642,54 @@ in_addr_t get_source_address(msg_header_t *msg)
 
 }
 
+/* __hex_pairs; hexadecimal rendering of every byte value */
+static const char __hex_pairs[] =
+	"000102030405060708090A0B0C0D0E0F101112131415161718191A1B1C1D1E1F"
+	"202122232425262728292A2B2C2D2E2F303132333435363738393A3B3C3D3E3F"
+	"404142434445464748494A4B4C4D4E4F505152535455565758595A5B5C5D5E5F"
+	"606162636465666768696A6B6C6D6E6F707172737475767778797A7B7C7D7E7F"
+	"808182838485868788898A8B8C8D8E8F909192939495969798999A9B9C9D9E9F"
+	"A0A1A2A3A4A5A6A7A8A9AAABACADAEAFB0B1B2B3B4B5B6B7B8B9BABBBCBDBEBF"
+	"C0C1C2C3C4C5C6C7C8C9CACBCCCDCECFD0D1D2D3D4D5D6D7D8D9DADBDCDDDEDF"
+	"E0E1E2E3E4E5E6E7E8E9EAEBECEDEEEFF0F1F2F3F4F5F6F7F8F9FAFBFCFDFEFF";
+
+/* hex_encode */
+int hex_encode(	char *out, const void *data, const int len,
+				const char separator	)
+{
+
+	const unsigned char *d = (const unsigned char *)data;
+	char *o = out;
+
+	for ( int i = 0; i < len; i++ )
+	{
+		memcpy(o, &__hex_pairs[2 * d[i]], 2);
+		o += 2;
+		if ( ( separator != '\0' ) && ( i < len - 1 ) ) { *o++ = separator; }
+	}
+
+	return(o - out);
+
+}
+
 /* print_hex_data */
 int print_hex_data(const char *buffer, const int len)
 {
 
-	int last_byte = len - 1;
+	char line[3 * BYTES_PER_LINE];
 	if ( len < 0 ) { return(EX_WRONG_PARAM); }
 
-	for ( int i = 0; i < len; i++ )
+	// every line is rendered in a buffer and written at once
+	for ( int i = 0; i < len; i += BYTES_PER_LINE )
 	{
-		if ( ( i != 0 ) && ( ( i % BYTES_PER_LINE ) == 0 ) )
-			{ log_app_msg("\n\t\t\t"); }
-		log_app_msg("%02X", 0xFF & (unsigned int)buffer[i]);
-		if ( i < last_byte ) { log_app_msg(":"); }
+
+		int bytes = ( len - i < BYTES_PER_LINE ) ? len - i : BYTES_PER_LINE;
+		int n = hex_encode(line, buffer + i, bytes, ':');
+		if ( i + bytes < len ) { line[n++] = ':'; }
+
+		if ( i != 0 ) { log_app_msg("\n\t\t\t"); }
+		log_app_msg("%.*s", n, line);
+
 	}
 
 	return(EX_OK);
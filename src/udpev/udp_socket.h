@@ -24,8 +24,12 @@
 #define UDP_SOCKET_H_
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
 #include <ifaddrs.h>
 #include <netdb.h>
 #include <sys/ioctl.h>
@@ -33,10 +37,14 @@
 #include <net/if.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <linux/net_tstamp.h>
 
 #include "../logger.h"
 #include "../execution_codes.h"
 
+#include "probes.h"
+#include "cycles.h"
+
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 // SOCKET STRUCTURES
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
@@ -104,6 +112,26 @@ msg_header_t *new_msg_header();
  */
 msg_header_t *init_msg_header(void* buffer, const int buffer_len);
 
+/**
+ * @brief Initializes a message header structure that scatters the received
+ * 			bytes over two buffers: the first header_len bytes are stored in
+ * 			the header buffer and the rest, in the data buffer.
+ * @param header Buffer where to store the first bytes of the message.
+ * @param header_len Length of the header buffer.
+ * @param buffer Buffer where to store the rest of the message.
+ * @param buffer_len Maximum length of the given buffer.
+ * @return An initialized msg_header structure.
+ */
+msg_header_t *init_msg_header_sg(	void *header, const int header_len,
+									void *buffer, const int buffer_len	);
+
+/**
+ * @brief Frees a message header structure, its control buffer, its address
+ * 			and its iovec array (the buffers they point to are not freed).
+ * @param m The message header.
+ */
+void free_msg_header(msg_header_t *m);
+
 /**
  * @brief Initializes a sockaddr_in structure for broadcasting messages in
  * 			the given port.
@@ -159,6 +187,48 @@ int set_bindtodevice_socket(const char *if_name, const int socket_fd);
 
 int set_msghdrs_socket(const int socket_fd);
 
+/**
+ * @brief Asks the kernel to timestamp every message received through the
+ * 			given socket (SO_TIMESTAMPNS, CLOCK_REALTIME).
+ * @param socket_fd File descriptor of the socket.
+ * @return EX_OK if enabled; otherwise < 0 (messages are not timestamped).
+ */
+int set_timestamp_socket(const int socket_fd);
+
+/**
+ * @brief Asks the kernel to report, through the error queue of the given
+ * 			socket, when every message sent enters the packet scheduler and
+ * 			when the driver hands it to the device (SO_TIMESTAMPING). Reports
+ * 			carry the number of the message (OPT_ID) and no payload.
+ * @param socket_fd File descriptor of the socket.
+ * @return EX_OK if enabled; otherwise < 0.
+ */
+int set_tx_timestamp_socket(const int socket_fd);
+
+/**
+ * @brief Sets the O_NONBLOCK flag of the given socket.
+ * @param socket_fd File descriptor of the socket.
+ * @return 'EX_OK' in case everything went allright; otherwise, < 0.
+ */
+int set_nonblocking_socket(const int socket_fd);
+
+/**
+ * @brief Sets the priority of the given socket, both for the local queueing
+ * 			disciplines (SO_PRIORITY) and for the network (IP_TOS).
+ * @param socket_fd File descriptor of the socket.
+ * @param priority Value for SO_PRIORITY.
+ * @param dscp DiffServ code point for the IP_TOS field.
+ * @return 'EX_OK' in case everything went allright; otherwise, < 0.
+ */
+int set_priority_socket(const int socket_fd, const int priority, const int dscp);
+
+/**
+ * @brief Checks whether the last send failed only because the buffer of a
+ * 			non-blocking socket was full.
+ */
+static inline bool would_block()
+	{ return( ( errno == EAGAIN ) || ( errno == EWOULDBLOCK ) ); }
+
 /**
  * @brief Creates and binds an UDP socket that uses the given port.
  * @param port The UDP port to be used by this socket.
@@ -198,6 +268,17 @@ int open_broadcast_udp_socket(const char *if_name, const int port);
 int send_message(	const sockaddr_t* dest_addr, const int socket_fd,
 					const void *buffer, const int len	);
 
+/**
+ * @brief Sends a message whose bytes are gathered from several buffers.
+ * @param dest_addr The destination address where the message will be sent to.
+ * @param socket_fd File descriptor of the socket to be used.
+ * @param iov Array with the buffers of the message.
+ * @param iovlen Number of buffers in the array.
+ * @return Number of bytes sent; < 0 in case of error.
+ */
+int send_message_iov(	const sockaddr_t* dest_addr, const int socket_fd,
+						const iovec_t *iov, const int iovlen	);
+
 /**
  * @brief Receives a message from the given socket..
  * @param socket_fd File descriptor of the socket to be used.
@@ -217,12 +298,13 @@ int recv_message(const int socket_fd, void *data);
  * 				headers.
  * @param block_ip IPv4 address whose messages are to flagged as "blocked".
  * @param blocked Block flag that indicates that a message is to be blocked.
+ * @param rx_ns Kernel RX timestamp of the message (ns, 0: none), or NULL.
  * @return The number of bytes read and stored in the message. If < 0, it
  * 			indicates that an error has occurred and, therefore, data and
  * 			blocked flag values shall not be taken into consideration.
  */
 int recv_msg(	const int socket_fd, msg_header_t *msg,
-				const in_addr_t block_ip, bool *blocked	);
+				const in_addr_t block_ip, bool *blocked, uint64_t *rx_ns	);
 
 /**
  * Gets the source address of the given message, by iterating along all
@@ -230,9 +312,11 @@ int recv_msg(	const int socket_fd, msg_header_t *msg,
  *
  * @param msg Structure containing the received message and all associated
  * 				headers with associated information.
+ * @param rx_ns Kernel RX timestamp found in the headers (ns, 0: none), or
+ * 				NULL if it is not needed.
  * @return Source address of the given message.
  */
-in_addr_t get_source_address(msg_header_t *msg);
+in_addr_t get_source_address(msg_header_t *msg, uint64_t *rx_ns);
 
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 // COMMON SOCKET TOOLS
@@ -240,6 +324,17 @@ in_addr_t get_source_address(msg_header_t *msg);
 
 #define BYTES_PER_LINE 5000	/**< Number of bytes per line to be printed. */
 
+/**
+ * @brief Renders data in hexadecimal, two characters per byte from a table.
+ * @param out Buffer, at least 3 * len bytes long.
+ * @param data Data to be rendered.
+ * @param len Bytes of data.
+ * @param separator Character between bytes ('\0' for none).
+ * @return Number of characters written (not NUL terminated).
+ */
+int hex_encode(	char *out, const void *data, const int len,
+				const char separator	);
+
 /**
  * @brief Prints the data field of the given IEEE 802.3 frame.
  * @param buffer The IEEE 802.3 frame whose data is to be printed.
@@ -0,0 +1,276 @@
+/**
+ * @file watchdog.c
+ * @author Ricardo Tubío (rtpardavila[at]gmail.com)
+ * @version 0.1
+ *
+ * @section LICENSE
+ *
+ * This file is part of udpip-broadcaster.
+ * udpip-broadcaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * udpip-broadcaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with udpip-broadcaster.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "watchdog.h"
+#include "control.h"
+
+__thread watchdog_t *watchdog_local = NULL;
+
+/* __log_stall; to stderr, stdout may be what blocks the loop */
+static void __log_stall(	const char *what, const uint64_t ns,
+							const int fd, const uintptr_t cb	)
+{
+
+	void *addr = (void *)cb;
+	char **symbol = ( cb != 0 ) ? backtrace_symbols(&addr, 1) : NULL;
+
+	fprintf(stderr, ">>> watchdog: %s took %.3f ms (fd=%d, callback=%s)\n"
+				, what, ns / 1e6, fd, ( symbol != NULL ) ? symbol[0] : "-");
+
+	free(symbol);
+
+}
+
+/* __backtrace; the loop thread prints where it is stuck */
+static void __backtrace(int signum)
+{
+	void *frames[WATCHDOG_FRAMES];
+	int n = backtrace(frames, WATCHDOG_FRAMES);
+	backtrace_symbols_fd(frames, n, STDERR_FILENO);
+}
+
+/* __watch; catches the loop while it is still stuck */
+static void *__watch(void *arg)
+{
+
+	watchdog_t *w = (watchdog_t *)arg;
+	struct timespec period;
+	period.tv_sec = w->threshold / 2 / 1000000000ULL;
+	period.tv_nsec = w->threshold / 2 % 1000000000ULL;
+
+	for ( ;; )
+	{
+
+		nanosleep(&period, NULL);
+
+		uint64_t since = __atomic_load_n(&w->busy_since, __ATOMIC_ACQUIRE);
+		if ( ( since == 0 ) || ( since == w->reported ) ) { continue; }
+
+		uint64_t now = watchdog_now();
+		if ( now < since + w->threshold ) { continue; }
+
+		// only once per iteration, the backtrace follows this message
+		w->reported = since;
+		int fd = __atomic_load_n(&w->fd, __ATOMIC_ACQUIRE);
+		__log_stall("loop (still running)", now - since, fd
+					, ( fd >= 0 ) ? __atomic_load_n(&w->cb, __ATOMIC_RELAXED)
+								: 0);
+		pthread_kill(w->loop_thread, WATCHDOG_SIGNAL);
+
+	}
+
+	return(NULL);
+
+}
+
+/* new_watchdog */
+watchdog_t *new_watchdog()
+{
+	watchdog_t *s = NULL;
+	if ( ( s = (watchdog_t *)malloc(LEN__WATCHDOG) ) == NULL )
+		{ handle_sys_error("new_watchdog: <malloc> returns NULL."); }
+	if ( memset(s, 0, LEN__WATCHDOG) == NULL )
+		{ handle_sys_error("new_watchdog: <memset> returns NULL."); }
+	return(s);
+}
+
+/* init_watchdog */
+watchdog_t *init_watchdog(struct ev_loop *loop, const int threshold_ms)
+{
+
+	watchdog_t *s = new_watchdog();
+	void *frames[1];
+	struct sigaction sa;
+	pthread_attr_t attr;
+
+	s->loop = loop;
+	s->threshold = (uint64_t)threshold_ms * 1000000ULL;
+	s->fd = s->slowest_fd = -1;
+	s->lag = init_latency(loop, "lag");
+	s->callbacks = init_latency(loop, "callback");
+	s->loop_thread = pthread_self();
+
+	// 1) <backtrace> may allocate memory the first time it is called, which
+	//		must not happen inside of the signal handler
+	backtrace(frames, 1);
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = __backtrace;
+	sa.sa_flags = SA_RESTART;
+	sigemptyset(&sa.sa_mask);
+	if ( sigaction(WATCHDOG_SIGNAL, &sa, NULL) < 0 )
+		{ handle_sys_error("init_watchdog: <sigaction> returns error."); }
+
+	// 2) the poll return is marked before any other callback is invoked,
+	//		the iteration is accounted after every other prepare watcher
+	ev_check_init(&s->check, cb_watchdog_check);
+	ev_set_priority(&s->check, EV_MAXPRI);
+	s->check.data = s;
+	ev_check_start(loop, &s->check);
+
+	ev_prepare_init(&s->prepare, cb_watchdog_prepare);
+	ev_set_priority(&s->prepare, EV_MINPRI);
+	ev_prepare_start(loop, &s->prepare);
+
+	watchdog_local = s;
+
+	// 3) the watchdog thread runs until the process exits
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	if ( pthread_create(&s->thread, &attr, __watch, s) != 0 )
+		{ handle_sys_error("init_watchdog: <pthread_create> returns error."); }
+	pthread_attr_destroy(&attr);
+
+	return(s);
+
+}
+
+/* watchdog_set_stats */
+void watchdog_set_stats(watchdog_t *w, stats_block_t *b)
+{
+	w->stats = b;
+	stats_loop(b, w->stalls, w->lag->max);
+}
+
+/* watchdog_reset */
+void watchdog_reset(watchdog_t *w)
+{
+	latency_reset(w->lag);
+	latency_reset(w->callbacks);
+	w->iterations = w->stalls = w->slow_callbacks = 0;
+	stats_loop(w->stats, w->stalls, w->lag->max);
+}
+
+/* watchdog_control */
+int watchdog_control(	void *arg, int argc, char **argv,
+						char *out, const int out_len	)
+{
+
+	watchdog_t *w = (watchdog_t *)arg;
+
+	if ( ( argc == 2 ) && ( strcmp(argv[1], "reset") == 0 ) )
+	{
+		watchdog_reset(w);
+		return(control_append(out, out_len, "watchdog reset\n"));
+	}
+	if ( argc != 1 )
+		{ return(control_append(out, out_len, "usage: %s [reset]\n"
+									, argv[0])); }
+
+	int n = control_append(out, out_len, "iterations=%llu stalls=%llu" \
+							" slow_callbacks=%llu threshold=%llu (ns)\n"
+							, (unsigned long long)w->iterations
+							, (unsigned long long)w->stalls
+							, (unsigned long long)w->slow_callbacks
+							, (unsigned long long)w->threshold);
+
+	const latency_t *h[2] = { w->lag, w->callbacks };
+	for ( int i = 0; i < 2; i++ )
+	{
+		n += control_append(out + n, out_len - n, "%-8s count=%llu" \
+				" p50=%llu p99=%llu p999=%llu max=%llu (ns)\n"
+				, h[i]->name, (unsigned long long)h[i]->total
+				, (unsigned long long)latency_percentile(h[i], 0.5)
+				, (unsigned long long)latency_percentile(h[i], 0.99)
+				, (unsigned long long)latency_percentile(h[i], 0.999)
+				, (unsigned long long)h[i]->max);
+	}
+
+	return(n);
+
+}
+
+/* watchdog_callback */
+void watchdog_callback(watchdog_t *w, const uint64_t now)
+{
+
+	uint64_t ns = now - w->cb_since;
+	latency_add(w->callbacks, w->cb_since, now);
+
+	if ( ns > w->slowest )
+	{
+		w->slowest = ns;
+		w->slowest_fd = w->fd;
+		w->slowest_cb = w->cb;
+	}
+
+	if ( ns < w->threshold ) { return; }
+
+	w->slow_callbacks++;
+	__log_stall("callback", ns, w->fd, w->cb);
+
+}
+
+/* print_watchdog */
+void print_watchdog(const watchdog_t *w)
+{
+	log_app_msg(">>> Watchdog = \n{\n");
+	log_app_msg("\t.threshold = %llu ns\n", (unsigned long long)w->threshold);
+	log_app_msg("\t.signal = %d\n", WATCHDOG_SIGNAL);
+	log_app_msg("\t.iterations = %llu\n", (unsigned long long)w->iterations);
+	log_app_msg("\t.stalls = %llu\n", (unsigned long long)w->stalls);
+	log_app_msg("\t.slow_callbacks = %llu\n"
+					, (unsigned long long)w->slow_callbacks);
+	log_app_msg("}\n");
+}
+
+/* cb_watchdog_check */
+void cb_watchdog_check(struct ev_loop *loop, ev_check *watcher, int revents)
+{
+
+	watchdog_t *w = (watchdog_t *)watcher->data;
+
+	w->slowest = 0;
+	w->slowest_fd = -1;
+	w->slowest_cb = 0;
+
+	__atomic_store_n(&w->busy_since, watchdog_now(), __ATOMIC_RELEASE);
+
+}
+
+/* cb_watchdog_prepare */
+void cb_watchdog_prepare(struct ev_loop *loop, ev_prepare *watcher
+							, int revents)
+{
+
+	watchdog_t *w = (watchdog_t *)watcher;
+	uint64_t since = w->busy_since;
+	if ( since == 0 ) { return; }
+
+	uint64_t now = watchdog_now();
+	__atomic_store_n(&w->busy_since, 0, __ATOMIC_RELEASE);
+
+	uint64_t max = w->lag->max;
+	latency_add(w->lag, since, now);
+	w->iterations++;
+
+	if ( now - since >= w->threshold )
+	{
+		w->stalls++;
+		__log_stall("loop iteration", now - since
+					, w->slowest_fd, w->slowest_cb);
+	}
+	else if ( w->lag->max == max ) { return; }
+
+	stats_loop(w->stats, w->stalls, w->lag->max);
+
+}
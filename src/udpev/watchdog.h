@@ -0,0 +1,203 @@
+/**
+ * @file watchdog.h
+ * @author Ricardo Tubío (rtpardavila[at]gmail.com)
+ * @version 0.1
+ *
+ * @section LICENSE
+ *
+ * This file is part of udpip-broadcaster.
+ * udpip-broadcaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * udpip-broadcaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with udpip-broadcaster.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Event loop watchdog: a prepare/check pair of watchers measures the time the
+ * loop spends running callbacks in every iteration (its lag, since the poll
+ * returned until it is entered again) and socket callbacks are timed one by
+ * one. Iterations and callbacks over the threshold are counted and logged
+ * with the socket and callback involved; a watchdog thread catches the loop
+ * while it is still stuck and makes it print its own backtrace.
+ */
+
+#ifndef WATCHDOG_H_
+#define WATCHDOG_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <execinfo.h>
+#include <ev.h>
+
+#include "../execution_codes.h"
+#include "../logger.h"
+
+#include "latency.h"
+#include "stats.h"
+
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// DATA STRUCTURES
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+#define WATCHDOG_SIGNAL SIGUSR2		/**< Asks the loop for its backtrace. */
+#define WATCHDOG_FRAMES 32			/**< Frames of the backtraces. */
+
+/**
+ * @struct watchdog
+ * @brief Lag and stall accounting of an event loop.
+ */
+typedef struct watchdog
+{
+
+	ev_prepare prepare;				/**< Loop about to poll (MUST be 1st). */
+	ev_check check;					/**< Poll returned. */
+	struct ev_loop *loop;			/**< Watched loop. */
+	uint64_t threshold;				/**< Stall threshold (ns). */
+	stats_block_t *stats;			/**< Where counters are published. */
+
+	pthread_t loop_thread;			/**< Thread that runs the loop. */
+	pthread_t thread;				/**< Watchdog thread. */
+	uint64_t reported;				/**< Stall reported by the thread. */
+
+	uint64_t busy_since;			/**< Poll return (ns), 0 while polling. */
+	int fd;							/**< Socket being served, -1 if none. */
+	uintptr_t cb;					/**< Callback serving it. */
+	uint64_t cb_since;				/**< Start of that callback (ns). */
+
+	int slowest_fd;					/**< Slowest socket of the iteration. */
+	uintptr_t slowest_cb;			/**< Its callback. */
+	uint64_t slowest;				/**< Its time (ns). */
+
+	uint64_t iterations;			/**< Loop iterations. */
+	uint64_t stalls;				/**< Iterations over the threshold. */
+	uint64_t slow_callbacks;		/**< Callbacks over the threshold. */
+	latency_t *lag;					/**< Time running callbacks, per iter. */
+	latency_t *callbacks;			/**< Time per socket callback. */
+
+} watchdog_t;
+
+#define LEN__WATCHDOG sizeof(watchdog_t)
+
+/**< Watchdog of the loop run by the calling thread, NULL if none. */
+extern __thread watchdog_t *watchdog_local;
+
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+// WATCHDOG MANAGEMENT
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+/**
+ * @brief Allocates memory for a watchdog structure.
+ * @return A pointer to the newly allocated block of memory.
+ */
+watchdog_t *new_watchdog();
+
+/**
+ * @brief Starts watching the loop run by the calling thread.
+ * @param loop The loop.
+ * @param threshold_ms Iterations and callbacks longer than this are stalls.
+ * @return A pointer to the initialized structure.
+ */
+watchdog_t *init_watchdog(struct ev_loop *loop, const int threshold_ms);
+
+/**
+ * @brief Publishes the stall counters in a block of the shared statistics
+ * 			segment.
+ * @param w The watchdog.
+ * @param b The block.
+ */
+void watchdog_set_stats(watchdog_t *w, stats_block_t *b);
+
+/**
+ * @brief Empties the histograms and the counters.
+ * @param w The watchdog.
+ */
+void watchdog_reset(watchdog_t *w);
+
+/**
+ * @brief Handler of the "watchdog" control command.
+ * 			watchdog: lag and stalls; watchdog reset: empties them.
+ * @return Number of bytes written to the response.
+ */
+int watchdog_control(	void *arg, int argc, char **argv,
+						char *out, const int out_len	);
+
+/**
+ * @brief Accounts the socket callback that just ended; slow ones are logged.
+ * @param w The watchdog.
+ * @param now Current time (ns).
+ */
+void watchdog_callback(watchdog_t *w, const uint64_t now);
+
+/**
+ * @brief Prints the configuration and the counters of the watchdog.
+ * @param w The watchdog.
+ */
+void print_watchdog(const watchdog_t *w);
+
+/**
+ * @brief Callback that marks the return of the poll.
+ */
+void cb_watchdog_check(struct ev_loop *loop, ev_check *watcher, int revents);
+
+/**
+ * @brief Callback that accounts the iteration, before polling again.
+ */
+void cb_watchdog_prepare(struct ev_loop *loop, ev_prepare *watcher
+							, int revents);
+
+/**
+ * @brief Current time of the watchdog clock (CLOCK_MONOTONIC, ns).
+ */
+static inline uint64_t watchdog_now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return(latency_ns(&ts));
+}
+
+/**
+ * @brief Marks the start of a socket callback of the calling thread.
+ * @param fd Socket served.
+ * @param cb Address of the callback that serves it.
+ */
+static inline void watchdog_enter(const int fd, const uintptr_t cb)
+{
+
+	watchdog_t *w = watchdog_local;
+	if ( w == NULL ) { return; }
+
+	w->cb_since = watchdog_now();
+	__atomic_store_n(&w->cb, cb, __ATOMIC_RELAXED);
+	__atomic_store_n(&w->fd, fd, __ATOMIC_RELEASE);
+
+}
+
+/**
+ * @brief Marks the end of a socket callback of the calling thread.
+ */
+static inline void watchdog_leave()
+{
+
+	watchdog_t *w = watchdog_local;
+	if ( w == NULL ) { return; }
+
+	watchdog_callback(w, watchdog_now());
+	__atomic_store_n(&w->fd, -1, __ATOMIC_RELEASE);
+
+}
+
+#endif /* WATCHDOG_H_ */
@@ -0,0 +1,226 @@
+/**
+ * @file udpipstat.c
+ * @author Ricardo Tubío (rtpardavila[at]gmail.com)
+ * @version 0.1
+ *
+ * @section LICENSE
+ *
+ * This file is part of udpip-broadcaster.
+ * udpip-broadcaster is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * udpip-broadcaster is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with udpip-broadcaster.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Reader of the statistics segment published by udpipbroadcaster (--stats):
+ * prints the rates of every block once per interval, like vmstat does, with
+ * the percentiles of the forwarding latency since the daemon started. The
+ * segment is only mapped and read, the daemon does not take part at all.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <signal.h>
+#include <time.h>
+
+#include "execution_codes.h"
+#include "logger.h"
+#include "udpev/stats.h"
+
+/************************************************** Application definitions */
+
+static const char* __x_app_name = "udpipstat";
+static const char* __x_app_version = "0.1";
+
+#define __HEADER_EVERY 20		/**< Lines between headers. */
+#define __MAX_BLOCKS 8			/**< Max. blocks shown. */
+
+/******************************************************* INTERNAL FUNCTIONS */
+
+/* print_help */
+static void print_help()
+{
+	fprintf(stdout, "HELP, %s\n", __x_app_name);
+	fprintf(stdout, "usage: %s [-n /name] [-i seconds] [-c count]\n"
+					, __x_app_name);
+	fprintf(stdout, "\t-n, --name\tstatistics segment (default %s)\n"
+					, STATS_DEFAULT_NAME);
+	fprintf(stdout, "\t-i, --interval\tseconds between samples (default 1)\n");
+	fprintf(stdout, "\t-c, --count\tnumber of samples (default: forever)\n");
+}
+
+/* print_version */
+static void print_version()
+{
+	fprintf(stdout, "Version = %s\n", __x_app_version);
+}
+
+/* __alive */
+static bool __alive(const pid_t pid)
+{
+	return( ( kill(pid, 0) == 0 ) || ( errno == EPERM ) );
+}
+
+/* __print_header */
+static void __print_header()
+{
+	log_app_msg("%-5s %10s %10s %10s %10s %9s %9s %9s %8s %8s %8s %8s" \
+				"  %s\n"
+				, "block", "rx/s", "rx kB/s", "tx/s", "tx kB/s"
+				, "blocked/s", "errors/s", "drops/s"
+				, "p50 us", "p99 us", "p999 us", "stalls", "queued");
+}
+
+/* __print_rates */
+static void __print_rates(	const stats_block_t *cur,
+							const stats_block_t *prev, const double secs	)
+{
+
+	char queued[STATS_QUEUES * 11 + 1] = "-";
+	int off = 0;
+
+	for ( int i = 0; i < (int)cur->no_queues && i < STATS_QUEUES; i++ )
+		{ off += snprintf(queued + off, sizeof(queued) - off
+							, ( i == 0 ) ? "%u" : "/%u", cur->queued[i]); }
+
+	log_app_msg("%-5.*s %10.1f %10.1f %10.1f %10.1f %9.1f %9.1f %9.1f" \
+				" %8.1f %8.1f %8.1f %8u  %s\n"
+		, STATS_NAME_LEN, cur->name
+		, ( cur->rx_packets - prev->rx_packets ) / secs
+		, ( cur->rx_bytes - prev->rx_bytes ) / secs / 1000.0
+		, ( cur->tx_packets - prev->tx_packets ) / secs
+		, ( cur->tx_bytes - prev->tx_bytes ) / secs / 1000.0
+		, ( cur->blocked - prev->blocked ) / secs
+		, ( cur->errors - prev->errors ) / secs
+		, ( cur->drops - prev->drops ) / secs
+		, cur->lat_p50 / 1000.0, cur->lat_p99 / 1000.0
+		, cur->lat_p999 / 1000.0
+		, cur->stalls - prev->stalls, queued);
+
+}
+
+/* main */
+int main(int argc, char **argv)
+{
+
+	const char *name = STATS_DEFAULT_NAME;
+	double interval = 1.0;
+	long count = 0;
+	int idx = 0, read = 0;
+
+	static struct option args[] =
+	{
+		{"help",	no_argument,		NULL,	'h'	},
+		{"version",	no_argument,		NULL,	'v'	},
+		{"name",	required_argument,	NULL,	'n'	},
+		{"interval",	required_argument,	NULL,	'i'	},
+		{"count",	required_argument,	NULL,	'c'	},
+		{0,0,0,0}
+	};
+
+	while
+		( ( read = getopt_long(argc, argv, "hvn:i:c:", args, &idx) ) > -1 )
+	{
+
+		switch(read)
+		{
+			case 'n':
+
+				name = optarg;
+				break;
+
+			case 'i':
+
+				if ( ( interval = atof(optarg) ) <= 0.0 )
+					{ handle_app_error("Interval must be > 0.\n"); }
+				break;
+
+			case 'c':
+
+				if ( ( count = atol(optarg) ) < 0 )
+					{ handle_app_error("Count must be >= 0.\n"); }
+				break;
+
+			case 'v':
+
+				print_version();
+				exit(EXIT_SUCCESS);
+				break;
+
+			case 'h':
+			default:
+
+				print_help();
+				exit(EXIT_SUCCESS);
+				break;
+		}
+
+	}
+
+	// 1) the segment is mapped once, samples are plain memory reads
+	const stats_segment_t *g = NULL;
+	if ( ( g = open_stats_segment(name) ) == NULL )
+		{ handle_app_error("No statistics segment %s (is udpipbroadcaster " \
+							"running with --stats?).\n", name); }
+
+	int no_blocks = ( g->header.no_blocks < __MAX_BLOCKS ) ?
+						(int)g->header.no_blocks : __MAX_BLOCKS;
+	stats_block_t cur[__MAX_BLOCKS], prev[__MAX_BLOCKS];
+	memset(prev, 0, sizeof(prev));
+
+	// 2) the first sample shows the averages since the daemon started
+	double secs = difftime(time(NULL), (time_t)g->header.started);
+	if ( secs < 1.0 ) { secs = 1.0; }
+
+	struct timespec next;
+	clock_gettime(CLOCK_MONOTONIC, &next);
+
+	for ( long n = 0; ( count == 0 ) || ( n < count ); n++ )
+	{
+
+		if ( __alive(g->header.pid) == false )
+			{ handle_app_error("udpipbroadcaster (pid %u) is not running.\n"
+								, g->header.pid); }
+
+		if ( n % __HEADER_EVERY == 0 ) { __print_header(); }
+
+		for ( int i = 0; i < no_blocks; i++ )
+		{
+			if ( stats_snapshot(stats_segment_block(g, i), &cur[i]) < 0 )
+				{ handle_app_error("Block %d is inconsistent.\n", i); }
+			__print_rates(&cur[i], &prev[i], secs);
+		}
+
+		fflush(stdout);
+		memcpy(prev, cur, sizeof(cur));
+
+		if ( ( count != 0 ) && ( n + 1 >= count ) ) { break; }
+
+		// 3) absolute deadlines, the samples do not drift
+		next.tv_sec += (time_t)interval;
+		next.tv_nsec += (long)( ( interval - (time_t)interval ) * 1e9 );
+		if ( next.tv_nsec >= 1000000000L )
+			{ next.tv_sec++; next.tv_nsec -= 1000000000L; }
+		while ( clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL)
+					== EINTR ) {}
+
+		secs = interval;
+
+	}
+
+	exit(EXIT_SUCCESS);
+
+}